@@ -0,0 +1,64 @@
+#version 330 core
+// Atributte 0 of the vertex
+layout (location = 0) in vec3 vertexPosition;
+// Atributte 1 of the vertex
+layout (location = 1) in vec3 vertexColor;
+// Particle's stored state, one per instance. Compact particles store the position as a fraction of
+// the bounds and the scales as a fraction of the maximun scale
+layout (location = 2) in vec3 instancePosition;
+layout (location = 3) in vec3 instanceDirection;
+layout (location = 4) in float instanceStateTime;
+layout (location = 5) in float instanceTTL;
+layout (location = 6) in vec4 instanceInitialColor;
+layout (location = 7) in vec4 instanceFinalColor;
+layout (location = 8) in float instanceInitialScale;
+layout (location = 9) in float instanceFinalScale;
+layout (location = 10) in float instanceLiveTime;
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform vec3 cameraPosition;
+uniform vec3 cameraUp;
+// Simulated time of the particle system
+uniform float time;
+// Constant force applied to every particle
+uniform vec3 externalForce;
+// Range of the compact particles, (0, 1, 1) for the full precision particles
+uniform vec3 boundsMin;
+uniform vec3 boundsSize;
+uniform float maxScale;
+
+// Vertex data out data
+out vec4 vColor;
+out vec2 textCoord;
+
+void main()
+{
+    // Same closed form as Particle::advance
+    float age = time - instanceStateTime;
+    float ttl = instanceTTL - age;
+    if (ttl <= 0.0f)
+    {
+        // Dead particles are moved outside the clip volume
+        vColor = vec4(0.0f);
+        textCoord = vec2(0.0f);
+        gl_Position = vec4(2.0f, 2.0f, 2.0f, 1.0f);
+        return;
+    }
+    vec3 position = boundsMin + instancePosition * boundsSize;
+    position += instanceDirection * age + 0.5f * externalForce * age * age;
+
+    // Same interpolation as Particle::getScale and Particle::getColor
+    float lifeFraction = clamp(1.0f - ttl / instanceLiveTime, 0.0f, 1.0f);
+    float scale = maxScale * mix(instanceInitialScale, instanceFinalScale, lifeFraction);
+
+    // Same billboard as Particle::computeBillBoardMatrix, the quad faces the camera
+    vec3 front = normalize(cameraPosition - position);
+    vec3 right = normalize(cross(cameraUp, front));
+    vec3 up = normalize(cross(front, right));
+
+    vec2 corner = scale * vertexPosition.xy;
+    vColor = mix(instanceInitialColor, instanceFinalColor, lifeFraction);
+    textCoord = vec2(vertexPosition.xy + 0.5);
+    gl_Position = projection * view * vec4(position + corner.x * right + corner.y * up, 1.0f);
+}
\ No newline at end of file
@@ -0,0 +1,15 @@
+#version 330 core
+// Particle color (per instance)
+in vec4 vColor;
+in vec2 textCoord;
+
+uniform sampler2D text1;
+
+// Fragment Color
+out vec4 fragColor;
+
+void main()
+{
+    vec4 textureColor = texture(text1, textCoord);
+    fragColor = textureColor * vColor;
+}
\ No newline at end of file
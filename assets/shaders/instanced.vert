@@ -0,0 +1,31 @@
+#version 330 core
+// Atributte 0 of the vertex
+layout (location = 0) in vec3 vertexPosition;
+// Atributte 1 of the vertex
+layout (location = 1) in vec3 vertexColor;
+// Particle's position (xyz) and scale (w), one per instance
+layout (location = 2) in vec4 instancePositionScale;
+// Particle's color and alpha, one per instance
+layout (location = 3) in vec4 instanceColor;
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform vec3 cameraPosition;
+uniform vec3 cameraUp;
+
+// Vertex data out data
+out vec4 vColor;
+out vec2 textCoord;
+
+void main()
+{
+    // Same billboard as Particle::computeBillBoardMatrix, the quad faces the camera
+    vec3 front = normalize(cameraPosition - instancePositionScale.xyz);
+    vec3 right = normalize(cross(cameraUp, front));
+    vec3 up = normalize(cross(front, right));
+
+    vec2 corner = instancePositionScale.w * vertexPosition.xy;
+    vColor = instanceColor;
+    textCoord = vec2(vertexPosition.xy + 0.5);
+    gl_Position = projection * view * vec4(instancePositionScale.xyz + corner.x * right + corner.y * up, 1.0f);
+}
\ No newline at end of file
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+/**
+ * Thread safe FIFO queue with a fixed capacity
+ * Producers block while the queue is full, so work is never dropped,
+ * consumers block while the queue is empty
+*/
+template <typename T>
+class BoundedQueue
+{
+public:
+    /**
+     * Creates a queue
+     * @param capacity Maximun number of items waiting in the queue
+    */
+    BoundedQueue(size_t capacity)
+    {
+        this->capacity = capacity > 0 ? capacity : 1;
+        this->closed = false;
+    }
+    /**
+     * Adds an item at the end of the queue, waits while the queue is full
+     * @param item Item to be added
+     * @return False if the queue was closed and the item was not added
+    */
+    bool push(T &&item)
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->notFull.wait(lock, [this] { return this->closed || this->items.size() < this->capacity; });
+
+        if (this->closed)
+            return false;
+
+        this->items.push_back(std::move(item));
+        this->notEmpty.notify_one();
+        return true;
+    }
+    /**
+     * Removes the first item of the queue, waits while the queue is empty
+     * @param item Where the removed item will be stored
+     * @return False if the queue is closed and there are no items left
+    */
+    bool pop(T &item)
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->notEmpty.wait(lock, [this] { return this->closed || !this->items.empty(); });
+
+        if (this->items.empty())
+            return false;
+
+        item = std::move(this->items.front());
+        this->items.pop_front();
+        this->notFull.notify_one();
+        return true;
+    }
+    /**
+     * Closes the queue, wakes up every waiting producer and consumer
+     * The items already in the queue can still be popped
+    */
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->closed = true;
+        this->notFull.notify_all();
+        this->notEmpty.notify_all();
+    }
+    /**
+     * Gets the number of items waiting in the queue
+     * @return Number of items in the queue
+    */
+    size_t size()
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        return this->items.size();
+    }
+
+private:
+    std::mutex mutex;                       // Protects the items and the closed flag
+    std::condition_variable notFull;        // Signaled when an item is removed
+    std::condition_variable notEmpty;       // Signaled when an item is added
+    std::deque<T> items;                    // Items waiting in the queue
+    size_t capacity;                        // Maximun number of items in the queue
+    bool closed;                            // The queue doesn't accept new items
+};
@@ -0,0 +1,473 @@
+#include "collider.h"
+
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+
+#include "mapped-file.h"
+
+const char *colliderNames[NUMBER_OF_COLLIDER_TYPES] = {"plane", "sphere", "box", "sdf", "heightfield"};
+const char *colliderResponseNames[NUMBER_OF_COLLIDER_RESPONSES] = {"bounce", "kill", "stick"};
+
+namespace
+{
+const char distanceVolumeMagic[8] = {'S', 'D', 'F', 'V', 'O', 'L', 'U', 'M'};
+/**
+ * Volume loaded from a file, with the time of the file it was loaded from
+*/
+struct LoadedVolume
+{
+    long long modificationTime;                   // Modification time of the file when it was loaded, -1 if it didn't exist
+    std::shared_ptr<const DistanceVolume> volume; // Volume, NULL if it didn't load
+};
+// The volumes are shared by every collider using their file. The ones that failed are NULL so they're only reported once,
+// a file is loaded again when its modification time changes so a fixed file loads without restarting
+std::map<std::string, LoadedVolume> loadedVolumes;
+// Samples along each axis of a distance volume file, bounds the memory a file can ask for (512 MB) and keeps the indices in 32 bits
+const unsigned int maxDistanceVolumeResolution = 512;
+// Particles of a heightfield sampled at once
+const unsigned int heightFieldBlock = 64;
+
+/**
+ * First bytes of a distance volume file
+*/
+struct DistanceVolumeHeader
+{
+    char magic[8];              // distanceVolumeMagic
+    unsigned int resolution[3]; // Number of samples along each axis
+    float boundsMin[3];         // Position of the first sample
+    float boundsMax[3];         // Position of the last sample
+};
+
+/**
+ * Checks the resolution of a distance volume file
+ * @param resolution Number of samples along each axis
+ * @return Every axis has between 2 and maxDistanceVolumeResolution samples
+*/
+bool isValidResolution(const unsigned int resolution[3])
+{
+    for (int axis = 0; axis < 3; axis++)
+        if (resolution[axis] < 2 || resolution[axis] > maxDistanceVolumeResolution)
+            return false;
+    return true;
+}
+
+/**
+ * Gets the number of samples of a distance volume
+ * @param resolution Number of samples along each axis, valid so the product can't overflow 64 bits
+ * @return Number of samples
+*/
+unsigned long long getSampleCount(const unsigned int resolution[3])
+{
+    return (unsigned long long)resolution[0] * resolution[1] * resolution[2];
+}
+
+/**
+ * Collider with the values used for each particle computed once per range
+*/
+struct PreparedCollider
+{
+    const Collider *collider; // Source collider
+    glm::vec3 size;           // Normalized normal of the plane, radius of the sphere (x), half extents of the box, size of the terrain
+    float scale;              // Scale of the volume
+};
+
+/**
+ * Applies the response of a collider to a particle touching it
+ * @param collider Collider touched
+ * @param particle Particle inside the collider
+ * @param push Displacement that moves the particle back to the surface
+ * @param normal Direction out of the collider
+*/
+void respond(const Collider &collider, Particle &particle, glm::vec3 push, glm::vec3 normal)
+{
+    if (collider.response == COLLIDER_KILL)
+    {
+        particle.kill();
+        return;
+    }
+
+    particle.translate(push);
+    if (collider.response == COLLIDER_STICK)
+    {
+        // The rest of its life is shortened to the fade, the particles already fading keep fading
+        particle.setDirection(glm::vec3(0.0f));
+        particle.fade(collider.restitution);
+        return;
+    }
+
+    // The speed into the surface is reflected and the speed along it slowed down
+    const glm::vec3 direction = particle.getDirection();
+    const float normalSpeed = glm::dot(direction, normal);
+    if (normalSpeed < 0.0f)
+    {
+        const glm::vec3 tangent = direction - normalSpeed * normal;
+        particle.setDirection(tangent * (1.0f - collider.friction) - normal * (normalSpeed * collider.restitution));
+    }
+}
+
+/**
+ * Collides a range of particles with a heightfield
+ * The particles are gathered in blocks, the heights of a block are sampled at once
+ * @param prepared Heightfield collider
+ * @param particles First particle of the range
+ * @param count Number of particles
+ * @return Number of particles below the surface
+*/
+unsigned int collideHeightField(const PreparedCollider &prepared, Particle *particles, unsigned int count)
+{
+    const Collider &collider = *prepared.collider;
+    const glm::vec3 inverseSize = 1.0f / prepared.size;
+    unsigned int indices[heightFieldBlock];
+    float x[heightFieldBlock], y[heightFieldBlock], z[heightFieldBlock], heights[heightFieldBlock];
+    unsigned int contacts = 0;
+    for (unsigned int first = 0; first < count; first += heightFieldBlock)
+    {
+        const unsigned int end = glm::min(first + heightFieldBlock, count);
+        unsigned int blockCount = 0;
+        for (unsigned int i = first; i < end; i++)
+            if (particles[i].isAlive())
+            {
+                const glm::vec3 position = (particles[i].getPosition() - collider.position) * inverseSize;
+                indices[blockCount] = i;
+                x[blockCount] = position.x;
+                y[blockCount] = position.y;
+                z[blockCount] = position.z;
+                blockCount++;
+            }
+
+        collider.heightField->sample(x, z, blockCount, heights);
+        for (unsigned int k = 0; k < blockCount; k++)
+        {
+            if (y[k] >= heights[k])
+                continue;
+
+            // The particle is pushed straight up, the normal comes from the slope scaled to the size of the terrain.
+            // Only the bounces use it
+            glm::vec3 normal(0.0f, 1.0f, 0.0f);
+            if (collider.response == COLLIDER_BOUNCE)
+            {
+                const glm::vec2 slope = collider.heightField->slope(x[k], z[k]);
+                normal = glm::normalize(glm::vec3(-slope.x * prepared.size.y * inverseSize.x, 1.0f, -slope.y * prepared.size.y * inverseSize.z));
+            }
+            respond(collider, particles[indices[k]], glm::vec3(0.0f, (heights[k] - y[k]) * prepared.size.y, 0.0f), normal);
+            contacts++;
+        }
+    }
+    return contacts;
+}
+
+/**
+ * Finds how deep a particle is inside a collider
+ * @param prepared Collider
+ * @param position Position of the particle
+ * @param normal Where the direction out of the collider is stored, only when the particle touches it
+ * @return Signed distance to the surface, negative inside
+*/
+float colliderDistance(const PreparedCollider &prepared, glm::vec3 position, glm::vec3 &normal)
+{
+    const Collider &collider = *prepared.collider;
+    const glm::vec3 offset = position - collider.position;
+    switch (collider.type)
+    {
+    case COLLIDER_PLANE:
+        normal = prepared.size;
+        return glm::dot(offset, prepared.size);
+    case COLLIDER_SPHERE:
+    {
+        const float distance = glm::length(offset);
+        normal = distance > 0.0f ? offset / distance : glm::vec3(0.0f, 1.0f, 0.0f);
+        return distance - prepared.size.x;
+    }
+    case COLLIDER_BOX:
+    {
+        const glm::vec3 q = glm::abs(offset) - prepared.size;
+        const float inside = glm::max(q.x, glm::max(q.y, q.z));
+        if (inside > 0.0f)
+        {
+            // Outside, the normal points from the closest point of the box
+            const glm::vec3 outside = glm::max(q, glm::vec3(0.0f));
+            const float distance = glm::length(outside);
+            normal = glm::sign(offset) * outside / distance;
+            return distance;
+        }
+        // Inside, the particle leaves through the closest face
+        const int axis = q.x == inside ? 0 : (q.y == inside ? 1 : 2);
+        normal = glm::vec3(0.0f);
+        normal[axis] = offset[axis] < 0.0f ? -1.0f : 1.0f;
+        return inside;
+    }
+    case COLLIDER_SDF:
+    {
+        const glm::vec3 local = offset / prepared.scale;
+        const float distance = collider.volume->sample(local) * prepared.scale;
+        if (distance < 0.0f)
+            normal = collider.volume->normal(local);
+        return distance;
+    }
+    }
+    return INFINITY;
+}
+
+/**
+ * Checks if a collider can touch the particles inside a box
+ * @param prepared Collider
+ * @param boundsMin Bounding box of the particles
+ * @param boundsMax
+ * @return The collider touches the box
+*/
+bool colliderTouches(const PreparedCollider &prepared, glm::vec3 boundsMin, glm::vec3 boundsMax)
+{
+    const Collider &collider = *prepared.collider;
+    switch (collider.type)
+    {
+    case COLLIDER_PLANE:
+    {
+        // Distance of the corner of the box the farthest behind the plane
+        const glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+        const glm::vec3 halfExtents = (boundsMax - boundsMin) * 0.5f;
+        return glm::dot(center - collider.position, prepared.size) - glm::dot(halfExtents, glm::abs(prepared.size)) < 0.0f;
+    }
+    case COLLIDER_SPHERE:
+    {
+        const glm::vec3 closest = glm::clamp(collider.position, boundsMin, boundsMax);
+        const glm::vec3 offset = closest - collider.position;
+        return glm::dot(offset, offset) < prepared.size.x * prepared.size.x;
+    }
+    case COLLIDER_BOX:
+        return glm::all(glm::lessThan(collider.position - prepared.size, boundsMax)) &&
+               glm::all(glm::greaterThan(collider.position + prepared.size, boundsMin));
+    case COLLIDER_SDF:
+    {
+        // The shape has to be inside the bounds of its volume
+        glm::vec3 volumeMin, volumeMax;
+        collider.volume->getBounds(volumeMin, volumeMax);
+        volumeMin = collider.position + volumeMin * prepared.scale;
+        volumeMax = collider.position + volumeMax * prepared.scale;
+        return glm::all(glm::lessThan(volumeMin, boundsMax)) && glm::all(glm::greaterThan(volumeMax, boundsMin));
+    }
+    case COLLIDER_HEIGHTFIELD:
+        // Solid below the terrain
+        return collider.position.x < boundsMax.x && collider.position.x + prepared.size.x > boundsMin.x &&
+               collider.position.z < boundsMax.z && collider.position.z + prepared.size.z > boundsMin.z &&
+               boundsMin.y < collider.position.y + prepared.size.y;
+    }
+    return false;
+}
+} // namespace
+
+DistanceVolume::DistanceVolume(glm::uvec3 resolution, glm::vec3 boundsMin, glm::vec3 boundsMax, const std::vector<float> &distances)
+{
+    this->resolution = resolution;
+    this->boundsMin = boundsMin;
+    this->boundsMax = boundsMax;
+    this->inverseSpacing = glm::vec3(resolution - glm::uvec3(1)) / (boundsMax - boundsMin);
+    this->distances = distances;
+}
+
+std::shared_ptr<const DistanceVolume> DistanceVolume::load(const std::string &path)
+{
+    const long long modificationTime = getModificationTime(path);
+    const auto loaded = loadedVolumes.find(path);
+    if (loaded != loadedVolumes.end() && loaded->second.modificationTime == modificationTime)
+        return loaded->second.volume;
+
+    std::shared_ptr<const DistanceVolume> volume;
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    const unsigned long long fileSize = file ? (unsigned long long)file.tellg() : 0;
+    file.seekg(0);
+    DistanceVolumeHeader header;
+    if (!file)
+        std::cout << "Couldn't open the distance volume " << path << std::endl;
+    else if (!file.read((char *)&header, sizeof(header)) || memcmp(header.magic, distanceVolumeMagic, sizeof(distanceVolumeMagic)) != 0 ||
+             !isValidResolution(header.resolution) || fileSize != sizeof(header) + getSampleCount(header.resolution) * sizeof(float) ||
+             !(header.boundsMin[0] < header.boundsMax[0] && header.boundsMin[1] < header.boundsMax[1] && header.boundsMin[2] < header.boundsMax[2]))
+        std::cout << "Distance volume " << path << " corrupted" << std::endl;
+    else
+    {
+        // The size of the file was checked, the samples are allocated only for a file that has them
+        std::vector<float> distances((size_t)getSampleCount(header.resolution));
+        if (!file.read((char *)distances.data(), distances.size() * sizeof(float)))
+            std::cout << "Distance volume " << path << " corrupted" << std::endl;
+        else
+            volume = std::make_shared<const DistanceVolume>(glm::uvec3(header.resolution[0], header.resolution[1], header.resolution[2]),
+                                                            glm::vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]),
+                                                            glm::vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]), distances);
+    }
+
+    loadedVolumes[path] = {modificationTime, volume};
+    return volume;
+}
+
+bool DistanceVolume::save(const std::string &path) const
+{
+    std::ofstream file(path, std::ios::binary);
+    if (!file)
+    {
+        std::cout << "Couldn't open the file " << path << " for save" << std::endl;
+        return false;
+    }
+
+    DistanceVolumeHeader header;
+    memcpy(header.magic, distanceVolumeMagic, sizeof(distanceVolumeMagic));
+    for (int axis = 0; axis < 3; axis++)
+    {
+        header.resolution[axis] = this->resolution[axis];
+        header.boundsMin[axis] = this->boundsMin[axis];
+        header.boundsMax[axis] = this->boundsMax[axis];
+    }
+    file.write((const char *)&header, sizeof(header));
+    file.write((const char *)this->distances.data(), this->distances.size() * sizeof(float));
+    return (bool)file;
+}
+
+float DistanceVolume::sample(glm::vec3 position) const
+{
+    // The position is clamped inside the bounds, the distance to them is added back at the end
+    const glm::vec3 last = glm::vec3(this->resolution - glm::uvec3(1));
+    const glm::vec3 grid = glm::clamp((position - this->boundsMin) * this->inverseSpacing, glm::vec3(0.0f), last);
+    const glm::uvec3 cell = glm::min(glm::uvec3(grid), this->resolution - glm::uvec3(2));
+    const glm::vec3 weight = grid - glm::vec3(cell);
+    const float outside = glm::length(position - (this->boundsMin + grid / this->inverseSpacing));
+
+    const unsigned int strideY = this->resolution.x;
+    const unsigned int strideZ = this->resolution.x * this->resolution.y;
+    const float *corner = &this->distances[cell.z * strideZ + cell.y * strideY + cell.x];
+    const float c00 = glm::mix(corner[0], corner[1], weight.x);
+    const float c10 = glm::mix(corner[strideY], corner[strideY + 1], weight.x);
+    const float c01 = glm::mix(corner[strideZ], corner[strideZ + 1], weight.x);
+    const float c11 = glm::mix(corner[strideZ + strideY], corner[strideZ + strideY + 1], weight.x);
+    return glm::mix(glm::mix(c00, c10, weight.y), glm::mix(c01, c11, weight.y), weight.z) + outside;
+}
+
+glm::vec3 DistanceVolume::normal(glm::vec3 position) const
+{
+    const glm::vec3 spacing = 1.0f / this->inverseSpacing;
+    const glm::vec3 gradient(this->sample(position + glm::vec3(spacing.x, 0.0f, 0.0f)) - this->sample(position - glm::vec3(spacing.x, 0.0f, 0.0f)),
+                             this->sample(position + glm::vec3(0.0f, spacing.y, 0.0f)) - this->sample(position - glm::vec3(0.0f, spacing.y, 0.0f)),
+                             this->sample(position + glm::vec3(0.0f, 0.0f, spacing.z)) - this->sample(position - glm::vec3(0.0f, 0.0f, spacing.z)));
+    const float length = glm::length(gradient);
+    return length > 0.0f ? gradient / length : glm::vec3(0.0f);
+}
+
+void DistanceVolume::getBounds(glm::vec3 &boundsMin, glm::vec3 &boundsMax) const
+{
+    boundsMin = this->boundsMin;
+    boundsMax = this->boundsMax;
+}
+
+void prepareColliders(std::vector<Collider> &colliders)
+{
+    for (size_t i = 0; i < colliders.size(); i++)
+    {
+        if (colliders[i].type == COLLIDER_SDF && !colliders[i].volume)
+            colliders[i].volume = DistanceVolume::load(colliders[i].path);
+        if (colliders[i].type == COLLIDER_HEIGHTFIELD && !colliders[i].heightField)
+            colliders[i].heightField = HeightField::load(colliders[i].path);
+    }
+}
+
+unsigned int collideParticles(const std::vector<Collider> &colliders, Particle *particles, unsigned int count)
+{
+    glm::vec3 boundsMin(INFINITY);
+    glm::vec3 boundsMax(-INFINITY);
+    for (unsigned int i = 0; i < count; i++)
+        if (particles[i].isAlive())
+        {
+            boundsMin = glm::min(boundsMin, particles[i].getPosition());
+            boundsMax = glm::max(boundsMax, particles[i].getPosition());
+        }
+    if (boundsMin.x > boundsMax.x)
+        return 0;
+
+    // Only the colliders touching the particles of the range are tested
+    unsigned int contacts = 0;
+    for (size_t c = 0; c < colliders.size(); c++)
+    {
+        const Collider &collider = colliders[c];
+        PreparedCollider prepared = {&collider, collider.size, collider.size.x > 0.0f ? collider.size.x : 1.0f};
+        if (collider.type == COLLIDER_PLANE)
+            prepared.size = glm::length(collider.size) > 0.0f ? glm::normalize(collider.size) : glm::vec3(0.0f, 1.0f, 0.0f);
+        if (collider.type == COLLIDER_HEIGHTFIELD)
+            prepared.size = glm::max(collider.size, glm::vec3(1e-6f));
+        if ((collider.type == COLLIDER_SDF && !collider.volume) || (collider.type == COLLIDER_HEIGHTFIELD && !collider.heightField) ||
+            !colliderTouches(prepared, boundsMin, boundsMax))
+            continue;
+
+        if (collider.type == COLLIDER_HEIGHTFIELD)
+        {
+            contacts += collideHeightField(prepared, particles, count);
+            continue;
+        }
+
+        for (unsigned int i = 0; i < count; i++)
+        {
+            Particle &particle = particles[i];
+            glm::vec3 normal;
+            if (!particle.isAlive())
+                continue;
+            const float distance = colliderDistance(prepared, particle.getPosition(), normal);
+            if (distance >= 0.0f)
+                continue;
+
+            respond(collider, particle, -distance * normal, normal);
+            contacts++;
+        }
+    }
+    return contacts;
+}
+
+void writeColliders(std::ostream &file, const std::vector<Collider> &colliders)
+{
+    file << colliders.size();
+    for (size_t i = 0; i < colliders.size(); i++)
+    {
+        const Collider &collider = colliders[i];
+        file << " " << colliderNames[collider.type] << " " << colliderResponseNames[collider.response]
+             << " " << collider.position.x << " " << collider.position.y << " " << collider.position.z
+             << " " << collider.size.x << " " << collider.size.y << " " << collider.size.z
+             << " " << collider.restitution << " " << collider.friction;
+        // Only the sdf colliders and the heightfields have a file, the path can't have spaces
+        if (collider.type == COLLIDER_SDF || collider.type == COLLIDER_HEIGHTFIELD)
+            file << " " << collider.path;
+    }
+}
+
+bool readColliders(const std::string &value, std::vector<Collider> &colliders)
+{
+    std::istringstream text(value);
+    size_t count;
+    if (!(text >> count))
+        return false;
+
+    // The colliders are added as they're parsed, a corrupted count fails on the missing entries instead of allocating them
+    std::vector<Collider> read;
+    for (size_t i = 0; i < count; i++)
+    {
+        Collider collider = Collider();
+        std::string name, response;
+        if (!(text >> name >> response >> collider.position.x >> collider.position.y >> collider.position.z >> collider.size.x >>
+              collider.size.y >> collider.size.z >> collider.restitution >> collider.friction))
+            return false;
+
+        collider.type = NUMBER_OF_COLLIDER_TYPES;
+        for (int type = 0; type < NUMBER_OF_COLLIDER_TYPES; type++)
+            if (name == colliderNames[type])
+                collider.type = type;
+        collider.response = NUMBER_OF_COLLIDER_RESPONSES;
+        for (int type = 0; type < NUMBER_OF_COLLIDER_RESPONSES; type++)
+            if (response == colliderResponseNames[type])
+                collider.response = type;
+        if (collider.type == NUMBER_OF_COLLIDER_TYPES || collider.response == NUMBER_OF_COLLIDER_RESPONSES)
+            return false;
+        if ((collider.type == COLLIDER_SDF || collider.type == COLLIDER_HEIGHTFIELD) && !(text >> collider.path))
+            return false;
+        read.push_back(collider);
+    }
+
+    colliders.swap(read);
+    return true;
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "height-field.h"
+#include "particle.h"
+
+/**
+ * Kinds of static colliders
+*/
+enum ColliderType
+{
+    COLLIDER_PLANE,       // Infinite plane, the particles collide with the side its normal points away from
+    COLLIDER_SPHERE,      // Solid sphere
+    COLLIDER_BOX,         // Solid axis aligned box
+    COLLIDER_SDF,         // Solid shape of a signed distance volume loaded from a file
+    COLLIDER_HEIGHTFIELD, // Terrain of a grayscale image, solid below the surface
+    NUMBER_OF_COLLIDER_TYPES
+};
+
+/**
+ * What happens to the particles that touch a collider
+*/
+enum ColliderResponse
+{
+    COLLIDER_BOUNCE, // The particles are pushed out and bounce off the surface
+    COLLIDER_KILL,   // The particles die
+    COLLIDER_STICK,  // The particles stop on the surface and fade out
+    NUMBER_OF_COLLIDER_RESPONSES
+};
+
+/**
+ * Names of the collider types and responses, used by the configuration files and the interface
+*/
+extern const char *colliderNames[NUMBER_OF_COLLIDER_TYPES];
+extern const char *colliderResponseNames[NUMBER_OF_COLLIDER_RESPONSES];
+
+/**
+ * Signed distances sampled on a regular grid, the shape of the sdf colliders
+ * The file is a header (magic, resolution, bounds) followed by the distances as floats, x first. The samples are
+ * at the corners of the grid cells, the first one at the minimun of the bounds and the last one at the maximun.
+*/
+class DistanceVolume
+{
+public:
+    /**
+     * Creates a volume from its samples
+     * @param resolution Number of samples along each axis, at least 2
+     * @param boundsMin Position of the first sample
+     * @param boundsMax Position of the last sample
+     * @param distances Signed distance of each sample, negative inside the shape, x first
+    */
+    DistanceVolume(glm::uvec3 resolution, glm::vec3 boundsMin, glm::vec3 boundsMax, const std::vector<float> &distances);
+    /**
+     * Loads a volume file, the volumes are cached so the colliders sharing a file share its volume, a file is loaded again when it changes
+     * @param path Path to the volume file
+     * @return The volume, NULL if the file doesn't exist, is corrupted or has more than 512 samples along an axis
+    */
+    static std::shared_ptr<const DistanceVolume> load(const std::string &path);
+    /**
+     * Saves the volume
+     * @param path Path to the volume file
+     * @return The volume was saved
+    */
+    bool save(const std::string &path) const;
+    /**
+     * Samples the distance with trilinear interpolation
+     * Outside the bounds the distance to the bounds is added to the distance at the closest point inside them
+     * @param position Position in the space of the volume
+     * @return Signed distance to the shape
+    */
+    float sample(glm::vec3 position) const;
+    /**
+     * Computes the direction out of the shape with central differences
+     * @param position Position in the space of the volume
+     * @return Normalized gradient of the distance, 0 where it's flat
+    */
+    glm::vec3 normal(glm::vec3 position) const;
+    /**
+     * Gets the bounds of the samples
+     * @param boundsMin Where the position of the first sample is stored
+     * @param boundsMax Where the position of the last sample is stored
+    */
+    void getBounds(glm::vec3 &boundsMin, glm::vec3 &boundsMax) const;
+
+private:
+    glm::uvec3 resolution;        // Number of samples along each axis
+    glm::vec3 boundsMin;          // Position of the first sample
+    glm::vec3 boundsMax;          // Position of the last sample
+    glm::vec3 inverseSpacing;     // Samples per unit along each axis
+    std::vector<float> distances; // Signed distance of each sample, x first
+};
+
+/**
+ * Static collider acting on the particles of a particle system
+*/
+struct Collider
+{
+    int type;                                       // ColliderType
+    int response;                                   // ColliderResponse
+    glm::vec3 position;                             // Point of the plane, center of the sphere and the box, origin of the volume, lowest corner of the terrain
+    glm::vec3 size;                                 // Normal of the plane, radius of the sphere (x), half extents of the box, scale of the volume (x), size of the terrain
+    float restitution;                              // Fraction of the normal speed kept by the bounce, seconds the stuck particles take to fade out
+    float friction;                                 // Fraction of the tangent speed lost by the bounce
+    std::string path;                               // Path to the volume file of the sdf colliders, to the image of the heightfields
+    std::shared_ptr<const DistanceVolume> volume;   // Volume of the sdf colliders, NULL until they're prepared or if it didn't load
+    std::shared_ptr<const HeightField> heightField; // Heights of the heightfields, NULL until they're prepared or if it didn't load
+};
+
+/**
+ * Loads the volumes of the sdf colliders and the images of the heightfields, the ones that don't load don't collide
+ * @param colliders Colliders to be prepared
+*/
+void prepareColliders(std::vector<Collider> &colliders);
+
+/**
+ * Collides a range of particles with the colliders, one collider at a time
+ * The bounding box of the alive particles is computed first and the colliders it doesn't touch are skipped.
+ * The heightfields are sampled in blocks of particles.
+ * @param colliders Prepared colliders
+ * @param particles First particle of the range
+ * @param count Number of particles
+ * @return Number of contacts between a particle and a collider
+*/
+unsigned int collideParticles(const std::vector<Collider> &colliders, Particle *particles, unsigned int count);
+
+/**
+ * Writes colliders as a configuration value, the number of colliders followed by each collider
+ * @param file Where the colliders are written, its precision is used
+ * @param colliders Colliders to be written
+*/
+void writeColliders(std::ostream &file, const std::vector<Collider> &colliders);
+
+/**
+ * Reads colliders from a configuration value, the volumes aren't loaded
+ * @param value Text value
+ * @param colliders Where the colliders are stored
+ * @return The value is valid
+*/
+bool readColliders(const std::string &value, std::vector<Collider> &colliders);
@@ -0,0 +1,754 @@
+#include "configuration.h"
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+
+/**
+ * Transform a string into a int
+ * @param value Value to transform
+ * @param out Where the transformed value will be stored
+ * @return Transformation succesful
+*/
+static bool readProperty(std::string value, int &out)
+{
+    try
+    {
+        out = atoi(value.c_str());
+    }
+    catch (std::exception const &e)
+    {
+        std::cout << "error : " << e.what() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Transform a string into a float
+ * @param value Value to transform
+ * @param out Where the transformed value will be stored
+ * @return Transformation succesful
+*/
+static bool readProperty(std::string value, float &out)
+{
+    try
+    {
+        out = atof(value.c_str());
+    }
+    catch (std::exception const &e)
+    {
+        std::cout << "error : " << e.what() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Transform a string into a vec3
+ * @param value Value to transform
+ * @param out Where the transformed value will be stored
+ * @return Transformation succesful
+*/
+static bool readProperty(std::string value, glm::vec3 &out)
+{
+    char delimiter = ' ';
+    size_t previous = 0, splitIndex;
+
+    // Split the vector by spaces (x y z)
+    for (int i = 0; i < 2; i++)
+    {
+        splitIndex = value.find(delimiter, previous);
+        if (splitIndex == std::string::npos)
+            return false;
+
+        if (!readProperty(value.substr(previous, splitIndex - previous), out[i]))
+            return false;
+        previous = splitIndex + 1;
+    }
+
+    if (!readProperty(value.substr(previous, splitIndex - previous), out[2]))
+        return false;
+
+    return true;
+}
+
+bool storeProperty(std::string key, std::string value, MenuProperties &properties)
+{
+    /**
+     * Looks for the possible property and stored it into
+     * the corresponding menu properties field
+    */
+    if (key.compare("maxParticles") == 0)
+    {
+        if (!readProperty(value, properties.maxParticles))
+            return false;
+        return properties.maxParticles >= 0 && properties.maxParticles <= maxParticlesLimit;
+    }
+    if (key.compare("ttl") == 0)
+    {
+        if (!readProperty(value, properties.ttl))
+            return false;
+        return true;
+    }
+    if (key.compare("spawnInterval") == 0)
+    {
+        if (!readProperty(value, properties.spawnInterval))
+            return false;
+        return true;
+    }
+    if (key.compare("particlesPerSpawn") == 0)
+    {
+        if (!readProperty(value, properties.particlesPerSpawn))
+            return false;
+        return true;
+    }
+    if (key.compare("position") == 0)
+    {
+        if (!readProperty(value, properties.position))
+            return false;
+        return true;
+    }
+    if (key.compare("positionVariance") == 0)
+    {
+        if (!readProperty(value, properties.positionVariance))
+            return false;
+        return true;
+    }
+    if (key.compare("direction") == 0)
+    {
+        if (!readProperty(value, properties.direction))
+            return false;
+        return true;
+    }
+    if (key.compare("directionScale") == 0)
+    {
+        if (!readProperty(value, properties.directionScale))
+            return false;
+        return true;
+    }
+    if (key.compare("directionVariance") == 0)
+    {
+        if (!readProperty(value, properties.directionVariance))
+            return false;
+        return true;
+    }
+    if (key.compare("initialScale") == 0)
+    {
+        if (!readProperty(value, properties.initialScale))
+            return false;
+        return true;
+    }
+    if (key.compare("finalScale") == 0)
+    {
+        if (!readProperty(value, properties.finalScale))
+            return false;
+        return true;
+    }
+    if (key.compare("scaleVariance") == 0)
+    {
+        if (!readProperty(value, properties.scaleVariance))
+            return false;
+        return true;
+    }
+    if (key.compare("minInitialColor") == 0)
+    {
+        if (!readProperty(value, properties.minInitialColor))
+            return false;
+        return true;
+    }
+    if (key.compare("maxInitialColor") == 0)
+    {
+        if (!readProperty(value, properties.maxInitialColor))
+            return false;
+        return true;
+    }
+    if (key.compare("minFinalColor") == 0)
+    {
+        if (!readProperty(value, properties.minFinalColor))
+            return false;
+        return true;
+    }
+    if (key.compare("maxFinalColor") == 0)
+    {
+        if (!readProperty(value, properties.maxFinalColor))
+            return false;
+        return true;
+    }
+    if (key.compare("initialAplha") == 0)
+    {
+        if (!readProperty(value, properties.initialAplha))
+            return false;
+        return true;
+    }
+    if (key.compare("finalAlpha") == 0)
+    {
+        if (!readProperty(value, properties.finalAlpha))
+            return false;
+        return true;
+    }
+    if (key.compare("alphaVariance") == 0)
+    {
+        if (!readProperty(value, properties.alphaVariance))
+            return false;
+        return true;
+    }
+    if (key.compare("externalForce") == 0)
+    {
+        if (!readProperty(value, properties.externalForce))
+            return false;
+        return true;
+    }
+    if (key.compare("externalForceVelocity") == 0)
+    {
+        if (!readProperty(value, properties.externalForceVelocity))
+            return false;
+        return true;
+    }
+    if (key.compare("fileTextureName") == 0)
+    {
+        properties.fileTextureName = value;
+        return true;
+    }
+    if (key.compare("seed") == 0)
+    {
+        if (!readProperty(value, properties.seed))
+            return false;
+        return true;
+    }
+    if (key.compare("fixedTimeStep") == 0)
+    {
+        if (!readProperty(value, properties.fixedTimeStep))
+            return false;
+        return true;
+    }
+    if (key.compare("prewarmTime") == 0)
+    {
+        if (!readProperty(value, properties.prewarmTime))
+            return false;
+        return true;
+    }
+    if (key.compare("analyticEvaluation") == 0)
+    {
+        int analyticEvaluation;
+        if (!readProperty(value, analyticEvaluation))
+            return false;
+        properties.analyticEvaluation = analyticEvaluation != 0;
+        return true;
+    }
+    if (key.compare("compactStorage") == 0)
+    {
+        int compactStorage;
+        if (!readProperty(value, compactStorage))
+            return false;
+        properties.compactStorage = compactStorage != 0;
+        return true;
+    }
+    if (key.compare("forceFields") == 0)
+    {
+        if (!readForceFields(value, properties.forceFields))
+            return false;
+        return true;
+    }
+    if (key.compare("collisionRadius") == 0)
+    {
+        if (!readProperty(value, properties.collisionRadius))
+            return false;
+        return true;
+    }
+    if (key.compare("collisionIterations") == 0)
+    {
+        if (!readProperty(value, properties.collisionIterations))
+            return false;
+        return true;
+    }
+    if (key.compare("colliders") == 0)
+    {
+        if (!readColliders(value, properties.colliders))
+            return false;
+        return true;
+    }
+    if (key.compare("fluidEnabled") == 0)
+    {
+        int fluidEnabled;
+        if (!readProperty(value, fluidEnabled))
+            return false;
+        properties.fluid.enabled = fluidEnabled != 0;
+        return true;
+    }
+    if (key.compare("fluidRadius") == 0)
+    {
+        if (!readProperty(value, properties.fluid.radius))
+            return false;
+        return true;
+    }
+    if (key.compare("fluidRestDensity") == 0)
+    {
+        if (!readProperty(value, properties.fluid.restDensity))
+            return false;
+        return true;
+    }
+    if (key.compare("fluidStiffness") == 0)
+    {
+        if (!readProperty(value, properties.fluid.stiffness))
+            return false;
+        return true;
+    }
+    if (key.compare("fluidViscosity") == 0)
+    {
+        if (!readProperty(value, properties.fluid.viscosity))
+            return false;
+        return true;
+    }
+    if (key.compare("fluidTimeStep") == 0)
+    {
+        if (!readProperty(value, properties.fluid.timeStep))
+            return false;
+        return true;
+    }
+    if (key.compare("gravityEnabled") == 0)
+    {
+        int gravityEnabled;
+        if (!readProperty(value, gravityEnabled))
+            return false;
+        properties.gravity.enabled = gravityEnabled != 0;
+        return true;
+    }
+    if (key.compare("gravityStrength") == 0)
+    {
+        if (!readProperty(value, properties.gravity.strength))
+            return false;
+        return true;
+    }
+    if (key.compare("gravityOpeningAngle") == 0)
+    {
+        if (!readProperty(value, properties.gravity.openingAngle))
+            return false;
+        return true;
+    }
+    if (key.compare("gravitySoftening") == 0)
+    {
+        if (!readProperty(value, properties.gravity.softening))
+            return false;
+        return true;
+    }
+    if (key.compare("flockEnabled") == 0)
+    {
+        int flockEnabled;
+        if (!readProperty(value, flockEnabled))
+            return false;
+        properties.flock.enabled = flockEnabled != 0;
+        return true;
+    }
+    if (key.compare("flockRadius") == 0)
+    {
+        if (!readProperty(value, properties.flock.radius))
+            return false;
+        return true;
+    }
+    if (key.compare("flockMaxNeighbors") == 0)
+    {
+        if (!readProperty(value, properties.flock.maxNeighbors))
+            return false;
+        return true;
+    }
+    if (key.compare("flockSeparation") == 0)
+    {
+        if (!readProperty(value, properties.flock.separation))
+            return false;
+        return true;
+    }
+    if (key.compare("flockAlignment") == 0)
+    {
+        if (!readProperty(value, properties.flock.alignment))
+            return false;
+        return true;
+    }
+    if (key.compare("flockCohesion") == 0)
+    {
+        if (!readProperty(value, properties.flock.cohesion))
+            return false;
+        return true;
+    }
+    if (key.compare("flockSeek") == 0)
+    {
+        if (!readProperty(value, properties.flock.seek))
+            return false;
+        return true;
+    }
+    if (key.compare("flockTarget") == 0)
+    {
+        if (!readProperty(value, properties.flock.target))
+            return false;
+        return true;
+    }
+    if (key.compare("flockMaxSpeed") == 0)
+    {
+        if (!readProperty(value, properties.flock.maxSpeed))
+            return false;
+        return true;
+    }
+    if (key.compare("smokeEnabled") == 0)
+    {
+        int smokeEnabled;
+        if (!readProperty(value, smokeEnabled))
+            return false;
+        properties.smoke.enabled = smokeEnabled != 0;
+        return true;
+    }
+    if (key.compare("smokeBoundsMin") == 0)
+    {
+        if (!readProperty(value, properties.smoke.boundsMin))
+            return false;
+        return true;
+    }
+    if (key.compare("smokeBoundsMax") == 0)
+    {
+        if (!readProperty(value, properties.smoke.boundsMax))
+            return false;
+        return true;
+    }
+    if (key.compare("smokeCellSize") == 0)
+    {
+        if (!readProperty(value, properties.smoke.cellSize))
+            return false;
+        return true;
+    }
+    if (key.compare("smokeBuoyancy") == 0)
+    {
+        if (!readProperty(value, properties.smoke.buoyancy))
+            return false;
+        return true;
+    }
+    if (key.compare("smokeCooling") == 0)
+    {
+        if (!readProperty(value, properties.smoke.cooling))
+            return false;
+        return true;
+    }
+    if (key.compare("smokeSourceRadius") == 0)
+    {
+        if (!readProperty(value, properties.smoke.sourceRadius))
+            return false;
+        return true;
+    }
+    if (key.compare("smokeSourceTemperature") == 0)
+    {
+        if (!readProperty(value, properties.smoke.sourceTemperature))
+            return false;
+        return true;
+    }
+    if (key.compare("smokePressureIterations") == 0)
+    {
+        if (!readProperty(value, properties.smoke.pressureIterations))
+            return false;
+        return true;
+    }
+    if (key.compare("smokeTimeStep") == 0)
+    {
+        if (!readProperty(value, properties.smoke.timeStep))
+            return false;
+        return true;
+    }
+    if (key.compare("smokeDrag") == 0)
+    {
+        if (!readProperty(value, properties.smoke.drag))
+            return false;
+        return true;
+    }
+    return false;
+}
+
+bool readConfiguration(const std::string &path, MenuProperties &properties)
+{
+    std::ifstream file;
+
+    // Open the file
+    file.open(path);
+
+    // Error
+    if (!file)
+    {
+        std::cout << "Unable to open the configuration file " << path << std::endl;
+        return false;
+    }
+
+    std::string line;
+
+    // Reads each line and stores the property
+    while (std::getline(file, line))
+    {
+        // Splits the string
+        std::size_t splitIndex = line.find(' ');
+
+        // We got an error
+        if (splitIndex == std::string::npos)
+        {
+            std::cout << "File " << path << " corrupted" << std::endl;
+            return false;
+        }
+
+        std::string key = line.substr(0, splitIndex);
+        std::string value = line.substr(splitIndex + 1, line.size());
+
+        // We got an error
+        if (!storeProperty(key, value, properties))
+        {
+            std::cout << "File " << path << " corrupted" << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool writeConfiguration(const std::string &path, const MenuProperties &properties)
+{
+    std::ofstream file;
+    file.open(path);
+
+    if (!file)
+    {
+        std::cout << "Couldn't open the file " << path << " for save" << std::endl;
+        return false;
+    }
+
+    writeProperties(file, properties);
+
+    return true;
+}
+
+void writeProperties(std::ostream &file, const MenuProperties &properties)
+{
+    file << "maxParticles"
+         << " " << properties.maxParticles << std::endl;
+
+    file << "ttl"
+         << " " << properties.ttl << std::endl;
+
+    file << "spawnInterval"
+         << " " << properties.spawnInterval << std::endl;
+
+    file << "particlesPerSpawn"
+         << " " << properties.particlesPerSpawn << std::endl;
+
+    file << "position"
+         << " " << properties.position.x
+         << " " << properties.position.y
+         << " " << properties.position.z << std::endl;
+
+    file << "positionVariance"
+         << " " << properties.positionVariance.x
+         << " " << properties.positionVariance.y
+         << " " << properties.positionVariance.z << std::endl;
+
+    file << "direction"
+         << " " << properties.direction.x
+         << " " << properties.direction.y
+         << " " << properties.direction.z << std::endl;
+
+    file << "directionScale"
+         << " " << properties.directionScale << std::endl;
+
+    file << "directionVariance"
+         << " " << properties.directionVariance.x
+         << " " << properties.directionVariance.y
+         << " " << properties.directionVariance.z << std::endl;
+
+    file << "initialScale"
+         << " " << properties.initialScale << std::endl;
+
+    file << "finalScale"
+         << " " << properties.finalScale << std::endl;
+
+    file << "scaleVariance"
+         << " " << properties.scaleVariance << std::endl;
+
+    file << "minInitialColor"
+         << " " << properties.minInitialColor.x
+         << " " << properties.minInitialColor.y
+         << " " << properties.minInitialColor.z << std::endl;
+
+    file << "maxInitialColor"
+         << " " << properties.maxInitialColor.x
+         << " " << properties.maxInitialColor.y
+         << " " << properties.maxInitialColor.z << std::endl;
+
+    file << "minFinalColor"
+         << " " << properties.minFinalColor.x
+         << " " << properties.minFinalColor.y
+         << " " << properties.minFinalColor.z << std::endl;
+
+    file << "maxFinalColor"
+         << " " << properties.maxFinalColor.x
+         << " " << properties.maxFinalColor.y
+         << " " << properties.maxFinalColor.z << std::endl;
+
+    file << "initialAplha"
+         << " " << properties.initialAplha << std::endl;
+
+    file << "finalAlpha"
+         << " " << properties.finalAlpha << std::endl;
+
+    file << "alphaVariance"
+         << " " << properties.alphaVariance << std::endl;
+
+    file << "externalForce"
+         << " " << properties.externalForce.x
+         << " " << properties.externalForce.y
+         << " " << properties.externalForce.z << std::endl;
+
+    file << "externalForceVelocity"
+         << " " << properties.externalForceVelocity << std::endl;
+
+    file << "fileTextureName"
+         << " " << properties.fileTextureName << std::endl;
+
+    file << "seed"
+         << " " << properties.seed << std::endl;
+
+    file << "fixedTimeStep"
+         << " " << properties.fixedTimeStep << std::endl;
+
+    file << "prewarmTime"
+         << " " << properties.prewarmTime << std::endl;
+
+    file << "analyticEvaluation"
+         << " " << properties.analyticEvaluation << std::endl;
+
+    file << "compactStorage"
+         << " " << properties.compactStorage << std::endl;
+
+    // All the fields are written in a single line, so they're replaced at once
+    file << "forceFields"
+         << " ";
+    writeForceFields(file, properties.forceFields);
+    file << std::endl;
+
+    file << "collisionRadius"
+         << " " << properties.collisionRadius << std::endl;
+
+    file << "collisionIterations"
+         << " " << properties.collisionIterations << std::endl;
+
+    file << "colliders"
+         << " ";
+    writeColliders(file, properties.colliders);
+    file << std::endl;
+
+    file << "fluidEnabled"
+         << " " << properties.fluid.enabled << std::endl;
+
+    file << "fluidRadius"
+         << " " << properties.fluid.radius << std::endl;
+
+    file << "fluidRestDensity"
+         << " " << properties.fluid.restDensity << std::endl;
+
+    file << "fluidStiffness"
+         << " " << properties.fluid.stiffness << std::endl;
+
+    file << "fluidViscosity"
+         << " " << properties.fluid.viscosity << std::endl;
+
+    file << "fluidTimeStep"
+         << " " << properties.fluid.timeStep << std::endl;
+
+    file << "gravityEnabled"
+         << " " << properties.gravity.enabled << std::endl;
+
+    file << "gravityStrength"
+         << " " << properties.gravity.strength << std::endl;
+
+    file << "gravityOpeningAngle"
+         << " " << properties.gravity.openingAngle << std::endl;
+
+    file << "gravitySoftening"
+         << " " << properties.gravity.softening << std::endl;
+
+    file << "flockEnabled"
+         << " " << properties.flock.enabled << std::endl;
+
+    file << "flockRadius"
+         << " " << properties.flock.radius << std::endl;
+
+    file << "flockMaxNeighbors"
+         << " " << properties.flock.maxNeighbors << std::endl;
+
+    file << "flockSeparation"
+         << " " << properties.flock.separation << std::endl;
+
+    file << "flockAlignment"
+         << " " << properties.flock.alignment << std::endl;
+
+    file << "flockCohesion"
+         << " " << properties.flock.cohesion << std::endl;
+
+    file << "flockSeek"
+         << " " << properties.flock.seek << std::endl;
+
+    file << "flockTarget"
+         << " " << properties.flock.target.x
+         << " " << properties.flock.target.y
+         << " " << properties.flock.target.z << std::endl;
+
+    file << "flockMaxSpeed"
+         << " " << properties.flock.maxSpeed << std::endl;
+
+    file << "smokeEnabled"
+         << " " << properties.smoke.enabled << std::endl;
+
+    file << "smokeBoundsMin"
+         << " " << properties.smoke.boundsMin.x
+         << " " << properties.smoke.boundsMin.y
+         << " " << properties.smoke.boundsMin.z << std::endl;
+
+    file << "smokeBoundsMax"
+         << " " << properties.smoke.boundsMax.x
+         << " " << properties.smoke.boundsMax.y
+         << " " << properties.smoke.boundsMax.z << std::endl;
+
+    file << "smokeCellSize"
+         << " " << properties.smoke.cellSize << std::endl;
+
+    file << "smokeBuoyancy"
+         << " " << properties.smoke.buoyancy << std::endl;
+
+    file << "smokeCooling"
+         << " " << properties.smoke.cooling << std::endl;
+
+    file << "smokeSourceRadius"
+         << " " << properties.smoke.sourceRadius << std::endl;
+
+    file << "smokeSourceTemperature"
+         << " " << properties.smoke.sourceTemperature << std::endl;
+
+    file << "smokePressureIterations"
+         << " " << properties.smoke.pressureIterations << std::endl;
+
+    file << "smokeTimeStep"
+         << " " << properties.smoke.timeStep << std::endl;
+
+    file << "smokeDrag"
+         << " " << properties.smoke.drag << std::endl;
+}
+
+void applyProperties(ParticleSystem *particleSystem, const MenuProperties &properties)
+{
+    particleSystem->setTTL(properties.ttl);
+    particleSystem->setParticleSpawns(properties.particlesPerSpawn, properties.spawnInterval);
+    particleSystem->setPosition(properties.position, properties.positionVariance);
+    particleSystem->setDirection(properties.direction * properties.directionScale, properties.directionVariance * properties.directionScale);
+    particleSystem->setScale(properties.initialScale, properties.finalScale, properties.scaleVariance);
+    particleSystem->setColor(properties.minInitialColor, properties.maxInitialColor, properties.minFinalColor, properties.maxFinalColor);
+    particleSystem->setAplha(properties.initialAplha, properties.finalAlpha, properties.alphaVariance);
+    particleSystem->setGlobalExternalForce(properties.externalForce * properties.externalForceVelocity);
+    particleSystem->setForceFields(properties.forceFields);
+    particleSystem->setCollisions(properties.collisionRadius, (unsigned int)glm::max(properties.collisionIterations, 0));
+    particleSystem->setColliders(properties.colliders);
+    particleSystem->setFluid(properties.fluid);
+    particleSystem->setGravity(properties.gravity);
+    particleSystem->setFlock(properties.flock);
+    particleSystem->setSmoke(properties.smoke);
+    particleSystem->setAnalyticEvaluation(properties.analyticEvaluation);
+    particleSystem->setCompactStorage(properties.compactStorage);
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "particle-system.h"
+
+// Max number of particles of a particle system, bounds the interface, the configuration files and the snapshots
+const int maxParticlesLimit = 10000000;
+
+/**
+ * Particle system properties edited through the interface and stored in the configuration files
+*/
+struct MenuProperties
+{
+    int maxParticles;                  // Max number of particles supported by the particle system
+    float ttl;                         // Particle's time to live
+    float spawnInterval;               // Particle's spawn interval
+    int particlesPerSpawn;             // Number of particles spawned per spawn
+    glm::vec3 position;                // Base position of the spawned particles
+    glm::vec3 positionVariance;        // Variance of the spawn position
+    glm::vec3 direction;               // Base direction of the particles spawned
+    float directionScale;              // Direction scale or speed of the spawned particles
+    glm::vec3 directionVariance;       // Variance of the spawn direction
+    float initialScale;                // Particle's scale at the its life begin
+    float finalScale;                  // Particle's scale at the its life end
+    float scaleVariance;               // Particle's scale variance
+    glm::vec3 minInitialColor;         // Particle's minimun color at the its life begin
+    glm::vec3 maxInitialColor;         // Particle's maximun color at the its life begin
+    glm::vec3 minFinalColor;           // Particle's minimun color at the its life end
+    glm::vec3 maxFinalColor;           // Particle's maximun color at the its life end
+    float initialAplha;                // Particle's alpha at the its life begin
+    float finalAlpha;                  // Particle's alpha at the its life end
+    float alphaVariance;               // Particle's alpha variance
+    glm::vec3 externalForce;           // External force direction that globaly influence the particles' direction (ie gravity)
+    float externalForceVelocity;       // External force velocity
+    std::string fileTextureName;       // Current texture path to be loaded
+    std::string lastTextureLoaded;     // Last path of the loaded texture
+    std::string configurationFilePath; // Path to the configuration file to be lodaded or saved
+    std::string capturePath;           // Path prefix of the captured images
+    int captureFormat;                 // Format of the captured images (CaptureFormat)
+    int seed;                          // Seed of the particle system random values, 0 seeds them from the clock
+    float fixedTimeStep;               // Simulation time step in seconds, 0 steps the simulation with the frame time
+    float prewarmTime;                 // Seconds the particle system is advanced when it's loaded, so it starts in its steady state
+    bool analyticEvaluation;           // The particles are evaluated in closed form on the GPU instead of updated
+    bool compactStorage;               // The evaluated particles are stored quantized
+    std::vector<ForceField> forceFields; // Force fields acting on the particles
+    float collisionRadius;             // Radius of the colliding particles
+    int collisionIterations;           // Collision solver iterations per update, 0 disables the collisions
+    std::vector<Collider> colliders;   // Static colliders the particles bounce off or die on
+    FluidParameters fluid;             // Fluid simulated by the particles
+    GravityParameters gravity;         // Gravity between the particles
+    FlockParameters flock;             // Flocking behavior of the particles
+    SmokeParameters smoke;             // Smoke grid carrying the particles
+};
+
+/**
+ * Stores a menu property
+ * @param key Property to store
+ * @param value String Value of the property 
+ * @param properties Where the property will be stored
+ * @return Stored succesfully
+*/
+bool storeProperty(std::string key, std::string value, MenuProperties &properties);
+
+/**
+ * Reads a particle system configuration file
+ * @param path Path to the configuration file
+ * @param properties Where the properties will be stored, the properties not present in the file are kept
+ * @return The file was read succesfully
+*/
+bool readConfiguration(const std::string &path, MenuProperties &properties);
+
+/**
+ * Writes the properties saved in the configuration files, one "key value" line per property
+ * The values are written with the output precision
+ * @param output Where the properties are written
+ * @param properties Properties to be written
+*/
+void writeProperties(std::ostream &output, const MenuProperties &properties);
+
+/**
+ * Writes a particle system configuration file
+ * @param path Path to the configuration file
+ * @param properties Properties to be saved
+ * @return The file was written succesfully
+*/
+bool writeConfiguration(const std::string &path, const MenuProperties &properties);
+
+/**
+ * Sets the particle system properties based on the menu properties
+ * @param particleSystem Particle system to be configured
+ * @param properties Properties to be applied
+*/
+void applyProperties(ParticleSystem *particleSystem, const MenuProperties &properties);
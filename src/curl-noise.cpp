@@ -0,0 +1,180 @@
+#include "curl-noise.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include <glm/gtc/noise.hpp>
+
+#include "profiler.h"
+
+std::vector<glm::vec3> CurlNoise::velocities;
+
+namespace
+{
+const char curlNoiseMagic[8] = {'C', 'U', 'R', 'L', 'N', 'O', 'I', 'S'};
+// Noise cells per tile, the noise repeats with this period so the volume tiles
+const float noisePeriod = 4.0f;
+// Samples processed at once, their cells and weights stay in the stack
+const unsigned int sampleBlock = 64;
+
+/**
+ * First bytes of a curl noise file
+*/
+struct CurlNoiseHeader
+{
+    char magic[8];           // curlNoiseMagic
+    unsigned int resolution; // CurlNoise::resolution, rejects other layouts
+};
+
+/**
+ * Index of a cell of the volume
+ * @param x Cell coordinates, wrapped around
+ * @param y
+ * @param z
+ * @return Index of the cell
+*/
+unsigned int cellIndex(unsigned int x, unsigned int y, unsigned int z)
+{
+    const unsigned int mask = CurlNoise::resolution - 1;
+    return ((z & mask) * CurlNoise::resolution + (y & mask)) * CurlNoise::resolution + (x & mask);
+}
+} // namespace
+
+void CurlNoise::bake()
+{
+    PROFILE_SCOPE("CurlNoise::bake");
+
+    const unsigned int n = resolution;
+    const glm::vec3 period(noisePeriod);
+
+    // Vector potential, each component is an independent periodic noise
+    std::vector<glm::vec3> potential(n * n * n);
+    for (unsigned int z = 0; z < n; z++)
+        for (unsigned int y = 0; y < n; y++)
+            for (unsigned int x = 0; x < n; x++)
+            {
+                const glm::vec3 position = glm::vec3(x, y, z) / (float)n * noisePeriod;
+                potential[cellIndex(x, y, z)] = glm::vec3(glm::perlin(position, period),
+                                                          glm::perlin(position + glm::vec3(31.4f, 0.0f, 0.0f), period),
+                                                          glm::perlin(position + glm::vec3(0.0f, 47.2f, 0.0f), period));
+            }
+
+    // The curl with central differences, the neighbours wrap around so the volume still tiles
+    velocities.resize(n * n * n);
+    float maxLength = 0.0f;
+    for (unsigned int z = 0; z < n; z++)
+        for (unsigned int y = 0; y < n; y++)
+            for (unsigned int x = 0; x < n; x++)
+            {
+                const glm::vec3 dx = potential[cellIndex(x + 1, y, z)] - potential[cellIndex(x + n - 1, y, z)];
+                const glm::vec3 dy = potential[cellIndex(x, y + 1, z)] - potential[cellIndex(x, y + n - 1, z)];
+                const glm::vec3 dz = potential[cellIndex(x, y, z + 1)] - potential[cellIndex(x, y, z + n - 1)];
+                const glm::vec3 velocity(dy.z - dz.y, dz.x - dx.z, dx.y - dy.x);
+                velocities[cellIndex(x, y, z)] = velocity;
+                maxLength = glm::max(maxLength, glm::length(velocity));
+            }
+
+    if (maxLength > 0.0f)
+        for (size_t i = 0; i < velocities.size(); i++)
+            velocities[i] /= maxLength;
+}
+
+bool CurlNoise::load(const std::string &path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+
+    CurlNoiseHeader header;
+    std::vector<glm::vec3> volume(resolution * resolution * resolution);
+    if (!file.read((char *)&header, sizeof(header)) || memcmp(header.magic, curlNoiseMagic, sizeof(curlNoiseMagic)) != 0 ||
+        header.resolution != resolution || !file.read((char *)volume.data(), volume.size() * sizeof(glm::vec3)))
+    {
+        std::cout << "Curl noise file " << path << " corrupted" << std::endl;
+        return false;
+    }
+
+    velocities.swap(volume);
+    return true;
+}
+
+bool CurlNoise::save(const std::string &path)
+{
+    if (velocities.empty())
+        bake();
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file)
+    {
+        std::cout << "Couldn't open the file " << path << " for save" << std::endl;
+        return false;
+    }
+
+    CurlNoiseHeader header;
+    memcpy(header.magic, curlNoiseMagic, sizeof(curlNoiseMagic));
+    header.resolution = resolution;
+    file.write((const char *)&header, sizeof(header));
+    file.write((const char *)velocities.data(), velocities.size() * sizeof(glm::vec3));
+    return (bool)file;
+}
+
+void CurlNoise::prepare(const std::string &path)
+{
+    if (load(path))
+        return;
+    bake();
+    save(path);
+}
+
+void CurlNoise::sample(const float *x, const float *y, const float *z, unsigned int count, float *velocityX, float *velocityY, float *velocityZ)
+{
+    if (velocities.empty())
+        bake();
+
+    const float size = (float)resolution;
+    int cellX[sampleBlock], cellY[sampleBlock], cellZ[sampleBlock];
+    float weightX[sampleBlock], weightY[sampleBlock], weightZ[sampleBlock];
+    for (unsigned int first = 0; first < count; first += sampleBlock)
+    {
+        const unsigned int blockCount = glm::min(sampleBlock, count - first);
+
+        // Cells and interpolation weights, the floor is a truncation corrected for negative values so it's vectorized
+        for (unsigned int i = 0; i < blockCount; i++)
+        {
+            const float sx = x[first + i] * size;
+            const float sy = y[first + i] * size;
+            const float sz = z[first + i] * size;
+            const int tx = (int)sx;
+            const int ty = (int)sy;
+            const int tz = (int)sz;
+            cellX[i] = tx - (sx < (float)tx);
+            cellY[i] = ty - (sy < (float)ty);
+            cellZ[i] = tz - (sz < (float)tz);
+            weightX[i] = sx - (float)cellX[i];
+            weightY[i] = sy - (float)cellY[i];
+            weightZ[i] = sz - (float)cellZ[i];
+        }
+
+        // The eight corners are gathered, the cells wrap around
+        const glm::vec3 *volume = velocities.data();
+        const unsigned int mask = resolution - 1;
+        for (unsigned int i = 0; i < blockCount; i++)
+        {
+            const unsigned int x0 = (unsigned int)cellX[i] & mask;
+            const unsigned int x1 = (x0 + 1) & mask;
+            const unsigned int y0 = ((unsigned int)cellY[i] & mask) * resolution;
+            const unsigned int y1 = (y0 + resolution) & (mask * resolution);
+            const unsigned int z0 = ((unsigned int)cellZ[i] & mask) * resolution * resolution;
+            const unsigned int z1 = (z0 + resolution * resolution) & (mask * resolution * resolution);
+            const glm::vec3 c00 = glm::mix(volume[z0 + y0 + x0], volume[z0 + y0 + x1], weightX[i]);
+            const glm::vec3 c10 = glm::mix(volume[z0 + y1 + x0], volume[z0 + y1 + x1], weightX[i]);
+            const glm::vec3 c01 = glm::mix(volume[z1 + y0 + x0], volume[z1 + y0 + x1], weightX[i]);
+            const glm::vec3 c11 = glm::mix(volume[z1 + y1 + x0], volume[z1 + y1 + x1], weightX[i]);
+            const glm::vec3 velocity = glm::mix(glm::mix(c00, c10, weightY[i]), glm::mix(c01, c11, weightY[i]), weightZ[i]);
+            velocityX[first + i] = velocity.x;
+            velocityY[first + i] = velocity.y;
+            velocityZ[first + i] = velocity.z;
+        }
+    }
+}
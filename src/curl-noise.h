@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+/**
+ * Tileable divergence free velocity volume, the curl of a periodic noise baked into a grid
+ * The volume tiles every unit, the particles swirl along it without bunching
+*/
+class CurlNoise
+{
+public:
+    static const unsigned int resolution = 32; // Cells of the volume along each axis, a power of two
+
+    /**
+     * Bakes the volume, the same volume is baked every time so the simulation stays reproducible
+    */
+    static void bake();
+    /**
+     * Loads a volume baked before
+     * @param path Path to the volume file
+     * @return The volume was loaded, false if the file doesn't exist or has another layout
+    */
+    static bool load(const std::string &path);
+    /**
+     * Saves the volume, it's baked first if needed
+     * @param path Path to the volume file
+     * @return The volume was saved
+    */
+    static bool save(const std::string &path);
+    /**
+     * Loads the volume from its cache, or bakes it and writes the cache
+     * @param path Path to the volume file
+    */
+    static void prepare(const std::string &path);
+    /**
+     * Samples the volume with trilinear interpolation, the volume is baked on the first sample if it wasn't loaded
+     * @param x Sample coordinates, the volume tiles every unit
+     * @param y
+     * @param z
+     * @param count Number of samples
+     * @param velocityX Where the velocities are stored, at most 1 long
+     * @param velocityY
+     * @param velocityZ
+    */
+    static void sample(const float *x, const float *y, const float *z, unsigned int count, float *velocityX, float *velocityY, float *velocityZ);
+
+private:
+    static std::vector<glm::vec3> velocities; // Velocity of each cell, x first
+};
@@ -0,0 +1,176 @@
+#include "flock-solver.h"
+
+#include "profiler.h"
+
+namespace
+{
+// Slots handled by each task of the thread pool
+const unsigned int chunkSize = 2048;
+// Particles whose neighbours are gathered and summed together
+const unsigned int blockSize = 64;
+// Neighbours a particle can steer with, the blocks are sized for it
+const unsigned int neighborLimit = 64;
+// Squared distance the separation stops growing at, so coincident particles don't push infinitely
+const float minDistanceSquared = 1e-4f;
+
+/**
+ * Neighbours of a block of particles, the k-th neighbour of particle b is at k * blockSize + b
+ * The particles with less neighbours than the most of the block are padded with zeros, which add nothing to the sums
+*/
+struct NeighborBlock
+{
+    float offsetX[neighborLimit * blockSize];   // Position of the neighbour relative to the particle
+    float offsetY[neighborLimit * blockSize];
+    float offsetZ[neighborLimit * blockSize];
+    float velocityX[neighborLimit * blockSize]; // Velocity of the neighbour
+    float velocityY[neighborLimit * blockSize];
+    float velocityZ[neighborLimit * blockSize];
+};
+} // namespace
+
+FlockSolver::FlockSolver(ThreadPool *threadPool)
+{
+    this->threadPool = threadPool;
+}
+
+void FlockSolver::setThreadPool(ThreadPool *threadPool)
+{
+    this->threadPool = threadPool;
+}
+
+void FlockSolver::step(const FlockParameters &parameters, const SpatialHash &spatialHash, std::vector<Particle> &particles, glm::vec3 externalForce, float deltaTime)
+{
+    PROFILE_SCOPE("FlockSolver::step");
+
+    const unsigned int count = spatialHash.getNumberOfParticles();
+    const std::vector<unsigned int> &indices = spatialHash.getSortedIndices();
+    const std::vector<glm::vec3> &positions = spatialHash.getSortedPositions();
+    const unsigned int maxNeighbors = (unsigned int)glm::clamp(parameters.maxNeighbors, 1, (int)neighborLimit);
+
+    // The particles are moved in place, the rules see the velocities of the step start
+    this->velocities.resize(count);
+    this->forEachChunk(count, [&](unsigned int first, unsigned int end) {
+        for (unsigned int slot = first; slot < end; slot++)
+            this->velocities[slot] = particles[indices[slot]].getDirection();
+    });
+
+    this->forEachChunk(count, [&](unsigned int first, unsigned int end) {
+        std::vector<NeighborBlock> blockStorage(1);
+        NeighborBlock &block = blockStorage[0];
+        // The particle finds itself too, one more is gathered so it still has the maximum of neighbours
+        unsigned int slots[neighborLimit + 1];
+        float distancesSquared[neighborLimit + 1];
+        float separationX[blockSize], separationY[blockSize], separationZ[blockSize];
+        float alignmentX[blockSize], alignmentY[blockSize], alignmentZ[blockSize];
+        float cohesionX[blockSize], cohesionY[blockSize], cohesionZ[blockSize];
+
+        for (unsigned int blockFirst = first; blockFirst < end; blockFirst += blockSize)
+        {
+            const unsigned int blockCount = glm::min(blockSize, end - blockFirst);
+
+            // Gathers the neighbours
+            unsigned int blockNeighbors = 0;
+            unsigned int found[blockSize];
+            for (unsigned int b = 0; b < blockCount; b++)
+            {
+                const unsigned int slot = blockFirst + b;
+                const unsigned int gathered = spatialHash.gatherNeighbors(positions[slot], parameters.radius, maxNeighbors + 1, slots, distancesSquared);
+                unsigned int k = 0;
+                for (unsigned int n = 0; n < gathered && k < maxNeighbors; n++)
+                {
+                    if (slots[n] == slot)
+                        continue;
+                    const unsigned int entry = k * blockSize + b;
+                    const glm::vec3 offset = positions[slots[n]] - positions[slot];
+                    const glm::vec3 velocity = this->velocities[slots[n]];
+                    block.offsetX[entry] = offset.x;
+                    block.offsetY[entry] = offset.y;
+                    block.offsetZ[entry] = offset.z;
+                    block.velocityX[entry] = velocity.x;
+                    block.velocityY[entry] = velocity.y;
+                    block.velocityZ[entry] = velocity.z;
+                    k++;
+                }
+                found[b] = k;
+                blockNeighbors = glm::max(blockNeighbors, k);
+            }
+            for (unsigned int k = 0; k < blockNeighbors; k++)
+                for (unsigned int b = 0; b < blockSize; b++)
+                    if (b >= blockCount || k >= found[b])
+                    {
+                        const unsigned int entry = k * blockSize + b;
+                        block.offsetX[entry] = block.offsetY[entry] = block.offsetZ[entry] = 0.0f;
+                        block.velocityX[entry] = block.velocityY[entry] = block.velocityZ[entry] = 0.0f;
+                    }
+
+            // Sums of the rules, every particle of the block at once
+            for (unsigned int b = 0; b < blockSize; b++)
+            {
+                separationX[b] = separationY[b] = separationZ[b] = 0.0f;
+                alignmentX[b] = alignmentY[b] = alignmentZ[b] = 0.0f;
+                cohesionX[b] = cohesionY[b] = cohesionZ[b] = 0.0f;
+            }
+            for (unsigned int k = 0; k < blockNeighbors; k++)
+            {
+                const unsigned int row = k * blockSize;
+                for (unsigned int b = 0; b < blockSize; b++)
+                {
+                    const float offsetX = block.offsetX[row + b];
+                    const float offsetY = block.offsetY[row + b];
+                    const float offsetZ = block.offsetZ[row + b];
+                    const float push = 1.0f / glm::max(offsetX * offsetX + offsetY * offsetY + offsetZ * offsetZ, minDistanceSquared);
+                    separationX[b] -= offsetX * push;
+                    separationY[b] -= offsetY * push;
+                    separationZ[b] -= offsetZ * push;
+                    alignmentX[b] += block.velocityX[row + b];
+                    alignmentY[b] += block.velocityY[row + b];
+                    alignmentZ[b] += block.velocityZ[row + b];
+                    cohesionX[b] += offsetX;
+                    cohesionY[b] += offsetY;
+                    cohesionZ[b] += offsetZ;
+                }
+            }
+
+            // Steers and moves each particle, each slot is a different particle
+            for (unsigned int b = 0; b < blockCount; b++)
+            {
+                const unsigned int slot = blockFirst + b;
+                const glm::vec3 velocity = this->velocities[slot];
+                glm::vec3 acceleration = externalForce;
+                if (found[b] > 0)
+                {
+                    const float inverseNeighbors = 1.0f / (float)found[b];
+                    acceleration += glm::vec3(separationX[b], separationY[b], separationZ[b]) * parameters.separation;
+                    acceleration += (glm::vec3(alignmentX[b], alignmentY[b], alignmentZ[b]) * inverseNeighbors - velocity) * parameters.alignment;
+                    acceleration += glm::vec3(cohesionX[b], cohesionY[b], cohesionZ[b]) * (inverseNeighbors * parameters.cohesion);
+                }
+                const glm::vec3 toTarget = parameters.target - positions[slot];
+                const float targetDistance = glm::length(toTarget);
+                if (targetDistance > 0.0f)
+                    acceleration += (toTarget * (parameters.maxSpeed / targetDistance) - velocity) * parameters.seek;
+
+                glm::vec3 newVelocity = velocity + acceleration * deltaTime;
+                const float speed = glm::length(newVelocity);
+                if (speed > parameters.maxSpeed)
+                    newVelocity *= parameters.maxSpeed / speed;
+
+                Particle &particle = particles[indices[slot]];
+                particle.setDirection(newVelocity);
+                particle.update(deltaTime, glm::vec3(0.0f));
+            }
+        }
+    });
+}
+
+void FlockSolver::forEachChunk(unsigned int count, const std::function<void(unsigned int, unsigned int)> &task)
+{
+    const unsigned int numberOfChunks = (count + chunkSize - 1) / chunkSize;
+    const std::function<void(unsigned int)> chunkTask = [&](unsigned int chunk) {
+        task(chunk * chunkSize, glm::min((chunk + 1) * chunkSize, count));
+    };
+    if (this->threadPool)
+        this->threadPool->parallelFor(numberOfChunks, chunkTask);
+    else
+        for (unsigned int chunk = 0; chunk < numberOfChunks; chunk++)
+            chunkTask(chunk);
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "particle.h"
+#include "spatial-hash.h"
+#include "thread-pool.h"
+
+/**
+ * Properties of the flocking behavior
+*/
+struct FlockParameters
+{
+    bool enabled;      // The particles steer as a flock instead of moving on their own
+    float radius;      // Distance the particles see their neighbours at
+    int maxNeighbors;  // Neighbours each particle steers with at most, bounds the cost of crowded flocks
+    float separation;  // Steering away from the close neighbours, stronger the closer they are
+    float alignment;   // Steering towards the average velocity of the neighbours
+    float cohesion;    // Steering towards the center of the neighbours
+    float seek;        // Steering towards the target
+    glm::vec3 target;  // Position the flock seeks
+    float maxSpeed;    // Speed the particles can't go over, also the speed they seek the target with
+};
+
+/**
+ * Flocking solver (Reynolds 1987), separation, alignment and cohesion with the neighbours plus seeking a target
+ * The particles are processed in the order of the spatial hash, in blocks whose capped neighbour lists are gathered
+ * transposed: the k-th neighbour of every particle of the block is contiguous, so the rules are summed over the
+ * particles of the block in loops the compiler vectorizes. The blocks are split in chunks across the thread pool.
+*/
+class FlockSolver
+{
+public:
+    /**
+     * Creates a flock solver
+     * @param threadPool Threads running the rules, NULL runs them on the calling thread
+    */
+    FlockSolver(ThreadPool *threadPool = NULL);
+    /**
+     * Sets the threads running the rules
+     * @param threadPool Threads running the rules, NULL runs them on the calling thread
+    */
+    void setThreadPool(ThreadPool *threadPool);
+    /**
+     * Steers and moves the particles of a spatial hash one step
+     * The velocities are updated first and the particles move with their new velocity
+     * @param parameters Flock properties
+     * @param spatialHash Alive particles, built with the positions of the particles and the radius as cell size
+     * @param particles Particles the hash was built from
+     * @param externalForce Acceleration of every particle (i.e gravity)
+     * @param deltaTime Time step
+    */
+    void step(const FlockParameters &parameters, const SpatialHash &spatialHash, std::vector<Particle> &particles, glm::vec3 externalForce, float deltaTime);
+
+private:
+    /**
+     * Runs a task over chunks of a range, in parallel with the thread pool
+     * @param count Number of elements
+     * @param task Called with the first and the end element of each chunk
+    */
+    void forEachChunk(unsigned int count, const std::function<void(unsigned int, unsigned int)> &task);
+
+    ThreadPool *threadPool;            // Threads running the rules, NULL runs them on the calling thread
+    std::vector<glm::vec3> velocities; // Velocity of each slot at the start of the step
+};
@@ -0,0 +1,131 @@
+#include "fluid-solver.h"
+
+#include <cmath>
+
+#include <glm/gtc/constants.hpp>
+
+#include "profiler.h"
+
+namespace
+{
+// Slots handled by each task of the thread pool
+const unsigned int chunkSize = 2048;
+} // namespace
+
+FluidSolver::FluidSolver(ThreadPool *threadPool)
+{
+    this->threadPool = threadPool;
+}
+
+void FluidSolver::setThreadPool(ThreadPool *threadPool)
+{
+    this->threadPool = threadPool;
+}
+
+void FluidSolver::step(const FluidParameters &parameters, const SpatialHash &spatialHash, std::vector<Particle> &particles, glm::vec3 externalForce, float deltaTime)
+{
+    PROFILE_SCOPE("FluidSolver::step");
+
+    const unsigned int count = spatialHash.getNumberOfParticles();
+    const std::vector<unsigned int> &indices = spatialHash.getSortedIndices();
+    const std::vector<glm::vec3> &positions = spatialHash.getSortedPositions();
+    this->velocities.resize(count);
+    this->densities.resize(count);
+    this->pressures.resize(count);
+    this->accelerations.resize(count);
+
+    // Kernels: poly6 for the density, the gradient of spiky for the pressure and the laplacian of the viscosity kernel
+    const float h = parameters.radius;
+    const float h2 = h * h;
+    const float h6 = h2 * h2 * h2;
+    const float spacing = 0.5f * h;
+    const float mass = parameters.restDensity * spacing * spacing * spacing;
+    const float poly6 = 315.0f / (64.0f * glm::pi<float>() * h6 * h2 * h);
+    const float spikyGradient = 45.0f / (glm::pi<float>() * h6);
+    const float viscosityLaplacian = 45.0f / (glm::pi<float>() * h6);
+    // A particle doesn't move further than the radius in a step, so a violent step can't blow the fluid up
+    const float maxSpeed = h / deltaTime;
+
+    // The neighbours found by the density pass are kept for the forces, each chunk stores its own so the chunks run in parallel
+    const unsigned int numberOfChunks = (count + chunkSize - 1) / chunkSize;
+    this->chunkNeighbors.resize(numberOfChunks);
+    this->neighborStart.resize(count);
+    this->forEachChunk(count, [&](unsigned int first, unsigned int end) {
+        std::vector<FluidNeighbor> &neighbors = this->chunkNeighbors[first / chunkSize];
+        neighbors.clear();
+        for (unsigned int slot = first; slot < end; slot++)
+        {
+            this->velocities[slot] = particles[indices[slot]].getDirection();
+            this->neighborStart[slot] = (unsigned int)neighbors.size();
+            float sum = 0.0f;
+            spatialHash.forEachNeighbor(positions[slot], h, [&](unsigned int neighbor, float distanceSquared) {
+                const float w = h2 - distanceSquared;
+                sum += w * w * w;
+                if (neighbor != slot)
+                    neighbors.push_back({neighbor, std::sqrt(distanceSquared)});
+            });
+            // The pressure only pushes, a negative pressure would clump the particles at the surface
+            this->densities[slot] = mass * poly6 * sum;
+            this->pressures[slot] = parameters.stiffness * glm::max(this->densities[slot] - parameters.restDensity, 0.0f);
+        }
+    });
+
+    this->forEachChunk(count, [&](unsigned int first, unsigned int end) {
+        const std::vector<FluidNeighbor> &neighbors = this->chunkNeighbors[first / chunkSize];
+        for (unsigned int slot = first; slot < end; slot++)
+        {
+            const glm::vec3 position = positions[slot];
+            const glm::vec3 velocity = this->velocities[slot];
+            const float pressure = this->pressures[slot];
+            const unsigned int neighborEnd = slot + 1 < end ? this->neighborStart[slot + 1] : (unsigned int)neighbors.size();
+            glm::vec3 pressureForce(0.0f);
+            glm::vec3 viscosityForce(0.0f);
+            for (unsigned int n = this->neighborStart[slot]; n < neighborEnd; n++)
+            {
+                const unsigned int neighbor = neighbors[n].slot;
+                const float distance = neighbors[n].distance;
+                const float q = h - distance;
+                const float inverseDensity = 1.0f / this->densities[neighbor];
+                // Coincident particles have no direction to be pushed along, the viscosity still evens their velocities
+                if (distance > 0.0f)
+                    pressureForce += (position - positions[neighbor]) * ((pressure + this->pressures[neighbor]) * 0.5f * inverseDensity * q * q / distance);
+                viscosityForce += (this->velocities[neighbor] - velocity) * (inverseDensity * q);
+            }
+            const float scale = mass / this->densities[slot];
+            this->accelerations[slot] = (pressureForce * spikyGradient + viscosityForce * (parameters.viscosity * viscosityLaplacian)) * scale + externalForce;
+        }
+    });
+
+    // Each slot is a different particle, the chunks write different particles
+    this->forEachChunk(count, [&](unsigned int first, unsigned int end) {
+        for (unsigned int slot = first; slot < end; slot++)
+        {
+            glm::vec3 velocity = this->velocities[slot] + this->accelerations[slot] * deltaTime;
+            const float speed = glm::length(velocity);
+            if (speed > maxSpeed)
+                velocity *= maxSpeed / speed;
+
+            Particle &particle = particles[indices[slot]];
+            particle.setDirection(velocity);
+            particle.update(deltaTime, glm::vec3(0.0f));
+        }
+    });
+}
+
+const std::vector<float> &FluidSolver::getDensities() const
+{
+    return this->densities;
+}
+
+void FluidSolver::forEachChunk(unsigned int count, const std::function<void(unsigned int, unsigned int)> &task)
+{
+    const unsigned int numberOfChunks = (count + chunkSize - 1) / chunkSize;
+    const std::function<void(unsigned int)> chunkTask = [&](unsigned int chunk) {
+        task(chunk * chunkSize, glm::min((chunk + 1) * chunkSize, count));
+    };
+    if (this->threadPool)
+        this->threadPool->parallelFor(numberOfChunks, chunkTask);
+    else
+        for (unsigned int chunk = 0; chunk < numberOfChunks; chunk++)
+            chunkTask(chunk);
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "particle.h"
+#include "spatial-hash.h"
+#include "thread-pool.h"
+
+/**
+ * Properties of the fluid simulated by the particles
+*/
+struct FluidParameters
+{
+    bool enabled;      // The particles are simulated as a fluid instead of moving on their own
+    float radius;      // Smoothing radius, the particles closer than it interact
+    float restDensity; // Density the pressure pushes the fluid towards
+    float stiffness;   // Pressure per unit of density above the rest density, the square of the speed of sound
+    float viscosity;   // How much the particles drag their neighbours along
+    float timeStep;    // Fixed time step of the solver
+};
+
+/**
+ * Neighbour of a particle found by the density pass
+*/
+struct FluidNeighbor
+{
+    unsigned int slot; // Slot of the neighbour in the spatial hash
+    float distance;    // Distance to the neighbour
+};
+
+/**
+ * Smoothed particle hydrodynamics solver (Muller et al. 2003)
+ * Each step computes the density of every particle from its neighbours, the pressure from the density and then the
+ * pressure and viscosity accelerations. The passes run over the slots of the spatial hash, so the neighbours are close in memory,
+ * and each pass is split in chunks across the thread pool. Every particle has the mass of a cube of rest density half the
+ * radius wide, so a fluid at rest has about 30 neighbours.
+*/
+class FluidSolver
+{
+public:
+    /**
+     * Creates a fluid solver
+     * @param threadPool Threads running the passes, NULL runs them on the calling thread
+    */
+    FluidSolver(ThreadPool *threadPool = NULL);
+    /**
+     * Sets the threads running the passes
+     * @param threadPool Threads running the passes, NULL runs them on the calling thread
+    */
+    void setThreadPool(ThreadPool *threadPool);
+    /**
+     * Advances the particles of a spatial hash one step
+     * Symplectic Euler, the velocities are updated first and the particles move with their new velocity
+     * @param parameters Fluid properties
+     * @param spatialHash Alive particles, built with the positions of the particles and the smoothing radius as cell size
+     * @param particles Particles the hash was built from
+     * @param externalForce Acceleration of every particle (i.e gravity)
+     * @param deltaTime Time step
+    */
+    void step(const FluidParameters &parameters, const SpatialHash &spatialHash, std::vector<Particle> &particles, glm::vec3 externalForce, float deltaTime);
+    /**
+     * Gets the densities of the last step
+     * @return Density of each slot of the spatial hash the step used
+    */
+    const std::vector<float> &getDensities() const;
+
+private:
+    /**
+     * Runs a task over chunks of a range, in parallel with the thread pool
+     * @param count Number of elements
+     * @param task Called with the first and the end element of each chunk
+    */
+    void forEachChunk(unsigned int count, const std::function<void(unsigned int, unsigned int)> &task);
+
+    ThreadPool *threadPool;               // Threads running the passes, NULL runs them on the calling thread
+    std::vector<glm::vec3> velocities;    // Velocity of each slot at the start of the step
+    std::vector<float> densities;         // Density of each slot
+    std::vector<float> pressures;         // Pressure of each slot
+    std::vector<glm::vec3> accelerations; // Pressure, viscosity and external acceleration of each slot
+    std::vector<std::vector<FluidNeighbor>> chunkNeighbors; // Neighbours of the slots of each chunk
+    std::vector<unsigned int> neighborStart;                // First neighbour of each slot in the list of its chunk
+};
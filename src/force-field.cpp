@@ -0,0 +1,295 @@
+#include "force-field.h"
+
+#include <cmath>
+#include <sstream>
+
+#include <glm/gtc/noise.hpp>
+
+#include "curl-noise.h"
+
+const char *forceFieldNames[NUMBER_OF_FORCE_FIELD_TYPES] = {"attractor", "vortex", "drag", "wind", "turbulence", "curl"};
+
+namespace
+{
+// Keeps the attractors and vortices finite at their center
+const float forceFieldSoftening = 0.01f;
+
+/**
+ * Computes the inverse radius of a field's volume
+ * The weight of a particle is 1 - distance * inverse radius, so the fields acting everywhere weight 1.
+ * The loops below have no branches and only read and write plain arrays, so they're vectorized.
+ * @param field Force field
+ * @return Inverse radius, 0 if the field acts everywhere
+*/
+float inverseRadius(const ForceField &field)
+{
+    return field.radius > 0.0f ? 1.0f / field.radius : 0.0f;
+}
+
+/**
+ * Accelerates the particles towards the center of the field
+ * @param field Attractor, a negative strength repels
+ * @param chunk Particles
+*/
+void applyAttractor(const ForceField &field, ForceChunk &chunk)
+{
+    const float invRadius = inverseRadius(field);
+    const glm::vec3 center = field.position;
+    const float strength = field.strength;
+    for (unsigned int i = 0; i < chunk.count; i++)
+    {
+        const float dx = center.x - chunk.positionX[i];
+        const float dy = center.y - chunk.positionY[i];
+        const float dz = center.z - chunk.positionZ[i];
+        const float distance = std::sqrt(dx * dx + dy * dy + dz * dz + forceFieldSoftening * forceFieldSoftening);
+        const float weight = glm::max(1.0f - distance * invRadius, 0.0f);
+        const float scale = strength * weight / distance;
+        chunk.accelerationX[i] += dx * scale;
+        chunk.accelerationY[i] += dy * scale;
+        chunk.accelerationZ[i] += dz * scale;
+    }
+}
+
+/**
+ * Accelerates the particles around the axis of the field, tangent to the circle around it
+ * @param field Vortex, a negative strength spins the other way
+ * @param chunk Particles
+*/
+void applyVortex(const ForceField &field, ForceChunk &chunk)
+{
+    const float invRadius = inverseRadius(field);
+    const glm::vec3 center = field.position;
+    const float strength = field.strength;
+    const glm::vec3 axis = glm::length(field.direction) > 0.0f ? glm::normalize(field.direction) : glm::vec3(0.0f, 1.0f, 0.0f);
+    for (unsigned int i = 0; i < chunk.count; i++)
+    {
+        const float rx = chunk.positionX[i] - center.x;
+        const float ry = chunk.positionY[i] - center.y;
+        const float rz = chunk.positionZ[i] - center.z;
+        // Tangent around the axis, its length is the distance to the axis
+        const float tx = axis.y * rz - axis.z * ry;
+        const float ty = axis.z * rx - axis.x * rz;
+        const float tz = axis.x * ry - axis.y * rx;
+        const float distance = std::sqrt(rx * rx + ry * ry + rz * rz);
+        const float weight = glm::max(1.0f - distance * invRadius, 0.0f);
+        const float scale = strength * weight / std::sqrt(tx * tx + ty * ty + tz * tz + forceFieldSoftening * forceFieldSoftening);
+        chunk.accelerationX[i] += tx * scale;
+        chunk.accelerationY[i] += ty * scale;
+        chunk.accelerationZ[i] += tz * scale;
+    }
+}
+
+/**
+ * Decelerates the particles proportionally to their velocity
+ * @param field Drag, its strength is the inverse time to stop
+ * @param chunk Particles
+*/
+void applyDrag(const ForceField &field, ForceChunk &chunk)
+{
+    const float invRadius = inverseRadius(field);
+    const glm::vec3 center = field.position;
+    const float strength = field.strength;
+    for (unsigned int i = 0; i < chunk.count; i++)
+    {
+        const float rx = chunk.positionX[i] - center.x;
+        const float ry = chunk.positionY[i] - center.y;
+        const float rz = chunk.positionZ[i] - center.z;
+        const float weight = glm::max(1.0f - std::sqrt(rx * rx + ry * ry + rz * rz) * invRadius, 0.0f);
+        const float scale = -strength * weight;
+        chunk.accelerationX[i] += chunk.velocityX[i] * scale;
+        chunk.accelerationY[i] += chunk.velocityY[i] * scale;
+        chunk.accelerationZ[i] += chunk.velocityZ[i] * scale;
+    }
+}
+
+/**
+ * Accelerates the particles along the direction of the field
+ * @param field Wind
+ * @param chunk Particles
+*/
+void applyWind(const ForceField &field, ForceChunk &chunk)
+{
+    const float invRadius = inverseRadius(field);
+    const glm::vec3 center = field.position;
+    const glm::vec3 wind = glm::length(field.direction) > 0.0f ? glm::normalize(field.direction) * field.strength : glm::vec3(0.0f);
+    for (unsigned int i = 0; i < chunk.count; i++)
+    {
+        const float rx = chunk.positionX[i] - center.x;
+        const float ry = chunk.positionY[i] - center.y;
+        const float rz = chunk.positionZ[i] - center.z;
+        const float weight = glm::max(1.0f - std::sqrt(rx * rx + ry * ry + rz * rz) * invRadius, 0.0f);
+        chunk.accelerationX[i] += wind.x * weight;
+        chunk.accelerationY[i] += wind.y * weight;
+        chunk.accelerationZ[i] += wind.z * weight;
+    }
+}
+
+/**
+ * Accelerates the particles with a noise that changes over space and time
+ * @param field Turbulence
+ * @param chunk Particles
+ * @param time Time of the particle system
+*/
+void applyTurbulence(const ForceField &field, ForceChunk &chunk, float time)
+{
+    // The noise isn't vectorized, it's the most expensive field
+    const float invRadius = inverseRadius(field);
+    for (unsigned int i = 0; i < chunk.count; i++)
+    {
+        const glm::vec3 position(chunk.positionX[i], chunk.positionY[i], chunk.positionZ[i]);
+        const float weight = glm::max(1.0f - glm::length(position - field.position) * invRadius, 0.0f);
+        if (weight <= 0.0f)
+            continue;
+
+        // Each component samples the noise far from the others, so they're independent
+        const glm::vec3 sample = position * field.frequency;
+        const glm::vec3 noise(glm::simplex(glm::vec4(sample, time)),
+                              glm::simplex(glm::vec4(sample + glm::vec3(31.4f, 0.0f, 0.0f), time)),
+                              glm::simplex(glm::vec4(sample + glm::vec3(0.0f, 47.2f, 0.0f), time)));
+        chunk.accelerationX[i] += noise.x * field.strength * weight;
+        chunk.accelerationY[i] += noise.y * field.strength * weight;
+        chunk.accelerationZ[i] += noise.z * field.strength * weight;
+    }
+}
+
+/**
+ * Accelerates the particles along the curl noise volume, sampled where the particles are after the volume scrolls
+ * @param field Curl noise
+ * @param chunk Particles
+ * @param time Time of the particle system
+*/
+void applyCurlNoise(const ForceField &field, ForceChunk &chunk, float time)
+{
+    float sampleX[ForceChunk::capacity], sampleY[ForceChunk::capacity], sampleZ[ForceChunk::capacity];
+    float noiseX[ForceChunk::capacity], noiseY[ForceChunk::capacity], noiseZ[ForceChunk::capacity];
+    const glm::vec3 scroll = field.direction * time;
+    const float frequency = field.frequency;
+    for (unsigned int i = 0; i < chunk.count; i++)
+    {
+        sampleX[i] = chunk.positionX[i] * frequency - scroll.x;
+        sampleY[i] = chunk.positionY[i] * frequency - scroll.y;
+        sampleZ[i] = chunk.positionZ[i] * frequency - scroll.z;
+    }
+    CurlNoise::sample(sampleX, sampleY, sampleZ, chunk.count, noiseX, noiseY, noiseZ);
+
+    const float invRadius = inverseRadius(field);
+    const glm::vec3 center = field.position;
+    const float strength = field.strength;
+    for (unsigned int i = 0; i < chunk.count; i++)
+    {
+        const float rx = chunk.positionX[i] - center.x;
+        const float ry = chunk.positionY[i] - center.y;
+        const float rz = chunk.positionZ[i] - center.z;
+        const float scale = strength * glm::max(1.0f - std::sqrt(rx * rx + ry * ry + rz * rz) * invRadius, 0.0f);
+        chunk.accelerationX[i] += noiseX[i] * scale;
+        chunk.accelerationY[i] += noiseY[i] * scale;
+        chunk.accelerationZ[i] += noiseZ[i] * scale;
+    }
+}
+} // namespace
+
+unsigned int evaluateForceFields(const std::vector<ForceField> &forceFields, ForceChunk &chunk, float time)
+{
+    for (unsigned int i = 0; i < chunk.count; i++)
+    {
+        chunk.accelerationX[i] = 0.0f;
+        chunk.accelerationY[i] = 0.0f;
+        chunk.accelerationZ[i] = 0.0f;
+    }
+    if (chunk.count == 0)
+        return 0;
+
+    // Bounding box of the chunk, the fields whose sphere doesn't touch it are skipped
+    glm::vec3 boundsMin(chunk.positionX[0], chunk.positionY[0], chunk.positionZ[0]);
+    glm::vec3 boundsMax = boundsMin;
+    for (unsigned int i = 1; i < chunk.count; i++)
+    {
+        const glm::vec3 position(chunk.positionX[i], chunk.positionY[i], chunk.positionZ[i]);
+        boundsMin = glm::min(boundsMin, position);
+        boundsMax = glm::max(boundsMax, position);
+    }
+
+    unsigned int evaluated = 0;
+    for (size_t i = 0; i < forceFields.size(); i++)
+    {
+        const ForceField &field = forceFields[i];
+        if (field.strength == 0.0f)
+            continue;
+        if (field.radius > 0.0f)
+        {
+            const glm::vec3 closest = glm::clamp(field.position, boundsMin, boundsMax);
+            const glm::vec3 offset = closest - field.position;
+            if (glm::dot(offset, offset) >= field.radius * field.radius)
+                continue;
+        }
+
+        switch (field.type)
+        {
+        case FORCE_ATTRACTOR:
+            applyAttractor(field, chunk);
+            break;
+        case FORCE_VORTEX:
+            applyVortex(field, chunk);
+            break;
+        case FORCE_DRAG:
+            applyDrag(field, chunk);
+            break;
+        case FORCE_WIND:
+            applyWind(field, chunk);
+            break;
+        case FORCE_TURBULENCE:
+            applyTurbulence(field, chunk, time);
+            break;
+        case FORCE_CURL_NOISE:
+            applyCurlNoise(field, chunk, time);
+            break;
+        default:
+            continue;
+        }
+        evaluated++;
+    }
+    return evaluated;
+}
+
+void writeForceFields(std::ostream &file, const std::vector<ForceField> &forceFields)
+{
+    file << forceFields.size();
+    for (size_t i = 0; i < forceFields.size(); i++)
+    {
+        const ForceField &field = forceFields[i];
+        file << " " << forceFieldNames[field.type]
+             << " " << field.position.x << " " << field.position.y << " " << field.position.z
+             << " " << field.direction.x << " " << field.direction.y << " " << field.direction.z
+             << " " << field.strength << " " << field.radius << " " << field.frequency;
+    }
+}
+
+bool readForceFields(const std::string &value, std::vector<ForceField> &forceFields)
+{
+    std::istringstream text(value);
+    size_t count;
+    if (!(text >> count))
+        return false;
+
+    // The fields are added as they're parsed, a corrupted count fails on the missing entries instead of allocating them
+    std::vector<ForceField> fields;
+    for (size_t i = 0; i < count; i++)
+    {
+        ForceField field = ForceField();
+        std::string name;
+        if (!(text >> name >> field.position.x >> field.position.y >> field.position.z >> field.direction.x >>
+              field.direction.y >> field.direction.z >> field.strength >> field.radius >> field.frequency))
+            return false;
+
+        field.type = NUMBER_OF_FORCE_FIELD_TYPES;
+        for (int type = 0; type < NUMBER_OF_FORCE_FIELD_TYPES; type++)
+            if (name == forceFieldNames[type])
+                field.type = type;
+        if (field.type == NUMBER_OF_FORCE_FIELD_TYPES)
+            return false;
+        fields.push_back(field);
+    }
+
+    forceFields.swap(fields);
+    return true;
+}
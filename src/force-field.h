@@ -0,0 +1,84 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+/**
+ * Kinds of force fields
+*/
+enum ForceFieldType
+{
+    FORCE_ATTRACTOR,  // Pulls the particles towards its position, a negative strength repels them
+    FORCE_VORTEX,     // Spins the particles around its axis
+    FORCE_DRAG,       // Slows the particles down
+    FORCE_WIND,       // Pushes the particles along its direction
+    FORCE_TURBULENCE, // Noise that changes over space and time
+    FORCE_CURL_NOISE, // Swirls the particles along the baked curl noise volume, scrolled over time
+    NUMBER_OF_FORCE_FIELD_TYPES
+};
+
+/**
+ * Names of the force field types, used by the configuration files and the interface
+*/
+extern const char *forceFieldNames[NUMBER_OF_FORCE_FIELD_TYPES];
+
+/**
+ * Force field acting on the particles of a particle system
+ * Fields with a radius only act inside their sphere, their strength falls off linearly from the center
+*/
+struct ForceField
+{
+    int type;            // ForceFieldType
+    glm::vec3 position;  // Center of the field and of its volume
+    glm::vec3 direction; // Axis of the vortex, direction of the wind, scroll velocity of the curl noise
+    float strength;      // Acceleration at the center
+    float radius;        // Radius of the volume, 0 acts everywhere
+    float frequency;     // Spatial frequency of the turbulence and the curl noise
+};
+
+/**
+ * Particles of a chunk laid out as structure of arrays, so each field is evaluated in a vectorizable loop
+*/
+struct ForceChunk
+{
+    static const unsigned int capacity = 256; // Maximun number of particles of a chunk
+
+    unsigned int count;            // Number of particles of the chunk
+    float positionX[capacity];     // Particle's position
+    float positionY[capacity];
+    float positionZ[capacity];
+    float velocityX[capacity];     // Particle's direction
+    float velocityY[capacity];
+    float velocityZ[capacity];
+    float accelerationX[capacity]; // Acceleration of every field, written by evaluateForceFields
+    float accelerationY[capacity];
+    float accelerationZ[capacity];
+};
+
+/**
+ * Computes the acceleration of the force fields on a chunk of particles
+ * The fields whose volume doesn't touch the bounding box of the chunk are skipped
+ * @param forceFields Fields acting on the particles
+ * @param chunk Positions and velocities of the particles, where the accelerations are stored
+ * @param time Time of the particle system, moves the turbulence
+ * @return Number of fields evaluated (not culled)
+*/
+unsigned int evaluateForceFields(const std::vector<ForceField> &forceFields, ForceChunk &chunk, float time);
+
+/**
+ * Writes force fields as a configuration value, the number of fields followed by each field
+ * @param file Where the fields are written, its precision is used
+ * @param forceFields Fields to be written
+*/
+void writeForceFields(std::ostream &file, const std::vector<ForceField> &forceFields);
+
+/**
+ * Reads force fields from a configuration value
+ * @param value Text value
+ * @param forceFields Where the fields are stored
+ * @return The value is valid
+*/
+bool readForceFields(const std::string &value, std::vector<ForceField> &forceFields);
@@ -0,0 +1,243 @@
+#include "frame-capture.h"
+#include "image-writer.h"
+#include "profiler.h"
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+FrameCapture::FrameCapture(unsigned int numberOfBuffers, unsigned int numberOfWorkers, unsigned int maxPendingFrames)
+    : jobs(maxPendingFrames)
+{
+    this->nextReadBack = 0;
+    this->oldestReadBack = 0;
+    this->format = CAPTURE_PNG;
+    this->capturing = false;
+    this->framesCaptured = 0;
+    this->framesQueued = 0;
+    this->framesWritten = 0;
+
+    // Creates the ring of pixel buffers, their storage is allocated on the first capture
+    this->readBacks.resize(numberOfBuffers > 0 ? numberOfBuffers : 1);
+    for (size_t i = 0; i < this->readBacks.size(); i++)
+    {
+        ReadBack &readBack = this->readBacks[i];
+        glGenBuffers(1, &readBack.pbo);
+        readBack.fence = 0;
+        readBack.frame = 0;
+        readBack.width = 0;
+        readBack.height = 0;
+        readBack.pending = false;
+    }
+
+    // Starts the encoding threads
+    for (unsigned int i = 0; i < (numberOfWorkers > 0 ? numberOfWorkers : 1); i++)
+        this->workers.push_back(std::thread(&FrameCapture::encodeFrames, this));
+}
+
+FrameCapture::~FrameCapture()
+{
+    // Writes the frames not written yet and stops the workers
+    this->stop();
+    this->jobs.close();
+    for (size_t i = 0; i < this->workers.size(); i++)
+        this->workers[i].join();
+
+    for (size_t i = 0; i < this->readBacks.size(); i++)
+    {
+        if (this->readBacks[i].fence)
+            glDeleteSync(this->readBacks[i].fence);
+        glDeleteBuffers(1, &this->readBacks[i].pbo);
+    }
+}
+
+void FrameCapture::start(const std::string &outputPrefix, CaptureFormat format)
+{
+    // Finishes the previous sequence
+    this->stop();
+
+    this->outputPrefix = outputPrefix;
+    this->format = format;
+    this->framesCaptured = 0;
+    this->framesQueued = 0;
+    {
+        std::lock_guard<std::mutex> lock(this->writtenMutex);
+        this->framesWritten = 0;
+    }
+    this->capturing = true;
+}
+
+void FrameCapture::stop()
+{
+    if (!this->capturing)
+        return;
+
+    // Collects the read backs still in flight
+    this->flush();
+
+    // Waits until the workers have written every frame of the sequence
+    std::unique_lock<std::mutex> lock(this->writtenMutex);
+    this->writtenChanged.wait(lock, [this] { return this->framesWritten >= this->framesQueued; });
+
+    this->capturing = false;
+}
+
+void FrameCapture::capture(unsigned int width, unsigned int height)
+{
+    if (!this->capturing || width == 0 || height == 0)
+        return;
+
+    const unsigned int numberOfBuffers = (unsigned int)this->readBacks.size();
+
+    // Collects the finished read backs, in capture order, without waiting for the GPU
+    while (this->readBacks[this->oldestReadBack].pending && this->collect(this->readBacks[this->oldestReadBack], false))
+        this->oldestReadBack = (this->oldestReadBack + 1) % numberOfBuffers;
+
+    ReadBack &readBack = this->readBacks[this->nextReadBack];
+
+    // The ring is full, the oldest read back was issued numberOfBuffers frames ago so it's usually already done
+    if (readBack.pending)
+    {
+        this->collect(readBack, true);
+        this->oldestReadBack = (this->oldestReadBack + 1) % numberOfBuffers;
+    }
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readBack.pbo);
+    // Resizes the pixel buffer if the window size changed
+    if (readBack.width != width || readBack.height != height)
+        glBufferData(GL_PIXEL_PACK_BUFFER, (size_t)width * height * 4, NULL, GL_STREAM_READ);
+
+    // Starts the read back, the call returns as soon as the copy is queued on the GPU
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, (void *)0);
+    readBack.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    readBack.width = width;
+    readBack.height = height;
+    readBack.frame = this->framesCaptured++;
+    readBack.pending = true;
+
+    this->nextReadBack = (this->nextReadBack + 1) % numberOfBuffers;
+}
+
+bool FrameCapture::isCapturing()
+{
+    return this->capturing;
+}
+
+unsigned int FrameCapture::getFramesCaptured()
+{
+    return this->framesCaptured;
+}
+
+unsigned int FrameCapture::getFramesWritten()
+{
+    std::lock_guard<std::mutex> lock(this->writtenMutex);
+    return this->framesWritten;
+}
+
+bool FrameCapture::collect(ReadBack &readBack, bool wait)
+{
+    if (!readBack.pending)
+        return true;
+
+    // Checks if the GPU has finished the read back
+    GLenum status = glClientWaitSync(readBack.fence, 0, 0);
+    if (status == GL_TIMEOUT_EXPIRED)
+    {
+        if (!wait)
+            return false;
+
+        do
+            status = glClientWaitSync(readBack.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+        while (status == GL_TIMEOUT_EXPIRED);
+    }
+    glDeleteSync(readBack.fence);
+    readBack.fence = 0;
+    readBack.pending = false;
+
+    EncodeJob job;
+    // Reuses the memory of an already written frame
+    {
+        std::lock_guard<std::mutex> lock(this->freeBuffersMutex);
+        if (!this->freeBuffers.empty())
+        {
+            job.pixels = std::move(this->freeBuffers.back());
+            this->freeBuffers.pop_back();
+        }
+    }
+    const size_t size = (size_t)readBack.width * readBack.height * 4;
+    job.pixels.resize(size);
+    job.width = readBack.width;
+    job.height = readBack.height;
+    job.format = this->format;
+
+    // Copies the pixels out of the pixel buffer
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readBack.pbo);
+    const void *pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+    if (pixels)
+    {
+        memcpy(job.pixels.data(), pixels, size);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    if (!pixels)
+    {
+        std::cout << "ERROR:: Unable to map the frame " << readBack.frame << std::endl;
+        return true;
+    }
+
+    // Builds the image path, i.e capture/frame_00042.png
+    char number[16];
+    snprintf(number, sizeof(number), "_%05u", readBack.frame);
+    job.path = this->outputPrefix + number + (this->format == CAPTURE_PNG ? ".png" : ".rgba");
+
+    // Hands the frame to the workers, waits if they are behind (backpressure, frames aren't dropped)
+    this->framesQueued++;
+    this->jobs.push(std::move(job));
+    return true;
+}
+
+void FrameCapture::flush()
+{
+    const unsigned int numberOfBuffers = (unsigned int)this->readBacks.size();
+
+    while (this->readBacks[this->oldestReadBack].pending)
+    {
+        this->collect(this->readBacks[this->oldestReadBack], true);
+        this->oldestReadBack = (this->oldestReadBack + 1) % numberOfBuffers;
+    }
+}
+
+void FrameCapture::encodeFrames()
+{
+    PROFILE_THREAD_NAME("Capture encoder");
+    EncodeJob job;
+
+    while (this->jobs.pop(job))
+    {
+        PROFILE_SCOPE("Encode frame");
+
+        // OpenGL stores the rows bottom to top, the images are flipped while written
+        bool written;
+        if (job.format == CAPTURE_PNG)
+            written = writePNG(job.path, job.width, job.height, 4, job.pixels.data(), true);
+        else
+            written = writeRaw(job.path, job.width, job.height, 4, job.pixels.data(), true);
+
+        if (!written)
+            std::cout << "ERROR:: Unable to write the frame " << job.path << std::endl;
+
+        // Gives the frame memory back to be reused
+        {
+            std::lock_guard<std::mutex> lock(this->freeBuffersMutex);
+            this->freeBuffers.push_back(std::move(job.pixels));
+        }
+        {
+            std::lock_guard<std::mutex> lock(this->writtenMutex);
+            this->framesWritten++;
+        }
+        this->writtenChanged.notify_all();
+    }
+}
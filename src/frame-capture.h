@@ -0,0 +1,134 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bounded-queue.h"
+
+/**
+ * Image formats supported by the frame capture
+*/
+enum CaptureFormat
+{
+    CAPTURE_PNG,
+    CAPTURE_RAW
+};
+
+/**
+ * Captures the rendered frames into an image sequence without stalling the render loop
+ * The frame buffer is read back asynchronously into a ring of pixel buffer objects,
+ * a read back is collected a few frames later, when the GPU has finished it, and handed
+ * to a pool of workers that encode and write the images.
+ * When the workers can't keep up the capture waits for them, so no frame is ever dropped
+*/
+class FrameCapture
+{
+public:
+    /**
+     * Creates a frame capture
+     * @param numberOfBuffers Number of pixel buffers in the read back ring (frames in flight)
+     * @param numberOfWorkers Number of threads encoding the images
+     * @param maxPendingFrames Maximun number of frames waiting to be encoded
+    */
+    FrameCapture(unsigned int numberOfBuffers = 3, unsigned int numberOfWorkers = 2, unsigned int maxPendingFrames = 8);
+    /**
+     * Finishes the pending frames and destroys the frame capture
+    */
+    ~FrameCapture();
+    /**
+     * Starts a new image sequence
+     * @param outputPrefix Path prefix of the images, the frame number and the extension are appended
+     * @param format Format of the images
+    */
+    void start(const std::string &outputPrefix, CaptureFormat format);
+    /**
+     * Stops the image sequence, waits until every captured frame is written
+    */
+    void stop();
+    /**
+     * Reads back the current frame buffer, has to be called after the scene is rendered
+     * and before the buffers are swapped
+     * @param width Width of the frame buffer
+     * @param height Height of the frame buffer
+    */
+    void capture(unsigned int width, unsigned int height);
+    /**
+     * Gets the capture status
+     * @return An image sequence is being captured
+    */
+    bool isCapturing();
+    /**
+     * Gets the number of frames captured in the current sequence
+     * @return Number of frames read back
+    */
+    unsigned int getFramesCaptured();
+    /**
+     * Gets the number of frames written in the current sequence
+     * @return Number of images written to disk
+    */
+    unsigned int getFramesWritten();
+
+private:
+    /**
+     * Pixel buffer where a frame is read back
+    */
+    struct ReadBack
+    {
+        unsigned int pbo;     // Index (GPU) of the pixel buffer
+        GLsync fence;         // Signaled when the read back is done
+        unsigned int frame;   // Frame number in the sequence
+        unsigned int width;   // Width of the frame read back
+        unsigned int height;  // Height of the frame read back
+        bool pending;         // The read back hasn't been collected yet
+    };
+    /**
+     * Frame waiting to be encoded
+    */
+    struct EncodeJob
+    {
+        std::vector<unsigned char> pixels; // RGBA pixels, bottom row first
+        std::string path;                  // Path of the image to be written
+        CaptureFormat format;              // Format of the image
+        unsigned int width;                // Width of the frame
+        unsigned int height;               // Height of the frame
+    };
+
+    /**
+     * Copies a finished read back and queues it to be encoded
+     * @param readBack Read back to be collected
+     * @param wait Waits for the GPU if the read back isn't finished
+     * @return The read back was collected
+    */
+    bool collect(ReadBack &readBack, bool wait);
+    /**
+     * Collects every pending read back in capture order
+    */
+    void flush();
+    /**
+     * Worker loop, encodes the queued frames until the queue is closed
+    */
+    void encodeFrames();
+
+    std::vector<ReadBack> readBacks; // Ring of pixel buffers
+    unsigned int nextReadBack;       // Index of the next pixel buffer to be used
+    unsigned int oldestReadBack;     // Index of the oldest pixel buffer not collected
+
+    BoundedQueue<EncodeJob> jobs;                        // Frames waiting to be encoded
+    std::vector<std::thread> workers;                    // Encoding threads
+    std::mutex freeBuffersMutex;                         // Protects the free buffers
+    std::vector<std::vector<unsigned char>> freeBuffers; // Recycled frame memory
+
+    std::string outputPrefix;     // Path prefix of the current sequence
+    CaptureFormat format;         // Format of the current sequence
+    bool capturing;               // A sequence is being captured
+    unsigned int framesCaptured;  // Frames read back in the current sequence
+    unsigned int framesQueued;    // Frames handed to the workers in the current sequence
+
+    std::mutex writtenMutex;                // Protects the written frames counter
+    std::condition_variable writtenChanged; // Signaled when a frame is written
+    unsigned int framesWritten;             // Frames written in the current sequence
+};
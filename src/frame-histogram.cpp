@@ -0,0 +1,126 @@
+#include "frame-histogram.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+// Each power of two is split in 2^subBucketBits buckets, the first 2^(subBucketBits + 1) values have their own bucket
+const unsigned int subBucketBits = 5;
+const unsigned int subBucketCount = 1u << (subBucketBits + 1);
+const unsigned int subBucketHalf = 1u << subBucketBits;
+// Values over 2^27 us (~2 min) are counted in the last bucket
+const unsigned int maxValueBits = 26;
+const unsigned int numberOfBuckets = subBucketCount + (maxValueBits - subBucketBits) * subBucketHalf;
+} // namespace
+
+FrameHistogram::FrameHistogram(unsigned int windowSize)
+{
+    this->windowSize = windowSize;
+    this->counts.resize(numberOfBuckets, 0);
+    this->window.resize(windowSize, 0);
+    this->nextSample = 0;
+    this->numberOfSamples = 0;
+}
+
+void FrameHistogram::record(float milliseconds)
+{
+    const unsigned long long microseconds = milliseconds > 0.0f ? (unsigned long long)(milliseconds * 1000.0f + 0.5f) : 0;
+    const unsigned int index = bucketIndex(microseconds);
+
+    if (this->windowSize > 0)
+    {
+        // The window is full, the oldest sample leaves the histogram
+        if (this->numberOfSamples == this->windowSize)
+        {
+            this->counts[this->window[this->nextSample]]--;
+            this->numberOfSamples--;
+        }
+        this->window[this->nextSample] = (unsigned short)index;
+        this->nextSample = (this->nextSample + 1) % this->windowSize;
+    }
+
+    this->counts[index]++;
+    this->numberOfSamples++;
+}
+
+void FrameHistogram::clear()
+{
+    std::fill(this->counts.begin(), this->counts.end(), 0);
+    this->nextSample = 0;
+    this->numberOfSamples = 0;
+}
+
+float FrameHistogram::getPercentile(float percentile)
+{
+    if (this->numberOfSamples == 0)
+        return 0.0f;
+
+    // Number of samples that have to be at or under the returned value
+    size_t target = (size_t)std::ceil(percentile / 100.0f * this->numberOfSamples);
+    if (target < 1)
+        target = 1;
+
+    size_t accumulated = 0;
+    for (unsigned int i = 0; i < numberOfBuckets; i++)
+    {
+        accumulated += this->counts[i];
+        if (accumulated >= target)
+            return bucketUpperValue(i) / 1000.0f;
+    }
+    return bucketUpperValue(numberOfBuckets - 1) / 1000.0f;
+}
+
+float FrameHistogram::getMax()
+{
+    for (unsigned int i = numberOfBuckets; i-- > 0;)
+        if (this->counts[i] > 0)
+            return bucketUpperValue(i) / 1000.0f;
+    return 0.0f;
+}
+
+size_t FrameHistogram::getNumberOfSamples()
+{
+    return this->numberOfSamples;
+}
+
+void FrameHistogram::writeDistribution(std::ostream &output, const std::string &name)
+{
+    size_t accumulated = 0;
+    for (unsigned int i = 0; i < numberOfBuckets; i++)
+    {
+        if (this->counts[i] == 0)
+            continue;
+
+        accumulated += this->counts[i];
+        output << name << "," << bucketUpperValue(i) / 1000.0 << "," << this->counts[i] << ","
+               << (double)accumulated / this->numberOfSamples << std::endl;
+    }
+}
+
+unsigned int FrameHistogram::bucketIndex(unsigned long long microseconds)
+{
+    // Small values have a bucket each
+    if (microseconds < subBucketCount)
+        return (unsigned int)microseconds;
+
+    // Finds the power of two of the value, the sub bucket is given by the bits after the leading one
+    unsigned int shift = 1;
+    while ((microseconds >> shift) >= subBucketCount)
+        shift++;
+
+    if (shift > maxValueBits - subBucketBits)
+        return numberOfBuckets - 1;
+
+    const unsigned int subBucket = (unsigned int)(microseconds >> shift) - subBucketHalf;
+    return subBucketCount + (shift - 1) * subBucketHalf + subBucket;
+}
+
+unsigned long long FrameHistogram::bucketUpperValue(unsigned int index)
+{
+    if (index < subBucketCount)
+        return index;
+
+    const unsigned int shift = (index - subBucketCount) / subBucketHalf + 1;
+    const unsigned long long subBucket = (index - subBucketCount) % subBucketHalf + subBucketHalf;
+    return ((subBucket + 1) << shift) - 1;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * Histogram of frame times, with the bucket layout of an HDR histogram
+ * Times are stored in microseconds, in buckets whose width grows with the value:
+ * each power of two is split in 32 sub buckets, so every value is known within ~3%
+ * from 1 us to two minutes using a few hundred counters.
+ * The histogram can keep only the last samples (rolling window) or every sample.
+*/
+class FrameHistogram
+{
+public:
+    /**
+     * Creates an empty histogram
+     * @param windowSize Number of recent samples kept, 0 keeps every sample
+    */
+    FrameHistogram(unsigned int windowSize = 0);
+    /**
+     * Adds a sample, dropping the oldest one if the window is full
+     * @param milliseconds Sample time in milliseconds
+    */
+    void record(float milliseconds);
+    /**
+     * Removes every sample
+    */
+    void clear();
+    /**
+     * Gets the time under which a percentage of the samples are
+     * @param percentile Percentage of samples, [0, 100]
+     * @return Time in milliseconds (upper bound of its bucket), 0 if there aren't samples
+    */
+    float getPercentile(float percentile);
+    /**
+     * Gets the longest sample
+     * @return Time in milliseconds (upper bound of its bucket), 0 if there aren't samples
+    */
+    float getMax();
+    /**
+     * Gets the number of samples in the histogram
+     * @return Number of samples
+    */
+    size_t getNumberOfSamples();
+    /**
+     * Writes the cumulative distribution as CSV rows: name,upper_ms,count,cumulative_fraction
+     * Only the non empty buckets are written
+     * @param output Where the rows are written
+     * @param name Name written in the first column
+    */
+    void writeDistribution(std::ostream &output, const std::string &name);
+
+private:
+    /**
+     * Gets the bucket of a value
+     * @param microseconds Value in microseconds
+     * @return Bucket index
+    */
+    static unsigned int bucketIndex(unsigned long long microseconds);
+    /**
+     * Gets the largest value of a bucket
+     * @param index Bucket index
+     * @return Value in microseconds
+    */
+    static unsigned long long bucketUpperValue(unsigned int index);
+
+    std::vector<unsigned int> counts;     // Number of samples per bucket
+    std::vector<unsigned short> window;   // Bucket of each sample in the window (ring buffer)
+    unsigned int windowSize;              // Samples kept, 0 is unbounded
+    unsigned int nextSample;              // Position in the window of the next sample
+    size_t numberOfSamples;               // Samples in the histogram
+};
@@ -0,0 +1,113 @@
+#include "gpu-timer.h"
+#include <glad/glad.h>
+
+GpuTimer::GpuTimer(const std::vector<std::string> &passNames, unsigned int numberOfFrames)
+{
+    this->passNames = passNames;
+    this->currentFrame = 0;
+    this->gpuTimes.resize(passNames.size(), 0.0f);
+    this->cpuTimes.resize(passNames.size(), 0.0f);
+    this->cpuStarts.resize(passNames.size());
+
+    // Creates a query per pass for each frame in flight
+    this->queries.resize(numberOfFrames > 1 ? numberOfFrames : 2);
+    for (size_t frame = 0; frame < this->queries.size(); frame++)
+    {
+        this->queries[frame].resize(passNames.size());
+        for (size_t pass = 0; pass < passNames.size(); pass++)
+        {
+            glGenQueries(1, &this->queries[frame][pass].id);
+            this->queries[frame][pass].began = false;
+            this->queries[frame][pass].pending = false;
+        }
+    }
+}
+
+GpuTimer::~GpuTimer()
+{
+    for (size_t frame = 0; frame < this->queries.size(); frame++)
+        for (size_t pass = 0; pass < this->queries[frame].size(); pass++)
+            glDeleteQueries(1, &this->queries[frame][pass].id);
+}
+
+void GpuTimer::begin(unsigned int pass)
+{
+    Query &query = this->queries[this->currentFrame][pass];
+
+    // The previous result of this query wasn't read in time (still pending after every frame in flight), it's lost
+    query.began = true;
+    query.pending = true;
+    glBeginQuery(GL_TIME_ELAPSED, query.id);
+    this->cpuStarts[pass] = std::chrono::steady_clock::now();
+}
+
+void GpuTimer::end(unsigned int pass)
+{
+    glEndQuery(GL_TIME_ELAPSED);
+
+    const std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - this->cpuStarts[pass];
+    this->cpuTimes[pass] = elapsed.count();
+}
+
+void GpuTimer::nextFrame()
+{
+    const unsigned int numberOfFrames = (unsigned int)this->queries.size();
+
+    // Passes not run in this frame don't take CPU time
+    for (size_t pass = 0; pass < this->passNames.size(); pass++)
+        if (!this->queries[this->currentFrame][pass].began)
+            this->cpuTimes[pass] = 0.0f;
+
+    // Reads every result the GPU has finished, the oldest frame first so the newest result is kept
+    for (unsigned int i = 1; i <= numberOfFrames; i++)
+    {
+        std::vector<Query> &frame = this->queries[(this->currentFrame + i) % numberOfFrames];
+        for (size_t pass = 0; pass < frame.size(); pass++)
+        {
+            Query &query = frame[pass];
+            if (!query.pending)
+                continue;
+
+            GLint available = 0;
+            glGetQueryObjectiv(query.id, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                continue;
+
+            GLuint64 nanoseconds = 0;
+            glGetQueryObjectui64v(query.id, GL_QUERY_RESULT, &nanoseconds);
+            this->gpuTimes[pass] = nanoseconds / 1000000.0f;
+            query.pending = false;
+        }
+    }
+
+    // The next frame reuses the oldest queries
+    this->currentFrame = (this->currentFrame + 1) % numberOfFrames;
+    std::vector<Query> &oldest = this->queries[this->currentFrame];
+    for (size_t pass = 0; pass < oldest.size(); pass++)
+    {
+        // The pass wasn't run in that frame (i.e the capture is stopped)
+        if (!oldest[pass].began)
+            this->gpuTimes[pass] = 0.0f;
+        oldest[pass].began = false;
+    }
+}
+
+unsigned int GpuTimer::getNumberOfPasses()
+{
+    return (unsigned int)this->passNames.size();
+}
+
+const std::string &GpuTimer::getPassName(unsigned int pass)
+{
+    return this->passNames[pass];
+}
+
+float GpuTimer::getGpuTime(unsigned int pass)
+{
+    return this->gpuTimes[pass];
+}
+
+float GpuTimer::getCpuTime(unsigned int pass)
+{
+    return this->cpuTimes[pass];
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+/**
+ * Measures the GPU and CPU time of the render passes
+ * Each pass is wrapped in a GL_TIME_ELAPSED query. The queries are multi buffered,
+ * the results are polled every frame and read as soon as they're available, usually
+ * a few frames later on a GPU bound or vsynced frame, so reading them never stalls the pipeline.
+ * Passes can't be nested (only one GL_TIME_ELAPSED query can be active)
+*/
+class GpuTimer
+{
+public:
+    /**
+     * Creates the timer queries
+     * @param passNames Name of each measured pass
+     * @param numberOfFrames Number of frames of queries in flight, a result not read within them is lost
+    */
+    GpuTimer(const std::vector<std::string> &passNames, unsigned int numberOfFrames = 4);
+    /**
+     * Deletes the timer queries
+    */
+    ~GpuTimer();
+    /**
+     * Starts measuring a pass
+     * @param pass Pass index
+    */
+    void begin(unsigned int pass);
+    /**
+     * Stops measuring a pass
+     * @param pass Pass index
+    */
+    void end(unsigned int pass);
+    /**
+     * Moves to the next frame of queries, reads the results of every frame in flight the GPU has finished
+     * Has to be called once per frame, after every pass
+    */
+    void nextFrame();
+    /**
+     * Gets the number of measured passes
+     * @return Number of passes
+    */
+    unsigned int getNumberOfPasses();
+    /**
+     * Gets the name of a pass
+     * @param pass Pass index
+     * @return Pass name
+    */
+    const std::string &getPassName(unsigned int pass);
+    /**
+     * Gets the last GPU time of a pass
+     * @param pass Pass index
+     * @return GPU time in milliseconds
+    */
+    float getGpuTime(unsigned int pass);
+    /**
+     * Gets the last CPU time of a pass (time spent issuing the pass commands)
+     * @param pass Pass index
+     * @return CPU time in milliseconds
+    */
+    float getCpuTime(unsigned int pass);
+
+private:
+    /**
+     * Measurement of a pass in a frame
+    */
+    struct Query
+    {
+        unsigned int id; // Index (GPU) of the timer query
+        bool began;      // The pass began in this frame
+        bool pending;    // The query was issued and its result wasn't read yet
+    };
+
+    std::vector<std::string> passNames;          // Name of each pass
+    std::vector<std::vector<Query>> queries;     // Queries per frame in flight and pass
+    unsigned int currentFrame;                   // Frame of queries being recorded
+    std::vector<float> gpuTimes;                 // Last GPU time of each pass (ms)
+    std::vector<float> cpuTimes;                 // Last CPU time of each pass (ms)
+    std::vector<std::chrono::steady_clock::time_point> cpuStarts; // CPU time when each pass began
+};
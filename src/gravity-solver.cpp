@@ -0,0 +1,469 @@
+#include "gravity-solver.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "profiler.h"
+
+namespace
+{
+// Bodies handled by each task of the thread pool
+const unsigned int bodyChunkSize = 16384;
+// Groups handled by each task of the thread pool, their interaction lists vary a lot
+const unsigned int groupChunkSize = 16;
+// Bits of the Morton codes per axis, also the deepest level of the octree
+const unsigned int mortonBits = 10;
+// Bits of the codes sorted on each pass of the radix sort
+const unsigned int radixBits = 10;
+const unsigned int radixSize = 1 << radixBits;
+// Cells with this many bodies or less are leaves
+const unsigned int maxLeafSize = 16;
+// The tree is walked once for the bodies of the largest cells with this many bodies or less
+const unsigned int maxGroupSize = 64;
+// The subtrees of the cells at this level are built in parallel
+const unsigned int subtreeLevel = 3;
+// Interactions summed side by side, a multiple of the vector width
+const unsigned int lanes = 8;
+
+/**
+ * Bounding box of the alive particles of a chunk
+*/
+struct ChunkBounds
+{
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+/**
+ * Spreads the bits of a coordinate so there are two zero bits between each one
+ * @param value Coordinate, 10 bits
+ * @return Spread bits, 30 bits
+*/
+unsigned int spreadBits(unsigned int value)
+{
+    value = (value | (value << 16)) & 0x030000FFu;
+    value = (value | (value << 8)) & 0x0300F00Fu;
+    value = (value | (value << 4)) & 0x030C30C3u;
+    value = (value | (value << 2)) & 0x09249249u;
+    return value;
+}
+
+/**
+ * Adds a node to the aggregate of its parent
+ * @param parent Node whose mass, center of mass sum and bounds grow
+ * @param child Child node
+*/
+void addChild(GravityNode &parent, const GravityNode &child)
+{
+    // The center of mass is summed weighted and divided once all the children are added
+    parent.centerOfMass += child.centerOfMass * child.mass;
+    parent.mass += child.mass;
+    parent.boundsMin = glm::min(parent.boundsMin, child.boundsMin);
+    parent.boundsMax = glm::max(parent.boundsMax, child.boundsMax);
+}
+
+/**
+ * Creates an internal node without children
+ * @param first First body of the node
+ * @param end One past the last body of the node
+ * @return Node to add the children to
+*/
+GravityNode emptyNode(unsigned int first, unsigned int end)
+{
+    GravityNode node;
+    node.centerOfMass = glm::vec3(0.0f);
+    node.mass = 0.0f;
+    node.boundsMin = glm::vec3(INFINITY);
+    node.boundsMax = glm::vec3(-INFINITY);
+    node.first = first;
+    node.count = end - first;
+    node.next = 0;
+    node.leaf = 0;
+    return node;
+}
+} // namespace
+
+GravitySolver::GravitySolver(ThreadPool *threadPool)
+{
+    this->threadPool = threadPool;
+    this->boundsMin = glm::vec3(0.0f);
+    this->boundsSize = 1.0f;
+}
+
+void GravitySolver::setThreadPool(ThreadPool *threadPool)
+{
+    this->threadPool = threadPool;
+}
+
+void GravitySolver::step(const GravityParameters &parameters, std::vector<Particle> &particles, glm::vec3 externalForce, float deltaTime)
+{
+    PROFILE_SCOPE("GravitySolver::step");
+
+    this->sortBodies(particles);
+    const unsigned int count = (unsigned int)this->indices.size();
+    if (count == 0)
+    {
+        this->nodes.clear();
+        return;
+    }
+    this->buildTree();
+    this->computeAccelerations(parameters);
+
+    // Each body is a different particle, the chunks write different particles
+    this->forEachChunk(count, bodyChunkSize, [&](unsigned int, unsigned int first, unsigned int end) {
+        for (unsigned int body = first; body < end; body++)
+        {
+            Particle &particle = particles[this->indices[body]];
+            particle.setDirection(particle.getDirection() + (this->accelerations[body] + externalForce) * deltaTime);
+            particle.update(deltaTime, glm::vec3(0.0f));
+        }
+    });
+}
+
+const std::vector<GravityNode> &GravitySolver::getNodes() const
+{
+    return this->nodes;
+}
+
+void GravitySolver::sortBodies(const std::vector<Particle> &particles)
+{
+    PROFILE_SCOPE("GravitySolver::sortBodies");
+
+    // The alive particles of each chunk are counted and bounded
+    const unsigned int numberOfParticles = (unsigned int)particles.size();
+    const unsigned int numberOfChunks = (numberOfParticles + bodyChunkSize - 1) / bodyChunkSize;
+    std::vector<ChunkBounds> chunkBounds(numberOfChunks, {glm::vec3(INFINITY), glm::vec3(-INFINITY)});
+    std::vector<unsigned int> chunkStart(numberOfChunks + 1, 0);
+    this->forEachChunk(numberOfParticles, bodyChunkSize, [&](unsigned int chunk, unsigned int first, unsigned int end) {
+        ChunkBounds &bounds = chunkBounds[chunk];
+        unsigned int alive = 0;
+        for (unsigned int i = first; i < end; i++)
+            if (particles[i].isAlive())
+            {
+                const glm::vec3 position = particles[i].getPosition();
+                bounds.min = glm::min(bounds.min, position);
+                bounds.max = glm::max(bounds.max, position);
+                alive++;
+            }
+        chunkStart[chunk + 1] = alive;
+    });
+
+    glm::vec3 boundsMax(-INFINITY);
+    this->boundsMin = glm::vec3(INFINITY);
+    for (unsigned int chunk = 0; chunk < numberOfChunks; chunk++)
+    {
+        this->boundsMin = glm::min(this->boundsMin, chunkBounds[chunk].min);
+        boundsMax = glm::max(boundsMax, chunkBounds[chunk].max);
+        chunkStart[chunk + 1] += chunkStart[chunk];
+    }
+    const unsigned int count = chunkStart[numberOfChunks];
+    this->codes.resize(count);
+    this->indices.resize(count);
+    if (count == 0)
+        return;
+
+    // The codes are relative to the cube around the bodies, the bodies on its far faces stay in the last cells
+    const glm::vec3 extent = boundsMax - this->boundsMin;
+    this->boundsSize = glm::max(glm::max(extent.x, extent.y), glm::max(extent.z, 1e-6f));
+    const float scale = (float)(1 << mortonBits) / this->boundsSize;
+    const float lastCell = (float)((1 << mortonBits) - 1);
+    this->forEachChunk(numberOfParticles, bodyChunkSize, [&](unsigned int chunk, unsigned int first, unsigned int end) {
+        unsigned int body = chunkStart[chunk];
+        for (unsigned int i = first; i < end; i++)
+            if (particles[i].isAlive())
+            {
+                const glm::vec3 cell = glm::min((particles[i].getPosition() - this->boundsMin) * scale, glm::vec3(lastCell));
+                this->codes[body] = (spreadBits((unsigned int)cell.x) << 2) | (spreadBits((unsigned int)cell.y) << 1) | spreadBits((unsigned int)cell.z);
+                this->indices[body++] = i;
+            }
+    });
+
+    // Radix sort by code, a counting sort per digit. Each chunk counts its digits and writes its bodies after
+    // the ones of the chunks before it, so the sort is stable and deterministic
+    const unsigned int numberOfBodyChunks = (count + bodyChunkSize - 1) / bodyChunkSize;
+    this->swapCodes.resize(count);
+    this->swapIndices.resize(count);
+    for (unsigned int shift = 0; shift < 3 * mortonBits; shift += radixBits)
+    {
+        this->histograms.assign(numberOfBodyChunks * radixSize, 0);
+        this->forEachChunk(count, bodyChunkSize, [&](unsigned int chunk, unsigned int first, unsigned int end) {
+            unsigned int *histogram = &this->histograms[chunk * radixSize];
+            for (unsigned int body = first; body < end; body++)
+                histogram[(this->codes[body] >> shift) & (radixSize - 1)]++;
+        });
+
+        unsigned int offset = 0;
+        for (unsigned int digit = 0; digit < radixSize; digit++)
+            for (unsigned int chunk = 0; chunk < numberOfBodyChunks; chunk++)
+            {
+                const unsigned int digitCount = this->histograms[chunk * radixSize + digit];
+                this->histograms[chunk * radixSize + digit] = offset;
+                offset += digitCount;
+            }
+
+        this->forEachChunk(count, bodyChunkSize, [&](unsigned int chunk, unsigned int first, unsigned int end) {
+            unsigned int *next = &this->histograms[chunk * radixSize];
+            for (unsigned int body = first; body < end; body++)
+            {
+                const unsigned int target = next[(this->codes[body] >> shift) & (radixSize - 1)]++;
+                this->swapCodes[target] = this->codes[body];
+                this->swapIndices[target] = this->indices[body];
+            }
+        });
+        this->codes.swap(this->swapCodes);
+        this->indices.swap(this->swapIndices);
+    }
+
+    // Positions in the sorted order, a component per array so the interactions load them in vectors
+    this->x.resize(count);
+    this->y.resize(count);
+    this->z.resize(count);
+    this->forEachChunk(count, bodyChunkSize, [&](unsigned int, unsigned int first, unsigned int end) {
+        for (unsigned int body = first; body < end; body++)
+        {
+            const glm::vec3 position = particles[this->indices[body]].getPosition();
+            this->x[body] = position.x;
+            this->y[body] = position.y;
+            this->z[body] = position.z;
+        }
+    });
+}
+
+void GravitySolver::buildTree()
+{
+    PROFILE_SCOPE("GravitySolver::buildTree");
+
+    const unsigned int count = (unsigned int)this->indices.size();
+    this->subtreeCells.clear();
+    this->listSubtrees(0, count, 0);
+
+    this->subtrees.resize(this->subtreeCells.size());
+    const std::function<void(unsigned int)> buildSubtree = [&](unsigned int subtree) {
+        const glm::uvec3 cell = this->subtreeCells[subtree];
+        this->subtrees[subtree].clear();
+        this->buildNode(cell.x, cell.y, cell.z, this->subtrees[subtree]);
+    };
+    if (this->threadPool)
+        this->threadPool->parallelFor((unsigned int)this->subtrees.size(), buildSubtree);
+    else
+        for (unsigned int subtree = 0; subtree < this->subtrees.size(); subtree++)
+            buildSubtree(subtree);
+
+    this->nodes.clear();
+    unsigned int subtree = 0;
+    this->appendNode(0, count, 0, subtree);
+
+    // Every body is in a group, the deepest leaves can hold more bodies than a group so they're groups of their own
+    this->groups.clear();
+    unsigned int node = 0;
+    while (node < this->nodes.size())
+        if (this->nodes[node].count <= maxGroupSize || this->nodes[node].leaf)
+        {
+            this->groups.push_back(node);
+            node = this->nodes[node].next;
+        }
+        else
+            node++;
+}
+
+void GravitySolver::buildNode(unsigned int first, unsigned int end, unsigned int level, std::vector<GravityNode> &nodes) const
+{
+    const unsigned int index = (unsigned int)nodes.size();
+    nodes.push_back(GravityNode());
+    GravityNode node = emptyNode(first, end);
+
+    // The deepest cells are leaves however many bodies they have, they're at the same position
+    if (end - first <= maxLeafSize || level == mortonBits)
+    {
+        for (unsigned int body = first; body < end; body++)
+        {
+            const glm::vec3 position(this->x[body], this->y[body], this->z[body]);
+            node.centerOfMass += position;
+            node.boundsMin = glm::min(node.boundsMin, position);
+            node.boundsMax = glm::max(node.boundsMax, position);
+        }
+        node.mass = (float)(end - first);
+        node.leaf = 1;
+    }
+    else
+    {
+        unsigned int bounds[9];
+        this->splitCell(first, end, level, bounds);
+        for (unsigned int child = 0; child < 8; child++)
+            if (bounds[child] < bounds[child + 1])
+            {
+                const unsigned int childIndex = (unsigned int)nodes.size();
+                this->buildNode(bounds[child], bounds[child + 1], level + 1, nodes);
+                addChild(node, nodes[childIndex]);
+            }
+    }
+    node.centerOfMass /= node.mass;
+    node.next = (unsigned int)nodes.size();
+    nodes[index] = node;
+}
+
+void GravitySolver::listSubtrees(unsigned int first, unsigned int end, unsigned int level)
+{
+    if (end - first <= maxLeafSize || level == subtreeLevel)
+    {
+        this->subtreeCells.push_back(glm::uvec3(first, end, level));
+        return;
+    }
+
+    unsigned int bounds[9];
+    this->splitCell(first, end, level, bounds);
+    for (unsigned int child = 0; child < 8; child++)
+        if (bounds[child] < bounds[child + 1])
+            this->listSubtrees(bounds[child], bounds[child + 1], level + 1);
+}
+
+void GravitySolver::appendNode(unsigned int first, unsigned int end, unsigned int level, unsigned int &subtree)
+{
+    // Same cells as the list, the subtrees are moved after the nodes before them
+    if (end - first <= maxLeafSize || level == subtreeLevel)
+    {
+        const unsigned int offset = (unsigned int)this->nodes.size();
+        for (GravityNode node : this->subtrees[subtree++])
+        {
+            node.next += offset;
+            this->nodes.push_back(node);
+        }
+        return;
+    }
+
+    const unsigned int index = (unsigned int)this->nodes.size();
+    this->nodes.push_back(GravityNode());
+    GravityNode node = emptyNode(first, end);
+    unsigned int bounds[9];
+    this->splitCell(first, end, level, bounds);
+    for (unsigned int child = 0; child < 8; child++)
+        if (bounds[child] < bounds[child + 1])
+        {
+            const unsigned int childIndex = (unsigned int)this->nodes.size();
+            this->appendNode(bounds[child], bounds[child + 1], level + 1, subtree);
+            addChild(node, this->nodes[childIndex]);
+        }
+    node.centerOfMass /= node.mass;
+    node.next = (unsigned int)this->nodes.size();
+    this->nodes[index] = node;
+}
+
+void GravitySolver::splitCell(unsigned int first, unsigned int end, unsigned int level, unsigned int bounds[9]) const
+{
+    // The bodies of the cell share the bits above the level, so they're sorted by the digit of their child
+    const unsigned int shift = 3 * (mortonBits - 1 - level);
+    const unsigned int *codes = this->codes.data();
+    bounds[0] = first;
+    for (unsigned int child = 1; child < 8; child++)
+        bounds[child] = (unsigned int)(std::partition_point(codes + bounds[child - 1], codes + end, [&](unsigned int code) {
+                                           return ((code >> shift) & 7) < child;
+                                       }) -
+                                       codes);
+    bounds[8] = end;
+}
+
+void GravitySolver::computeAccelerations(const GravityParameters &parameters)
+{
+    PROFILE_SCOPE("GravitySolver::computeAccelerations");
+
+    const float openingAngleSquared = parameters.openingAngle * parameters.openingAngle;
+    const float softeningSquared = parameters.softening * parameters.softening;
+    // Cleared so no body keeps the acceleration of an older step, the groups cover every body
+    this->accelerations.assign(this->indices.size(), glm::vec3(0.0f));
+    this->forEachChunk((unsigned int)this->groups.size(), groupChunkSize, [&](unsigned int, unsigned int first, unsigned int end) {
+        // Interactions of the group, a component per array
+        std::vector<float> listX, listY, listZ, listMass;
+        for (unsigned int groupIndex = first; groupIndex < end; groupIndex++)
+        {
+            const GravityNode &group = this->nodes[this->groups[groupIndex]];
+            listX.clear();
+            listY.clear();
+            listZ.clear();
+            listMass.clear();
+
+            // The nodes small enough seen from every point of the group act as a single body, the others are opened
+            unsigned int index = 0;
+            while (index < this->nodes.size())
+            {
+                const GravityNode &node = this->nodes[index];
+                const glm::vec3 offset = glm::max(glm::max(group.boundsMin - node.centerOfMass, node.centerOfMass - group.boundsMax), glm::vec3(0.0f));
+                const glm::vec3 extent = node.boundsMax - node.boundsMin;
+                const float size = glm::max(glm::max(extent.x, extent.y), extent.z);
+                if (size * size < openingAngleSquared * glm::dot(offset, offset))
+                {
+                    listX.push_back(node.centerOfMass.x);
+                    listY.push_back(node.centerOfMass.y);
+                    listZ.push_back(node.centerOfMass.z);
+                    listMass.push_back(node.mass);
+                    index = node.next;
+                }
+                else if (node.leaf)
+                {
+                    // The bodies of the group itself are listed too, they don't pull themselves since their offset is 0
+                    listX.insert(listX.end(), this->x.begin() + node.first, this->x.begin() + node.first + node.count);
+                    listY.insert(listY.end(), this->y.begin() + node.first, this->y.begin() + node.first + node.count);
+                    listZ.insert(listZ.end(), this->z.begin() + node.first, this->z.begin() + node.first + node.count);
+                    listMass.insert(listMass.end(), node.count, 1.0f);
+                    index = node.next;
+                }
+                else
+                    index++;
+            }
+
+            // Massless interactions fill the last lanes
+            while (listMass.size() % lanes != 0)
+            {
+                listX.push_back(0.0f);
+                listY.push_back(0.0f);
+                listZ.push_back(0.0f);
+                listMass.push_back(0.0f);
+            }
+
+            const unsigned int interactions = (unsigned int)listMass.size();
+            for (unsigned int body = group.first; body < group.first + group.count; body++)
+            {
+                const float bodyX = this->x[body];
+                const float bodyY = this->y[body];
+                const float bodyZ = this->z[body];
+                float sumX[lanes] = {}, sumY[lanes] = {}, sumZ[lanes] = {};
+                for (unsigned int i = 0; i < interactions; i += lanes)
+                {
+                    // Contiguous loads, the lanes are independent so the loop vectorizes without reordering the sums
+                    const float *blockX = listX.data() + i;
+                    const float *blockY = listY.data() + i;
+                    const float *blockZ = listZ.data() + i;
+                    const float *blockMass = listMass.data() + i;
+                    for (unsigned int lane = 0; lane < lanes; lane++)
+                    {
+                        const float dx = blockX[lane] - bodyX;
+                        const float dy = blockY[lane] - bodyY;
+                        const float dz = blockZ[lane] - bodyZ;
+                        const float inverseDistance = 1.0f / std::sqrt(dx * dx + dy * dy + dz * dz + softeningSquared);
+                        const float weight = blockMass[lane] * inverseDistance * inverseDistance * inverseDistance;
+                        sumX[lane] += dx * weight;
+                        sumY[lane] += dy * weight;
+                        sumZ[lane] += dz * weight;
+                    }
+                }
+
+                glm::vec3 acceleration(0.0f);
+                for (unsigned int lane = 0; lane < lanes; lane++)
+                    acceleration += glm::vec3(sumX[lane], sumY[lane], sumZ[lane]);
+                this->accelerations[body] = acceleration * parameters.strength;
+            }
+        }
+    });
+}
+
+void GravitySolver::forEachChunk(unsigned int count, unsigned int chunkSize, const std::function<void(unsigned int, unsigned int, unsigned int)> &task)
+{
+    const unsigned int numberOfChunks = (count + chunkSize - 1) / chunkSize;
+    const std::function<void(unsigned int)> chunkTask = [&](unsigned int chunk) {
+        task(chunk, chunk * chunkSize, glm::min((chunk + 1) * chunkSize, count));
+    };
+    if (this->threadPool)
+        this->threadPool->parallelFor(numberOfChunks, chunkTask);
+    else
+        for (unsigned int chunk = 0; chunk < numberOfChunks; chunk++)
+            chunkTask(chunk);
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "particle.h"
+#include "thread-pool.h"
+
+/**
+ * Properties of the gravity between the particles
+*/
+struct GravityParameters
+{
+    bool enabled;       // The particles attract each other
+    float strength;     // Gravitational constant times the mass of a particle, the acceleration one particle causes at distance 1
+    float openingAngle; // Size over distance under which a node of the tree acts as a single body, 0 sums every pair
+    float softening;    // Length added to the distances so close particles don't slingshot, more than 0
+};
+
+/**
+ * Node of the octree, the nodes are stored depth first so the children of a node follow it
+*/
+struct GravityNode
+{
+    glm::vec3 centerOfMass; // Average position of the bodies inside
+    float mass;             // Number of bodies inside
+    glm::vec3 boundsMin;    // Bounding box of the bodies inside
+    unsigned int first;     // First body inside, in the sorted arrays
+    glm::vec3 boundsMax;
+    unsigned int count;     // Number of bodies inside
+    unsigned int next;      // Node after the children, where the traversal continues when the node isn't opened
+    unsigned int leaf;      // The node has no children, its bodies interact one by one
+};
+
+/**
+ * Barnes-Hut gravity solver (Barnes and Hut 1986)
+ * The alive particles are sorted by the Morton code of their position, so the bodies of each octree cell are contiguous,
+ * and the octree is built over the sorted bodies into a flat array of nodes. The cells under the third level are built
+ * in parallel, then the top levels link them. The forces are computed for a group of nearby bodies at once: the tree is
+ * walked once for the whole group, the nodes far enough from its bounding box and the bodies of the nearby leaves are
+ * listed and then summed over in lanes the compiler vectorizes.
+*/
+class GravitySolver
+{
+public:
+    /**
+     * Creates a gravity solver
+     * @param threadPool Threads building the tree and computing the forces, NULL runs them on the calling thread
+    */
+    GravitySolver(ThreadPool *threadPool = NULL);
+    /**
+     * Sets the threads building the tree and computing the forces
+     * @param threadPool Threads building the tree and computing the forces, NULL runs them on the calling thread
+    */
+    void setThreadPool(ThreadPool *threadPool);
+    /**
+     * Advances the alive particles one step
+     * Symplectic Euler, the velocities are updated first and the particles move with their new velocity
+     * @param parameters Gravity properties
+     * @param particles Particles, the dead ones are skipped
+     * @param externalForce Acceleration of every particle (i.e gravity)
+     * @param deltaTime Time step
+    */
+    void step(const GravityParameters &parameters, std::vector<Particle> &particles, glm::vec3 externalForce, float deltaTime);
+    /**
+     * Gets the octree of the last step
+     * @return Nodes, depth first, the root first
+    */
+    const std::vector<GravityNode> &getNodes() const;
+
+private:
+    /**
+     * Sorts the alive particles by the Morton code of their position
+     * @param particles Particles, the dead ones are skipped
+    */
+    void sortBodies(const std::vector<Particle> &particles);
+    /**
+     * Builds the octree over the sorted bodies
+    */
+    void buildTree();
+    /**
+     * Builds the subtree of an octree cell, depth first
+     * @param first First body of the cell
+     * @param end One past the last body of the cell
+     * @param level Depth of the cell, the root is at 0
+     * @param nodes Where the nodes are appended, their next nodes are relative to the start of the vector
+    */
+    void buildNode(unsigned int first, unsigned int end, unsigned int level, std::vector<GravityNode> &nodes) const;
+    /**
+     * Lists the cells whose subtrees are built in parallel, depth first
+     * @param first First body of the cell
+     * @param end One past the last body of the cell
+     * @param level Depth of the cell, the root is at 0
+    */
+    void listSubtrees(unsigned int first, unsigned int end, unsigned int level);
+    /**
+     * Appends the top levels of the octree and the subtrees built in parallel, depth first
+     * @param first First body of the cell
+     * @param end One past the last body of the cell
+     * @param level Depth of the cell, the root is at 0
+     * @param subtree Next subtree to append, in the order of the list
+    */
+    void appendNode(unsigned int first, unsigned int end, unsigned int level, unsigned int &subtree);
+    /**
+     * Splits the bodies of a cell between its children
+     * @param first First body of the cell
+     * @param end One past the last body of the cell
+     * @param level Depth of the cell, the root is at 0
+     * @param bounds Where the first body of each child is stored, then the end of the cell
+    */
+    void splitCell(unsigned int first, unsigned int end, unsigned int level, unsigned int bounds[9]) const;
+    /**
+     * Computes the acceleration of the bodies of each group
+     * @param parameters Gravity properties
+    */
+    void computeAccelerations(const GravityParameters &parameters);
+    /**
+     * Runs a task over chunks of a range, in parallel with the thread pool
+     * @param count Number of elements
+     * @param chunkSize Elements per chunk
+     * @param task Called with the chunk, the first and the end element of each chunk
+    */
+    void forEachChunk(unsigned int count, unsigned int chunkSize, const std::function<void(unsigned int, unsigned int, unsigned int)> &task);
+
+    ThreadPool *threadPool;                   // Threads building the tree and computing the forces, NULL runs them on the calling thread
+    glm::vec3 boundsMin;                      // Cube containing the bodies, the Morton codes are relative to it
+    float boundsSize;
+    std::vector<unsigned int> codes;          // Morton code of each body, sorted
+    std::vector<unsigned int> indices;        // Particle index of each body
+    std::vector<unsigned int> swapCodes;      // Destination of each radix sort pass
+    std::vector<unsigned int> swapIndices;
+    std::vector<unsigned int> histograms;     // Digit counts of each chunk, then the next slot of each digit
+    std::vector<float> x;                     // Position of each body, a component per array
+    std::vector<float> y;
+    std::vector<float> z;
+    std::vector<glm::vec3> accelerations;     // Acceleration of each body
+    std::vector<GravityNode> nodes;           // Octree, depth first
+    std::vector<glm::uvec3> subtreeCells;     // First body, end and level of the cells built in parallel
+    std::vector<std::vector<GravityNode>> subtrees; // Nodes of the cells built in parallel
+    std::vector<unsigned int> groups;         // Nodes whose bodies share a walk of the tree
+};
@@ -0,0 +1,117 @@
+#include "height-field.h"
+
+#include <cmath>
+#include <iostream>
+#include <map>
+
+#include <stb_image.h>
+
+#include "mapped-file.h"
+
+namespace
+{
+/**
+ * Heightfield loaded from an image, with the time of the image it was loaded from
+*/
+struct LoadedHeightField
+{
+    long long modificationTime;                    // Modification time of the image when it was loaded, -1 if it didn't exist
+    std::shared_ptr<const HeightField> heightField; // Heightfield, NULL if it didn't load
+};
+// The heightfields are shared by every collider using their image. The ones that failed are NULL so they're only reported once,
+// an image is loaded again when its modification time changes so a fixed image loads without restarting
+std::map<std::string, LoadedHeightField> loadedHeightFields;
+// Samples processed at once, their cells and weights stay in the stack
+const unsigned int sampleBlock = 64;
+} // namespace
+
+HeightField::HeightField(unsigned int width, unsigned int depth, const std::vector<float> &heights)
+{
+    this->width = width;
+    this->depth = depth;
+    this->heights = heights;
+}
+
+std::shared_ptr<const HeightField> HeightField::load(const std::string &path)
+{
+    const long long modificationTime = getModificationTime(path);
+    const auto loaded = loadedHeightFields.find(path);
+    if (loaded != loadedHeightFields.end() && loaded->second.modificationTime == modificationTime)
+        return loaded->second.heightField;
+
+    // The first row of the image is at z = 0, the textures loaded before may have flipped them
+    int width, depth, channels;
+    stbi_set_flip_vertically_on_load(false);
+    unsigned short *data = stbi_load_16(path.c_str(), &width, &depth, &channels, 1);
+    std::shared_ptr<const HeightField> heightField;
+    if (!data)
+        std::cout << "Couldn't load the heightfield " << path << std::endl;
+    else if (width < 2 || depth < 2)
+        std::cout << "Heightfield " << path << " is smaller than 2x2 pixels" << std::endl;
+    else
+    {
+        std::vector<float> heights((size_t)width * depth);
+        for (size_t i = 0; i < heights.size(); i++)
+            heights[i] = data[i] / 65535.0f;
+        heightField = std::make_shared<const HeightField>(width, depth, heights);
+    }
+    stbi_image_free(data);
+
+    loadedHeightFields[path] = {modificationTime, heightField};
+    return heightField;
+}
+
+float HeightField::sample(float x, float z) const
+{
+    float height;
+    this->sample(&x, &z, 1, &height);
+    return height;
+}
+
+void HeightField::sample(const float *x, const float *z, unsigned int count, float *heights) const
+{
+    const float lastX = (float)(this->width - 1);
+    const float lastZ = (float)(this->depth - 1);
+    int corner[sampleBlock], inside[sampleBlock];
+    float weightX[sampleBlock], weightZ[sampleBlock];
+    for (unsigned int first = 0; first < count; first += sampleBlock)
+    {
+        const unsigned int blockCount = glm::min(sampleBlock, count - first);
+
+        // Cells and interpolation weights, the samples outside are clamped to the border and discarded at the end
+        for (unsigned int i = 0; i < blockCount; i++)
+        {
+            const float sx = x[first + i] * lastX;
+            const float sz = z[first + i] * lastZ;
+            inside[i] = (sx >= 0.0f) & (sx <= lastX) & (sz >= 0.0f) & (sz <= lastZ);
+            const int cellX = (int)glm::clamp(sx, 0.0f, lastX - 1.0f);
+            const int cellZ = (int)glm::clamp(sz, 0.0f, lastZ - 1.0f);
+            corner[i] = cellZ * (int)this->width + cellX;
+            weightX[i] = glm::clamp(sx - (float)cellX, 0.0f, 1.0f);
+            weightZ[i] = glm::clamp(sz - (float)cellZ, 0.0f, 1.0f);
+        }
+
+        // The four corners are gathered
+        const float *samples = this->heights.data();
+        for (unsigned int i = 0; i < blockCount; i++)
+        {
+            const float *cell = samples + corner[i];
+            const float near = glm::mix(cell[0], cell[1], weightX[i]);
+            const float far = glm::mix(cell[this->width], cell[this->width + 1], weightX[i]);
+            heights[first + i] = inside[i] ? glm::mix(near, far, weightZ[i]) : -INFINITY;
+        }
+    }
+}
+
+glm::vec2 HeightField::slope(float x, float z) const
+{
+    // One sample apart on each side, clamped inside the field
+    const float stepX = 1.0f / (float)(this->width - 1);
+    const float stepZ = 1.0f / (float)(this->depth - 1);
+    const float x0 = glm::max(x - stepX, 0.0f);
+    const float x1 = glm::min(x + stepX, 1.0f);
+    const float z0 = glm::max(z - stepZ, 0.0f);
+    const float z1 = glm::min(z + stepZ, 1.0f);
+    return glm::vec2((this->sample(x1, z) - this->sample(x0, z)) / (x1 - x0),
+                     (this->sample(x, z1) - this->sample(x, z0)) / (z1 - z0));
+}
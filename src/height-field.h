@@ -0,0 +1,59 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+/**
+ * Terrain heights sampled on a regular grid, the shape of the heightfield colliders
+ * The heights are normalized, 0 is black and 1 white. The field covers the unit square of x and z,
+ * the first pixel is at (0, 0) and the last one at (1, 1). Rows of the image go along z.
+*/
+class HeightField
+{
+public:
+    /**
+     * Creates a heightfield from its samples
+     * @param width Number of samples along x, at least 2
+     * @param depth Number of samples along z, at least 2
+     * @param heights Normalized height of each sample, x first
+    */
+    HeightField(unsigned int width, unsigned int depth, const std::vector<float> &heights);
+    /**
+     * Loads a grayscale image, the heightfields are cached so the colliders sharing an image share its heights, an image is loaded again when it changes
+     * The colored images are converted to gray, 16 bits images keep their precision
+     * @param path Path to the image
+     * @return The heightfield, NULL if the image doesn't load
+    */
+    static std::shared_ptr<const HeightField> load(const std::string &path);
+    /**
+     * Samples the height with bilinear interpolation
+     * @param x Sample coordinates, inside the unit square
+     * @param z
+     * @return Normalized height, -infinity outside the field
+    */
+    float sample(float x, float z) const;
+    /**
+     * Samples the heights of several positions with bilinear interpolation
+     * The cells and weights are computed in a vectorized loop, only the corners are gathered one by one
+     * @param x Sample coordinates, inside the unit square
+     * @param z
+     * @param count Number of samples
+     * @param heights Where the normalized heights are stored, -infinity outside the field
+    */
+    void sample(const float *x, const float *z, unsigned int count, float *heights) const;
+    /**
+     * Computes the slope of the field with central differences
+     * @param x Sample coordinates, inside the unit square
+     * @param z
+     * @return Derivatives of the normalized height along x and z
+    */
+    glm::vec2 slope(float x, float z) const;
+
+private:
+    unsigned int width;         // Number of samples along x
+    unsigned int depth;         // Number of samples along z
+    std::vector<float> heights; // Normalized height of each sample, x first
+};
@@ -0,0 +1,347 @@
+#include "image-writer.h"
+#include <fstream>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+// Deflate tables (RFC 1951 3.2.5), base values and extra bits of the length and distance codes
+static const unsigned short lengthBase[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                              35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const unsigned char lengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                              3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const unsigned short distanceBase[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+                                                257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static const unsigned char distanceExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+                                                7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+static const int windowSize = 32768; // Maximun distance of a match
+static const int hashSize = 1 << 15; // Number of heads of the hash chains
+static const int maxChainLength = 32; // Maximun number of candidates tested per position
+static const int maxMatchLength = 258;
+
+/**
+ * Writes bits into a byte stream, least significant bit first
+*/
+struct BitWriter
+{
+    std::vector<unsigned char> &out; // Output stream
+    unsigned int buffer;             // Bits not written yet
+    int count;                       // Number of bits in the buffer
+
+    BitWriter(std::vector<unsigned char> &out) : out(out), buffer(0), count(0) {}
+
+    void write(unsigned int bits, int numberOfBits)
+    {
+        this->buffer |= bits << this->count;
+        this->count += numberOfBits;
+        while (this->count >= 8)
+        {
+            this->out.push_back(this->buffer & 0xff);
+            this->buffer >>= 8;
+            this->count -= 8;
+        }
+    }
+
+    /**
+     * Writes a Huffman code, codes are stored starting by their most significant bit
+    */
+    void writeCode(unsigned int code, int length)
+    {
+        unsigned int reversed = 0;
+        for (int i = 0; i < length; i++)
+            reversed |= ((code >> i) & 1) << (length - 1 - i);
+        this->write(reversed, length);
+    }
+
+    void flush()
+    {
+        if (this->count > 0)
+            this->out.push_back(this->buffer & 0xff);
+        this->buffer = 0;
+        this->count = 0;
+    }
+};
+
+/**
+ * Writes a literal/length symbol using the fixed Huffman codes
+*/
+static void writeSymbol(BitWriter &writer, int symbol)
+{
+    if (symbol <= 143)
+        writer.writeCode(0x30 + symbol, 8);
+    else if (symbol <= 255)
+        writer.writeCode(0x190 + symbol - 144, 9);
+    else if (symbol <= 279)
+        writer.writeCode(symbol - 256, 7);
+    else
+        writer.writeCode(0xc0 + symbol - 280, 8);
+}
+
+/**
+ * Writes a back reference (length, distance) using the fixed Huffman codes
+*/
+static void writeMatch(BitWriter &writer, int length, int distance)
+{
+    int code = 28;
+    while (lengthBase[code] > length)
+        code--;
+    writeSymbol(writer, 257 + code);
+    writer.write(length - lengthBase[code], lengthExtra[code]);
+
+    code = 29;
+    while (distanceBase[code] > distance)
+        code--;
+    writer.writeCode(code, 5);
+    writer.write(distance - distanceBase[code], distanceExtra[code]);
+}
+
+static unsigned int hash3(const unsigned char *data)
+{
+    const unsigned int value = data[0] | (data[1] << 8) | (data[2] << 16);
+    return (value * 2654435761u) >> 17;
+}
+
+/**
+ * Compresses a buffer into a zlib stream with a single fixed Huffman deflate block
+*/
+static std::vector<unsigned char> zlibCompress(const std::vector<unsigned char> &data)
+{
+    std::vector<unsigned char> out;
+    out.reserve(data.size() / 2 + 64);
+    // zlib header: deflate, 32K window, default level
+    out.push_back(0x78);
+    out.push_back(0x5e);
+
+    BitWriter writer(out);
+    // Final block, fixed Huffman codes
+    writer.write(1, 1);
+    writer.write(1, 2);
+
+    std::vector<int> head(hashSize, -1);
+    std::vector<int> previous(windowSize, -1);
+
+    const int size = (int)data.size();
+    int i = 0;
+    while (i < size)
+    {
+        int bestLength = 0;
+        int bestDistance = 0;
+
+        if (i + 3 <= size)
+        {
+            const unsigned int h = hash3(&data[i]);
+            // Looks for the longest match in the hash chain
+            int candidate = head[h];
+            for (int chain = 0; chain < maxChainLength && candidate >= 0 && i - candidate <= windowSize; chain++)
+            {
+                const int maxLength = std::min(maxMatchLength, size - i);
+                int length = 0;
+                while (length < maxLength && data[candidate + length] == data[i + length])
+                    length++;
+
+                if (length > bestLength)
+                {
+                    bestLength = length;
+                    bestDistance = i - candidate;
+                    if (length == maxLength)
+                        break;
+                }
+                const int next = previous[candidate & (windowSize - 1)];
+                if (next >= candidate)
+                    break;
+                candidate = next;
+            }
+        }
+
+        const int advance = bestLength >= 3 ? bestLength : 1;
+        if (bestLength >= 3)
+            writeMatch(writer, bestLength, bestDistance);
+        else
+            writeSymbol(writer, data[i]);
+
+        // Inserts every consumed position in the hash chains
+        for (int j = 0; j < advance; j++, i++)
+        {
+            if (i + 3 > size)
+                continue;
+            const unsigned int h = hash3(&data[i]);
+            previous[i & (windowSize - 1)] = head[h];
+            head[h] = i;
+        }
+    }
+    // End of block
+    writeSymbol(writer, 256);
+    writer.flush();
+
+    // Adler-32 checksum of the uncompressed data
+    unsigned int a = 1, b = 0;
+    for (size_t k = 0; k < data.size(); k++)
+    {
+        a = (a + data[k]) % 65521;
+        b = (b + a) % 65521;
+    }
+    const unsigned int adler = (b << 16) | a;
+    out.push_back(adler >> 24);
+    out.push_back((adler >> 16) & 0xff);
+    out.push_back((adler >> 8) & 0xff);
+    out.push_back(adler & 0xff);
+
+    return out;
+}
+
+/**
+ * CRC-32 lookup table, built once (thread safe static initialization)
+*/
+struct CrcTable
+{
+    unsigned int values[256];
+
+    CrcTable()
+    {
+        for (unsigned int n = 0; n < 256; n++)
+        {
+            unsigned int c = n;
+            for (int k = 0; k < 8; k++)
+                c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            this->values[n] = c;
+        }
+    }
+};
+
+static unsigned int crc32(const unsigned char *data, size_t size, unsigned int crc = 0)
+{
+    static const CrcTable table;
+
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++)
+        crc = table.values[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+static void writeUInt32(std::ofstream &file, unsigned int value)
+{
+    const unsigned char bytes[4] = {(unsigned char)(value >> 24), (unsigned char)(value >> 16),
+                                    (unsigned char)(value >> 8), (unsigned char)value};
+    file.write((const char *)bytes, 4);
+}
+
+static void writeChunk(std::ofstream &file, const char *type, const std::vector<unsigned char> &data)
+{
+    writeUInt32(file, (unsigned int)data.size());
+    file.write(type, 4);
+    if (!data.empty())
+        file.write((const char *)data.data(), data.size());
+
+    unsigned int crc = crc32((const unsigned char *)type, 4);
+    if (!data.empty())
+        crc = crc32(data.data(), data.size(), crc);
+    writeUInt32(file, crc);
+}
+
+static unsigned char paeth(int a, int b, int c)
+{
+    const int p = a + b - c;
+    const int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+    if (pa <= pb && pa <= pc)
+        return (unsigned char)a;
+    if (pb <= pc)
+        return (unsigned char)b;
+    return (unsigned char)c;
+}
+
+bool writePNG(const std::string &path, unsigned int width, unsigned int height, unsigned int channels,
+              const unsigned char *data, bool flipVertically)
+{
+    static const unsigned char colorTypes[5] = {0, 0, 4, 2, 6};
+    if (channels < 1 || channels > 4 || width == 0 || height == 0)
+        return false;
+
+    const size_t stride = (size_t)width * channels;
+
+    // Filters each row with the filter that gives the lowest sum of absolute differences
+    std::vector<unsigned char> filtered((stride + 1) * height);
+    std::vector<unsigned char> candidate(stride);
+    for (unsigned int y = 0; y < height; y++)
+    {
+        const unsigned char *row = data + stride * (flipVertically ? height - 1 - y : y);
+        const unsigned char *above = y == 0 ? NULL : data + stride * (flipVertically ? height - y : y - 1);
+        unsigned char *out = &filtered[(stride + 1) * y];
+
+        long bestScore = -1;
+        for (int filter = 0; filter < 5; filter++)
+        {
+            long score = 0;
+            for (size_t x = 0; x < stride; x++)
+            {
+                const int left = x >= channels ? row[x - channels] : 0;
+                const int up = above ? above[x] : 0;
+                const int upLeft = above && x >= channels ? above[x - channels] : 0;
+
+                unsigned char value = row[x];
+                switch (filter)
+                {
+                case 1:
+                    value -= left;
+                    break;
+                case 2:
+                    value -= up;
+                    break;
+                case 3:
+                    value -= (left + up) >> 1;
+                    break;
+                case 4:
+                    value -= paeth(left, up, upLeft);
+                    break;
+                }
+                candidate[x] = value;
+                score += abs((signed char)value);
+            }
+            if (bestScore < 0 || score < bestScore)
+            {
+                bestScore = score;
+                out[0] = (unsigned char)filter;
+                memcpy(out + 1, candidate.data(), stride);
+            }
+        }
+    }
+
+    std::ofstream file(path.c_str(), std::ios::binary);
+    if (!file)
+        return false;
+
+    static const unsigned char signature[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+    file.write((const char *)signature, 8);
+
+    std::vector<unsigned char> header(13, 0);
+    for (int i = 0; i < 4; i++)
+    {
+        header[i] = (unsigned char)(width >> (24 - 8 * i));
+        header[4 + i] = (unsigned char)(height >> (24 - 8 * i));
+    }
+    header[8] = 8;                     // Bit depth
+    header[9] = colorTypes[channels]; // Color type
+
+    writeChunk(file, "IHDR", header);
+    writeChunk(file, "IDAT", zlibCompress(filtered));
+    writeChunk(file, "IEND", std::vector<unsigned char>());
+
+    return (bool)file;
+}
+
+bool writeRaw(const std::string &path, unsigned int width, unsigned int height, unsigned int channels,
+              const unsigned char *data, bool flipVertically)
+{
+    std::ofstream file(path.c_str(), std::ios::binary);
+    if (!file)
+        return false;
+
+    const size_t stride = (size_t)width * channels;
+    if (!flipVertically)
+        file.write((const char *)data, stride * height);
+    else
+        for (unsigned int y = 0; y < height; y++)
+            file.write((const char *)(data + stride * (height - 1 - y)), stride);
+
+    return (bool)file;
+}
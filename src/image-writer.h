@@ -0,0 +1,31 @@
+#pragma once
+
+#include <string>
+
+/**
+ * Writes an image as a PNG file
+ * The image data is compressed with deflate (fixed Huffman codes) after
+ * choosing the best PNG filter for each row, in the same way stb_image_write does
+ * @param path Path of the file to be written
+ * @param width Image width in pixels
+ * @param height Image height in pixels
+ * @param channels Number of 8 bit channels per pixel (1, 3 or 4)
+ * @param data Image pixels, rows are tightly packed
+ * @param flipVertically The first row of data is the bottom of the image (OpenGL convention)
+ * @return The file was written
+*/
+bool writePNG(const std::string &path, unsigned int width, unsigned int height, unsigned int channels,
+              const unsigned char *data, bool flipVertically = false);
+
+/**
+ * Writes an image as a raw file, the pixels are stored without header or compression, top row first
+ * @param path Path of the file to be written
+ * @param width Image width in pixels
+ * @param height Image height in pixels
+ * @param channels Number of 8 bit channels per pixel
+ * @param data Image pixels, rows are tightly packed
+ * @param flipVertically The first row of data is the bottom of the image (OpenGL convention)
+ * @return The file was written
+*/
+bool writeRaw(const std::string &path, unsigned int width, unsigned int height, unsigned int channels,
+              const unsigned char *data, bool flipVertically = false);
@@ -9,7 +9,9 @@
 
 #include <iostream>
 #include <fstream>
+#include <iomanip>
 #include <string>
+#include <time.h> /* time */
 
 #include <glm/glm.hpp>
 #include <stb_image.h>
@@ -17,6 +19,16 @@
 #include "shader.h"
 #include "camera.h"
 #include "particle-system.h"
+#include "frame-capture.h"
+#include "configuration.h"
+#include "gpu-timer.h"
+#include "frame-histogram.h"
+#include "profiler.h"
+#include "replay-log.h"
+#include "particle-snapshot.h"
+#include "particle-cache.h"
+#include "particle-cache-player.h"
+#include "curl-noise.h"
 
 #if defined(_MSC_VER) && (_MSC_VER >= 1900) && !defined(IMGUI_DISABLE_WIN32_FUNCTIONS)
 #pragma comment(lib, "legacy_stdio_definitions")
@@ -33,6 +45,10 @@ GLFWwindow *window;
 
 // Shader object
 Shader *shader;
+// Shader of the instanced particles (cache playback)
+Shader *instancedShader;
+// Shader of the particles evaluated in closed form
+Shader *analyticShader;
 // Index (GPU) of the geometry buffer
 unsigned int VBO;
 // Index (GPU) vertex array object
@@ -44,39 +60,86 @@ unsigned int textureID;
 Camera *camera;
 // Particle system object
 ParticleSystem *particleSystem;
+// Threads the particle system splits its work across
+ThreadPool *simulationThreads;
+// Exports the rendered frames as an image sequence
+FrameCapture *frameCapture;
+// Measures the render passes on the GPU
+GpuTimer *gpuTimer;
+// Where the baked curl noise volume is cached
+std::string curlNoisePath = "curl-noise.bin";
+// Where the particle system snapshots are saved and loaded
+std::string snapshotPath = "snapshot.bin";
+// Records the simulated particles of every step
+ParticleCacheWriter cacheWriter;
+// Where the particle caches are written
+std::string cachePath = "particles.pcache";
+// Plays back particle caches, the simulation is paused while a cache is open
+ParticleCachePlayer *cachePlayer;
+// Particle cache to be played
+std::string playbackPath = "particles.pcache";
+// Simulated time since the particle cache was started
+float cacheTime = 0.0f;
+// Records the simulation inputs to replay them
+ReplayRecorder replayRecorder;
+// Where the replay logs are written
+std::string replayPath = "replay.log";
+// Seed of the recorded particle systems
+unsigned int replaySeed = 0;
+// Frame time not simulated yet when the simulation has a fixed time step
+float simulationTimeAccumulator = 0.0f;
+// Max fixed steps per frame, so a slow frame doesn't make the next ones slower
+const int maxStepsPerFrame = 8;
+
+// Render passes measured by the GPU timer
+enum RenderPass
+{
+    PARTICLES_PASS,
+    CAPTURE_PASS,
+    INTERFACE_PASS
+};
+
+/**
+ * CPU time spent on each phase of the last frame (milliseconds)
+*/
+struct FrameTimes
+{
+    float simulation; // Input and particle system update
+    float interface;  // Interface controls creation
+    float render;     // Render commands submission and buffer swap
+} frameTimes;
+
+// Phases whose frame times are recorded in histograms
+enum FramePhase
+{
+    SIMULATION_PHASE,
+    INTERFACE_PHASE,
+    RENDER_PHASE,
+    FRAME_PHASE,
+    NUMBER_OF_PHASES
+};
+const char *phaseNames[NUMBER_OF_PHASES] = {"Simulation", "Interface", "Render", "Frame"};
+// Frame times of the last 600 frames (~10 seconds) per phase, shown in the interface
+std::vector<FrameHistogram> recentFrameTimes(NUMBER_OF_PHASES, FrameHistogram(600));
+// Frame times of the whole session per phase, written on exit
+std::vector<FrameHistogram> sessionFrameTimes(NUMBER_OF_PHASES, FrameHistogram());
+// Where the session frame times are written on exit
+const char *frameTimesPath = "frame-times.csv";
+
+#ifdef ENABLE_PROFILER
+// Where the profiler captures are written
+std::string tracePath = "trace.json";
+// The profiler capture has to be started or stopped at the end of the frame, when there isn't any open zone
+bool toggleProfilerCapture = false;
+#endif
 
 // Toogles the camera's controls
 bool cameraEnabled = false;
 // Time since the last update
 float lastUpdate;
 
-struct MenuProperties
-{
-    int maxParticles;                  // Max number of particles supported by the particle system
-    float ttl;                         // Particle's time to live
-    float spawnInterval;               // Particle's spawn interval
-    int particlesPerSpawn;             // Number of particles spawned per spawn
-    glm::vec3 position;                // Base position of the spawned particles
-    glm::vec3 positionVariance;        // Variance of the spawn position
-    glm::vec3 direction;               // Base direction of the particles spawned
-    float directionScale;              // Direction scale or speed of the spawned particles
-    glm::vec3 directionVariance;       // Variance of the spawn direction
-    float initialScale;                // Particle's scale at the its life begin
-    float finalScale;                  // Particle's scale at the its life end
-    float scaleVariance;               // Particle's scale variance
-    glm::vec3 minInitialColor;         // Particle's minimun color at the its life begin
-    glm::vec3 maxInitialColor;         // Particle's maximun color at the its life begin
-    glm::vec3 minFinalColor;           // Particle's minimun color at the its life end
-    glm::vec3 maxFinalColor;           // Particle's maximun color at the its life end
-    float initialAplha;                // Particle's alpha at the its life begin
-    float finalAlpha;                  // Particle's alpha at the its life end
-    float alphaVariance;               // Particle's alpha variance
-    glm::vec3 externalForce;           // External force direction that globaly influence the particles' direction (ie gravity)
-    float externalForceVelocity;       // External force velocity
-    std::string fileTextureName;       // Current texture path to be loaded
-    std::string lastTextureLoaded;     // Last path of the loaded texture
-    std::string configurationFilePath; // Path to the configuration file to be lodaded or saved
-} menuOptions;
+// Current particle system properties (edited through the interface)
+MenuProperties menuOptions;
 
 // Mouse CallBack
 void processMousePos(GLFWwindow *, double, double);
@@ -310,14 +373,8 @@ int loadTexture(const char *path)
 */
 void setParticlesParameters()
 {
-    particleSystem->setTTL(menuOptions.ttl);
-    particleSystem->setParticleSpawns(menuOptions.particlesPerSpawn, menuOptions.spawnInterval);
-    particleSystem->setPosition(menuOptions.position, menuOptions.positionVariance);
-    particleSystem->setDirection(menuOptions.direction * menuOptions.directionScale, menuOptions.directionVariance * menuOptions.directionScale);
-    particleSystem->setScale(menuOptions.initialScale, menuOptions.finalScale, menuOptions.scaleVariance);
-    particleSystem->setColor(menuOptions.minInitialColor, menuOptions.maxInitialColor, menuOptions.minFinalColor, menuOptions.maxFinalColor);
-    particleSystem->setAplha(menuOptions.initialAplha, menuOptions.finalAlpha, menuOptions.alphaVariance);
-    particleSystem->setGlobalExternalForce(menuOptions.externalForce * menuOptions.externalForceVelocity);
+    PROFILE_SCOPE("setParticlesParameters");
+    applyProperties(particleSystem, menuOptions);
 }
 
 /**
@@ -336,13 +393,25 @@ bool init()
     // Init interface
     initGui();
 
+    // Creates the frame capture
+    frameCapture = new FrameCapture();
+    // Creates the render passes timer
+    gpuTimer = new GpuTimer({"Particles", "Capture", "Interface"});
+
     // Loads the shader
     shader = new Shader("assets/shaders/basic.vert", "assets/shaders/basic.frag");
+    instancedShader = new Shader("assets/shaders/instanced.vert", "assets/shaders/instanced.frag");
+    analyticShader = new Shader("assets/shaders/analytic.vert", "assets/shaders/instanced.frag");
     // Loads all the geometry into the GPU
     buildGeometry();
+    // Creates the particle cache player, it draws the particles geometry
+    cachePlayer = new ParticleCachePlayer(VBO);
     // Loads the texture into the GPU
     textureID = loadTexture("assets/textures/spark.png");
 
+    // Loads the curl noise volume of the force fields, it's baked the first time
+    CurlNoise::prepare(curlNoisePath);
+
     // Creates the camera
     camera = new Camera(glm::vec3(0, 0, 5), 45.0f, 0.01f, 100.0f, 5, 0.1f);
 
@@ -380,8 +449,25 @@ bool init()
 
     menuOptions.configurationFilePath = "assets/configurations/config.ini";
 
+    menuOptions.capturePath = "capture/frame";
+    menuOptions.captureFormat = CAPTURE_PNG;
+
+    menuOptions.seed = 0;
+    menuOptions.fixedTimeStep = 0.0f;
+    menuOptions.prewarmTime = 0.0f;
+    menuOptions.analyticEvaluation = false;
+    menuOptions.compactStorage = false;
+    menuOptions.collisionRadius = 0.1f;
+    menuOptions.collisionIterations = 0;
+    menuOptions.fluid = {false, 0.12f, 1000.0f, 20.0f, 0.05f, 0.01f};
+    menuOptions.gravity = {false, 0.0001f, 0.5f, 0.05f};
+    menuOptions.flock = {false, 0.5f, 16, 0.02f, 1.0f, 1.0f, 0.5f, glm::vec3(0.0f), 2.0f};
+    menuOptions.smoke = {false, glm::vec3(-2.0f), glm::vec3(2.0f), 0.125f, 4.0f, 1.0f, 0.3f, 1.0f, 20, 0.0f, 4.0f};
+
     // Builds the particle system
+    simulationThreads = new ThreadPool();
     particleSystem = new ParticleSystem(menuOptions.maxParticles, camera);
+    particleSystem->setThreadPool(simulationThreads);
     // Sets the particle system properties
     setParticlesParameters();
 
@@ -447,9 +533,13 @@ void processKey(GLFWwindow *window, int key, int scancode, int action, int mode)
     // Checks if the r key is pressed
     if (key == GLFW_KEY_R && action == GLFW_RELEASE)
     {
-        // Reloads the shader
+        // Reloads the shaders
         delete shader;
         shader = new Shader("assets/shaders/basic.vert", "assets/shaders/basic.frag");
+        delete instancedShader;
+        instancedShader = new Shader("assets/shaders/instanced.vert", "assets/shaders/instanced.frag");
+        delete analyticShader;
+        analyticShader = new Shader("assets/shaders/analytic.vert", "assets/shaders/instanced.frag");
     }
 
     // Toogles the camera interaction
@@ -474,223 +564,69 @@ void reloadParticleSystem()
 {
     delete particleSystem;
     particleSystem = new ParticleSystem(menuOptions.maxParticles, camera);
+    particleSystem->setThreadPool(simulationThreads);
+    // Recorded particle systems always use the seed written in the log
+    const unsigned int seed = replayRecorder.isRecording() ? replaySeed : (unsigned int)menuOptions.seed;
+    if (seed != 0)
+        particleSystem->setSeed(seed);
     setParticlesParameters();
-}
+    // Starts the effect in its steady state
+    particleSystem->prewarm(menuOptions.prewarmTime);
 
-/**
- * Transform a string into a int
- * @param value Value to transform
- * @param out Where the transformed value will be stored
- * @return Transformation succesful
-*/
-bool readProperty(std::string value, int &out)
-{
-    try
-    {
-        out = atoi(value.c_str());
-    }
-    catch (std::exception const &e)
-    {
-        std::cout << "error : " << e.what() << std::endl;
-        return false;
-    }
-    return true;
+    replayRecorder.recordReload(menuOptions);
 }
 
 /**
- * Transform a string into a float
- * @param value Value to transform
- * @param out Where the transformed value will be stored
- * @return Transformation succesful
+ * Starts recording the simulation, the particle system is rebuilt so the replay starts from an empty system
 */
-bool readProperty(std::string value, float &out)
+void startReplayRecording()
 {
-    try
-    {
-        out = atof(value.c_str());
-    }
-    catch (std::exception const &e)
-    {
-        std::cout << "error : " << e.what() << std::endl;
-        return false;
-    }
-    return true;
+    replaySeed = menuOptions.seed != 0 ? (unsigned int)menuOptions.seed : (unsigned int)time(NULL);
+    if (!replayRecorder.start(replayPath, replaySeed))
+        return;
+
+    // Every recorded step uses the same time step when the simulation is fixed
+    simulationTimeAccumulator = 0.0f;
+    reloadParticleSystem();
 }
 
 /**
- * Transform a string into a vec3
- * @param value Value to transform
- * @param out Where the transformed value will be stored
- * @return Transformation succesful
+ * Advances the particle system one step and records it
+ * @param deltaTime Time step
 */
-bool readProperty(std::string value, glm::vec3 &out)
+void simulateStep(float deltaTime)
 {
-    char delimiter = ' ';
-    size_t previous = 0, splitIndex;
+    replayRecorder.recordStep(deltaTime, menuOptions);
+    particleSystem->update(deltaTime);
 
-    // Split the vector by spaces (x y z)
-    for (int i = 0; i < 2; i++)
-    {
-        splitIndex = value.find(delimiter, previous);
-        if (splitIndex == std::string::npos)
-            return false;
-
-        if (!readProperty(value.substr(previous, splitIndex - previous), out[i]))
-            return false;
-        previous = splitIndex + 1;
-    }
-
-    if (!readProperty(value.substr(previous, splitIndex - previous), out[2]))
-        return false;
-
-    return true;
+    cacheTime += deltaTime;
+    cacheWriter.record(particleSystem, cacheTime);
 }
 
 /**
- * Stores a menu property
- * @param key Property to store
- * @param value String Value of the property 
- * @param properties Where the property will be stored
- * @return Stored succesfully
+ * Advances the simulation, with the frame time or with fixed steps
+ * @param deltaTime Time since last update
 */
-bool storeProperty(std::string key, std::string value, MenuProperties &properties)
+void simulate(float deltaTime)
 {
-    /**
-     * Looks for the possible property and stored it into
-     * the corresponding menu properties field
-    */
-    if (key.compare("maxParticles") == 0)
-    {
-        if (!readProperty(value, properties.maxParticles))
-            return false;
-        return true;
-    }
-    if (key.compare("ttl") == 0)
-    {
-        if (!readProperty(value, properties.ttl))
-            return false;
-        return true;
-    }
-    if (key.compare("spawnInterval") == 0)
-    {
-        if (!readProperty(value, properties.spawnInterval))
-            return false;
-        return true;
-    }
-    if (key.compare("particlesPerSpawn") == 0)
-    {
-        if (!readProperty(value, properties.particlesPerSpawn))
-            return false;
-        return true;
-    }
-    if (key.compare("position") == 0)
-    {
-        if (!readProperty(value, properties.position))
-            return false;
-        return true;
-    }
-    if (key.compare("positionVariance") == 0)
-    {
-        if (!readProperty(value, properties.positionVariance))
-            return false;
-        return true;
-    }
-    if (key.compare("direction") == 0)
-    {
-        if (!readProperty(value, properties.direction))
-            return false;
-        return true;
-    }
-    if (key.compare("directionScale") == 0)
-    {
-        if (!readProperty(value, properties.directionScale))
-            return false;
-        return true;
-    }
-    if (key.compare("directionVariance") == 0)
-    {
-        if (!readProperty(value, properties.directionVariance))
-            return false;
-        return true;
-    }
-    if (key.compare("initialScale") == 0)
-    {
-        if (!readProperty(value, properties.initialScale))
-            return false;
-        return true;
-    }
-    if (key.compare("finalScale") == 0)
-    {
-        if (!readProperty(value, properties.finalScale))
-            return false;
-        return true;
-    }
-    if (key.compare("scaleVariance") == 0)
-    {
-        if (!readProperty(value, properties.scaleVariance))
-            return false;
-        return true;
-    }
-    if (key.compare("minInitialColor") == 0)
+    if (menuOptions.fixedTimeStep <= 0.0f)
     {
-        if (!readProperty(value, properties.minInitialColor))
-            return false;
-        return true;
-    }
-    if (key.compare("maxInitialColor") == 0)
-    {
-        if (!readProperty(value, properties.maxInitialColor))
-            return false;
-        return true;
-    }
-    if (key.compare("minFinalColor") == 0)
-    {
-        if (!readProperty(value, properties.minFinalColor))
-            return false;
-        return true;
-    }
-    if (key.compare("maxFinalColor") == 0)
-    {
-        if (!readProperty(value, properties.maxFinalColor))
-            return false;
-        return true;
-    }
-    if (key.compare("initialAplha") == 0)
-    {
-        if (!readProperty(value, properties.initialAplha))
-            return false;
-        return true;
-    }
-    if (key.compare("finalAlpha") == 0)
-    {
-        if (!readProperty(value, properties.finalAlpha))
-            return false;
-        return true;
-    }
-    if (key.compare("alphaVariance") == 0)
-    {
-        if (!readProperty(value, properties.alphaVariance))
-            return false;
-        return true;
-    }
-    if (key.compare("externalForce") == 0)
-    {
-        if (!readProperty(value, properties.externalForce))
-            return false;
-        return true;
-    }
-    if (key.compare("externalForceVelocity") == 0)
-    {
-        if (!readProperty(value, properties.externalForceVelocity))
-            return false;
-        return true;
+        simulateStep(deltaTime);
+        return;
     }
-    if (key.compare("fileTextureName") == 0)
+
+    // Runs as many fixed steps as the frame time allows, the rest is kept for the next frame
+    simulationTimeAccumulator += deltaTime;
+    int steps = 0;
+    while (simulationTimeAccumulator >= menuOptions.fixedTimeStep && steps < maxStepsPerFrame)
     {
-        properties.fileTextureName = value;
-        return true;
+        simulateStep(menuOptions.fixedTimeStep);
+        simulationTimeAccumulator -= menuOptions.fixedTimeStep;
+        steps++;
     }
-    return false;
+    // Drops the time the simulation can't catch up with
+    if (steps == maxStepsPerFrame)
+        simulationTimeAccumulator = glm::min(simulationTimeAccumulator, menuOptions.fixedTimeStep);
 }
 
 /**
@@ -698,58 +634,17 @@ bool storeProperty(std::string key, std::string value, MenuProperties &propertie
 */
 void loadConfiguration()
 {
-    std::ifstream file;
-
-    // Open the file
-    file.open(menuOptions.configurationFilePath);
-
-    // Error
-    if (!file)
-    {
-        std::cout << "Unable to open the configuration file " << menuOptions.configurationFilePath << std::endl;
-        return;
-    }
-
-    std::string line;
-
     // Make a copie of the menu propeties
     MenuProperties newProperties = menuOptions;
 
-    // Reads each line and stores the property
-    while (std::getline(file, line))
-    {
-        std::cout << line << std::endl;
-        // Splits the string
-        std::size_t splitIndex = line.find(' ');
-
-        // We got an error
-        if (splitIndex == std::string::npos)
-        {
-            std::cout << "File " << menuOptions.configurationFilePath << " corrupted" << std::endl;
-            return;
-        }
-
-        std::string key = line.substr(0, splitIndex);
-        std::string value = line.substr(splitIndex + 1, line.size());
-
-        std::cout << key << " " << value << std::endl;
-
-        // We got an error
-        if (!storeProperty(key, value, newProperties))
-        {
-            std::cout << "File " << menuOptions.configurationFilePath << " corrupted" << std::endl;
-            return;
-        }
-    }
+    if (!readConfiguration(menuOptions.configurationFilePath, newProperties))
+        return;
 
     // File read complete, copies the new properties
     menuOptions = newProperties;
     // Reloads the particle system
     reloadParticleSystem();
     changeTexture();
-
-    // Close the file
-    file.close();
 }
 
 /**
@@ -757,101 +652,147 @@ void loadConfiguration()
 */
 void saveConfiguration()
 {
-    std::ofstream file;
-    file.open(menuOptions.configurationFilePath);
-
-    if (!file)
-        std::cout << "Couldn't open the file " << menuOptions.configurationFilePath << " for save" << std::endl;
-
-    file << "maxParticles"
-         << " " << menuOptions.maxParticles << std::endl;
-
-    file << "ttl"
-         << " " << menuOptions.ttl << std::endl;
-
-    file << "spawnInterval"
-         << " " << menuOptions.spawnInterval << std::endl;
-
-    file << "particlesPerSpawn"
-         << " " << menuOptions.particlesPerSpawn << std::endl;
-
-    file << "position"
-         << " " << menuOptions.position.x
-         << " " << menuOptions.position.y
-         << " " << menuOptions.position.z << std::endl;
-
-    file << "positionVariance"
-         << " " << menuOptions.positionVariance.x
-         << " " << menuOptions.positionVariance.y
-         << " " << menuOptions.positionVariance.z << std::endl;
-
-    file << "direction"
-         << " " << menuOptions.direction.x
-         << " " << menuOptions.direction.y
-         << " " << menuOptions.direction.z << std::endl;
-
-    file << "directionScale"
-         << " " << menuOptions.directionScale << std::endl;
-
-    file << "directionVariance"
-         << " " << menuOptions.directionVariance.x
-         << " " << menuOptions.directionVariance.y
-         << " " << menuOptions.directionVariance.z << std::endl;
-
-    file << "initialScale"
-         << " " << menuOptions.initialScale << std::endl;
-
-    file << "finalScale"
-         << " " << menuOptions.finalScale << std::endl;
-
-    file << "scaleVariance"
-         << " " << menuOptions.scaleVariance << std::endl;
-
-    file << "minInitialColor"
-         << " " << menuOptions.minInitialColor.x
-         << " " << menuOptions.minInitialColor.y
-         << " " << menuOptions.minInitialColor.z << std::endl;
-
-    file << "maxInitialColor"
-         << " " << menuOptions.maxInitialColor.x
-         << " " << menuOptions.maxInitialColor.y
-         << " " << menuOptions.maxInitialColor.z << std::endl;
-
-    file << "minFinalColor"
-         << " " << menuOptions.minFinalColor.x
-         << " " << menuOptions.minFinalColor.y
-         << " " << menuOptions.minFinalColor.z << std::endl;
-
-    file << "maxFinalColor"
-         << " " << menuOptions.maxFinalColor.x
-         << " " << menuOptions.maxFinalColor.y
-         << " " << menuOptions.maxFinalColor.z << std::endl;
-
-    file << "initialAplha"
-         << " " << menuOptions.initialAplha << std::endl;
+    writeConfiguration(menuOptions.configurationFilePath, menuOptions);
+}
 
-    file << "finalAlpha"
-         << " " << menuOptions.finalAlpha << std::endl;
+/**
+ * Saves the running particle system, with its particles, to a snapshot file
+*/
+void saveSnapshot()
+{
+    const double start = glfwGetTime();
+    if (writeSnapshot(snapshotPath, particleSystem, menuOptions))
+        std::cout << "Snapshot saved to " << snapshotPath << " in " << (glfwGetTime() - start) * 1000.0 << " ms" << std::endl;
+}
 
-    file << "alphaVariance"
-         << " " << menuOptions.alphaVariance << std::endl;
+/**
+ * Replaces the particle system with the one saved in a snapshot file
+*/
+void loadSnapshot()
+{
+    const double start = glfwGetTime();
+    ParticleSystem *loadedSystem = readSnapshot(snapshotPath, camera, menuOptions);
+    if (!loadedSystem)
+        return;
 
-    file << "externalForce"
-         << " " << menuOptions.externalForce.x
-         << " " << menuOptions.externalForce.y
-         << " " << menuOptions.externalForce.z << std::endl;
+    // The replay can't rebuild a restored particle system
+    replayRecorder.stop();
 
-    file << "externalForceVelocity"
-         << " " << menuOptions.externalForceVelocity << std::endl;
+    delete particleSystem;
+    particleSystem = loadedSystem;
+    // Same setup as a reloaded particle system, the restored state only holds the emitter
+    particleSystem->setThreadPool(simulationThreads);
+    setParticlesParameters();
+    std::cout << "Snapshot loaded from " << snapshotPath << " in " << (glfwGetTime() - start) * 1000.0 << " ms" << std::endl;
+    changeTexture();
+}
+/**
+ * Creates/ Updates the statistics window, with the frame timings and the draw counters
+*/
+void updateStatisticsInterface()
+{
+    ImGui::SetNextWindowPos(ImVec2(windowWidth - 340.0f, 20.0f), ImGuiCond_FirstUseEver);
+    ImGui::SetNextWindowSize(ImVec2(320.0f, 260.0f), ImGuiCond_FirstUseEver);
+    ImGui::Begin("Statistics");
+
+    const float frameRate = ImGui::GetIO().Framerate;
+    ImGui::Text("%.1f FPS (%.2f ms)", frameRate, 1000.0f / frameRate);
+    ImGui::Separator();
+
+    // Timings table, the CPU time of each phase and the CPU and GPU time of each render pass
+    ImGui::Columns(3, "Timings");
+    ImGui::Text("Phase");
+    ImGui::NextColumn();
+    ImGui::Text("CPU (ms)");
+    ImGui::NextColumn();
+    ImGui::Text("GPU (ms)");
+    ImGui::NextColumn();
+    ImGui::Separator();
+
+    const float phaseTimes[] = {frameTimes.simulation, frameTimes.interface, frameTimes.render};
+    for (int i = SIMULATION_PHASE; i <= RENDER_PHASE; i++)
+    {
+        ImGui::Text("%s", phaseNames[i]);
+        ImGui::NextColumn();
+        ImGui::Text("%.3f", phaseTimes[i]);
+        ImGui::NextColumn();
+        ImGui::Text("-");
+        ImGui::NextColumn();
+    }
+    for (unsigned int pass = 0; pass < gpuTimer->getNumberOfPasses(); pass++)
+    {
+        ImGui::Text("  %s", gpuTimer->getPassName(pass).c_str());
+        ImGui::NextColumn();
+        ImGui::Text("%.3f", gpuTimer->getCpuTime(pass));
+        ImGui::NextColumn();
+        ImGui::Text("%.3f", gpuTimer->getGpuTime(pass));
+        ImGui::NextColumn();
+    }
+    ImGui::Columns(1);
+    ImGui::Separator();
+
+    // Percentiles of the recent frame times, the tail matters more than the average
+    ImGui::Text("Frame times (ms), last %zu frames", recentFrameTimes[FRAME_PHASE].getNumberOfSamples());
+    ImGui::Columns(5, "Percentiles");
+    const char *headers[] = {"Phase", "p50", "p95", "p99", "max"};
+    for (int i = 0; i < 5; i++)
+    {
+        ImGui::Text("%s", headers[i]);
+        ImGui::NextColumn();
+    }
+    ImGui::Separator();
+    for (int i = 0; i < NUMBER_OF_PHASES; i++)
+    {
+        FrameHistogram &histogram = recentFrameTimes[i];
+        ImGui::Text("%s", phaseNames[i]);
+        ImGui::NextColumn();
+        ImGui::Text("%.2f", histogram.getPercentile(50.0f));
+        ImGui::NextColumn();
+        ImGui::Text("%.2f", histogram.getPercentile(95.0f));
+        ImGui::NextColumn();
+        ImGui::Text("%.2f", histogram.getPercentile(99.0f));
+        ImGui::NextColumn();
+        ImGui::Text("%.2f", histogram.getMax());
+        ImGui::NextColumn();
+    }
+    ImGui::Columns(1);
+    ImGui::Separator();
+
+    // Draw counters of the particle system
+    const DrawStatistics &drawStatistics = cachePlayer->isOpen() ? cachePlayer->getDrawStatistics() : particleSystem->getDrawStatistics();
+    ImGui::Text("Draw calls: %u", drawStatistics.drawCalls);
+    ImGui::Text("Instances drawn: %u", drawStatistics.instances);
+    ImGui::Text("Uploaded: %.1f KB", drawStatistics.bytesUploaded / 1024.0f);
+    ImGui::Text("Particles memory: %.1f MB", particleSystem->getMemoryUsage() / (1024.0f * 1024.0f));
+
+#ifdef ENABLE_PROFILER
+    // Profiler capture controls
+    ImGui::Separator();
+    ImGui::InputText("Path_Trace", &tracePath);
+    if (!Profiler::isCapturing())
+    {
+        if (ImGui::Button("Start_Profiling"))
+            toggleProfilerCapture = true;
+    }
+    else
+    {
+        if (ImGui::Button("Stop_Profiling"))
+            toggleProfilerCapture = true;
+        ImGui::SameLine();
+        ImGui::Text("%zu zones", Profiler::getNumberOfZones());
+    }
+#endif
 
-    file << "fileTextureName"
-         << " " << menuOptions.fileTextureName << std::endl;
+    ImGui::End();
 }
+
 /**
  * Creates/ Upates all the interface controls
 */
 void updateInterface()
 {
+    PROFILE_SCOPE("updateInterface");
+
     // Start the Dear ImGui frame
     ImGui_ImplOpenGL3_NewFrame();
     ImGui_ImplGlfw_NewFrame();
@@ -867,7 +808,7 @@ void updateInterface()
     ImGui::TextWrapped("Changing the maximun number of particles will reset the particle system");
     if (ImGui::InputInt("Max Particles", &menuOptions.maxParticles))
     {
-        menuOptions.maxParticles = glm::max(menuOptions.maxParticles, 0);
+        menuOptions.maxParticles = glm::clamp(menuOptions.maxParticles, 0, maxParticlesLimit);
         menuOptions.particlesPerSpawn = glm::min(menuOptions.maxParticles, menuOptions.particlesPerSpawn);
         reloadParticleSystem();
     }
@@ -879,6 +820,13 @@ void updateInterface()
             loadConfiguration();
         if (ImGui::Button("Save_Config"))
             saveConfiguration();
+
+        ImGui::TextWrapped("Snapshots also save the running particles");
+        ImGui::InputTextWithHint("Path_Snapshot", "path", &snapshotPath);
+        if (ImGui::Button("Load_Snapshot"))
+            loadSnapshot();
+        if (ImGui::Button("Save_Snapshot"))
+            saveSnapshot();
     }
     if (ImGui::CollapsingHeader("Texture"))
     {
@@ -886,6 +834,94 @@ void updateInterface()
         if (ImGui::Button("Load_Texture"))
             changeTexture();
     }
+    if (ImGui::CollapsingHeader("Capture"))
+    {
+        ImGui::TextWrapped("Frames are saved as <path>_00000.png, the folder has to exist");
+        ImGui::InputText("Path_Capture", &menuOptions.capturePath);
+        ImGui::Combo("Format_Capture", &menuOptions.captureFormat, "PNG\0Raw RGBA\0");
+
+        if (!frameCapture->isCapturing())
+        {
+            if (ImGui::Button("Start_Capture"))
+                frameCapture->start(menuOptions.capturePath, (CaptureFormat)menuOptions.captureFormat);
+        }
+        else if (ImGui::Button("Stop_Capture"))
+            frameCapture->stop();
+
+        ImGui::Text("Captured: %u Written: %u", frameCapture->getFramesCaptured(), frameCapture->getFramesWritten());
+
+        ImGui::TextWrapped("Particle caches store the particles of every simulation step");
+        ImGui::InputText("Path_Cache", &cachePath);
+        if (!cacheWriter.isRecording())
+        {
+            if (ImGui::Button("Start_Cache"))
+            {
+                cacheTime = 0.0f;
+                cacheWriter.start(cachePath);
+            }
+        }
+        else if (ImGui::Button("Stop_Cache"))
+            cacheWriter.stop();
+
+        ImGui::Text("Cached: %u Written: %u (%.1f MB)", cacheWriter.getFramesRecorded(), cacheWriter.getFramesWritten(),
+                    cacheWriter.getBytesWritten() / (1024.0 * 1024.0));
+    }
+    if (ImGui::CollapsingHeader("Playback"))
+    {
+        ImGui::TextWrapped("The simulation is paused while a particle cache is open");
+        ImGui::InputText("Path_Playback", &playbackPath);
+        if (!cachePlayer->isOpen())
+        {
+            if (ImGui::Button("Open_Playback"))
+                cachePlayer->open(playbackPath);
+        }
+        else if (ImGui::Button("Close_Playback"))
+            cachePlayer->close();
+
+        if (cachePlayer->isOpen())
+        {
+            // Scrubs to any frame, forward or backward
+            int frame = cachePlayer->getRequestedFrame();
+            if (ImGui::SliderInt("Frame", &frame, 0, (int)cachePlayer->getFrameCount() - 1))
+                cachePlayer->seek(frame);
+
+            if (ImGui::Button("<"))
+                cachePlayer->seek(cachePlayer->getRequestedFrame() - 1);
+            ImGui::SameLine();
+            if (ImGui::Button(cachePlayer->isPlaying() ? "Pause" : "Play"))
+                cachePlayer->setPlaying(!cachePlayer->isPlaying());
+            ImGui::SameLine();
+            if (ImGui::Button(">"))
+                cachePlayer->seek(cachePlayer->getRequestedFrame() + 1);
+            ImGui::SameLine();
+            bool loop = cachePlayer->isLooping();
+            if (ImGui::Checkbox("Loop", &loop))
+                cachePlayer->setLooping(loop);
+
+            const int shownFrame = cachePlayer->getShownFrame();
+            ImGui::Text("Shown: %d Time: %.3f s", shownFrame, shownFrame >= 0 ? cachePlayer->getFrameTime(shownFrame) : 0.0f);
+        }
+    }
+    if (ImGui::CollapsingHeader("Replay"))
+    {
+        ImGui::TextWrapped("Seed 0 seeds the particles from the clock, fixed time step 0 simulates with the frame time");
+        if (ImGui::InputInt("Seed", &menuOptions.seed))
+            menuOptions.seed = glm::max(menuOptions.seed, 0);
+        if (ImGui::InputFloat("Fixed time step", &menuOptions.fixedTimeStep, 0.001f, 0.01f, 4))
+            menuOptions.fixedTimeStep = glm::max(menuOptions.fixedTimeStep, 0.0f);
+
+        ImGui::InputText("Path_Replay", &replayPath);
+        if (!replayRecorder.isRecording())
+        {
+            if (ImGui::Button("Start_Recording"))
+                startReplayRecording();
+        }
+        else if (ImGui::Button("Stop_Recording"))
+            replayRecorder.stop();
+
+        ImGui::Text("Seed: %u Recorded steps: %llu", replayRecorder.isRecording() ? replaySeed : particleSystem->getSeed(),
+                    replayRecorder.getSteps());
+    }
     if (ImGui::CollapsingHeader("Spawn"))
     {
         ImGui::SliderInt("Particles per Spawn", &menuOptions.particlesPerSpawn, 1, menuOptions.maxParticles);
@@ -895,6 +931,12 @@ void updateInterface()
 
         if (ImGui::InputFloat("Spawn time interval", &menuOptions.spawnInterval, 0.001f, 0.01, 4))
             menuOptions.spawnInterval = glm::max(menuOptions.spawnInterval, 0.001f);
+
+        // The prewarm is applied when the particle system is loaded
+        if (ImGui::InputFloat("Prewarm time", &menuOptions.prewarmTime, 0.1f, 1.0f, 2))
+            menuOptions.prewarmTime = glm::max(menuOptions.prewarmTime, 0.0f);
+        if (ImGui::Button("Restart"))
+            reloadParticleSystem();
     }
     if (ImGui::CollapsingHeader("Position"))
     {
@@ -918,6 +960,154 @@ void updateInterface()
             menuOptions.externalForce = glm::clamp(menuOptions.externalForce, glm::vec3(-1), glm::vec3(1));
 
         ImGui::InputFloat("F_Speed", &menuOptions.externalForceVelocity, 0.001, 0.01, 4);
+
+        ImGui::Checkbox("Analytic evaluation", &menuOptions.analyticEvaluation);
+        ImGui::SameLine();
+        ImGui::Checkbox("Compact storage", &menuOptions.compactStorage);
+    }
+    if (ImGui::CollapsingHeader("Force Fields"))
+    {
+        // The particles are updated step by step while there are fields, the analytic evaluation is suspended
+        for (size_t i = 0; i < menuOptions.forceFields.size(); i++)
+        {
+            ForceField &field = menuOptions.forceFields[i];
+            ImGui::PushID((int)i);
+            ImGui::Combo("FF_Type", &field.type, forceFieldNames, NUMBER_OF_FORCE_FIELD_TYPES);
+            ImGui::DragFloat3("FF_Position", &field.position[0], 0.01f);
+            if (field.type == FORCE_VORTEX || field.type == FORCE_WIND || field.type == FORCE_CURL_NOISE)
+                ImGui::DragFloat3("FF_Direction", &field.direction[0], 0.01f, -1.0f, 1.0f);
+            ImGui::InputFloat("FF_Strength", &field.strength, 0.01f, 0.1f, 4);
+            if (ImGui::InputFloat("FF_Radius", &field.radius, 0.01f, 0.1f, 4))
+                field.radius = glm::max(field.radius, 0.0f);
+            if ((field.type == FORCE_TURBULENCE || field.type == FORCE_CURL_NOISE) && ImGui::InputFloat("FF_Frequency", &field.frequency, 0.01f, 0.1f, 4))
+                field.frequency = glm::max(field.frequency, 0.0f);
+            const bool removed = ImGui::Button("Remove_Field");
+            ImGui::PopID();
+            ImGui::Separator();
+            if (removed)
+            {
+                menuOptions.forceFields.erase(menuOptions.forceFields.begin() + i);
+                break;
+            }
+        }
+        if (ImGui::Button("Add_Field"))
+        {
+            ForceField field = {FORCE_ATTRACTOR, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f), 1.0f, 0.0f, 1.0f};
+            menuOptions.forceFields.push_back(field);
+        }
+    }
+    if (ImGui::CollapsingHeader("Collisions"))
+    {
+        // The overlapping particles are pushed apart, 0 iterations disables the collisions
+        if (ImGui::InputFloat("C_Radius", &menuOptions.collisionRadius, 0.01f, 0.1f, 4))
+            menuOptions.collisionRadius = glm::max(menuOptions.collisionRadius, 0.001f);
+        ImGui::SliderInt("C_Iterations", &menuOptions.collisionIterations, 0, 8);
+    }
+    if (ImGui::CollapsingHeader("Fluid"))
+    {
+        // The particles are moved by the fluid solver with fixed steps, the analytic evaluation is suspended
+        ImGui::Checkbox("Fluid_Enabled", &menuOptions.fluid.enabled);
+        if (ImGui::InputFloat("Fluid_Radius", &menuOptions.fluid.radius, 0.01f, 0.1f, 4))
+            menuOptions.fluid.radius = glm::max(menuOptions.fluid.radius, 0.001f);
+        if (ImGui::InputFloat("Fluid_Rest_Density", &menuOptions.fluid.restDensity, 10.0f, 100.0f, 1))
+            menuOptions.fluid.restDensity = glm::max(menuOptions.fluid.restDensity, 0.001f);
+        if (ImGui::InputFloat("Fluid_Stiffness", &menuOptions.fluid.stiffness, 0.1f, 1.0f, 3))
+            menuOptions.fluid.stiffness = glm::max(menuOptions.fluid.stiffness, 0.0f);
+        if (ImGui::InputFloat("Fluid_Viscosity", &menuOptions.fluid.viscosity, 0.001f, 0.01f, 4))
+            menuOptions.fluid.viscosity = glm::max(menuOptions.fluid.viscosity, 0.0f);
+        if (ImGui::InputFloat("Fluid_Time_Step", &menuOptions.fluid.timeStep, 0.001f, 0.01f, 4))
+            menuOptions.fluid.timeStep = glm::max(menuOptions.fluid.timeStep, 0.001f);
+    }
+    if (ImGui::CollapsingHeader("Gravity"))
+    {
+        // The particles attract each other, moved by the Barnes-Hut solver, the analytic evaluation is suspended
+        ImGui::Checkbox("Gravity_Enabled", &menuOptions.gravity.enabled);
+        if (ImGui::InputFloat("Gravity_Strength", &menuOptions.gravity.strength, 0.00001f, 0.0001f, 6))
+            menuOptions.gravity.strength = glm::max(menuOptions.gravity.strength, 0.0f);
+        ImGui::SliderFloat("Gravity_Opening_Angle", &menuOptions.gravity.openingAngle, 0.0f, 1.5f);
+        if (ImGui::InputFloat("Gravity_Softening", &menuOptions.gravity.softening, 0.001f, 0.01f, 4))
+            menuOptions.gravity.softening = glm::max(menuOptions.gravity.softening, 0.001f);
+    }
+    if (ImGui::CollapsingHeader("Flock"))
+    {
+        // The particles steer with their neighbours and towards the target, the analytic evaluation is suspended
+        ImGui::Checkbox("Flock_Enabled", &menuOptions.flock.enabled);
+        if (ImGui::InputFloat("Flock_Radius", &menuOptions.flock.radius, 0.01f, 0.1f, 3))
+            menuOptions.flock.radius = glm::max(menuOptions.flock.radius, 0.001f);
+        ImGui::SliderInt("Flock_Max_Neighbors", &menuOptions.flock.maxNeighbors, 1, 64);
+        ImGui::DragFloat("Flock_Separation", &menuOptions.flock.separation, 0.001f, 0.0f, 10.0f);
+        ImGui::DragFloat("Flock_Alignment", &menuOptions.flock.alignment, 0.01f, 0.0f, 10.0f);
+        ImGui::DragFloat("Flock_Cohesion", &menuOptions.flock.cohesion, 0.01f, 0.0f, 10.0f);
+        ImGui::DragFloat("Flock_Seek", &menuOptions.flock.seek, 0.01f, 0.0f, 10.0f);
+        ImGui::DragFloat3("Flock_Target", &menuOptions.flock.target[0], 0.1f);
+        if (ImGui::InputFloat("Flock_Max_Speed", &menuOptions.flock.maxSpeed, 0.1f, 1.0f, 2))
+            menuOptions.flock.maxSpeed = glm::max(menuOptions.flock.maxSpeed, 0.01f);
+    }
+    if (ImGui::CollapsingHeader("Smoke"))
+    {
+        // The particles are carried by the velocity of the grid, the analytic evaluation is suspended
+        ImGui::Checkbox("Smoke_Enabled", &menuOptions.smoke.enabled);
+        ImGui::DragFloat3("Smoke_Bounds_Min", &menuOptions.smoke.boundsMin[0], 0.1f);
+        ImGui::DragFloat3("Smoke_Bounds_Max", &menuOptions.smoke.boundsMax[0], 0.1f);
+        if (ImGui::InputFloat("Smoke_Cell_Size", &menuOptions.smoke.cellSize, 0.01f, 0.1f, 3))
+            menuOptions.smoke.cellSize = glm::max(menuOptions.smoke.cellSize, 0.01f);
+        ImGui::DragFloat("Smoke_Buoyancy", &menuOptions.smoke.buoyancy, 0.01f, 0.0f, 50.0f);
+        ImGui::DragFloat("Smoke_Cooling", &menuOptions.smoke.cooling, 0.01f, 0.0f, 10.0f);
+        ImGui::DragFloat("Smoke_Source_Radius", &menuOptions.smoke.sourceRadius, 0.01f, 0.0f, 5.0f);
+        ImGui::DragFloat("Smoke_Source_Temperature", &menuOptions.smoke.sourceTemperature, 0.01f, 0.0f, 10.0f);
+        ImGui::SliderInt("Smoke_Pressure_Iterations", &menuOptions.smoke.pressureIterations, 0, 100);
+        ImGui::SliderFloat("Smoke_Time_Step", &menuOptions.smoke.timeStep, 0.0f, 0.1f);
+        ImGui::DragFloat("Smoke_Drag", &menuOptions.smoke.drag, 0.01f, 0.0f, 50.0f);
+    }
+    if (ImGui::CollapsingHeader("Colliders"))
+    {
+        // The particles are updated step by step while there are colliders, the analytic evaluation is suspended
+        for (size_t i = 0; i < menuOptions.colliders.size(); i++)
+        {
+            Collider &collider = menuOptions.colliders[i];
+            ImGui::PushID((int)i);
+            ImGui::Combo("CO_Type", &collider.type, colliderNames, NUMBER_OF_COLLIDER_TYPES);
+            ImGui::Combo("CO_Response", &collider.response, colliderResponseNames, NUMBER_OF_COLLIDER_RESPONSES);
+            ImGui::DragFloat3("CO_Position", &collider.position[0], 0.01f);
+            if (collider.type == COLLIDER_PLANE)
+                ImGui::DragFloat3("CO_Normal", &collider.size[0], 0.01f, -1.0f, 1.0f);
+            else if (collider.type == COLLIDER_BOX || collider.type == COLLIDER_HEIGHTFIELD)
+            {
+                if (ImGui::DragFloat3(collider.type == COLLIDER_BOX ? "CO_Half_Size" : "CO_Size", &collider.size[0], 0.01f))
+                    collider.size = glm::max(collider.size, glm::vec3(0.0f));
+            }
+            else if (ImGui::DragFloat(collider.type == COLLIDER_SPHERE ? "CO_Radius" : "CO_Scale", &collider.size[0], 0.01f))
+                collider.size.x = glm::max(collider.size.x, 0.0f);
+            if (collider.type == COLLIDER_SDF || collider.type == COLLIDER_HEIGHTFIELD)
+                ImGui::InputText("CO_Path", &collider.path);
+            if (collider.response == COLLIDER_BOUNCE)
+            {
+                ImGui::SliderFloat("CO_Restitution", &collider.restitution, 0.0f, 1.0f);
+                ImGui::SliderFloat("CO_Friction", &collider.friction, 0.0f, 1.0f);
+            }
+            else if (collider.response == COLLIDER_STICK && ImGui::InputFloat("CO_Fade_Time", &collider.restitution, 0.1f, 1.0f, 2))
+                collider.restitution = glm::max(collider.restitution, 0.0f);
+            const bool removed = ImGui::Button("Remove_Collider");
+            ImGui::PopID();
+            ImGui::Separator();
+            if (removed)
+            {
+                menuOptions.colliders.erase(menuOptions.colliders.begin() + i);
+                break;
+            }
+        }
+        if (ImGui::Button("Add_Collider"))
+        {
+            // A ground plane, the path and the loaded data start empty
+            Collider collider = Collider();
+            collider.type = COLLIDER_PLANE;
+            collider.response = COLLIDER_BOUNCE;
+            collider.position = glm::vec3(0.0f, -2.0f, 0.0f);
+            collider.size = glm::vec3(0.0f, 1.0f, 0.0f);
+            collider.restitution = 0.5f;
+            collider.friction = 0.1f;
+            menuOptions.colliders.push_back(collider);
+        }
     }
     if (ImGui::CollapsingHeader("Scale"))
     {
@@ -952,6 +1142,22 @@ void updateInterface()
             menuOptions.alphaVariance = glm::max(menuOptions.alphaVariance, 0.0f);
     }
     ImGui::End();
+
+    updateStatisticsInterface();
+}
+
+/**
+ * Uses a shader that builds the particle billboards itself and sets its camera and texture uniforms
+ * @param particlesShader Instanced or analytic particles shader
+*/
+void useInstancedShader(Shader *particlesShader)
+{
+    particlesShader->use();
+    particlesShader->setMat4("projection", camera->getProjectionMatrix(windowWidth, windowHeight));
+    particlesShader->setMat4("view", camera->getViewMatrix());
+    particlesShader->setVec3("cameraPosition", camera->getPosition());
+    particlesShader->setVec3("cameraUp", camera->getUpVector());
+    particlesShader->setInt("text1", 0);
 }
 
 /**
@@ -959,6 +1165,8 @@ void updateInterface()
 */
 void render()
 {
+    PROFILE_SCOPE("render");
+
     ImGui::Render();
     // Clears the color and depth buffers from the frame buffer
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -967,29 +1175,101 @@ void render()
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-    // Use the shader
-    shader->use();
-    // Sets the projection and view matrices
-    shader->setMat4("projection", camera->getProjectionMatrix(windowWidth, windowHeight));
-    shader->setMat4("view", camera->getViewMatrix());
-
     // Sets the current texture
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_2D, textureID);
-    shader->setInt("text1", 0);
 
-    // Renders the particle system
-    particleSystem->draw(shader, VAO);
+    // Renders the played particle cache or the particle system
+    gpuTimer->begin(PARTICLES_PASS);
+    if (cachePlayer->isOpen())
+    {
+        useInstancedShader(instancedShader);
+        cachePlayer->draw();
+    }
+    else if (particleSystem->isAnalyticEvaluation())
+    {
+        useInstancedShader(analyticShader);
+        particleSystem->drawAnalytic(analyticShader, VBO);
+    }
+    else
+    {
+        // Use the shader
+        shader->use();
+        // Sets the projection and view matrices
+        shader->setMat4("projection", camera->getProjectionMatrix(windowWidth, windowHeight));
+        shader->setMat4("view", camera->getViewMatrix());
+        shader->setInt("text1", 0);
+        particleSystem->draw(shader, VAO);
+    }
+    gpuTimer->end(PARTICLES_PASS);
+
+    // Reads back the rendered effect (without the interface) if a capture is running
+    if (frameCapture->isCapturing())
+    {
+        gpuTimer->begin(CAPTURE_PASS);
+        frameCapture->capture(windowWidth, windowHeight);
+        gpuTimer->end(CAPTURE_PASS);
+    }
 
     glDisable(GL_BLEND);
     glEnable(GL_DEPTH_TEST);
     // Draw interface
+    gpuTimer->begin(INTERFACE_PASS);
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+    gpuTimer->end(INTERFACE_PASS);
+
+    // Collects the timings of the previous frames
+    gpuTimer->nextFrame();
 
     // Swap the buffer
     glfwSwapBuffers(window);
 }
 
+/**
+ * Adds the last frame times to the histograms
+ * @param frameTime Time between the last two frames in milliseconds
+*/
+void recordFrameTimes(float frameTime)
+{
+    const float phaseTimes[NUMBER_OF_PHASES] = {frameTimes.simulation, frameTimes.interface, frameTimes.render, frameTime};
+    for (int i = 0; i < NUMBER_OF_PHASES; i++)
+    {
+        recentFrameTimes[i].record(phaseTimes[i]);
+        sessionFrameTimes[i].record(phaseTimes[i]);
+    }
+}
+
+/**
+ * Writes the frame times distribution of the whole session as CSV, and prints its percentiles
+ * @param path Path to the CSV file
+*/
+void writeFrameTimes(const char *path)
+{
+    std::cout << "Frame times (ms)      p50      p95      p99      max" << std::endl
+              << std::fixed << std::setprecision(2);
+    for (int i = 0; i < NUMBER_OF_PHASES; i++)
+    {
+        FrameHistogram &histogram = sessionFrameTimes[i];
+        std::cout << std::left << std::setw(16) << phaseNames[i] << std::right
+                  << " " << std::setw(8) << histogram.getPercentile(50.0f)
+                  << " " << std::setw(8) << histogram.getPercentile(95.0f)
+                  << " " << std::setw(8) << histogram.getPercentile(99.0f)
+                  << " " << std::setw(8) << histogram.getMax() << std::endl;
+    }
+
+    std::ofstream file(path);
+    if (!file.is_open())
+    {
+        std::cout << "ERROR:: Unable to write the frame times " << path << std::endl;
+        return;
+    }
+
+    file << "phase,upper_ms,count,cumulative_fraction" << std::endl;
+    for (int i = 0; i < NUMBER_OF_PHASES; i++)
+        sessionFrameTimes[i].writeDistribution(file, phaseNames[i]);
+    std::cout << "Frame times written to " << path << std::endl;
+}
+
 /**
  * App main loop
 */
@@ -999,29 +1279,70 @@ void update()
     // Loop until something tells the window, that it has to be closed
     while (!glfwWindowShouldClose(window))
     {
-        // Computes the delta time
-        const float currentTime = glfwGetTime();
-        const float deltaTime = currentTime - lastUpdate;
-        lastUpdate = currentTime;
-
-        // Checks for keyboard inputs
-        processKeyboardInput(window, deltaTime);
-
-        // Sets the particle system properties
-        setParticlesParameters();
-
-        // Updates the particle system
-        particleSystem->update(deltaTime);
+        {
+            PROFILE_SCOPE("Frame");
+
+            // Computes the delta time
+            const float currentTime = glfwGetTime();
+            const float deltaTime = currentTime - lastUpdate;
+            lastUpdate = currentTime;
+
+            // Checks for keyboard inputs
+            processKeyboardInput(window, deltaTime);
+
+            // Sets the particle system properties
+            setParticlesParameters();
+
+            // Updates the particle system, or the playback while a cache is open
+            if (cachePlayer->isOpen())
+                cachePlayer->update(deltaTime);
+            else
+                simulate(deltaTime);
+            const double simulationEnd = glfwGetTime();
+
+            // Upadtes the interface
+            updateInterface();
+            const double interfaceEnd = glfwGetTime();
+
+            // Renders everything
+            render();
+            const double renderEnd = glfwGetTime();
+
+            // Stores the CPU time of each phase
+            frameTimes.simulation = (simulationEnd - currentTime) * 1000.0f;
+            frameTimes.interface = (interfaceEnd - simulationEnd) * 1000.0f;
+            frameTimes.render = (renderEnd - interfaceEnd) * 1000.0f;
+            recordFrameTimes(deltaTime * 1000.0f);
+
+            // Check and call events
+            PROFILE_SCOPE("glfwPollEvents");
+            glfwPollEvents();
+        }
 
-        // Upadtes the interface
-        updateInterface();
+#ifdef ENABLE_PROFILER
+        // Starts or stops the profiler capture between frames
+        if (toggleProfilerCapture)
+        {
+            toggleProfilerCapture = false;
+            if (!Profiler::isCapturing())
+                Profiler::start();
+            else if (Profiler::stop(tracePath))
+                std::cout << "Profiler trace written to " << tracePath << std::endl;
+            else
+                std::cout << "ERROR:: Unable to write the profiler trace " << tracePath << std::endl;
+        }
+#endif
+    }
 
-        // Renders everything
-        render();
+    // Finishes the recordings still running when the window is closed
+    replayRecorder.stop();
+    cacheWriter.stop();
 
-        // Check and call events
-        glfwPollEvents();
-    }
+#ifdef ENABLE_PROFILER
+    // Writes the capture still running when the window is closed
+    if (Profiler::isCapturing())
+        Profiler::stop(tracePath);
+#endif
 }
 /**
  * App starting point
@@ -1031,6 +1352,8 @@ void update()
  */
 int main(int argc, char const *argv[])
 {
+    PROFILE_THREAD_NAME("Main");
+
     // Initialize all the app components
     if (!init())
     {
@@ -1046,18 +1369,30 @@ int main(int argc, char const *argv[])
     // Starts the app main loop
     update();
 
+    // Writes the frame times of the session
+    writeFrameTimes(frameTimesPath);
+
+    // Stops the cache decoder and deletes its instance buffer
+    delete cachePlayer;
     // Deletes the texture from the gpu
     glDeleteTextures(1, &textureID);
     // Deletes the vertex array from the GPU
     glDeleteVertexArrays(1, &VAO);
     // Deletes the vertex object from the GPU
     glDeleteBuffers(1, &VBO);
-    // Destroy the shader
+    // Destroy the shaders
     delete shader;
+    delete instancedShader;
+    delete analyticShader;
     // Deletes the camera
     delete camera;
-    // Deletes the particle system
+    // Deletes the particle system and its threads
     delete particleSystem;
+    delete simulationThreads;
+    // Writes the pending captured frames and deletes the frame capture
+    delete frameCapture;
+    // Deletes the render passes timer
+    delete gpuTimer;
 
     // Clear the interface
     ImGui_ImplOpenGL3_Shutdown();
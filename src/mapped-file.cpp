@@ -0,0 +1,136 @@
+#include "mapped-file.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+{
+    this->data = NULL;
+    this->size = 0;
+#ifdef _WIN32
+    this->file = INVALID_HANDLE_VALUE;
+    this->mapping = NULL;
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+    this->close();
+}
+
+#ifdef _WIN32
+bool MappedFile::open(const std::string &path)
+{
+    this->close();
+
+    this->file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (this->file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(this->file, &fileSize) || fileSize.QuadPart == 0)
+    {
+        this->close();
+        return false;
+    }
+
+    this->mapping = CreateFileMappingA(this->file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (this->mapping)
+        this->data = (const unsigned char *)MapViewOfFile(this->mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!this->data)
+    {
+        this->close();
+        return false;
+    }
+
+    this->size = (size_t)fileSize.QuadPart;
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (this->data)
+        UnmapViewOfFile(this->data);
+    if (this->mapping)
+        CloseHandle(this->mapping);
+    if (this->file != INVALID_HANDLE_VALUE)
+        CloseHandle(this->file);
+
+    this->data = NULL;
+    this->size = 0;
+    this->file = INVALID_HANDLE_VALUE;
+    this->mapping = NULL;
+}
+#else
+bool MappedFile::open(const std::string &path)
+{
+    this->close();
+
+    const int file = ::open(path.c_str(), O_RDONLY);
+    if (file < 0)
+        return false;
+
+    struct stat status;
+    if (fstat(file, &status) != 0 || status.st_size == 0)
+    {
+        ::close(file);
+        return false;
+    }
+
+    // The mapping keeps its own reference to the file
+    void *mapped = mmap(NULL, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    ::close(file);
+    if (mapped == MAP_FAILED)
+        return false;
+
+    this->data = (const unsigned char *)mapped;
+    this->size = (size_t)status.st_size;
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (this->data)
+        munmap((void *)this->data, this->size);
+
+    this->data = NULL;
+    this->size = 0;
+}
+#endif
+
+bool MappedFile::isOpen() const
+{
+    return this->data != NULL;
+}
+
+const unsigned char *MappedFile::getData() const
+{
+    return this->data;
+}
+
+size_t MappedFile::getSize() const
+{
+    return this->size;
+}
+
+long long getModificationTime(const std::string &path)
+{
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA attributes;
+    if (!GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &attributes))
+        return -1;
+    return (long long)attributes.ftLastWriteTime.dwHighDateTime << 32 | attributes.ftLastWriteTime.dwLowDateTime;
+#else
+    struct stat status;
+    if (stat(path.c_str(), &status) != 0)
+        return -1;
+    return (long long)status.st_mtime;
+#endif
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <string>
+
+/**
+ * Read only memory mapping of a whole file
+ * The pages are loaded by the OS when they're first read, so opening a big file is almost free
+ * and its data can be used in place without copies or parsing.
+*/
+class MappedFile
+{
+public:
+    MappedFile();
+    /**
+     * Unmaps the file
+    */
+    ~MappedFile();
+    /**
+     * Maps a file, a previously mapped file is unmapped
+     * @param path Path to the file
+     * @return The file was mapped
+    */
+    bool open(const std::string &path);
+    /**
+     * Unmaps the file
+    */
+    void close();
+    /**
+     * Checks if a file is mapped
+     * @return A file is mapped
+    */
+    bool isOpen() const;
+    /**
+     * Gets the mapped bytes
+     * @return First byte of the file, NULL if no file is mapped
+    */
+    const unsigned char *getData() const;
+    /**
+     * Gets the size of the mapped file
+     * @return Size in bytes
+    */
+    size_t getSize() const;
+
+private:
+    // Not copyable, the mapping is owned by one object
+    MappedFile(const MappedFile &);
+    MappedFile &operator=(const MappedFile &);
+
+    const unsigned char *data; // Mapped bytes
+    size_t size;               // Size of the mapped file
+#ifdef _WIN32
+    void *file;    // File handle
+    void *mapping; // File mapping handle
+#endif
+};
+
+/**
+ * Gets the last modification time of a file, the files cached by path are loaded again when it changes
+ * @param path Path to the file
+ * @return Modification time, only comparable with other times of this function, -1 if the file doesn't exist
+*/
+long long getModificationTime(const std::string &path);
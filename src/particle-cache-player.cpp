@@ -0,0 +1,330 @@
+#include "particle-cache-player.h"
+
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+
+#include <glad/glad.h>
+
+#include "profiler.h"
+
+// The position and the scale are read as a single vec4 instance attribute
+static_assert(offsetof(CachedParticle, scale) == offsetof(CachedParticle, position) + sizeof(glm::vec3),
+              "CachedParticle scale has to follow its position");
+
+ParticleCachePlayer::ParticleCachePlayer(unsigned int quadVBO)
+{
+    this->decodedFrame = -1;
+    this->quit = false;
+    this->busy = false;
+    this->requestedFrame = -1;
+    this->readyFrame = -1;
+    this->readyChanged = false;
+    this->shownFrame = -1;
+    this->instanceCount = 0;
+    this->instanceCapacity = 0;
+    this->playing = false;
+    this->looping = true;
+    this->playbackTime = 0.0f;
+    this->drawStatistics = DrawStatistics();
+
+    glGenVertexArrays(1, &this->quadVAO);
+    glGenBuffers(1, &this->instanceVBO);
+    glBindVertexArray(this->quadVAO);
+
+    // Quad geometry, same attributes as the particles geometry
+    glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)(3 * sizeof(float)));
+
+    // Instance attributes, read straight from the decoded particles
+    glBindBuffer(GL_ARRAY_BUFFER, this->instanceVBO);
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(CachedParticle), (void *)offsetof(CachedParticle, position));
+    glVertexAttribDivisor(2, 1);
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(CachedParticle), (void *)offsetof(CachedParticle, color));
+    glVertexAttribDivisor(3, 1);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // Starts the decoding thread
+    this->worker = std::thread(&ParticleCachePlayer::decodeFrames, this);
+}
+
+ParticleCachePlayer::~ParticleCachePlayer()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->quit = true;
+    }
+    this->requestChanged.notify_all();
+    this->worker.join();
+
+    glDeleteBuffers(1, &this->instanceVBO);
+    glDeleteVertexArrays(1, &this->quadVAO);
+}
+
+bool ParticleCachePlayer::open(const std::string &path)
+{
+    this->close();
+
+    if (!this->file.open(path))
+    {
+        std::cout << "Unable to open the particle cache " << path << std::endl;
+        return false;
+    }
+    if (!readCacheIndex(this->file.getData(), this->file.getSize(), this->index))
+    {
+        std::cout << "File " << path << " isn't a valid particle cache" << std::endl;
+        this->file.close();
+        return false;
+    }
+
+    this->seek(0);
+    return true;
+}
+
+void ParticleCachePlayer::close()
+{
+    // Cancels the request and waits until the worker stops reading the file
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->requestedFrame = -1;
+        this->readyFrame = -1;
+        this->readyChanged = false;
+        this->workerIdle.wait(lock, [this] { return !this->busy; });
+    }
+
+    // The worker is idle, its decoder can be reset
+    this->codec.reset();
+    this->decodedFrame = -1;
+
+    this->file.close();
+    this->index.clear();
+    this->shownFrame = -1;
+    this->instanceCount = 0;
+    this->playing = false;
+    this->playbackTime = 0.0f;
+}
+
+bool ParticleCachePlayer::isOpen()
+{
+    return this->file.isOpen();
+}
+
+void ParticleCachePlayer::update(float deltaTime)
+{
+    if (!this->isOpen() || !this->playing)
+        return;
+
+    // Moves to the last frame whose time was reached
+    this->playbackTime += deltaTime;
+    const int lastFrame = (int)this->index.size() - 1;
+    int frame = this->requestedFrame;
+    while (frame < lastFrame && this->getFrameTime(frame + 1) <= this->playbackTime)
+        frame++;
+
+    if (frame == lastFrame && this->playbackTime > this->getFrameTime(lastFrame))
+    {
+        if (this->looping)
+        {
+            frame = 0;
+            this->playbackTime = this->getFrameTime(0);
+        }
+        else
+            this->playing = false;
+    }
+
+    if (frame != this->requestedFrame)
+        this->request(frame);
+}
+
+void ParticleCachePlayer::seek(int frame)
+{
+    if (!this->isOpen())
+        return;
+
+    frame = glm::clamp(frame, 0, (int)this->index.size() - 1);
+    this->playbackTime = this->getFrameTime(frame);
+    this->request(frame);
+}
+
+void ParticleCachePlayer::setPlaying(bool playing)
+{
+    this->playing = playing && this->isOpen();
+}
+
+bool ParticleCachePlayer::isPlaying()
+{
+    return this->playing;
+}
+
+void ParticleCachePlayer::setLooping(bool loop)
+{
+    this->looping = loop;
+}
+
+bool ParticleCachePlayer::isLooping()
+{
+    return this->looping;
+}
+
+unsigned int ParticleCachePlayer::getFrameCount()
+{
+    return (unsigned int)this->index.size();
+}
+
+int ParticleCachePlayer::getRequestedFrame()
+{
+    return this->requestedFrame;
+}
+
+int ParticleCachePlayer::getShownFrame()
+{
+    return this->shownFrame;
+}
+
+float ParticleCachePlayer::getFrameTime(unsigned int frame)
+{
+    CacheFrameHeader header;
+    memcpy(&header, this->file.getData() + this->index[frame].offset, sizeof(header));
+    return header.time;
+}
+
+void ParticleCachePlayer::draw()
+{
+    PROFILE_SCOPE("ParticleCachePlayer::draw");
+
+    this->drawStatistics = DrawStatistics();
+    this->upload();
+    if (this->instanceCount == 0)
+        return;
+
+    // Every particle is drawn by a single call
+    glBindVertexArray(this->quadVAO);
+    glDrawArraysInstanced(GL_TRIANGLE_FAN, 0, 4, this->instanceCount);
+    glBindVertexArray(0);
+
+    this->drawStatistics.drawCalls = 1;
+    this->drawStatistics.instances = this->instanceCount;
+}
+
+const DrawStatistics &ParticleCachePlayer::getDrawStatistics()
+{
+    return this->drawStatistics;
+}
+
+void ParticleCachePlayer::request(int frame)
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->requestedFrame = frame;
+    }
+    this->requestChanged.notify_one();
+}
+
+void ParticleCachePlayer::upload()
+{
+    // Takes the newest decoded frame, the worker keeps decoding into its own buffer
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        if (!this->readyChanged)
+            return;
+        this->uploading.swap(this->ready);
+        this->shownFrame = this->readyFrame;
+        this->readyChanged = false;
+    }
+
+    PROFILE_SCOPE("ParticleCachePlayer::upload");
+
+    const size_t bytes = this->uploading.size() * sizeof(CachedParticle);
+    glBindBuffer(GL_ARRAY_BUFFER, this->instanceVBO);
+    if (bytes > this->instanceCapacity)
+    {
+        glBufferData(GL_ARRAY_BUFFER, bytes, this->uploading.data(), GL_STREAM_DRAW);
+        this->instanceCapacity = bytes;
+    }
+    else
+    {
+        // Orphans the buffer, so the upload doesn't wait for the draws still reading it
+        glBufferData(GL_ARRAY_BUFFER, this->instanceCapacity, NULL, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, this->uploading.data());
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    this->instanceCount = (unsigned int)this->uploading.size();
+    this->drawStatistics.bytesUploaded = bytes;
+}
+
+void ParticleCachePlayer::decodeFrames()
+{
+    PROFILE_THREAD_NAME("Cache decoder");
+
+    std::unique_lock<std::mutex> lock(this->mutex);
+    while (true)
+    {
+        this->requestChanged.wait(lock, [this] {
+            return this->quit || (this->requestedFrame >= 0 && this->requestedFrame != this->readyFrame);
+        });
+        if (this->quit)
+            return;
+
+        const int target = this->requestedFrame;
+        this->busy = true;
+        lock.unlock();
+
+        // Continues from the decoded frame when the target is ahead of it in the same chunk, otherwise
+        // starts on the keyframe of the target
+        int frame = (int)this->index[target].keyframe;
+        if (this->decodedFrame >= frame && this->decodedFrame < target)
+            frame = this->decodedFrame + 1;
+        else
+            this->codec.reset();
+
+        bool valid = true;
+        int lastDecoded = -1;
+        while (frame <= target)
+        {
+            PROFILE_SCOPE("Decode cache frame");
+
+            const CacheIndexEntry &entry = this->index[frame];
+            float time;
+            if (!this->codec.decode(this->file.getData() + entry.offset, entry.size, this->decoding, time))
+            {
+                valid = false;
+                break;
+            }
+            this->decodedFrame = lastDecoded = frame++;
+
+            // A new request stops the decode, the decoded frames aren't lost
+            lock.lock();
+            const bool newRequest = this->requestedFrame != target;
+            lock.unlock();
+            if (newRequest)
+                break;
+        }
+
+        lock.lock();
+        this->busy = false;
+        if (!valid)
+        {
+            // Marks the frame as done, so a corrupted frame isn't decoded again until requested again
+            std::cout << "Particle cache frame " << frame << " corrupted" << std::endl;
+            this->codec.reset();
+            this->decodedFrame = -1;
+            this->readyFrame = target;
+        }
+        // Shows the decoded frame if it was requested or the request is still ahead of it (playback)
+        else if (lastDecoded >= 0 && this->requestedFrame >= 0 && (lastDecoded == target || this->requestedFrame > lastDecoded))
+        {
+            this->ready.swap(this->decoding);
+            this->readyFrame = lastDecoded;
+            this->readyChanged = true;
+        }
+        this->workerIdle.notify_all();
+    }
+}
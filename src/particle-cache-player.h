@@ -0,0 +1,155 @@
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "mapped-file.h"
+#include "particle-cache.h"
+#include "particle-system.h"
+
+/**
+ * Plays back particle caches
+ * The cache is memory mapped and its index read at once, so any frame is found in constant time.
+ * A worker thread decodes the requested frame, starting from its keyframe or continuing from the
+ * last decoded frame, into an instance buffer. The render thread uploads the newest decoded frame
+ * and draws it with a single instanced draw call, it never waits for the decoder.
+ * The decoded frames are triple buffered: the worker decodes into one, the last decoded frame waits
+ * in another and the render thread uploads from the third.
+*/
+class ParticleCachePlayer
+{
+public:
+    /**
+     * Creates the player and its instance buffer
+     * @param quadVBO Vertex buffer of the particle quad (position and color)
+    */
+    ParticleCachePlayer(unsigned int quadVBO);
+    /**
+     * Stops the worker and deletes the instance buffer
+    */
+    ~ParticleCachePlayer();
+    /**
+     * Opens a cache and requests its first frame, the open cache is closed
+     * @param path Path to the cache file
+     * @return The file is a valid particle cache
+    */
+    bool open(const std::string &path);
+    /**
+     * Closes the cache
+    */
+    void close();
+    /**
+     * Checks if a cache is open
+     * @return A cache is open
+    */
+    bool isOpen();
+    /**
+     * Advances the playback
+     * @param deltaTime Time since the last update in seconds
+    */
+    void update(float deltaTime);
+    /**
+     * Requests a frame, it's shown once decoded
+     * @param frame Frame number, clamped to the cache frames
+    */
+    void seek(int frame);
+    /**
+     * Starts or pauses the playback
+     * @param playing The playback runs
+    */
+    void setPlaying(bool playing);
+    /**
+     * Checks if the playback runs
+     * @return The playback runs
+    */
+    bool isPlaying();
+    /**
+     * Sets if the playback starts again after the last frame
+     * @param loop The playback loops
+    */
+    void setLooping(bool loop);
+    /**
+     * Checks if the playback loops
+     * @return The playback loops
+    */
+    bool isLooping();
+    /**
+     * Gets the number of frames of the cache
+     * @return Number of frames
+    */
+    unsigned int getFrameCount();
+    /**
+     * Gets the last requested frame
+     * @return Frame number
+    */
+    int getRequestedFrame();
+    /**
+     * Gets the frame in the instance buffer
+     * @return Frame number, -1 if none was uploaded
+    */
+    int getShownFrame();
+    /**
+     * Gets the simulated time of a frame, read from its header
+     * @param frame Frame number
+     * @return Time in seconds
+    */
+    float getFrameTime(unsigned int frame);
+    /**
+     * Uploads the newest decoded frame and draws it
+     * The instanced particles shader has to be in use, with the camera and texture uniforms set
+    */
+    void draw();
+    /**
+     * Gets the counters of the last draw
+     * @return Draw statistics
+    */
+    const DrawStatistics &getDrawStatistics();
+
+private:
+    /**
+     * Worker loop, decodes the requested frames until the player is destroyed
+    */
+    void decodeFrames();
+    /**
+     * Hands a frame to the worker
+     * @param frame Frame number
+    */
+    void request(int frame);
+    /**
+     * Copies the newest decoded frame to the instance buffer
+    */
+    void upload();
+
+    MappedFile file;                    // Mapped cache file
+    std::vector<CacheIndexEntry> index; // Where each frame is
+    ParticleCacheCodec codec;           // Decoder, only used by the worker
+    int decodedFrame;                   // Frame held by the codec, only used by the worker
+
+    std::thread worker;                     // Decoding thread
+    std::mutex mutex;                       // Protects the request and the ready frame
+    std::condition_variable requestChanged; // Signaled when a frame is requested or the worker has to quit
+    std::condition_variable workerIdle;     // Signaled when the worker stops decoding
+    bool quit;                              // The worker has to finish
+    bool busy;                              // The worker is decoding, it reads the mapped file
+    int requestedFrame;                     // Frame to be decoded, -1 if none
+    std::vector<CachedParticle> decoding;   // Frame being decoded
+    std::vector<CachedParticle> ready;      // Newest decoded frame
+    int readyFrame;                         // Frame number of the ready frame, -1 if none
+    bool readyChanged;                      // The ready frame wasn't uploaded yet
+
+    std::vector<CachedParticle> uploading; // Frame being uploaded by the render thread
+    int shownFrame;                        // Frame in the instance buffer
+    unsigned int instanceCount;            // Particles in the instance buffer
+    size_t instanceCapacity;               // Size of the instance buffer in bytes
+
+    bool playing;       // The playback runs
+    bool looping;       // The playback starts again after the last frame
+    float playbackTime; // Simulated time being played
+
+    unsigned int quadVAO;          // Quad geometry with the instance attributes
+    unsigned int instanceVBO;      // Instance buffer, CachedParticle each
+    DrawStatistics drawStatistics; // Counters of the last draw
+};
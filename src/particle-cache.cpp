@@ -0,0 +1,703 @@
+#include "particle-cache.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#include "profiler.h"
+
+namespace
+{
+const char cacheMagic[8] = {'P', 'C', 'A', 'C', 'H', 'E', '\0', '\0'};
+const unsigned int cacheVersion = 1;
+const int maxPositionLevel = 65535;
+const int maxScaleLevel = 65535;
+// Packed differences, positions in [-2, 2] (5^3 codes) and scale and color in [-1, 1] (3^5 codes)
+const int positionEscape = 125;
+const int attributesEscape = 255;
+// Largest particle record: both escapes, 3 bytes per position or scale difference (17 bits zigzag)
+// and 2 bytes per color difference
+const size_t maxRecordSize = 1 + 3 * 3 + 1 + 3 + 4 * 2;
+// Particles read from the particle system at once
+const unsigned int readChunkSize = 4096;
+
+/**
+ * Quantizes a value inside a range
+ * @param value Value to be quantized
+ * @param min Start of the range
+ * @param levels Number of levels per unit of the range
+ * @param maxLevel Highest level
+ * @return Level of the value
+*/
+int quantize(float value, float min, float levels, int maxLevel)
+{
+    // Rounds by truncation once the level is known to be positive, floor is a library call on plain x86-64
+    const float level = (value - min) * levels + 0.5f;
+    if (!(level > 0.0f))
+        return 0;
+    return level >= (float)maxLevel ? maxLevel : (int)level;
+}
+
+/**
+ * Writes an unsigned value as a LEB128 varint (7 bits per byte)
+ * @param output Where the value is written, it's advanced
+ * @param value Value to be written
+*/
+void writeVarint(unsigned char *&output, unsigned int value)
+{
+    while (value >= 0x80)
+    {
+        *output++ = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    *output++ = (unsigned char)value;
+}
+
+/**
+ * Writes a signed value as a zigzag varint, small magnitudes take one byte
+*/
+void writeSigned(unsigned char *&output, int value)
+{
+    writeVarint(output, ((unsigned int)value << 1) ^ (unsigned int)(value >> 31));
+}
+
+/**
+ * Reads a LEB128 varint
+ * @param data Next byte to be read, it's advanced
+ * @param end End of the data
+ * @param value Where the value is stored
+ * @return The value is complete
+*/
+bool readVarint(const unsigned char *&data, const unsigned char *end, unsigned int &value)
+{
+    value = 0;
+    for (unsigned int shift = 0; shift < 35; shift += 7)
+    {
+        if (data >= end)
+            return false;
+        const unsigned char byte = *data++;
+        value |= (unsigned int)(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+/**
+ * Reads a zigzag varint
+*/
+bool readSigned(const unsigned char *&data, const unsigned char *end, int &value)
+{
+    unsigned int encoded;
+    if (!readVarint(data, end, encoded))
+        return false;
+    value = (int)(encoded >> 1) ^ -(int)(encoded & 1);
+    return true;
+}
+
+/**
+ * Quantization of a frame, computed the same way by the encoder and the decoder
+*/
+struct FrameQuantization
+{
+    glm::vec3 min;     // Bounding box start
+    glm::vec3 levels;  // Levels per unit on each axis
+    glm::vec3 step;    // Size of a level on each axis
+    float minScale;    // Scale range start
+    float scaleLevels; // Levels per scale unit
+    float scaleStep;   // Size of a scale level
+
+    FrameQuantization(const CacheFrameHeader &header)
+    {
+        for (int axis = 0; axis < 3; axis++)
+        {
+            const float size = header.boundsMax[axis] - header.boundsMin[axis];
+            this->min[axis] = header.boundsMin[axis];
+            this->levels[axis] = size > 0.0f ? maxPositionLevel / size : 0.0f;
+            this->step[axis] = size / maxPositionLevel;
+        }
+        const float scaleSize = header.maxScale - header.minScale;
+        this->minScale = header.minScale;
+        this->scaleLevels = scaleSize > 0.0f ? maxScaleLevel / scaleSize : 0.0f;
+        this->scaleStep = scaleSize / maxScaleLevel;
+    }
+};
+
+/**
+ * Quantized values of a particle: position (0-2), scale (3) and color (4-7)
+*/
+struct ParticleLevels
+{
+    int values[8];
+};
+
+/**
+ * Predicts the quantized values of a particle present in the previous frame
+ * @param previous Particle in the previous frame
+ * @param velocity Position change of the particle over the last frame
+ * @param scaleVelocity Scale change of the particle over the last frame
+ * @param colorVelocity Color change of the particle over the last frame
+ * @param quantization Quantization of the frame being coded
+ * @param prediction Where the predicted values are stored
+*/
+void predict(const CachedParticle &previous, const glm::vec3 &velocity, float scaleVelocity, const int *colorVelocity,
+                    const FrameQuantization &quantization, ParticleLevels &prediction)
+{
+    for (int axis = 0; axis < 3; axis++)
+        prediction.values[axis] = quantize(previous.position[axis] + velocity[axis], quantization.min[axis], quantization.levels[axis], maxPositionLevel);
+    prediction.values[3] = quantize(previous.scale + scaleVelocity, quantization.minScale, quantization.scaleLevels, maxScaleLevel);
+    for (int channel = 0; channel < 4; channel++)
+        prediction.values[4 + channel] = glm::clamp((int)previous.color[channel] + colorVelocity[channel], 0, 255);
+}
+} // namespace
+
+bool readCacheIndex(const unsigned char *data, size_t size, std::vector<CacheIndexEntry> &index)
+{
+    CacheFileHeader header;
+    if (size < sizeof(CacheFileHeader))
+        return false;
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) != 0 || header.version != cacheVersion ||
+        header.headerSize != sizeof(CacheFileHeader) || header.frameCount == 0 || header.indexOffset > size ||
+        (size - header.indexOffset) / sizeof(CacheIndexEntry) < header.frameCount)
+        return false;
+
+    // Copied, the index offset isn't aligned
+    index.resize(header.frameCount);
+    memcpy(index.data(), data + header.indexOffset, header.frameCount * sizeof(CacheIndexEntry));
+
+    // Every frame is between the header and the index, and it's decoded from a keyframe before it
+    for (unsigned int frame = 0; frame < header.frameCount; frame++)
+    {
+        const CacheIndexEntry &entry = index[frame];
+        if (entry.offset < sizeof(CacheFileHeader) || entry.offset > header.indexOffset ||
+            entry.size < sizeof(CacheFrameHeader) || entry.size > header.indexOffset - entry.offset ||
+            entry.keyframe > frame || index[entry.keyframe].keyframe != entry.keyframe)
+        {
+            index.clear();
+            return false;
+        }
+    }
+    return true;
+}
+
+ParticleCacheCodec::ParticleCacheCodec()
+{
+    this->hasPrevious = false;
+}
+
+void ParticleCacheCodec::reset()
+{
+    this->previous.clear();
+    this->previousTracks.clear();
+    this->hasPrevious = false;
+}
+
+void ParticleCacheCodec::encode(const std::vector<CachedParticle> &particles, float time, bool keyframe, std::vector<unsigned char> &output)
+{
+    PROFILE_SCOPE("ParticleCacheCodec::encode");
+
+    CacheFrameHeader header;
+    memset(&header, 0, sizeof(header));
+    header.particleCount = (unsigned int)particles.size();
+    header.keyframe = keyframe || !this->hasPrevious;
+    header.time = time;
+
+    // Bounding box and scale range of the frame
+    glm::vec3 boundsMin(0.0f), boundsMax(0.0f);
+    float minScale = 0.0f, maxScale = 0.0f;
+    for (size_t i = 0; i < particles.size(); i++)
+    {
+        boundsMin = i == 0 ? particles[i].position : glm::min(boundsMin, particles[i].position);
+        boundsMax = i == 0 ? particles[i].position : glm::max(boundsMax, particles[i].position);
+        minScale = i == 0 ? particles[i].scale : std::min(minScale, particles[i].scale);
+        maxScale = i == 0 ? particles[i].scale : std::max(maxScale, particles[i].scale);
+    }
+    for (int axis = 0; axis < 3; axis++)
+    {
+        header.boundsMin[axis] = boundsMin[axis];
+        header.boundsMax[axis] = boundsMax[axis];
+    }
+    header.minScale = minScale;
+    header.maxScale = maxScale;
+    const FrameQuantization quantization(header);
+
+    // Runs of consecutive ids, the ids of the alive particles are mostly consecutive
+    this->runs.clear();
+    unsigned int runEnd = 0;
+    for (size_t i = 0; i < particles.size(); i++)
+    {
+        if (i > 0 && particles[i].id == runEnd)
+            this->runs.back()++;
+        else
+        {
+            this->runs.push_back(particles[i].id - runEnd);
+            this->runs.push_back(1);
+        }
+        runEnd = particles[i].id + 1;
+    }
+    // The frame is written in place, the output is grown to the largest possible frame and trimmed after
+    const size_t headerOffset = output.size();
+    const size_t payloadOffset = headerOffset + sizeof(CacheFrameHeader);
+    output.resize(payloadOffset + (this->runs.size() + 1) * 5 + particles.size() * maxRecordSize);
+    unsigned char *payload = output.data() + payloadOffset;
+
+    writeVarint(payload, (unsigned int)this->runs.size() / 2);
+    for (size_t i = 0; i < this->runs.size(); i++)
+        writeVarint(payload, this->runs[i]);
+
+    std::vector<CachedParticle> &current = this->current;
+    current.resize(particles.size());
+    this->tracks.resize(particles.size());
+
+    size_t previousIndex = 0;
+    for (size_t i = 0; i < particles.size(); i++)
+    {
+        const CachedParticle &particle = particles[i];
+        CachedParticle &decoded = current[i];
+        Track &track = this->tracks[i];
+
+        ParticleLevels levels;
+        for (int axis = 0; axis < 3; axis++)
+            levels.values[axis] = quantize(particle.position[axis], quantization.min[axis], quantization.levels[axis], maxPositionLevel);
+        levels.values[3] = quantize(particle.scale, quantization.minScale, quantization.scaleLevels, maxScaleLevel);
+        for (int channel = 0; channel < 4; channel++)
+            levels.values[4 + channel] = particle.color[channel];
+
+        // Finds the particle in the previous frame, both lists are sorted by id
+        while (!header.keyframe && previousIndex < this->previous.size() && this->previous[previousIndex].id < particle.id)
+            previousIndex++;
+        const bool tracked = !header.keyframe && previousIndex < this->previous.size() && this->previous[previousIndex].id == particle.id;
+
+        if (tracked)
+        {
+            const Track &previousTrack = this->previousTracks[previousIndex];
+            ParticleLevels prediction;
+            predict(this->previous[previousIndex], previousTrack.velocity, previousTrack.scaleVelocity, previousTrack.colorVelocity,
+                    quantization, prediction);
+
+            int differences[8];
+            bool smallPosition = true, smallAttributes = true;
+            for (int value = 0; value < 8; value++)
+            {
+                differences[value] = levels.values[value] - prediction.values[value];
+                if (value < 3)
+                    smallPosition = smallPosition && differences[value] >= -2 && differences[value] <= 2;
+                else
+                    smallAttributes = smallAttributes && differences[value] >= -1 && differences[value] <= 1;
+            }
+
+            if (smallPosition)
+                *payload++ = (unsigned char)((differences[0] + 2) + 5 * (differences[1] + 2) + 25 * (differences[2] + 2));
+            else
+            {
+                *payload++ = positionEscape;
+                for (int value = 0; value < 3; value++)
+                    writeSigned(payload, differences[value]);
+            }
+
+            if (smallAttributes)
+            {
+                int code = 0;
+                for (int value = 7; value >= 3; value--)
+                    code = code * 3 + differences[value] + 1;
+                *payload++ = (unsigned char)code;
+            }
+            else
+            {
+                *payload++ = attributesEscape;
+                for (int value = 3; value < 8; value++)
+                    writeSigned(payload, differences[value]);
+            }
+        }
+        else
+        {
+            for (int value = 0; value < 4; value++)
+                writeVarint(payload, levels.values[value]);
+            for (int channel = 0; channel < 4; channel++)
+                *payload++ = particle.color[channel];
+        }
+
+        // Values seen by the decoder
+        decoded.id = particle.id;
+        for (int axis = 0; axis < 3; axis++)
+            decoded.position[axis] = quantization.min[axis] + levels.values[axis] * quantization.step[axis];
+        decoded.scale = quantization.minScale + levels.values[3] * quantization.scaleStep;
+        for (int channel = 0; channel < 4; channel++)
+            decoded.color[channel] = particle.color[channel];
+
+        const CachedParticle *previousParticle = tracked ? &this->previous[previousIndex] : &decoded;
+        track.velocity = decoded.position - previousParticle->position;
+        track.scaleVelocity = decoded.scale - previousParticle->scale;
+        for (int channel = 0; channel < 4; channel++)
+            track.colorVelocity[channel] = (int)decoded.color[channel] - (int)previousParticle->color[channel];
+    }
+
+    header.payloadSize = (unsigned int)(payload - (output.data() + payloadOffset));
+    output.resize(payloadOffset + header.payloadSize);
+    memcpy(&output[headerOffset], &header, sizeof(header));
+
+    this->previous.swap(this->current);
+    this->previousTracks.swap(this->tracks);
+    this->hasPrevious = true;
+}
+
+bool ParticleCacheCodec::decode(const unsigned char *data, size_t size, std::vector<CachedParticle> &particles, float &time)
+{
+    PROFILE_SCOPE("ParticleCacheCodec::decode");
+
+    if (size < sizeof(CacheFrameHeader))
+        return false;
+
+    CacheFrameHeader header;
+    memcpy(&header, data, sizeof(header));
+    if (sizeof(CacheFrameHeader) + (size_t)header.payloadSize > size || (!header.keyframe && !this->hasPrevious))
+        return false;
+    const FrameQuantization quantization(header);
+
+    const unsigned char *payload = data + sizeof(CacheFrameHeader);
+    const unsigned char *end = payload + header.payloadSize;
+
+    // Every particle takes at least 2 bytes, a corrupted count can't allocate more than the payload allows
+    if (header.particleCount > header.payloadSize / 2)
+        return false;
+    particles.resize(header.particleCount);
+    this->tracks.resize(header.particleCount);
+
+    // Expands the id runs
+    unsigned int numberOfRuns;
+    if (!readVarint(payload, end, numberOfRuns) || numberOfRuns > header.particleCount)
+        return false;
+    size_t particle = 0;
+    unsigned int runEnd = 0;
+    for (unsigned int i = 0; i < numberOfRuns; i++)
+    {
+        unsigned int gap, length;
+        if (!readVarint(payload, end, gap) || !readVarint(payload, end, length) || length > particles.size() - particle)
+            return false;
+        for (unsigned int j = 0; j < length; j++)
+            particles[particle++].id = runEnd + gap + j;
+        runEnd += gap + length;
+    }
+    if (particle != particles.size())
+        return false;
+
+    size_t previousIndex = 0;
+    for (size_t i = 0; i < particles.size(); i++)
+    {
+        CachedParticle &decoded = particles[i];
+        Track &track = this->tracks[i];
+
+        while (!header.keyframe && previousIndex < this->previous.size() && this->previous[previousIndex].id < decoded.id)
+            previousIndex++;
+        const bool tracked = !header.keyframe && previousIndex < this->previous.size() && this->previous[previousIndex].id == decoded.id;
+
+        ParticleLevels levels;
+        if (tracked)
+        {
+            const Track &previousTrack = this->previousTracks[previousIndex];
+            predict(this->previous[previousIndex], previousTrack.velocity, previousTrack.scaleVelocity, previousTrack.colorVelocity,
+                    quantization, levels);
+
+            if (payload + 2 > end)
+                return false;
+
+            int differences[8];
+            int code = *payload++;
+            if (code == positionEscape)
+            {
+                for (int value = 0; value < 3; value++)
+                    if (!readSigned(payload, end, differences[value]))
+                        return false;
+            }
+            else
+            {
+                for (int value = 0; value < 3; value++, code /= 5)
+                    differences[value] = code % 5 - 2;
+            }
+
+            if (payload >= end)
+                return false;
+            code = *payload++;
+            if (code == attributesEscape)
+            {
+                for (int value = 3; value < 8; value++)
+                    if (!readSigned(payload, end, differences[value]))
+                        return false;
+            }
+            else
+            {
+                for (int value = 3; value < 8; value++, code /= 3)
+                    differences[value] = code % 3 - 1;
+            }
+
+            for (int value = 0; value < 8; value++)
+                levels.values[value] += differences[value];
+        }
+        else
+        {
+            for (int value = 0; value < 4; value++)
+            {
+                unsigned int level;
+                if (!readVarint(payload, end, level))
+                    return false;
+                levels.values[value] = (int)level;
+            }
+            if (payload + 4 > end)
+                return false;
+            for (int channel = 0; channel < 4; channel++)
+                levels.values[4 + channel] = *payload++;
+        }
+
+        for (int axis = 0; axis < 3; axis++)
+            decoded.position[axis] = quantization.min[axis] + levels.values[axis] * quantization.step[axis];
+        decoded.scale = quantization.minScale + levels.values[3] * quantization.scaleStep;
+        for (int channel = 0; channel < 4; channel++)
+            decoded.color[channel] = (unsigned char)levels.values[4 + channel];
+
+        const CachedParticle *previousParticle = tracked ? &this->previous[previousIndex] : &decoded;
+        track.velocity = decoded.position - previousParticle->position;
+        track.scaleVelocity = decoded.scale - previousParticle->scale;
+        for (int channel = 0; channel < 4; channel++)
+            track.colorVelocity[channel] = (int)decoded.color[channel] - (int)previousParticle->color[channel];
+    }
+
+    time = header.time;
+    this->previous = particles;
+    this->previousTracks.swap(this->tracks);
+    this->hasPrevious = true;
+    return true;
+}
+
+/**
+ * Sorts particles by id
+ * The particles are recycled in a ring, so their ids are usually sorted starting from the oldest one
+ * and rotating them is enough
+ * @param particles Particles to be sorted
+*/
+static void sortById(std::vector<CachedParticle> &particles)
+{
+    PROFILE_SCOPE("sortById");
+
+    const auto byId = [](const CachedParticle &a, const CachedParticle &b) { return a.id < b.id; };
+    std::vector<CachedParticle>::iterator oldest = std::is_sorted_until(particles.begin(), particles.end(), byId);
+    if (oldest == particles.end())
+        return;
+
+    std::rotate(particles.begin(), oldest, particles.end());
+    if (!std::is_sorted(particles.begin(), particles.end(), byId))
+        std::sort(particles.begin(), particles.end(), byId);
+}
+
+ParticleCacheWriter::ParticleCacheWriter(unsigned int keyframeInterval, unsigned int maxPendingFrames)
+    : jobs(maxPendingFrames)
+{
+    this->keyframeInterval = keyframeInterval > 0 ? keyframeInterval : 1;
+    this->fileOffset = 0;
+    this->recording = false;
+    this->framesRecorded = 0;
+    this->framesWritten = 0;
+    this->bytesWritten = 0;
+
+    // Starts the encoding thread
+    this->worker = std::thread(&ParticleCacheWriter::writeFrames, this);
+}
+
+ParticleCacheWriter::~ParticleCacheWriter()
+{
+    // Writes the frames not written yet and stops the worker
+    this->stop();
+    this->jobs.close();
+    this->worker.join();
+}
+
+bool ParticleCacheWriter::start(const std::string &path)
+{
+    // Finishes the previous cache
+    this->stop();
+
+    this->file.open(path.c_str(), std::ios::binary | std::ios::trunc);
+    if (!this->file)
+    {
+        std::cout << "Unable to write the particle cache " << path << std::endl;
+        return false;
+    }
+
+    // The header is written again with the frame count and the index offset when the recording stops
+    CacheFileHeader header;
+    memset(&header, 0, sizeof(header));
+    this->file.write((const char *)&header, sizeof(header));
+
+    this->codec.reset();
+    this->chunk.clear();
+    this->index.clear();
+    this->fileOffset = sizeof(CacheFileHeader);
+    this->framesRecorded = 0;
+    {
+        std::lock_guard<std::mutex> lock(this->writtenMutex);
+        this->framesWritten = 0;
+        this->bytesWritten = sizeof(CacheFileHeader);
+    }
+    this->recording = true;
+    return true;
+}
+
+void ParticleCacheWriter::stop()
+{
+    if (!this->recording)
+        return;
+
+    // Waits until the worker has encoded every frame
+    {
+        std::unique_lock<std::mutex> lock(this->writtenMutex);
+        this->writtenChanged.wait(lock, [this] { return this->framesWritten >= this->framesRecorded; });
+    }
+    this->recording = false;
+
+    // The worker is idle, the last chunk, the index and the header are written here
+    this->writeChunk();
+
+    CacheFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+    header.version = cacheVersion;
+    header.headerSize = sizeof(CacheFileHeader);
+    header.frameCount = (unsigned int)this->index.size();
+    header.keyframeInterval = this->keyframeInterval;
+    header.indexOffset = this->fileOffset;
+
+    if (!this->index.empty())
+        this->file.write((const char *)this->index.data(), this->index.size() * sizeof(CacheIndexEntry));
+    this->file.seekp(0);
+    this->file.write((const char *)&header, sizeof(header));
+    if (!this->file)
+        std::cout << "Unable to write the particle cache index" << std::endl;
+    this->file.close();
+}
+
+void ParticleCacheWriter::record(ParticleSystem *particleSystem, float time)
+{
+    if (!this->recording)
+        return;
+
+    PROFILE_SCOPE("ParticleCacheWriter::record");
+
+    FrameJob job;
+    // Reuses the memory of an already written frame
+    {
+        std::lock_guard<std::mutex> lock(this->freeBuffersMutex);
+        if (!this->freeBuffers.empty())
+        {
+            job.particles = std::move(this->freeBuffers.back());
+            this->freeBuffers.pop_back();
+        }
+    }
+    job.particles.clear();
+    job.time = time;
+
+    // Only the render state is copied, the worker does the rest. The particles are read a chunk at a time
+    const unsigned int numberOfParticles = particleSystem->getMaxAmountOfParticles();
+    std::vector<Particle> buffer(std::min(readChunkSize, numberOfParticles));
+    job.particles.resize(numberOfParticles);
+    size_t alive = 0;
+    for (unsigned int first = 0; first < numberOfParticles; first += readChunkSize)
+    {
+        const unsigned int count = std::min(readChunkSize, numberOfParticles - first);
+        const Particle *particles = particleSystem->getParticles(first, count, buffer.data());
+        for (unsigned int i = 0; i < count; i++)
+        {
+            if (!particles[i].isAlive())
+                continue;
+
+            CachedParticle &cached = job.particles[alive++];
+            cached.position = particles[i].getPosition();
+            cached.scale = particles[i].getScale();
+            const glm::vec4 color = glm::clamp(particles[i].getColor(), 0.0f, 1.0f) * 255.0f + 0.5f;
+            for (int channel = 0; channel < 4; channel++)
+                cached.color[channel] = (unsigned char)color[channel];
+            cached.id = particles[i].getId();
+        }
+    }
+    job.particles.resize(alive);
+
+    // Hands the frame to the worker, waits if it's behind (backpressure, frames aren't dropped)
+    this->framesRecorded++;
+    this->jobs.push(std::move(job));
+}
+
+bool ParticleCacheWriter::isRecording()
+{
+    return this->recording;
+}
+
+unsigned int ParticleCacheWriter::getFramesRecorded()
+{
+    return this->framesRecorded;
+}
+
+unsigned int ParticleCacheWriter::getFramesWritten()
+{
+    std::lock_guard<std::mutex> lock(this->writtenMutex);
+    return this->framesWritten;
+}
+
+unsigned long long ParticleCacheWriter::getBytesWritten()
+{
+    std::lock_guard<std::mutex> lock(this->writtenMutex);
+    return this->bytesWritten;
+}
+
+void ParticleCacheWriter::writeFrames()
+{
+    PROFILE_THREAD_NAME("Cache encoder");
+    FrameJob job;
+
+    while (this->jobs.pop(job))
+    {
+        PROFILE_SCOPE("Encode cache frame");
+
+        // The codec matches the particles of consecutive frames by id
+        sortById(job.particles);
+
+        const unsigned int frame = (unsigned int)this->index.size();
+        CacheIndexEntry entry;
+        entry.offset = this->fileOffset + this->chunk.size();
+        entry.keyframe = frame - frame % this->keyframeInterval;
+
+        const size_t start = this->chunk.size();
+        this->codec.encode(job.particles, job.time, frame % this->keyframeInterval == 0, this->chunk);
+        entry.size = (unsigned int)(this->chunk.size() - start);
+        this->index.push_back(entry);
+
+        // A chunk is written at once, when its last frame is encoded
+        if ((frame + 1) % this->keyframeInterval == 0)
+            this->writeChunk();
+
+        // Gives the frame memory back to be reused
+        {
+            std::lock_guard<std::mutex> lock(this->freeBuffersMutex);
+            this->freeBuffers.push_back(std::move(job.particles));
+        }
+        {
+            std::lock_guard<std::mutex> lock(this->writtenMutex);
+            this->framesWritten++;
+        }
+        this->writtenChanged.notify_all();
+    }
+}
+
+void ParticleCacheWriter::writeChunk()
+{
+    if (this->chunk.empty())
+        return;
+
+    PROFILE_SCOPE("Write cache chunk");
+    this->file.write((const char *)this->chunk.data(), this->chunk.size());
+    this->fileOffset += this->chunk.size();
+    {
+        std::lock_guard<std::mutex> lock(this->writtenMutex);
+        this->bytesWritten += this->chunk.size();
+    }
+    this->chunk.clear();
+}
@@ -0,0 +1,241 @@
+#pragma once
+
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "bounded-queue.h"
+#include "particle-system.h"
+
+/**
+ * Particle caches store the render state (position, scale and color) of every alive particle on each
+ * recorded frame, so an effect can be analysed or played back without simulating it again.
+ *
+ * File layout:
+ *   CacheFileHeader
+ *   Chunks, a keyframe followed by keyframeInterval - 1 delta frames, each frame is:
+ *     CacheFrameHeader
+ *     Payload, the id runs and one record per particle sorted by id
+ *   CacheIndexEntry per frame
+ *
+ * Positions are quantized to 16 bits inside the frame bounding box, scales to 16 bits inside the
+ * frame scale range and colors to 8 bits. The ids are stored as runs of consecutive ids.
+ * Delta frames store, for the particles already present in the previous frame (same id), the
+ * difference against a prediction that extrapolates the last change of each value. Particles move
+ * and fade almost linearly so the differences are tiny: the position differences are packed in one
+ * byte and the scale and color differences in another, larger differences are escaped.
+ * New particles and keyframes store the quantized values.
+ * The data is stored in the native byte order.
+*/
+
+/**
+ * Render state of a cached particle
+ * Position, scale and color come first so an array of them can be used as instance data
+*/
+struct CachedParticle
+{
+    glm::vec3 position;     // Particle's position
+    float scale;            // Particle's scale
+    unsigned char color[4]; // Particle's color and alpha (0-255)
+    unsigned int id;        // Particle's identifier
+};
+
+/**
+ * First bytes of a particle cache file
+*/
+struct CacheFileHeader
+{
+    char magic[8];                  // "PCACHE\0\0"
+    unsigned int version;           // Format version
+    unsigned int headerSize;        // sizeof(CacheFileHeader)
+    unsigned int frameCount;        // Number of frames
+    unsigned int keyframeInterval;  // Frames per chunk
+    unsigned long long indexOffset; // Offset of the frame index
+};
+
+/**
+ * Fixed part of an encoded frame
+*/
+struct CacheFrameHeader
+{
+    unsigned int particleCount; // Number of particles of the frame
+    unsigned int keyframe;      // The frame doesn't depend on the previous one
+    float time;                 // Simulated time of the frame in seconds
+    float boundsMin[3];         // Bounding box of the positions
+    float boundsMax[3];
+    float minScale;             // Range of the scales
+    float maxScale;
+    unsigned int payloadSize;   // Size of the particle records
+};
+
+/**
+ * Index entry of a frame
+*/
+struct CacheIndexEntry
+{
+    unsigned long long offset; // Offset of the frame header
+    unsigned int size;         // Size of the frame, header and payload
+    unsigned int keyframe;     // Number of the keyframe the frame is decoded from
+};
+
+/**
+ * Reads and validates the index of a particle cache
+ * @param data Cache file
+ * @param size Size of the cache file
+ * @param index Where the index entries are stored, one per frame
+ * @return The file is a valid particle cache with at least one frame
+*/
+bool readCacheIndex(const unsigned char *data, size_t size, std::vector<CacheIndexEntry> &index);
+
+/**
+ * Encodes and decodes the frames of a particle cache
+ * The frames have to be encoded and decoded in order, starting on a keyframe, the codec keeps the
+ * previous frame to predict the next one. Encoding uses the decoded values, so both sides predict
+ * exactly the same.
+*/
+class ParticleCacheCodec
+{
+public:
+    ParticleCacheCodec();
+    /**
+     * Forgets the previous frame, the next one has to be a keyframe
+    */
+    void reset();
+    /**
+     * Encodes a frame
+     * @param particles Particles of the frame, sorted by id
+     * @param time Simulated time of the frame
+     * @param keyframe The frame doesn't depend on the previous one
+     * @param output Where the frame is appended (header and payload)
+    */
+    void encode(const std::vector<CachedParticle> &particles, float time, bool keyframe, std::vector<unsigned char> &output);
+    /**
+     * Decodes a frame
+     * @param data Encoded frame (header and payload)
+     * @param size Size of the encoded frame
+     * @param particles Where the particles of the frame are stored, sorted by id
+     * @param time Where the simulated time of the frame is stored
+     * @return The frame is valid and it could be decoded (delta frames need the previous frame)
+    */
+    bool decode(const unsigned char *data, size_t size, std::vector<CachedParticle> &particles, float &time);
+
+private:
+    /**
+     * Change of a particle's values over the last frame, used to predict the next frame
+    */
+    struct Track
+    {
+        glm::vec3 velocity;   // Position change
+        float scaleVelocity;  // Scale change
+        int colorVelocity[4]; // Color change
+    };
+
+    std::vector<CachedParticle> previous; // Decoded particles of the previous frame
+    std::vector<CachedParticle> current;  // Decoded particles of the frame being encoded
+    std::vector<Track> previousTracks;    // Changes of each previous particle
+    std::vector<Track> tracks;            // Changes of the frame being coded
+    std::vector<unsigned int> runs;       // Id runs of the frame being coded, (gap, length) pairs
+    bool hasPrevious;                     // A frame was coded since the last reset
+};
+
+/**
+ * Records particle caches without stalling the simulation
+ * The render state of the alive particles is copied on the calling thread, a worker thread sorts,
+ * encodes and writes the frames, a chunk at once. When the worker can't keep up the recording
+ * waits for it, so no frame is ever dropped.
+*/
+class ParticleCacheWriter
+{
+public:
+    /**
+     * Creates a cache writer
+     * @param keyframeInterval Frames per chunk, the first one is a keyframe
+     * @param maxPendingFrames Maximun number of frames waiting to be encoded
+    */
+    ParticleCacheWriter(unsigned int keyframeInterval = 30, unsigned int maxPendingFrames = 4);
+    /**
+     * Finishes the recording and stops the worker
+    */
+    ~ParticleCacheWriter();
+    /**
+     * Starts recording a new cache, the running recording is finished
+     * @param path Path to the cache file
+     * @return The file was created
+    */
+    bool start(const std::string &path);
+    /**
+     * Finishes the recording, waits until every frame is written and writes the index
+    */
+    void stop();
+    /**
+     * Records the current state of a particle system as a new frame
+     * @param particleSystem Particle system to be recorded
+     * @param time Simulated time of the frame in seconds
+    */
+    void record(ParticleSystem *particleSystem, float time);
+    /**
+     * Checks if a cache is being recorded
+     * @return A cache is being recorded
+    */
+    bool isRecording();
+    /**
+     * Gets the number of frames recorded in the current cache
+     * @return Frames handed to the worker
+    */
+    unsigned int getFramesRecorded();
+    /**
+     * Gets the number of frames written in the current cache
+     * @return Frames encoded and written
+    */
+    unsigned int getFramesWritten();
+    /**
+     * Gets the size of the current cache
+     * @return Bytes written to the file
+    */
+    unsigned long long getBytesWritten();
+
+private:
+    /**
+     * Frame waiting to be encoded
+    */
+    struct FrameJob
+    {
+        std::vector<CachedParticle> particles; // Alive particles, not sorted
+        float time;                            // Simulated time of the frame
+    };
+
+    /**
+     * Worker loop, encodes the queued frames until the queue is closed
+    */
+    void writeFrames();
+    /**
+     * Writes the encoded frames of the current chunk
+    */
+    void writeChunk();
+
+    unsigned int keyframeInterval; // Frames per chunk
+
+    BoundedQueue<FrameJob> jobs;                          // Frames waiting to be encoded
+    std::thread worker;                                   // Encoding thread
+    std::mutex freeBuffersMutex;                          // Protects the free buffers
+    std::vector<std::vector<CachedParticle>> freeBuffers; // Recycled frame memory
+
+    std::ofstream file;                 // Cache file, only used by the worker while recording
+    ParticleCacheCodec codec;           // Encoder of the current cache
+    std::vector<unsigned char> chunk;   // Encoded frames not written yet
+    std::vector<CacheIndexEntry> index; // Index of the encoded frames
+    unsigned long long fileOffset;      // Offset where the chunk will be written
+
+    bool recording;              // A cache is being recorded
+    unsigned int framesRecorded; // Frames handed to the worker
+
+    std::mutex writtenMutex;                // Protects the written counters
+    std::condition_variable writtenChanged; // Signaled when a frame is written
+    unsigned int framesWritten;             // Frames encoded and written
+    unsigned long long bytesWritten;        // Bytes written to the file
+};
@@ -0,0 +1,196 @@
+#include "particle-snapshot.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <type_traits>
+#include <vector>
+
+#include "mapped-file.h"
+#include "profiler.h"
+
+// The particles and the state are copied as raw bytes
+static_assert(std::is_trivially_copyable<Particle>::value, "Particle has to be plain data");
+static_assert(std::is_trivially_copyable<ParticleSystemState>::value, "ParticleSystemState has to be plain data");
+
+namespace
+{
+const char snapshotMagic[8] = {'P', 'S', 'N', 'A', 'P', 'S', 'H', 'T'};
+const unsigned int snapshotVersion = 1;
+const size_t sectionAlignment = 16;
+// Particles read from the particle system at once
+const unsigned int readChunkSize = 4096;
+
+/**
+ * First bytes of a snapshot file
+*/
+struct SnapshotHeader
+{
+    char magic[8];                       // snapshotMagic
+    unsigned int version;                // snapshotVersion
+    unsigned int headerSize;             // sizeof(SnapshotHeader), rejects other layouts
+    unsigned int particleSize;           // sizeof(Particle), rejects other layouts
+    unsigned int aliveParticles;         // Number of saved particles
+    unsigned long long propertiesOffset; // Offset of the properties text
+    unsigned long long propertiesSize;   // Size of the properties text
+    unsigned long long indicesOffset;    // Offset of the particle indices
+    unsigned long long particlesOffset;  // Offset of the particles
+    ParticleSystemState state;           // Emitter parameters and spawner state
+};
+
+/**
+ * Rounds an offset up to the section alignment
+ * @param offset Offset in bytes
+ * @return Aligned offset
+*/
+size_t align(size_t offset)
+{
+    return (offset + sectionAlignment - 1) / sectionAlignment * sectionAlignment;
+}
+
+/**
+ * Checks that a section is inside the file without overflowing
+ * @param offset Offset of the section
+ * @param sectionSize Size of the section
+ * @param fileSize Size of the file
+ * @return The whole section is inside the file
+*/
+bool isInside(unsigned long long offset, unsigned long long sectionSize, size_t fileSize)
+{
+    return sectionSize <= fileSize && offset <= fileSize - sectionSize;
+}
+} // namespace
+
+bool writeSnapshot(const std::string &path, ParticleSystem *particleSystem, const MenuProperties &properties)
+{
+    PROFILE_SCOPE("writeSnapshot");
+
+    // Enough digits to read every float back exactly
+    std::stringstream text;
+    text.precision(9);
+    writeProperties(text, properties);
+    const std::string propertiesText = text.str();
+
+    // The particles are read a chunk at a time, once to count the alive ones and once to copy them
+    const unsigned int numberOfParticles = particleSystem->getMaxAmountOfParticles();
+    std::vector<Particle> particleBuffer(std::min(readChunkSize, numberOfParticles));
+    unsigned int aliveParticles = 0;
+    for (unsigned int first = 0; first < numberOfParticles; first += readChunkSize)
+    {
+        const unsigned int count = std::min(readChunkSize, numberOfParticles - first);
+        const Particle *particles = particleSystem->getParticles(first, count, particleBuffer.data());
+        for (unsigned int i = 0; i < count; i++)
+            if (particles[i].isAlive())
+                aliveParticles++;
+    }
+
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, snapshotMagic, sizeof(snapshotMagic));
+    header.version = snapshotVersion;
+    header.headerSize = sizeof(SnapshotHeader);
+    header.particleSize = sizeof(Particle);
+    header.aliveParticles = aliveParticles;
+    header.propertiesOffset = align(sizeof(SnapshotHeader));
+    header.propertiesSize = propertiesText.size();
+    header.indicesOffset = align(header.propertiesOffset + header.propertiesSize);
+    header.particlesOffset = align(header.indicesOffset + aliveParticles * sizeof(unsigned int));
+    header.state = particleSystem->getState();
+
+    // The whole file is built in memory and written at once
+    std::vector<char> buffer(header.particlesOffset + aliveParticles * sizeof(Particle), 0);
+    memcpy(buffer.data(), &header, sizeof(header));
+    memcpy(buffer.data() + header.propertiesOffset, propertiesText.data(), propertiesText.size());
+
+    unsigned int *indices = (unsigned int *)(buffer.data() + header.indicesOffset);
+    Particle *savedParticles = (Particle *)(buffer.data() + header.particlesOffset);
+    unsigned int saved = 0;
+    for (unsigned int first = 0; first < numberOfParticles; first += readChunkSize)
+    {
+        const unsigned int count = std::min(readChunkSize, numberOfParticles - first);
+        const Particle *particles = particleSystem->getParticles(first, count, particleBuffer.data());
+        for (unsigned int i = 0; i < count; i++)
+        {
+            if (!particles[i].isAlive())
+                continue;
+            indices[saved] = first + i;
+            savedParticles[saved] = particles[i];
+            saved++;
+        }
+    }
+
+    std::ofstream file(path.c_str(), std::ios::binary);
+    if (!file)
+    {
+        std::cout << "Couldn't open the file " << path << " for save" << std::endl;
+        return false;
+    }
+    file.write(buffer.data(), buffer.size());
+    if (!file)
+    {
+        std::cout << "Couldn't write the snapshot " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+ParticleSystem *readSnapshot(const std::string &path, Camera *camera, MenuProperties &properties)
+{
+    PROFILE_SCOPE("readSnapshot");
+
+    MappedFile file;
+    if (!file.open(path))
+    {
+        std::cout << "Unable to open the snapshot " << path << std::endl;
+        return NULL;
+    }
+
+    // Checks the header and that every section is inside the file, the sums of a crafted header could wrap around
+    const unsigned char *data = file.getData();
+    const size_t size = file.getSize();
+    const SnapshotHeader *header = (const SnapshotHeader *)data;
+    if (size < sizeof(SnapshotHeader) || memcmp(header->magic, snapshotMagic, sizeof(snapshotMagic)) != 0 ||
+        header->version != snapshotVersion || header->headerSize != sizeof(SnapshotHeader) ||
+        header->particleSize != sizeof(Particle) ||
+        header->state.maxAmountofParticles > (unsigned int)maxParticlesLimit ||
+        header->aliveParticles > header->state.maxAmountofParticles ||
+        !isInside(header->propertiesOffset, header->propertiesSize, size) ||
+        !isInside(header->indicesOffset, (unsigned long long)header->aliveParticles * sizeof(unsigned int), size) ||
+        !isInside(header->particlesOffset, (unsigned long long)header->aliveParticles * sizeof(Particle), size) ||
+        header->indicesOffset % sectionAlignment != 0 || header->particlesOffset % sectionAlignment != 0)
+    {
+        std::cout << "File " << path << " isn't a valid snapshot" << std::endl;
+        return NULL;
+    }
+
+    // Reads the properties on a copy, so a corrupted file doesn't change them
+    MenuProperties newProperties = properties;
+    std::istringstream text(std::string((const char *)data + header->propertiesOffset, header->propertiesSize));
+    std::string line;
+    while (std::getline(text, line))
+    {
+        const std::size_t splitIndex = line.find(' ');
+        if (splitIndex == std::string::npos || !storeProperty(line.substr(0, splitIndex), line.substr(splitIndex + 1), newProperties))
+        {
+            std::cout << "File " << path << " corrupted" << std::endl;
+            return NULL;
+        }
+    }
+
+    // The particles are copied straight from the mapping
+    ParticleSystem *particleSystem = new ParticleSystem(header->state.maxAmountofParticles, camera);
+    if (!particleSystem->restore(header->state, (const unsigned int *)(data + header->indicesOffset),
+                                 (const Particle *)(data + header->particlesOffset), header->aliveParticles))
+    {
+        std::cout << "File " << path << " corrupted" << std::endl;
+        delete particleSystem;
+        return NULL;
+    }
+
+    properties = newProperties;
+    // The particle system size is given by the saved state
+    properties.maxParticles = (int)header->state.maxAmountofParticles;
+    return particleSystem;
+}
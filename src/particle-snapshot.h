@@ -0,0 +1,39 @@
+#pragma once
+
+#include <string>
+
+#include "camera.h"
+#include "configuration.h"
+#include "particle-system.h"
+
+/**
+ * Binary snapshots of a running particle system: the menu properties, the emitter and spawner state
+ * (including the random sequence) and every alive particle.
+ * The file is written with a single write and read through a memory mapping, the state and the
+ * particles are used in place, only the few properties lines are parsed. The data is stored in the
+ * native layout, so snapshots are only read by builds with the same particle layout.
+ *
+ * Layout, every section starts 16 bytes aligned:
+ *   SnapshotHeader
+ *   Properties text, configuration file syntax
+ *   Alive particle indices, unsigned int each
+ *   Alive particles, Particle each
+*/
+
+/**
+ * Writes a snapshot of a particle system
+ * @param path Path to the snapshot file
+ * @param particleSystem Particle system to be saved
+ * @param properties Menu properties of the particle system
+ * @return The file was written
+*/
+bool writeSnapshot(const std::string &path, ParticleSystem *particleSystem, const MenuProperties &properties);
+
+/**
+ * Reads a snapshot into a new particle system
+ * @param path Path to the snapshot file
+ * @param camera Camera of the new particle system
+ * @param properties Where the saved menu properties are stored, the properties not saved are kept
+ * @return New particle system, NULL if the file isn't a valid snapshot
+*/
+ParticleSystem *readSnapshot(const std::string &path, Camera *camera, MenuProperties &properties);
@@ -1,59 +1,87 @@
 #include "particle-system.h"
+#include "profiler.h"
+#include "random.h"
 #include <glad/glad.h>
-#include <stdlib.h> /* srand, rand */
-#include <time.h>   /* time */
+#include <time.h> /* time */
 #include <algorithm>
+#include <cmath>
+#include <cstddef>
 
-/**
- * Computes a random number from a base a variance
- * @param baseValue Median number of the random
- * @param variance Variance of the random centered of the baseValue
- * @return Random number in the range [baseValue - variance, baseValue + variance]
-*/
-float randomValue(float baseValue, float variance)
-{
-    float random = (float)rand() / (float)RAND_MAX * 2.0f - 1.0f;
-    return baseValue + variance * random;
-}
+// Time step of the prewarm when the particles motion isn't analytic
+static const float prewarmStep = 0.05f;
+// Max fluid steps per update, so a slow update doesn't make the next ones slower
+static const unsigned int maxFluidSteps = 8;
+// Max smoke grid steps per update, the grid is coarse so it falls behind rather than slowing the updates down
+static const unsigned int maxSmokeSteps = 4;
+// Smallest margin added around the compact bounds when they grow
+static const float compactBoundsMargin = 0.01f;
 
+namespace
+{
 /**
- * Computes a random vector from a base a variance
- * @param baseValue Median vector of the random
- * @param variance Variance of the random centered of the baseValue
- * @return Random vector in the range [baseValue - variance, baseValue + variance]
+ * Format of an instance attribute of the analytic shader
 */
-glm::vec3 randomValue(glm::vec3 baseValue, glm::vec3 variance)
+struct InstanceAttribute
 {
-    return glm::vec3(randomValue(baseValue.x, variance.x),
-                     randomValue(baseValue.y, variance.y),
-                     randomValue(baseValue.z, variance.z));
-}
+    GLint size;           // Number of components
+    GLenum type;          // Type of the components
+    GLboolean normalized; // The integer components are normalized
+    size_t offset;        // Offset in the instance data
+};
+
+// Instance attributes (locations 2 to 10) of the particles stored with full precision
+const InstanceAttribute fullInstanceAttributes[] = {
+    {3, GL_FLOAT, GL_FALSE, offsetof(ParticleInstance, position)},
+    {3, GL_FLOAT, GL_FALSE, offsetof(ParticleInstance, direction)},
+    {1, GL_FLOAT, GL_FALSE, offsetof(ParticleInstance, stateTime)},
+    {1, GL_FLOAT, GL_FALSE, offsetof(ParticleInstance, ttl)},
+    {4, GL_FLOAT, GL_FALSE, offsetof(ParticleInstance, initialColor)},
+    {4, GL_FLOAT, GL_FALSE, offsetof(ParticleInstance, finalColor)},
+    {1, GL_FLOAT, GL_FALSE, offsetof(ParticleInstance, initialScale)},
+    {1, GL_FLOAT, GL_FALSE, offsetof(ParticleInstance, finalScale)},
+    {1, GL_FLOAT, GL_FALSE, offsetof(ParticleInstance, liveTime)}};
+
+// Same attributes read from the compact particles, the shader scales them back with the compact bounds
+const InstanceAttribute compactInstanceAttributes[] = {
+    {3, GL_UNSIGNED_SHORT, GL_TRUE, offsetof(CompactParticle, position)},
+    {3, GL_HALF_FLOAT, GL_FALSE, offsetof(CompactParticle, direction)},
+    {1, GL_FLOAT, GL_FALSE, offsetof(CompactParticle, stateTime)},
+    {1, GL_FLOAT, GL_FALSE, offsetof(CompactParticle, ttl)},
+    {4, GL_UNSIGNED_BYTE, GL_TRUE, offsetof(CompactParticle, initialColor)},
+    {4, GL_UNSIGNED_BYTE, GL_TRUE, offsetof(CompactParticle, finalColor)},
+    {1, GL_SHORT, GL_TRUE, offsetof(CompactParticle, initialScale)},
+    {1, GL_SHORT, GL_TRUE, offsetof(CompactParticle, finalScale)},
+    {1, GL_FLOAT, GL_FALSE, offsetof(CompactParticle, liveTime)}};
+
+const unsigned int numberOfInstanceAttributes = sizeof(fullInstanceAttributes) / sizeof(InstanceAttribute);
 
 /**
- * Builds a random number between the range [min, max]
- * @param min Minimun posible random value
- * @param max Maximun posible random value
- * @return Random number in the range [min, max]
+ * Checks if a particle can be quantized without clamping
+ * @param bounds Compact bounds
+ * @param particle Particle to be quantized
+ * @return The particle position and scales are inside the bounds
 */
-float randomValueInterpolated(float min, float max)
+bool insideBounds(const CompactBounds &bounds, const Particle &particle)
 {
-    float random = (float)rand() / (float)RAND_MAX;
-
-    return glm::mix(min, max, random);
+    const glm::vec3 position = particle.getPosition();
+    return glm::all(glm::greaterThanEqual(position, bounds.min)) && glm::all(glm::lessThanEqual(position, bounds.max)) &&
+           particle.getMaxScale() <= bounds.maxScale;
 }
 
 /**
- * Builds a random vector between the range [min, max]
- * @param min Minimun posible random value
- * @param max Maximun posible random value
- * @return Random vector in the range [min, max]
+ * Adds a margin around the bounds, half their size, so they don't grow on every particle stored
+ * @param bounds Compact bounds
+ * @return Bounds with the margin
 */
-glm::vec3 randomValueInterpolated(glm::vec3 min, glm::vec3 max)
+CompactBounds addMargin(CompactBounds bounds)
 {
-    return glm::vec3(randomValueInterpolated(min.x, max.x),
-                     randomValueInterpolated(min.y, max.y),
-                     randomValueInterpolated(min.z, max.z));
+    const glm::vec3 margin = glm::max((bounds.max - bounds.min) * 0.5f, glm::vec3(compactBoundsMargin));
+    bounds.min -= margin;
+    bounds.max += margin;
+    bounds.maxScale = glm::max(bounds.maxScale * 1.5f, compactBoundsMargin);
+    return bounds;
 }
+} // namespace
 
 ParticleSystem::ParticleSystem(unsigned int maxAmountOfParticles, Camera *camera)
 {
@@ -63,18 +91,46 @@ ParticleSystem::ParticleSystem(unsigned int maxAmountOfParticles, Camera *camera
     this->lastParticleSpawned = 0;
 
     this->camera = camera;
+    this->drawStatistics = DrawStatistics();
+
+    this->time = 0.0f;
+    this->analyticEvaluationEnabled = false;
+    this->analyticEvaluation = false;
+    this->compactStorage = false;
+    this->compactBounds = CompactBounds();
+    this->instanceVAO = 0;
+    this->instanceVBO = 0;
+    this->compactInstances = false;
+    this->changedInstancesBegin = 0;
+    this->changedInstances = maxAmountOfParticles;
+    this->threadPool = NULL;
+    this->spatialHashBuilt = false;
+    this->collisionRadius = 0.1f;
+    this->collisionIterations = 0;
+    this->fluidParameters = {false, 0.12f, 1000.0f, 20.0f, 0.05f, 0.01f};
+    this->fluidTimeAccumulator = 0.0f;
+    this->gravityParameters = {false, 0.0001f, 0.5f, 0.05f};
+    this->flockParameters = {false, 0.5f, 16, 0.02f, 1.0f, 1.0f, 0.5f, glm::vec3(0.0f), 2.0f};
+    this->smokeParameters = {false, glm::vec3(-2.0f), glm::vec3(2.0f), 0.125f, 4.0f, 1.0f, 0.3f, 1.0f, 20, 0.0f, 4.0f};
+    this->smokeTimeAccumulator = 0.0f;
 
-    // Sets the size of the particle system
-    this->particles.resize(this->maxAmountofParticles);
+    // The particles are allocated when they're first used, in the storage set by then
 
-    // Sets the random number generator seed
-    srand(time(NULL));
+    // Seeds the random values from the clock, setSeed makes the particle system deterministic
+    this->setSeed((unsigned int)::time(NULL));
 }
 
 ParticleSystem::~ParticleSystem()
 {
     // Clear all the particles from the particle system
     this->particles.clear();
+
+    // The instance buffer only exists if the particles were drawn analytically
+    if (this->instanceVAO)
+    {
+        glDeleteVertexArrays(1, &this->instanceVAO);
+        glDeleteBuffers(1, &this->instanceVBO);
+    }
 }
 
 void ParticleSystem::setParticleSpawns(unsigned int numberOfParticles, float spawnInterval)
@@ -125,44 +181,611 @@ void ParticleSystem::setAplha(float initialAlpha, float finalAlpha, float varian
 
 void ParticleSystem::setGlobalExternalForce(glm::vec3 globalExternalForce)
 {
+    // The closed form assumes the force didn't change since the stored states, they're stored again
+    if (this->analyticEvaluation && globalExternalForce != this->globalExternalForce)
+    {
+        for (unsigned int i = 0; i < this->maxAmountofParticles; i++)
+            this->storeParticle(i, this->loadParticle(i).evaluate(this->time, this->globalExternalForce));
+        this->markInstancesChanged(0, this->maxAmountofParticles);
+    }
     this->globalExternalForce = globalExternalForce;
 }
 
+void ParticleSystem::setForceFields(const std::vector<ForceField> &forceFields)
+{
+    this->forceFields = forceFields;
+    this->updateEvaluationMode();
+}
+
+const std::vector<ForceField> &ParticleSystem::getForceFields()
+{
+    return this->forceFields;
+}
+
+void ParticleSystem::setCollisions(float radius, unsigned int iterations)
+{
+    this->collisionRadius = radius;
+    this->collisionIterations = radius > 0.0f ? iterations : 0;
+    this->updateEvaluationMode();
+}
+
+void ParticleSystem::setColliders(const std::vector<Collider> &colliders)
+{
+    this->colliders = colliders;
+    prepareColliders(this->colliders);
+    this->updateEvaluationMode();
+}
+
+const std::vector<Collider> &ParticleSystem::getColliders()
+{
+    return this->colliders;
+}
+
+void ParticleSystem::setFluid(const FluidParameters &parameters)
+{
+    this->fluidParameters = parameters;
+    this->fluidParameters.enabled = parameters.enabled && parameters.radius > 0.0f && parameters.timeStep > 0.0f && parameters.restDensity > 0.0f;
+    this->updateEvaluationMode();
+}
+
+void ParticleSystem::setGravity(const GravityParameters &parameters)
+{
+    // The softening keeps the particles from pulling themselves
+    this->gravityParameters = parameters;
+    this->gravityParameters.enabled = parameters.enabled && parameters.softening > 0.0f && parameters.openingAngle >= 0.0f;
+    this->updateEvaluationMode();
+}
+
+void ParticleSystem::setFlock(const FlockParameters &parameters)
+{
+    this->flockParameters = parameters;
+    this->flockParameters.enabled = parameters.enabled && parameters.radius > 0.0f && parameters.maxNeighbors > 0 && parameters.maxSpeed > 0.0f;
+    this->updateEvaluationMode();
+}
+
+void ParticleSystem::setSmoke(const SmokeParameters &parameters)
+{
+    this->smokeParameters = parameters;
+    this->smokeParameters.enabled = parameters.enabled && parameters.cellSize > 0.0f && parameters.timeStep >= 0.0f &&
+                                    glm::all(glm::lessThan(parameters.boundsMin, parameters.boundsMax));
+    // A grid turned on again starts still
+    if (!this->smokeParameters.enabled)
+        this->smokeSolver.reset();
+    this->updateEvaluationMode();
+}
+
+void ParticleSystem::setAnalyticEvaluation(bool analyticEvaluation)
+{
+    this->analyticEvaluationEnabled = analyticEvaluation;
+    this->updateEvaluationMode();
+}
+
+void ParticleSystem::updateEvaluationMode()
+{
+    const bool analyticEvaluation = this->analyticEvaluationEnabled && this->hasAnalyticMotion();
+    if (analyticEvaluation == this->analyticEvaluation)
+        return;
+
+    // Before the particles are allocated only the storage they'll be allocated in changes
+    if (this->particles.empty() && this->compactParticles.empty())
+    {
+        this->analyticEvaluation = analyticEvaluation;
+        return;
+    }
+
+    // Updated particles are always in their current state, evaluated particles are brought to it
+    this->setCompactParticles(false);
+    for (unsigned int i = 0; i < this->maxAmountofParticles; i++)
+    {
+        if (analyticEvaluation)
+            this->particles[i].setStateTime(this->time);
+        else
+            this->particles[i] = this->particles[i].evaluate(this->time, this->globalExternalForce);
+    }
+    this->analyticEvaluation = analyticEvaluation;
+    this->setCompactParticles(this->compactStorage && analyticEvaluation);
+    this->markInstancesChanged(0, this->maxAmountofParticles);
+}
+
+bool ParticleSystem::isAnalyticEvaluation()
+{
+    return this->analyticEvaluation;
+}
+
+float ParticleSystem::getTime()
+{
+    return this->time;
+}
+
+void ParticleSystem::setCompactStorage(bool compactStorage)
+{
+    this->compactStorage = compactStorage;
+    this->setCompactParticles(compactStorage && this->analyticEvaluation);
+}
+
+bool ParticleSystem::isCompactStorage()
+{
+    return this->compactStorage;
+}
+
+size_t ParticleSystem::getMemoryUsage()
+{
+    return this->particles.capacity() * sizeof(Particle) + this->compactParticles.capacity() * sizeof(CompactParticle) +
+           this->instanceData.capacity() * sizeof(ParticleInstance);
+}
+
 void ParticleSystem::update(float deltaTime)
+{
+    PROFILE_SCOPE("ParticleSystem::update");
+
+    this->emit(deltaTime);
+    this->simulate(deltaTime);
+}
+
+unsigned int ParticleSystem::emit(float deltaTime)
 {
     // Increase the time since the last particles spawn
     this->timeSinceLastSpawn += deltaTime;
 
+    if (this->timeSinceLastSpawn < this->spawnInterval)
+        return 0;
+
     // Spawns a new set of particles
-    if (this->timeSinceLastSpawn >= this->spawnInterval)
+    this->spawnParticles();
+    this->timeSinceLastSpawn = 0.0f;
+    return this->particlesPerSpawn;
+}
+
+void ParticleSystem::prewarm(float seconds)
+{
+    PROFILE_SCOPE("ParticleSystem::prewarm");
+
+    if (seconds <= 0.0f)
+        return;
+
+    this->allocateParticles();
+
+    // Without a spawn interval the emitter spawns on every update, there's no schedule to skip
+    if (this->spawnInterval <= 0.0f || this->particlesPerSpawn == 0)
+    {
+        this->updateFor(seconds);
+        return;
+    }
+
+    const bool analytic = this->hasAnalyticMotion();
+    const float startTime = this->time;
+
+    // Spawn times, the first one when the current interval ends, then one every interval
+    const float firstSpawn = glm::max(this->spawnInterval - this->timeSinceLastSpawn, 0.0f);
+    const unsigned long long spawns = firstSpawn > seconds ? 0 : (unsigned long long)((seconds - firstSpawn) / this->spawnInterval) + 1;
+
+    // Only the last spawns can still be alive and not recycled at the end
+    const unsigned long long aliveSpawns = (unsigned long long)(this->ttl / this->spawnInterval) + 1;
+    const unsigned long long storedSpawns = this->maxAmountofParticles / this->particlesPerSpawn + 1;
+    const unsigned long long skippedSpawns = spawns - glm::min(spawns, glm::min(aliveSpawns, storedSpawns));
+    const unsigned long long skippedParticles = skippedSpawns * this->particlesPerSpawn;
+
+    // Without a closed form the particle system is updated from the first spawn kept. When spawns are
+    // skipped the particles alive now are dead or recycled by the end
+    if (!analytic)
     {
+        float updatedTime = seconds;
+        if (skippedSpawns > 0)
+        {
+            std::fill(this->particles.begin(), this->particles.end(), Particle());
+            this->spawnCount += skippedParticles;
+            this->lastParticleSpawned = (unsigned int)((this->lastParticleSpawned + skippedParticles) % this->maxAmountofParticles);
+            // The first update spawns the first spawn kept
+            const float keptSpawn = firstSpawn + skippedSpawns * this->spawnInterval;
+            this->time = startTime + keptSpawn;
+            this->timeSinceLastSpawn = this->spawnInterval;
+            updatedTime = seconds - keptSpawn;
+        }
+        this->updateFor(updatedTime);
+        this->time = startTime + seconds;
+        return;
+    }
+
+    // The particles already alive move for the whole time, evaluated particles only need the new time
+    if (!this->analyticEvaluation)
+        for (unsigned int i = 0; i < this->maxAmountofParticles; i++)
+            if (this->particles[i].isAlive())
+                this->particles[i].advance(seconds, this->globalExternalForce);
+
+    // The skipped spawns only move the spawn sequence, the random values of the rest don't change.
+    // Their particles would be dead at the end, so the particles they recycle are removed
+    for (unsigned long long i = 0; i < glm::min(skippedParticles, (unsigned long long)this->maxAmountofParticles); i++)
+        this->storeParticle((this->lastParticleSpawned + i) % this->maxAmountofParticles, Particle());
+    this->spawnCount += skippedParticles;
+    this->lastParticleSpawned = (unsigned int)((this->lastParticleSpawned + skippedParticles) % this->maxAmountofParticles);
+
+    for (unsigned long long spawn = skippedSpawns; spawn < spawns; spawn++)
+    {
+        // The particles store the time they're spawned at
+        const float spawnTime = firstSpawn + spawn * this->spawnInterval;
+        this->time = startTime + spawnTime;
+
+        const unsigned int firstParticle = this->lastParticleSpawned;
         this->spawnParticles();
-        this->timeSinceLastSpawn = 0.0f;
+
+        if (!this->analyticEvaluation)
+            for (unsigned int i = 0; i < this->particlesPerSpawn; i++)
+                this->particles[(firstParticle + i) % this->maxAmountofParticles].advance(seconds - spawnTime, this->globalExternalForce);
     }
 
-    // Updates each particles
-    for (unsigned int i = 0; i < this->maxAmountofParticles; i++)
-        this->particles[i].update(deltaTime, this->globalExternalForce);
+    if (spawns > 0)
+        this->timeSinceLastSpawn = seconds - (firstSpawn + (spawns - 1) * this->spawnInterval);
+    else
+        this->timeSinceLastSpawn += seconds;
+    this->time = startTime + seconds;
+    this->spatialHashBuilt = false;
+    this->markInstancesChanged(0, this->maxAmountofParticles);
+}
+
+void ParticleSystem::simulate(float deltaTime)
+{
+    PROFILE_SCOPE("ParticleSystem::simulate");
+
+    const float startTime = this->time;
+    this->time += deltaTime;
+    this->spatialHashBuilt = false;
+    // Evaluated particles don't have to be moved
+    if (this->analyticEvaluation)
+        return;
+
+    this->allocateParticles();
+
+    // The force fields act at the time the step starts
+    if (this->fluidParameters.enabled)
+        this->simulateFluid(deltaTime);
+    else if (this->gravityParameters.enabled)
+        this->gravitySolver.step(this->gravityParameters, this->particles, this->globalExternalForce, deltaTime);
+    else if (this->flockParameters.enabled)
+    {
+        this->flockSolver.step(this->flockParameters, this->getSpatialHash(this->flockParameters.radius), this->particles, this->globalExternalForce, deltaTime);
+        this->spatialHashBuilt = false;
+    }
+    else if (this->smokeParameters.enabled)
+        this->simulateSmoke(deltaTime);
+    else if (!this->forceFields.empty())
+        this->simulateForceFields(deltaTime, startTime);
+    else
+        // Updates each particles
+        for (unsigned int i = 0; i < this->maxAmountofParticles; i++)
+            this->particles[i].update(deltaTime, this->globalExternalForce);
+
+    if (this->collisionIterations > 0)
+        this->solveCollisions();
+    // The fluid collides after each of its steps
+    if (!this->colliders.empty() && !this->fluidParameters.enabled)
+        this->collideStatic();
 }
 
 void ParticleSystem::draw(Shader *shader, unsigned int quadVAO)
 {
+    PROFILE_SCOPE("ParticleSystem::draw");
+
+    // Each particle sets its model matrix, scale and color uniforms
+    const size_t uniformBytes = sizeof(glm::mat4) + sizeof(float) + sizeof(glm::vec4);
+    this->drawStatistics = DrawStatistics();
+
     // Binds the particles geometry
     glBindVertexArray(quadVAO);
 
-    for (unsigned int i = 0; i < this->maxAmountofParticles; i++)
+    // The particles are read a chunk at a time
+    const unsigned int chunkSize = 4096;
+    std::vector<Particle> buffer(glm::min(chunkSize, this->maxAmountofParticles));
+    for (unsigned int first = 0; first < this->maxAmountofParticles; first += chunkSize)
+    {
+        const unsigned int count = glm::min(chunkSize, this->maxAmountofParticles - first);
+        const Particle *particles = this->getParticles(first, count, buffer.data());
+        for (unsigned int i = 0; i < count; i++)
+        {
+            // Dead particles don't set their uniforms, drawing them would repeat the previous particle
+            if (!particles[i].isAlive())
+                continue;
+            // Sets the particles uniform properties
+            particles[i].draw(shader, this->camera);
+            // Binds the vertex array to be drawn
+            // Renders the quad geometry
+            glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
+
+            this->drawStatistics.drawCalls++;
+            this->drawStatistics.instances++;
+            this->drawStatistics.bytesUploaded += uniformBytes;
+        }
+    }
+    glBindVertexArray(0);
+}
+
+void ParticleSystem::drawAnalytic(Shader *shader, unsigned int quadVBO)
+{
+    PROFILE_SCOPE("ParticleSystem::drawAnalytic");
+
+    this->drawStatistics = DrawStatistics();
+    this->allocateParticles();
+
+    // The instance buffer is created again when the storage changes, it holds the stored particles as they are
+    const bool compact = !this->compactParticles.empty();
+    if (this->instanceVAO && this->compactInstances != compact)
+    {
+        glDeleteVertexArrays(1, &this->instanceVAO);
+        glDeleteBuffers(1, &this->instanceVBO);
+        this->instanceVAO = 0;
+    }
+
+    if (!this->instanceVAO)
     {
-        // Sets the particles uniform properties
-        this->particles[i].draw(shader, this->camera);
-        // Binds the vertex array to be drawn
-        // Renders the quad geometry
-        glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
+        glGenVertexArrays(1, &this->instanceVAO);
+        glGenBuffers(1, &this->instanceVBO);
+        glBindVertexArray(this->instanceVAO);
+
+        // Quad geometry, same attributes as the particles geometry
+        glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)(3 * sizeof(float)));
+
+        // Stored state of each particle, one per instance
+        const size_t instanceSize = compact ? sizeof(CompactParticle) : sizeof(ParticleInstance);
+        const InstanceAttribute *attributes = compact ? compactInstanceAttributes : fullInstanceAttributes;
+        glBindBuffer(GL_ARRAY_BUFFER, this->instanceVBO);
+        glBufferData(GL_ARRAY_BUFFER, this->maxAmountofParticles * instanceSize, NULL, GL_DYNAMIC_DRAW);
+        for (unsigned int i = 0; i < numberOfInstanceAttributes; i++)
+        {
+            glEnableVertexAttribArray(2 + i);
+            glVertexAttribPointer(2 + i, attributes[i].size, attributes[i].type, attributes[i].normalized, instanceSize, (void *)attributes[i].offset);
+            glVertexAttribDivisor(2 + i, 1);
+        }
+        this->compactInstances = compact;
+
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        this->markInstancesChanged(0, this->maxAmountofParticles);
     }
+
+    this->drawStatistics.bytesUploaded = this->uploadInstances();
+
+    shader->setFloat("time", this->time);
+    shader->setVec3("externalForce", this->globalExternalForce);
+    // The full precision particles are read as they are
+    shader->setVec3("boundsMin", compact ? this->compactBounds.min : glm::vec3(0.0f));
+    shader->setVec3("boundsSize", compact ? this->compactBounds.max - this->compactBounds.min : glm::vec3(1.0f));
+    shader->setFloat("maxScale", compact ? this->compactBounds.maxScale : 1.0f);
+
+    // Every particle is drawn by a single call, the dead ones are discarded by the shader
+    glBindVertexArray(this->instanceVAO);
+    glDrawArraysInstanced(GL_TRIANGLE_FAN, 0, 4, this->maxAmountofParticles);
     glBindVertexArray(0);
+
+    this->drawStatistics.drawCalls = 1;
+    this->drawStatistics.instances = this->maxAmountofParticles;
+}
+
+void ParticleSystem::markInstancesChanged(unsigned int first, unsigned int count)
+{
+    // The spawns are consecutive, their ranges are joined, other ranges upload everything
+    if (this->changedInstances == 0)
+        this->changedInstancesBegin = first;
+    else if ((this->changedInstancesBegin + this->changedInstances) % this->maxAmountofParticles != first)
+        count = this->maxAmountofParticles;
+    this->changedInstances = glm::min(this->changedInstances + count, this->maxAmountofParticles);
+    if (this->changedInstances == this->maxAmountofParticles)
+        this->changedInstancesBegin = 0;
+}
+
+size_t ParticleSystem::uploadInstances()
+{
+    if (this->changedInstances == 0)
+        return 0;
+
+    PROFILE_SCOPE("ParticleSystem::uploadInstances");
+
+    const unsigned int first = this->changedInstancesBegin;
+    const unsigned int count = this->changedInstances;
+    const unsigned int tail = glm::min(count, this->maxAmountofParticles - first);
+
+    // Compact particles are already instance data, the others are converted
+    size_t instanceSize = sizeof(CompactParticle);
+    const unsigned char *head = (const unsigned char *)(this->compactParticles.data() + first);
+    const unsigned char *wrapped = (const unsigned char *)this->compactParticles.data();
+    if (!this->compactInstances)
+    {
+        this->instanceData.resize(count);
+        for (unsigned int i = 0; i < count; i++)
+            this->instanceData[i] = this->particles[(first + i) % this->maxAmountofParticles].getInstance();
+        instanceSize = sizeof(ParticleInstance);
+        head = (const unsigned char *)this->instanceData.data();
+        wrapped = (const unsigned char *)(this->instanceData.data() + tail);
+    }
+
+    // The range wraps around the end of the buffer at most once
+    glBindBuffer(GL_ARRAY_BUFFER, this->instanceVBO);
+    glBufferSubData(GL_ARRAY_BUFFER, first * instanceSize, tail * instanceSize, head);
+    if (count > tail)
+        glBufferSubData(GL_ARRAY_BUFFER, 0, (count - tail) * instanceSize, wrapped);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    this->changedInstances = 0;
+    return count * instanceSize;
+}
+
+const Particle *ParticleSystem::getParticles(unsigned int first, unsigned int count, Particle *buffer)
+{
+    if (!this->analyticEvaluation && !this->particles.empty())
+        return &this->particles[first];
+
+    PROFILE_SCOPE("ParticleSystem::evaluateParticles");
+
+    // Only the readers of the particles pay for their evaluation, before they're allocated every particle is dead
+    for (unsigned int i = 0; i < count; i++)
+        buffer[i] = this->analyticEvaluation ? this->loadParticle(first + i).evaluate(this->time, this->globalExternalForce) : Particle();
+    return buffer;
+}
+
+unsigned int ParticleSystem::getMaxAmountOfParticles()
+{
+    return this->maxAmountofParticles;
+}
+
+void ParticleSystem::setThreadPool(ThreadPool *threadPool)
+{
+    this->threadPool = threadPool;
+    this->spatialHash.setThreadPool(threadPool);
+    this->fluidSolver.setThreadPool(threadPool);
+    this->gravitySolver.setThreadPool(threadPool);
+    this->flockSolver.setThreadPool(threadPool);
+    this->smokeSolver.setThreadPool(threadPool);
+}
+
+const SpatialHash &ParticleSystem::getSpatialHash(float cellSize)
+{
+    if (!this->spatialHashBuilt || cellSize != this->spatialHash.getCellSize())
+    {
+        if (!this->analyticEvaluation && !this->particles.empty())
+            this->spatialHash.build(this->particles, cellSize);
+        else
+        {
+            // The evaluated particles are only kept while the hash is built
+            std::vector<Particle> particles(this->maxAmountofParticles);
+            this->getParticles(0, this->maxAmountofParticles, particles.data());
+            this->spatialHash.build(particles, cellSize);
+        }
+        this->spatialHashBuilt = true;
+    }
+    return this->spatialHash;
+}
+
+Camera *ParticleSystem::getCamera()
+{
+    return this->camera;
+}
+
+void ParticleSystem::setSeed(unsigned int seed)
+{
+    this->seed = seed;
+    this->spawnCount = 0;
+}
+
+unsigned int ParticleSystem::getSeed()
+{
+    return this->seed;
+}
+
+unsigned long long ParticleSystem::computeStateHash()
+{
+    // FNV-1a of the spawner state and every particle
+    unsigned long long hash = 14695981039346656037ull;
+    hash = hashBytes(hash, &this->timeSinceLastSpawn, sizeof(this->timeSinceLastSpawn));
+    hash = hashBytes(hash, &this->lastParticleSpawned, sizeof(this->lastParticleSpawned));
+    hash = hashBytes(hash, &this->spawnCount, sizeof(this->spawnCount));
+    hash = hashBytes(hash, &this->time, sizeof(this->time));
+    for (unsigned int i = 0; i < this->maxAmountofParticles; i++)
+        hash = this->loadParticle(i).hash(hash);
+    return hash;
+}
+
+ParticleSystemState ParticleSystem::getState()
+{
+    ParticleSystemState state = ParticleSystemState();
+    state.ttl = this->ttl;
+    state.position = this->position;
+    state.positionVariance = this->positionVariance;
+    state.initialScale = this->initialScale;
+    state.finalScale = this->finalScale;
+    state.scaleVariance = this->scaleVariance;
+    state.direction = this->direction;
+    state.directionVariance = this->directionVariance;
+    state.minBaseColor = this->minBaseColor;
+    state.maxBaseColor = this->maxBaseColor;
+    state.minFinalColor = this->minFinalColor;
+    state.maxFinalColor = this->maxFinalColor;
+    state.initialAlpha = this->initialAlpha;
+    state.finalAlpha = this->finalAlpha;
+    state.alphaVariance = this->alphaVariance;
+    state.globalExternalForce = this->globalExternalForce;
+    state.maxAmountofParticles = this->maxAmountofParticles;
+    state.particlesPerSpawn = this->particlesPerSpawn;
+    state.spawnInterval = this->spawnInterval;
+    state.timeSinceLastSpawn = this->timeSinceLastSpawn;
+    state.lastParticleSpawned = this->lastParticleSpawned;
+    state.seed = this->seed;
+    state.spawnCount = this->spawnCount;
+    state.time = this->time;
+    state.analyticEvaluation = this->analyticEvaluation;
+    return state;
+}
+
+bool ParticleSystem::restore(const ParticleSystemState &state, const unsigned int *indices, const Particle *particles, unsigned int count)
+{
+    PROFILE_SCOPE("ParticleSystem::restore");
+
+    if (state.maxAmountofParticles != this->maxAmountofParticles || state.lastParticleSpawned >= this->maxAmountofParticles)
+        return false;
+    for (unsigned int i = 0; i < count; i++)
+        if (indices[i] >= this->maxAmountofParticles)
+            return false;
+
+    this->ttl = state.ttl;
+    this->position = state.position;
+    this->positionVariance = state.positionVariance;
+    this->initialScale = state.initialScale;
+    this->finalScale = state.finalScale;
+    this->scaleVariance = state.scaleVariance;
+    this->direction = state.direction;
+    this->directionVariance = state.directionVariance;
+    this->minBaseColor = state.minBaseColor;
+    this->maxBaseColor = state.maxBaseColor;
+    this->minFinalColor = state.minFinalColor;
+    this->maxFinalColor = state.maxFinalColor;
+    this->initialAlpha = state.initialAlpha;
+    this->finalAlpha = state.finalAlpha;
+    this->alphaVariance = state.alphaVariance;
+    this->globalExternalForce = state.globalExternalForce;
+    this->particlesPerSpawn = state.particlesPerSpawn;
+    this->spawnInterval = state.spawnInterval;
+    this->timeSinceLastSpawn = state.timeSinceLastSpawn;
+    this->lastParticleSpawned = state.lastParticleSpawned;
+    this->seed = state.seed;
+    this->spawnCount = state.spawnCount;
+    this->time = state.time;
+    this->fluidTimeAccumulator = 0.0f;
+    // The grid isn't part of the state, it starts still again
+    this->smokeTimeAccumulator = 0.0f;
+    this->smokeSolver.reset();
+
+    // The particles are allocated again in the storage of the restored evaluation
+    std::vector<Particle>().swap(this->particles);
+    std::vector<CompactParticle>().swap(this->compactParticles);
+    std::vector<ParticleInstance>().swap(this->instanceData);
+    this->spatialHashBuilt = false;
+    this->analyticEvaluationEnabled = state.analyticEvaluation;
+    this->analyticEvaluation = state.analyticEvaluation && this->hasAnalyticMotion();
+    this->allocateParticles();
+    // The compact bounds hold every restored particle from the start, they aren't grown one particle at a time
+    if (!this->compactParticles.empty())
+    {
+        this->compactBounds = this->getCompactBounds(particles, count);
+        std::fill(this->compactParticles.begin(), this->compactParticles.end(), Particle().getCompact(this->compactBounds));
+    }
+
+    // Particles are plain data, they're copied as is and quantized with the compact storage
+    for (unsigned int i = 0; i < count; i++)
+        this->storeParticle(indices[i], particles[i]);
+    this->markInstancesChanged(0, this->maxAmountofParticles);
+    return true;
+}
+
+const DrawStatistics &ParticleSystem::getDrawStatistics()
+{
+    return this->drawStatistics;
 }
 
 void ParticleSystem::spawnParticles()
 {
+    PROFILE_SCOPE("ParticleSystem::spawnParticles");
+
     /**
      * Spawns each new particle one by one
      * The particles aren't created or deleted from the array,
@@ -170,6 +793,8 @@ void ParticleSystem::spawnParticles()
      * no matter if the particle is alive or dead. 
      * All the particles are recycled
     */
+    this->spatialHashBuilt = false;
+    this->markInstancesChanged(this->lastParticleSpawned, glm::min(this->particlesPerSpawn, this->maxAmountofParticles));
     for (unsigned int i = 0; i < this->particlesPerSpawn; i++)
     {
         // Spawns the next particle in the array
@@ -179,25 +804,337 @@ void ParticleSystem::spawnParticles()
     }
 }
 
+bool ParticleSystem::hasAnalyticMotion()
+{
+    // The global force is constant, the force fields, the collisions, the colliders, the fluid, the gravity, the flock and the smoke depend on the position of each particle
+    return this->forceFields.empty() && this->collisionIterations == 0 && this->colliders.empty() && !this->fluidParameters.enabled &&
+           !this->gravityParameters.enabled && !this->flockParameters.enabled && !this->smokeParameters.enabled;
+}
+
+void ParticleSystem::updateFor(float seconds)
+{
+    // Without a spawn interval the emitter spawns once per update, evaluated particles keep the state of their spawn
+    if (this->spawnInterval <= 0.0f || this->analyticEvaluation)
+    {
+        for (float step = 0.0f; step < seconds; step += prewarmStep)
+            this->update(glm::min(prewarmStep, seconds - step));
+        return;
+    }
+
+    // The steps don't depend on the spawn interval, every spawn due inside a step is spawned at its start and taken
+    // back to its spawn time, so the step moves each batch for the time it was alive
+    const unsigned int batchSize = glm::min(this->particlesPerSpawn, this->maxAmountofParticles);
+    for (float step = 0.0f; step < seconds; step += prewarmStep)
+    {
+        const float deltaTime = glm::min(prewarmStep, seconds - step);
+        float spawnOffset = glm::max(this->spawnInterval - this->timeSinceLastSpawn, 0.0f);
+        this->timeSinceLastSpawn += deltaTime;
+        for (; spawnOffset <= deltaTime; spawnOffset += this->spawnInterval)
+        {
+            const unsigned int first = this->lastParticleSpawned;
+            this->spawnParticles();
+            for (unsigned int i = 0; i < batchSize; i++)
+                this->particles[(first + i) % this->maxAmountofParticles].advance(-spawnOffset, this->globalExternalForce);
+            this->timeSinceLastSpawn = deltaTime - spawnOffset;
+        }
+        this->simulate(deltaTime);
+    }
+}
+
+void ParticleSystem::simulateForceFields(float deltaTime, float time)
+{
+    PROFILE_SCOPE("ParticleSystem::simulateForceFields");
+
+    // The alive particles are gathered into a structure of arrays a chunk at a time, the chunk stays in the cache
+    ForceChunk chunk;
+    unsigned int indices[ForceChunk::capacity];
+    for (unsigned int first = 0; first < this->maxAmountofParticles; first += ForceChunk::capacity)
+    {
+        const unsigned int last = glm::min(first + ForceChunk::capacity, this->maxAmountofParticles);
+        chunk.count = 0;
+        for (unsigned int i = first; i < last; i++)
+        {
+            Particle &particle = this->particles[i];
+            // Dead particles only count down, they would grow the bounding box of the chunk
+            if (!particle.isAlive())
+            {
+                particle.update(deltaTime, this->globalExternalForce);
+                continue;
+            }
+
+            const glm::vec3 position = particle.getPosition();
+            const glm::vec3 velocity = particle.getDirection();
+            indices[chunk.count] = i;
+            chunk.positionX[chunk.count] = position.x;
+            chunk.positionY[chunk.count] = position.y;
+            chunk.positionZ[chunk.count] = position.z;
+            chunk.velocityX[chunk.count] = velocity.x;
+            chunk.velocityY[chunk.count] = velocity.y;
+            chunk.velocityZ[chunk.count] = velocity.z;
+            chunk.count++;
+        }
+
+        evaluateForceFields(this->forceFields, chunk, time);
+
+        for (unsigned int i = 0; i < chunk.count; i++)
+        {
+            const glm::vec3 acceleration(chunk.accelerationX[i], chunk.accelerationY[i], chunk.accelerationZ[i]);
+            this->particles[indices[i]].update(deltaTime, this->globalExternalForce + acceleration);
+        }
+    }
+}
+
+void ParticleSystem::simulateFluid(float deltaTime)
+{
+    PROFILE_SCOPE("ParticleSystem::simulateFluid");
+
+    // The solver is only stable with small steps, the update is split in fixed steps
+    this->fluidTimeAccumulator += deltaTime;
+    unsigned int steps = 0;
+    while (this->fluidTimeAccumulator >= this->fluidParameters.timeStep && steps < maxFluidSteps)
+    {
+        const SpatialHash &spatialHash = this->getSpatialHash(this->fluidParameters.radius);
+        this->fluidSolver.step(this->fluidParameters, spatialHash, this->particles, this->globalExternalForce, this->fluidParameters.timeStep);
+        this->spatialHashBuilt = false;
+        if (!this->colliders.empty())
+            this->collideStatic();
+        this->fluidTimeAccumulator -= this->fluidParameters.timeStep;
+        steps++;
+    }
+    // Drops the time the solver can't catch up with
+    if (steps == maxFluidSteps)
+        this->fluidTimeAccumulator = glm::min(this->fluidTimeAccumulator, this->fluidParameters.timeStep);
+}
+
+void ParticleSystem::simulateSmoke(float deltaTime)
+{
+    PROFILE_SCOPE("ParticleSystem::simulateSmoke");
+
+    if (this->smokeParameters.timeStep <= 0.0f)
+        this->smokeSolver.step(this->smokeParameters, this->position, deltaTime);
+    else
+    {
+        // The grid runs at its own rate, the particles keep sampling the last solved velocity in between
+        this->smokeTimeAccumulator += deltaTime;
+        unsigned int steps = 0;
+        while (this->smokeTimeAccumulator >= this->smokeParameters.timeStep && steps < maxSmokeSteps)
+        {
+            this->smokeSolver.step(this->smokeParameters, this->position, this->smokeParameters.timeStep);
+            this->smokeTimeAccumulator -= this->smokeParameters.timeStep;
+            steps++;
+        }
+        if (steps == maxSmokeSteps)
+            this->smokeTimeAccumulator = glm::min(this->smokeTimeAccumulator, this->smokeParameters.timeStep);
+    }
+    this->smokeSolver.moveParticles(this->smokeParameters, this->particles, this->globalExternalForce, deltaTime);
+}
+
+void ParticleSystem::solveCollisions()
+{
+    PROFILE_SCOPE("ParticleSystem::solveCollisions");
+
+    const float contactDistance = 2.0f * this->collisionRadius;
+    const SpatialHash &spatialHash = this->getSpatialHash(contactDistance);
+    const unsigned int count = spatialHash.getNumberOfParticles();
+
+    // The particles are solved in the order of the hash, so the neighbours are close in memory
+    this->collisionPositions = spatialHash.getSortedPositions();
+    this->collisionCorrections.resize(count);
+    for (unsigned int iteration = 0; iteration < this->collisionIterations; iteration++)
+    {
+        // Jacobi iteration, the corrections only read the positions of the last iteration so the chunks are independent.
+        // The contacts are found around the positions the hash was built with, the particles only move a bit
+        this->forEachChunk(count, [&](unsigned int first, unsigned int end) {
+            for (unsigned int slot = first; slot < end; slot++)
+            {
+                const glm::vec3 position = this->collisionPositions[slot];
+                glm::vec3 correction(0.0f);
+                unsigned int contacts = 0;
+                spatialHash.forEachCandidate(position, contactDistance, [&](unsigned int neighbor) {
+                    const glm::vec3 offset = position - this->collisionPositions[neighbor];
+                    const float distanceSquared = glm::dot(offset, offset);
+                    if (neighbor == slot || distanceSquared >= contactDistance * contactDistance)
+                        return;
+
+                    // Each particle of the contact moves half the overlap, coincident particles are split by their order
+                    const float distance = std::sqrt(distanceSquared);
+                    const glm::vec3 normal = distance > 0.0f ? offset / distance : glm::vec3(0.0f, neighbor < slot ? 1.0f : -1.0f, 0.0f);
+                    correction += normal * (0.5f * (contactDistance - distance));
+                    contacts++;
+                });
+                // The corrections of several contacts are averaged, summed they would overshoot
+                this->collisionCorrections[slot] = contacts > 0 ? correction / (float)contacts : glm::vec3(0.0f);
+            }
+        });
+
+        this->forEachChunk(count, [&](unsigned int first, unsigned int end) {
+            for (unsigned int slot = first; slot < end; slot++)
+                this->collisionPositions[slot] += this->collisionCorrections[slot];
+        });
+    }
+
+    const std::vector<unsigned int> &indices = spatialHash.getSortedIndices();
+    const std::vector<glm::vec3> &positions = spatialHash.getSortedPositions();
+    this->forEachChunk(count, [&](unsigned int first, unsigned int end) {
+        for (unsigned int slot = first; slot < end; slot++)
+            this->particles[indices[slot]].translate(this->collisionPositions[slot] - positions[slot]);
+    });
+    this->spatialHashBuilt = false;
+}
+
+void ParticleSystem::collideStatic()
+{
+    PROFILE_SCOPE("ParticleSystem::collideStatic");
+
+    // Each chunk skips the colliders its particles don't reach
+    this->forEachChunk(this->maxAmountofParticles, [&](unsigned int first, unsigned int end) {
+        collideParticles(this->colliders, &this->particles[first], end - first);
+    });
+}
+
+void ParticleSystem::forEachChunk(unsigned int count, const std::function<void(unsigned int, unsigned int)> &task)
+{
+    const unsigned int chunkSize = 4096;
+    const unsigned int numberOfChunks = (count + chunkSize - 1) / chunkSize;
+    const std::function<void(unsigned int)> chunkTask = [&](unsigned int chunk) {
+        task(chunk * chunkSize, glm::min((chunk + 1) * chunkSize, count));
+    };
+    if (this->threadPool)
+        this->threadPool->parallelFor(numberOfChunks, chunkTask);
+    else
+        for (unsigned int chunk = 0; chunk < numberOfChunks; chunk++)
+            chunkTask(chunk);
+}
+
+void ParticleSystem::allocateParticles()
+{
+    if (!this->particles.empty() || !this->compactParticles.empty() || this->maxAmountofParticles == 0)
+        return;
+
+    PROFILE_SCOPE("ParticleSystem::allocateParticles");
+
+    // Only the storage in use is allocated, the compact bounds start with the spawn volume
+    if (this->compactStorage && this->analyticEvaluation)
+    {
+        this->compactBounds = this->getCompactBounds(NULL, 0);
+        this->compactParticles.assign(this->maxAmountofParticles, Particle().getCompact(this->compactBounds));
+    }
+    else
+        this->particles.resize(this->maxAmountofParticles);
+    this->markInstancesChanged(0, this->maxAmountofParticles);
+}
+
+Particle ParticleSystem::loadParticle(unsigned int index)
+{
+    if (!this->compactParticles.empty())
+        return Particle(this->compactParticles[index], this->compactBounds);
+    // Before they're allocated every particle is dead
+    return this->particles.empty() ? Particle() : this->particles[index];
+}
+
+void ParticleSystem::storeParticle(unsigned int index, const Particle &particle)
+{
+    if (this->compactParticles.empty())
+    {
+        this->particles[index] = particle;
+        return;
+    }
+
+    if (particle.isAlive() && !insideBounds(this->compactBounds, particle))
+        this->growCompactBounds(particle);
+    this->compactParticles[index] = particle.getCompact(this->compactBounds);
+}
+
+CompactBounds ParticleSystem::getCompactBounds(const Particle *particles, unsigned int count)
+{
+    // The bounds start with the spawn volume and every alive particle
+    CompactBounds bounds;
+    bounds.min = this->position - glm::abs(this->positionVariance);
+    bounds.max = this->position + glm::abs(this->positionVariance);
+    bounds.maxScale = glm::max(glm::abs(this->initialScale), glm::abs(this->finalScale)) + glm::abs(this->scaleVariance);
+    for (unsigned int i = 0; i < count; i++)
+    {
+        if (!particles[i].isAlive())
+            continue;
+        bounds.min = glm::min(bounds.min, particles[i].getPosition());
+        bounds.max = glm::max(bounds.max, particles[i].getPosition());
+        bounds.maxScale = glm::max(bounds.maxScale, particles[i].getMaxScale());
+    }
+    return addMargin(bounds);
+}
+
+void ParticleSystem::setCompactParticles(bool compact)
+{
+    // Particles not allocated yet are allocated in the right storage when they're used
+    if (compact == !this->compactParticles.empty() || (this->particles.empty() && this->compactParticles.empty()))
+        return;
+
+    PROFILE_SCOPE("ParticleSystem::setCompactParticles");
+
+    if (!compact)
+    {
+        this->particles.resize(this->maxAmountofParticles);
+        for (unsigned int i = 0; i < this->maxAmountofParticles; i++)
+            this->particles[i] = Particle(this->compactParticles[i], this->compactBounds);
+        std::vector<CompactParticle>().swap(this->compactParticles);
+    }
+    else
+    {
+        this->compactBounds = this->getCompactBounds(this->particles.data(), this->maxAmountofParticles);
+        this->compactParticles.resize(this->maxAmountofParticles);
+        for (unsigned int i = 0; i < this->maxAmountofParticles; i++)
+            this->compactParticles[i] = this->particles[i].getCompact(this->compactBounds);
+        std::vector<Particle>().swap(this->particles);
+    }
+    // The uploaded copy is sized again when it's used
+    std::vector<ParticleInstance>().swap(this->instanceData);
+    this->markInstancesChanged(0, this->maxAmountofParticles);
+}
+
+void ParticleSystem::growCompactBounds(const Particle &particle)
+{
+    PROFILE_SCOPE("ParticleSystem::growCompactBounds");
+
+    CompactBounds bounds = this->compactBounds;
+    bounds.min = glm::min(bounds.min, particle.getPosition());
+    bounds.max = glm::max(bounds.max, particle.getPosition());
+    bounds.maxScale = glm::max(bounds.maxScale, particle.getMaxScale());
+    bounds = addMargin(bounds);
+
+    // Every particle is quantized again, the margin keeps it from happening often
+    for (unsigned int i = 0; i < this->maxAmountofParticles; i++)
+        this->compactParticles[i] = Particle(this->compactParticles[i], this->compactBounds).getCompact(bounds);
+    this->compactBounds = bounds;
+    this->markInstancesChanged(0, this->maxAmountofParticles);
+}
+
 void ParticleSystem::spawnParticle(unsigned int index)
 {
+    this->allocateParticles();
+
+    // Each spawn has its own random sequence, given by the seed and the spawn number
+    const unsigned long long spawnNumber = this->spawnCount++;
+    RandomGenerator random(this->seed, spawnNumber);
+
     // Creates a new random position
-    const glm::vec3 newPosition(randomValue(this->position, this->positionVariance));
+    const glm::vec3 newPosition(randomValue(random, this->position, this->positionVariance));
     //Creates a new random direction
-    const glm::vec3 newDirection(randomValue(this->direction, this->directionVariance));
+    const glm::vec3 newDirection(randomValue(random, this->direction, this->directionVariance));
     // Creates a new random initial and final scale
-    const float newInitialScale = randomValue(this->initialScale, this->scaleVariance);
-    const float newFinalScale = randomValue(this->finalScale, this->scaleVariance);
+    const float newInitialScale = randomValue(random, this->initialScale, this->scaleVariance);
+    const float newFinalScale = randomValue(random, this->finalScale, this->scaleVariance);
     // Creates a new random initial and final color
-    const glm::vec3 newInitialColor(randomValueInterpolated(this->minBaseColor, this->maxBaseColor));
-    const glm::vec3 newFinalColor(randomValueInterpolated(this->minFinalColor, this->maxFinalColor));
+    const glm::vec3 newInitialColor(randomValueInterpolated(random, this->minBaseColor, this->maxBaseColor));
+    const glm::vec3 newFinalColor(randomValueInterpolated(random, this->minFinalColor, this->maxFinalColor));
     // Creates a new random initial and final alpha
-    const float newInitialAlpha = glm::clamp(randomValue(this->initialAlpha, this->alphaVariance),
+    const float newInitialAlpha = glm::clamp(randomValue(random, this->initialAlpha, this->alphaVariance),
                                              0.0f, 1.0f);
-    const float newFinalAlpha = glm::clamp(randomValue(this->finalAlpha, this->alphaVariance),
+    const float newFinalAlpha = glm::clamp(randomValue(random, this->finalAlpha, this->alphaVariance),
                                            0.0f, 1.0f);
 
     // Resets the given particle from the particles array
-    this->particles[index].reset(this->ttl, newPosition, newDirection, newInitialScale, newFinalScale,
-                                 newInitialColor, newFinalColor, newInitialAlpha, newFinalAlpha);
+    Particle particle;
+    particle.reset(this->ttl, newPosition, newDirection, newInitialScale, newFinalScale,
+                   newInitialColor, newFinalColor, newInitialAlpha, newFinalAlpha, (unsigned int)spawnNumber, this->time);
+    this->storeParticle(index, particle);
 }
@@ -6,6 +6,57 @@
 #include "particle.h"
 #include "shader.h"
 #include "camera.h"
+#include "collider.h"
+#include "flock-solver.h"
+#include "smoke-solver.h"
+#include "fluid-solver.h"
+#include "force-field.h"
+#include "gravity-solver.h"
+#include "spatial-hash.h"
+#include "thread-pool.h"
+
+/**
+ * Counters of the last draw of a particle system
+*/
+struct DrawStatistics
+{
+    unsigned int drawCalls; // Number of draw calls issued
+    unsigned int instances; // Number of particles drawn
+    size_t bytesUploaded;   // Bytes sent to the GPU (uniforms and buffers)
+};
+
+/**
+ * Emitter parameters and spawner state of a particle system, everything but the particles
+ * Plain data, so it can be stored as is in binary snapshots
+*/
+struct ParticleSystemState
+{
+    float ttl;                         // Base time to live of the spawned particles
+    glm::vec3 position;                // Position of the particle system
+    glm::vec3 positionVariance;        // Position variance of the particles's intial position
+    float initialScale;                // Particles initial scale
+    float finalScale;                  // Particles final scale
+    float scaleVariance;               // Particles scale variance
+    glm::vec3 direction;               // Base direction of the particles spawned
+    glm::vec3 directionVariance;       // Direction variance of the particles emitted
+    glm::vec3 minBaseColor;            // Min range of the base color for the spawned particles
+    glm::vec3 maxBaseColor;            // Max range of the base color for the spawned particles
+    glm::vec3 minFinalColor;           // Min range of the particles final color
+    glm::vec3 maxFinalColor;           // Max range of the particles final color
+    float initialAlpha;                // Particles initial alpha
+    float finalAlpha;                  // Particles final alpha
+    float alphaVariance;               // Particles alpha variance
+    glm::vec3 globalExternalForce;     // Global force applied to all particles
+    unsigned int maxAmountofParticles; // Maximun amount of particles supported by the particle system
+    unsigned int particlesPerSpawn;    // Number of particles spawned per spwan interval
+    float spawnInterval;               // Time between particles spawn
+    float timeSinceLastSpawn;          // Time since the last particle spawn
+    unsigned int lastParticleSpawned;  // Index of the last particle spawned
+    unsigned int seed;                 // Seed of the random values
+    unsigned long long spawnCount;     // Number of particles spawned since the seed was set
+    float time;                        // Simulated time of the particle system
+    bool analyticEvaluation;           // The particles are evaluated in closed form instead of updated
+};
 
 /**
  * Creates a configurable particle system
@@ -74,14 +125,208 @@ public:
     */
     void setGlobalExternalForce(glm::vec3 globalExternalForce);
     /**
-     * Updates the particle system
+     * Sets the force fields acting on the particles, besides the global force
+     * @param forceFields Force fields, none keeps the motion analytic
+    */
+    void setForceFields(const std::vector<ForceField> &forceFields);
+    /**
+     * Gets the force fields acting on the particles
+     * @return Constant reference to the force fields
+    */
+    const std::vector<ForceField> &getForceFields();
+    /**
+     * Sets the soft collisions between particles, the overlapping particles are pushed apart
+     * The contacts are found with the spatial hash and solved with Jacobi iterations after each update
+     * @param radius Radius of the particles, the particles closer than twice the radius collide
+     * @param iterations Solver iterations per update, 0 disables the collisions
+    */
+    void setCollisions(float radius, unsigned int iterations);
+    /**
+     * Sets the static colliders, the particles touching them bounce off or die after each update
+     * The volumes of the sdf colliders are loaded (once per file)
+     * @param colliders Colliders, none keeps the motion analytic
+    */
+    void setColliders(const std::vector<Collider> &colliders);
+    /**
+     * Gets the static colliders
+     * @return Constant reference to the colliders
+    */
+    const std::vector<Collider> &getColliders();
+    /**
+     * Sets the fluid simulation, the particles are moved as a fluid with fixed time steps instead of on their own
+     * The global force still acts on the fluid particles, the force fields don't
+     * @param parameters Fluid properties, a disabled fluid keeps the motion analytic
+    */
+    void setFluid(const FluidParameters &parameters);
+    /**
+     * Sets the gravity between the particles, the particles are moved by the Barnes-Hut solver once per update
+     * The global force still acts on the particles, the force fields don't. The fluid has priority over the gravity
+     * @param parameters Gravity properties, a disabled gravity keeps the motion analytic
+    */
+    void setGravity(const GravityParameters &parameters);
+    /**
+     * Sets the flocking behavior, the particles steer with their neighbours and towards a target once per update
+     * The global force still acts on the particles, the force fields don't. The fluid and the gravity have priority over the flock
+     * @param parameters Flock properties, a disabled flock keeps the motion analytic
+    */
+    void setFlock(const FlockParameters &parameters);
+    /**
+     * Sets the smoke grid, its velocity is solved around the emitter and the particles inside it are carried by it
+     * The global force acts on the particles, inside the grid its drag bounds the drift. The force fields don't act,
+     * the fluid, the gravity and the flock have priority over the smoke
+     * @param parameters Smoke properties, a disabled smoke keeps the motion analytic
+    */
+    void setSmoke(const SmokeParameters &parameters);
+    /**
+     * Sets if the particles are evaluated in closed form instead of updated every step
+     * The particles keep the state they had when they were spawned and are evaluated for the current
+     * time when they're used, the update only spawns. The motion is only analytic with a constant force,
+     * when the force changes the particles store their current state again. While force fields act on
+     * the particles or they collide they're updated every step.
+     * @param analyticEvaluation The particles are evaluated in closed form
+    */
+    void setAnalyticEvaluation(bool analyticEvaluation);
+    /**
+     * Checks if the particles are evaluated in closed form
+     * @return The particles are evaluated in closed form, false while force fields act on them or they collide
+    */
+    bool isAnalyticEvaluation();
+    /**
+     * Gets the simulated time
+     * @return Time of the particle system in seconds
+    */
+    float getTime();
+    /**
+     * Sets if the particles are stored quantized (CompactParticle), about half the memory of a particle
+     * It only applies to the analytic evaluation, where the stored states don't change while the
+     * particles live, so they're quantized once. The compact particles are also the instance data.
+     * Set before the first update the particles are allocated quantized, later they're converted.
+     * @param compactStorage The particles are stored quantized
+    */
+    void setCompactStorage(bool compactStorage);
+    /**
+     * Checks if the particles are stored quantized
+     * @return The compact storage is enabled, it's only used with the analytic evaluation
+    */
+    bool isCompactStorage();
+    /**
+     * Gets the memory used by the particles
+     * @return Bytes of the stored and uploaded particles arrays
+    */
+    size_t getMemoryUsage();
+    /**
+     * Updates the particle system, spawns the new particles (emit) and moves every particle (simulate)
      * @param deltaTime Time since the last update
     */
     void update(float deltaTime);
+    /**
+     * Spawns the particles due in this update
+     * @param deltaTime Time since the last update
+     * @return Number of particles spawned
+    */
+    unsigned int emit(float deltaTime);
+    /**
+     * Updates every particle, with the analytic evaluation only the time advances
+     * @param deltaTime Time since the last update
+    */
+    void simulate(float deltaTime);
+    /**
+     * Advances the particle system as if it was updated for some time, used to start effects in their
+     * steady state
+     * The spawns whose particles would be dead or recycled at the end aren't simulated, only the
+     * spawn sequence moves forward. The rest of the particles are advanced in a single closed form
+     * step when the motion is analytic, otherwise the particle system is updated in steps of 0.05 seconds
+     * from the first spawn kept, each step spawns every batch due inside it. The particles spawned
+     * inside a step are moved with the global force back to their spawn time, the rest of the forces
+     * act on them for the whole step.
+     * @param seconds Time to be advanced
+    */
+    void prewarm(float seconds);
+    /**
+     * Spawns a new particle
+     * Sets all the base properties of a give particle
+     * @param index Particle's index to be spawned
+    */
+    void spawnParticle(unsigned int index);
     /**
      * Draws the particles of the particle system
     */
     void draw(Shader *shader, unsigned int quadVAO);
+    /**
+     * Draws the particles with a single instanced draw call, the shader evaluates them in closed form
+     * Only the particles spawned since the last draw are uploaded. The analytic shader has to be in use,
+     * with the camera and texture uniforms set
+     * @param shader Analytic particles shader, its time and force uniforms are set
+     * @param quadVBO Vertex buffer of the particle quad (position and color)
+    */
+    void drawAnalytic(Shader *shader, unsigned int quadVBO);
+    /**
+     * Reads a range of the particles of the particle system, dead or alive
+     * The updated particles are read as they're stored, with the analytic evaluation they're evaluated for the
+     * current time into the buffer on each call. No copy of every particle is kept, the readers go through
+     * the particles a chunk at a time. Ranges can be read in parallel
+     * @param first Index of the first particle
+     * @param count Number of particles, the range can't go past the max amount of particles
+     * @param buffer Where the particles are evaluated if they can't be read as they are, room for count
+     * @return The particles of the range, valid until the particle system changes
+    */
+    const Particle *getParticles(unsigned int first, unsigned int count, Particle *buffer);
+    /**
+     * Gets the maximum amount of particles
+     * @return Number of particles of the particle system, dead or alive
+    */
+    unsigned int getMaxAmountOfParticles();
+    /**
+     * Sets the threads the work over every particle is split across
+     * @param threadPool Worker threads, NULL runs everything on the calling thread
+    */
+    void setThreadPool(ThreadPool *threadPool);
+    /**
+     * Gets the spatial hash of the alive particles, it's rebuilt if the particles changed since it was built
+     * @param cellSize Size of the cells, usually the radius of the queries
+     * @return Spatial hash of the current particles
+    */
+    const SpatialHash &getSpatialHash(float cellSize);
+    /**
+     * Gets the camera used to draw the particles
+     * @return Camera's pointer
+    */
+    Camera *getCamera();
+    /**
+     * Sets the seed of the random values, the spawn sequence starts again
+     * The same seed, time steps and parameters give the same particles on every run
+     * @param seed Random seed
+    */
+    void setSeed(unsigned int seed);
+    /**
+     * Gets the seed of the random values
+     * @return Random seed
+    */
+    unsigned int getSeed();
+    /**
+     * Computes a hash of the simulation state, used to check that runs are reproducible
+     * @return Hash of the spawner state and every particle
+    */
+    unsigned long long computeStateHash();
+    /**
+     * Gets the emitter parameters and the spawner state
+     * @return Current state, without the particles
+    */
+    ParticleSystemState getState();
+    /**
+     * Restores a saved state, the particles not given are set as dead
+     * @param state Emitter parameters and spawner state, its max amount of particles has to match the particle system
+     * @param indices Index of each given particle in the particles array
+     * @param particles Particles to be restored
+     * @param count Number of particles given
+     * @return The state was restored, false if it doesn't match the particle system
+    */
+    bool restore(const ParticleSystemState &state, const unsigned int *indices, const Particle *particles, unsigned int count);
+    /**
+     * Gets the counters of the last draw
+     * @return Constant reference to the draw counters
+    */
+    const DrawStatistics &getDrawStatistics();
 
 private:
     /**
@@ -90,12 +335,95 @@ private:
     */
     void spawnParticles();
     /**
-     * Spawns a new particle
-     * Sets all the base properties of a give particle
-     * @param index Particle's index to be spawned
+     * Checks if the particles motion has a closed form
+     * @return Only a constant force acts on the particles, there are no force fields, collisions, colliders, fluid, gravity, flock or smoke
     */
-    void spawnParticle(unsigned int index);
-
+    bool hasAnalyticMotion();
+    /**
+     * Switches between the analytic evaluation and the update when the evaluation is enabled or the
+     * motion stops or starts being analytic
+    */
+    void updateEvaluationMode();
+    /**
+     * Updates the particle system with steps of the prewarm step, spawning every batch due inside each step
+     * @param seconds Time to update
+    */
+    void updateFor(float seconds);
+    /**
+     * Updates every particle with the force fields, a chunk of particles at once
+     * @param deltaTime Time since the last update
+     * @param time Time the step starts at, moves the turbulence
+    */
+    void simulateForceFields(float deltaTime, float time);
+    /**
+     * Runs the fluid solver steps that fit in the time since the last update, the rest is kept for the next one
+     * @param deltaTime Time since last update
+    */
+    void simulateFluid(float deltaTime);
+    /**
+     * Advances the smoke grid, every update or with its fixed time step, and moves the particles with its velocity
+     * @param deltaTime Time since last update
+    */
+    void simulateSmoke(float deltaTime);
+    /**
+     * Pushes the overlapping particles apart
+    */
+    void solveCollisions();
+    /**
+     * Collides the particles with the static colliders
+    */
+    void collideStatic();
+    /**
+     * Runs a task over chunks of a range, in parallel with the thread pool
+     * @param count Number of elements
+     * @param task Called with the first and the end element of each chunk
+    */
+    void forEachChunk(unsigned int count, const std::function<void(unsigned int, unsigned int)> &task);
+    /**
+     * Allocates the particles the first time they're used, all dead, in the storage the evaluation and the
+     * compact storage select. Setting up a compact particle system never allocates the full precision particles
+    */
+    void allocateParticles();
+    /**
+     * Gets a stored particle
+     * @param index Particle's index
+     * @return Copy of the particle, restored from its compact state with the compact storage
+    */
+    Particle loadParticle(unsigned int index);
+    /**
+     * Stores a particle, the compact bounds grow if the particle is outside them
+     * @param index Particle's index
+     * @param particle Particle to be stored
+    */
+    void storeParticle(unsigned int index, const Particle &particle);
+    /**
+     * Gets the range of the quantized values for some particles
+     * @param particles Particles the bounds hold, the dead ones are skipped
+     * @param count Number of particles
+     * @return Spawn volume and the alive particles, with a margin to grow
+    */
+    CompactBounds getCompactBounds(const Particle *particles, unsigned int count);
+    /**
+     * Moves the particles between the full and the compact arrays, nothing is done before they're allocated
+     * @param compact The particles are moved to the compact array
+    */
+    void setCompactParticles(bool compact);
+    /**
+     * Grows the compact bounds to include a particle and quantizes every particle again
+     * @param particle Particle outside the bounds
+    */
+    void growCompactBounds(const Particle &particle);
+    /**
+     * Marks particles to be uploaded to the instance buffer
+     * @param first Index of the first particle
+     * @param count Number of particles, they wrap around the end of the array
+    */
+    void markInstancesChanged(unsigned int first, unsigned int count);
+    /**
+     * Uploads the changed particles to the instance buffer
+     * @return Bytes uploaded
+    */
+    size_t uploadInstances();
     Camera *camera; // Camera's pointers used to draw the particles
 
     float ttl; // Base time to live of the spawned particles
@@ -126,7 +454,52 @@ private:
     float timeSinceLastSpawn;         // Time since the last particle spawn
     unsigned int lastParticleSpawned; // Index of the last particle spawned
 
-    glm::vec3 globalExternalForce; // Sets a global director force to all particles (i.e gravity)
+    unsigned int seed;            // Seed of the random values
+    unsigned long long spawnCount; // Number of particles spawned since the seed was set, selects the random sequence
+
+    glm::vec3 globalExternalForce;       // Sets a global director force to all particles (i.e gravity)
+    std::vector<ForceField> forceFields; // Force fields acting on the particles
+
+    float collisionRadius;                       // Radius of the colliding particles
+    unsigned int collisionIterations;            // Collision solver iterations per update, 0 disables the collisions
+    std::vector<glm::vec3> collisionPositions;   // Positions being solved, in the order of the spatial hash
+    std::vector<glm::vec3> collisionCorrections; // Displacement of each particle in the current iteration
+    std::vector<Collider> colliders;             // Static colliders, prepared
+
+    FluidParameters fluidParameters; // Properties of the fluid
+    FluidSolver fluidSolver;         // Moves the particles when the fluid is enabled
+    float fluidTimeAccumulator;      // Time not simulated yet by the fluid solver
+
+    GravityParameters gravityParameters; // Properties of the gravity between the particles
+    GravitySolver gravitySolver;         // Moves the particles when the gravity is enabled
+
+    FlockParameters flockParameters; // Properties of the flocking behavior
+    FlockSolver flockSolver;         // Moves the particles when the flock is enabled
+
+    SmokeParameters smokeParameters; // Properties of the smoke grid
+    SmokeSolver smokeSolver;         // Solves the grid and moves the particles when the smoke is enabled
+    float smokeTimeAccumulator;      // Time not simulated yet by the smoke solver, with a fixed time step
+
+    std::vector<Particle> particles; // All the particles in the system dead or alive, empty with the compact storage or before they're used
+
+    bool compactStorage;                           // The particles are stored quantized with the analytic evaluation
+    std::vector<CompactParticle> compactParticles; // All the particles quantized, only with the compact storage
+    CompactBounds compactBounds;                   // Range of the quantized values
+
+    float time;                     // Simulated time
+    bool analyticEvaluationEnabled; // The analytic evaluation is used while the motion is analytic
+    bool analyticEvaluation;        // The particles are evaluated in closed form instead of updated
+
+    unsigned int instanceVAO;                   // Quad geometry with the instance attributes, created on the first analytic draw
+    unsigned int instanceVBO;                   // Stored state of every particle, ParticleInstance or CompactParticle each
+    bool compactInstances;                      // The instance buffer holds compact particles
+    std::vector<ParticleInstance> instanceData; // Changed particles being uploaded
+    unsigned int changedInstancesBegin;         // First particle not uploaded yet
+    unsigned int changedInstances;              // Number of particles not uploaded yet
+
+    ThreadPool *threadPool;  // Threads the work over every particle is split across, NULL runs it on the calling thread
+    SpatialHash spatialHash; // Alive particles sorted by cell, built when it's used
+    bool spatialHashBuilt;   // The spatial hash has the current particles
 
-    std::vector<Particle> particles; // All the particles in the system dead or alive
+    DrawStatistics drawStatistics; // Counters of the last draw
 };
\ No newline at end of file
@@ -1,5 +1,17 @@
 #include "particle.h"
 #include <iostream>
+#include <glm/gtc/packing.hpp>
+
+unsigned long long hashBytes(unsigned long long hash, const void *data, size_t size)
+{
+    const unsigned char *bytes = (const unsigned char *)data;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
 
 Particle::Particle()
 {
@@ -7,6 +19,29 @@ Particle::Particle()
     this->ttl = 0;
     this->liveTime = 0;
     this->alive = false;
+    this->id = 0;
+    this->stateTime = 0;
+}
+
+Particle::Particle(const CompactParticle &compact, const CompactBounds &bounds)
+{
+    const glm::vec3 size = bounds.max - bounds.min;
+    for (int i = 0; i < 3; i++)
+    {
+        this->position[i] = bounds.min[i] + glm::unpackUnorm1x16(compact.position[i]) * size[i];
+        this->direction[i] = glm::unpackHalf1x16(compact.direction[i]);
+    }
+    this->initialScale = glm::unpackSnorm1x16(compact.initialScale) * bounds.maxScale;
+    this->finalScale = glm::unpackSnorm1x16(compact.finalScale) * bounds.maxScale;
+    this->initialColor = glm::vec3(compact.initialColor[0], compact.initialColor[1], compact.initialColor[2]) / 255.0f;
+    this->finalColor = glm::vec3(compact.finalColor[0], compact.finalColor[1], compact.finalColor[2]) / 255.0f;
+    this->initialAlpha = compact.initialColor[3] / 255.0f;
+    this->finalAlpha = compact.finalColor[3] / 255.0f;
+    this->stateTime = compact.stateTime;
+    this->ttl = compact.ttl;
+    this->liveTime = compact.liveTime;
+    this->id = compact.id;
+    this->alive = this->ttl > 0.0f;
 }
 
 void Particle::update(float deltaTime, glm::vec3 externalForce)
@@ -25,30 +60,60 @@ void Particle::update(float deltaTime, glm::vec3 externalForce)
     this->direction += externalForce * deltaTime;
 }
 
-void Particle::draw(Shader *shader, Camera *camera)
+void Particle::advance(float time, glm::vec3 externalForce)
 {
+    this->ttl -= time;
+    this->alive = this->ttl > 0.0f;
+
     if (!this->alive)
         return;
 
-    // Computes its remaining live fraction
-	const float t = glm::clamp(1.0f - this->ttl / this->liveTime, 0.0f, 1.0f);
+    this->position += this->direction * time + 0.5f * externalForce * time * time;
+    this->direction += externalForce * time;
+}
 
-    // Computes the particle current scale given its live fraction
-    const float currentScale = glm::mix(this->initialScale, this->finalScale, t);
-    // Computes the particle current alpha given its live fraction
-    const float alpha = glm::mix(this->initialAlpha, this->finalAlpha, t);
-	
-   // Computes the particle current color given its live fraction
-    const glm::vec3 currentColor = glm::mix(this->initialColor, this->finalColor, t);
+Particle Particle::evaluate(float time, glm::vec3 externalForce) const
+{
+    Particle particle = *this;
+    if (particle.alive)
+        particle.advance(time - this->stateTime, externalForce);
+    particle.stateTime = time;
+    return particle;
+}
+
+void Particle::setStateTime(float time)
+{
+    this->stateTime = time;
+}
+
+ParticleInstance Particle::getInstance() const
+{
+    ParticleInstance instance;
+    instance.position = this->position;
+    instance.stateTime = this->stateTime;
+    instance.direction = this->direction;
+    instance.ttl = this->alive ? this->ttl : 0.0f;
+    instance.initialColor = glm::vec4(this->initialColor, this->initialAlpha);
+    instance.finalColor = glm::vec4(this->finalColor, this->finalAlpha);
+    instance.initialScale = this->initialScale;
+    instance.finalScale = this->finalScale;
+    instance.liveTime = this->liveTime;
+    return instance;
+}
+
+void Particle::draw(Shader *shader, Camera *camera) const
+{
+    if (!this->alive)
+        return;
 
     // Computes the orientation of the particle and sets its model matrix in the shader
     shader->setMat4("model", this->computeBillBoardMatrix(camera));
     // Sets the color and scale in the shader
-    shader->setFloat("scale", currentScale);
-    shader->setVec4("color", glm::vec4(currentColor.r, currentColor.g, currentColor.b, alpha));
+    shader->setFloat("scale", this->getScale());
+    shader->setVec4("color", this->getColor());
 }
 
-void Particle::reset(float liveTime, glm::vec3 position, glm::vec3 direction, float initialScale, float finalScale, glm::vec3 initialColor, glm::vec3 finalColor, float initialAlpha, float finalAlpha)
+void Particle::reset(float liveTime, glm::vec3 position, glm::vec3 direction, float initialScale, float finalScale, glm::vec3 initialColor, glm::vec3 finalColor, float initialAlpha, float finalAlpha, unsigned int id, float stateTime)
 {
     // Reset all the particle's properties
     this->liveTime = liveTime;
@@ -61,11 +126,47 @@ void Particle::reset(float liveTime, glm::vec3 position, glm::vec3 direction, fl
     this->finalColor = finalColor;
     this->initialAlpha = initialAlpha;
     this->finalAlpha = finalAlpha;
+    this->id = id;
+    this->stateTime = stateTime;
     // Sets the particle as alive
     this->alive = true;
 }
 
-glm::mat4 Particle::computeBillBoardMatrix(Camera *camera)
+CompactParticle Particle::getCompact(const CompactBounds &bounds) const
+{
+    // Dead particles are only kept for their identifier
+    CompactParticle compact = CompactParticle();
+    compact.id = this->id;
+    if (!this->alive)
+        return compact;
+
+    const glm::vec3 size = bounds.max - bounds.min;
+    for (int i = 0; i < 3; i++)
+    {
+        compact.position[i] = glm::packUnorm1x16(size[i] > 0.0f ? (this->position[i] - bounds.min[i]) / size[i] : 0.0f);
+        compact.direction[i] = glm::packHalf1x16(this->direction[i]);
+    }
+    compact.initialScale = glm::packSnorm1x16(bounds.maxScale > 0.0f ? this->initialScale / bounds.maxScale : 0.0f);
+    compact.finalScale = glm::packSnorm1x16(bounds.maxScale > 0.0f ? this->finalScale / bounds.maxScale : 0.0f);
+    compact.stateTime = this->stateTime;
+    compact.ttl = this->ttl;
+    compact.liveTime = this->liveTime;
+    for (int i = 0; i < 3; i++)
+    {
+        compact.initialColor[i] = glm::packUnorm1x8(this->initialColor[i]);
+        compact.finalColor[i] = glm::packUnorm1x8(this->finalColor[i]);
+    }
+    compact.initialColor[3] = glm::packUnorm1x8(this->initialAlpha);
+    compact.finalColor[3] = glm::packUnorm1x8(this->finalAlpha);
+    return compact;
+}
+
+float Particle::getMaxScale() const
+{
+    return glm::max(glm::abs(this->initialScale), glm::abs(this->finalScale));
+}
+
+glm::mat4 Particle::computeBillBoardMatrix(Camera *camera) const
 {
     /**
      *  See https://nehe.gamedev.net/article/billboarding_how_to/18011/  
@@ -107,7 +208,98 @@ glm::mat4 Particle::computeBillBoardMatrix(Camera *camera)
     return billboardModelMatrix;
 }
 
-glm::vec3 Particle::getPosition()
+glm::vec3 Particle::getPosition() const
 {
     return this->position;
-}
\ No newline at end of file
+}
+
+glm::vec3 Particle::getDirection() const
+{
+    return this->direction;
+}
+
+unsigned int Particle::getId() const
+{
+    return this->id;
+}
+
+void Particle::translate(glm::vec3 offset)
+{
+    this->position += offset;
+}
+
+void Particle::setDirection(glm::vec3 direction)
+{
+    this->direction = direction;
+}
+
+void Particle::kill()
+{
+    this->alive = false;
+    this->ttl = 0.0f;
+}
+
+void Particle::fade(float seconds)
+{
+    if (this->ttl <= seconds)
+        return;
+    if (seconds <= 0.0f)
+    {
+        this->kill();
+        return;
+    }
+
+    // The live time shrinks with the time to live, so the live fraction stays the same
+    this->liveTime *= seconds / this->ttl;
+    this->ttl = seconds;
+}
+
+bool Particle::isAlive() const
+{
+    return this->alive;
+}
+
+float Particle::getLifeFraction() const
+{
+    // Computes its remaining live fraction
+    return glm::clamp(1.0f - this->ttl / this->liveTime, 0.0f, 1.0f);
+}
+
+float Particle::getScale() const
+{
+    // Computes the particle current scale given its live fraction
+    return glm::mix(this->initialScale, this->finalScale, this->getLifeFraction());
+}
+
+glm::vec4 Particle::getColor() const
+{
+    const float t = this->getLifeFraction();
+
+    // Computes the particle current color and alpha given its live fraction
+    const glm::vec3 currentColor = glm::mix(this->initialColor, this->finalColor, t);
+    const float alpha = glm::mix(this->initialAlpha, this->finalAlpha, t);
+
+    return glm::vec4(currentColor.r, currentColor.g, currentColor.b, alpha);
+}
+
+unsigned long long Particle::hash(unsigned long long hash) const
+{
+    hash = hashBytes(hash, &this->alive, sizeof(this->alive));
+    if (!this->alive)
+        return hash;
+
+    hash = hashBytes(hash, &this->ttl, sizeof(this->ttl));
+    hash = hashBytes(hash, &this->id, sizeof(this->id));
+
+    hash = hashBytes(hash, &this->position, sizeof(this->position));
+    hash = hashBytes(hash, &this->direction, sizeof(this->direction));
+    hash = hashBytes(hash, &this->initialScale, sizeof(this->initialScale));
+    hash = hashBytes(hash, &this->finalScale, sizeof(this->finalScale));
+    hash = hashBytes(hash, &this->initialColor, sizeof(this->initialColor));
+    hash = hashBytes(hash, &this->finalColor, sizeof(this->finalColor));
+    hash = hashBytes(hash, &this->initialAlpha, sizeof(this->initialAlpha));
+    hash = hashBytes(hash, &this->finalAlpha, sizeof(this->finalAlpha));
+    hash = hashBytes(hash, &this->liveTime, sizeof(this->liveTime));
+    hash = hashBytes(hash, &this->stateTime, sizeof(this->stateTime));
+    return hash;
+}
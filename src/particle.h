@@ -4,6 +4,61 @@
 #include "shader.h"
 #include "camera.h"
 
+/**
+ * Adds some bytes to a FNV-1a hash
+ * @param hash Current hash
+ * @param data Bytes to be added
+ * @param size Number of bytes
+ * @return Updated hash
+*/
+unsigned long long hashBytes(unsigned long long hash, const void *data, size_t size);
+
+/**
+ * Stored state of a particle laid out as instance data, the analytic shader evaluates it for the current time
+*/
+struct ParticleInstance
+{
+    glm::vec3 position;     // Position at the state time
+    float stateTime;        // Time of the particle system when the state was stored
+    glm::vec3 direction;    // Direction at the state time
+    float ttl;              // Time to live at the state time, 0 for dead particles
+    glm::vec4 initialColor; // Initial color and alpha
+    glm::vec4 finalColor;   // Final color and alpha
+    float initialScale;     // Initial scale
+    float finalScale;       // Final scale
+    float liveTime;         // Full live time
+};
+
+/**
+ * Range of the quantized values of the compact particles
+*/
+struct CompactBounds
+{
+    glm::vec3 min;  // Minimun stored position
+    glm::vec3 max;  // Maximun stored position
+    float maxScale; // Maximun absolute scale, scales are stored as a fraction of it
+};
+
+/**
+ * Stored state of a particle quantized to 40 bytes, used as is for the CPU storage and as instance data
+ * Positions are 16 bits fixed point inside the bounds, directions half floats, scales 16 bits normalized
+ * to the maximun scale (negative scales mirror the quad) and colors RGBA8 with the alpha. Times keep their full precision, they grow with
+ * the simulated time.
+*/
+struct CompactParticle
+{
+    unsigned short position[3];    // Position at the state time, fixed point inside the bounds
+    short initialScale;            // Initial scale, signed fraction of the maximun scale
+    unsigned short direction[3];   // Direction at the state time, half floats
+    short finalScale;              // Final scale, signed fraction of the maximun scale
+    float stateTime;               // Time of the particle system when the state was stored
+    float ttl;                     // Time to live at the state time, 0 for dead particles
+    float liveTime;                // Full live time
+    unsigned char initialColor[4]; // Initial color and alpha
+    unsigned char finalColor[4];   // Final color and alpha
+    unsigned int id;               // Particle's identifier
+};
+
 class Particle
 {
 public:
@@ -11,18 +66,79 @@ public:
      * Creates a new particle
     */
     Particle();
+    /**
+     * Restores a particle from its compact state
+     * @param compact Quantized particle
+     * @param bounds Range of the quantized values
+    */
+    Particle(const CompactParticle &compact, const CompactBounds &bounds);
     /**
      * Updates the particle properties
      * @param deltaTime Time since last update
      * @param externalForce Force to be applied to the particle direction over time (i.e gravity)
     */
     void update(float deltaTime, glm::vec3 externalForce);
+    /**
+     * Advances the particle in a single step with the closed form motion under a constant force
+     * p = p0 + v0 * t + F * t^2 / 2, the stepped update approaches it as the time step gets smaller
+     * @param time Time to be advanced
+     * @param externalForce Constant force applied to the particle direction
+    */
+    void advance(float time, glm::vec3 externalForce);
+    /**
+     * Evaluates the particle at a time of the particle system, from its stored state
+     * The motion has to be analytic: only a constant force since the state time
+     * @param time Time of the particle system
+     * @param externalForce Constant force applied to the particle direction
+     * @return Particle at the given time, its state time is the given time
+    */
+    Particle evaluate(float time, glm::vec3 externalForce) const;
+    /**
+     * Moves the particle without changing its direction
+     * @param offset Displacement of the particle
+    */
+    void translate(glm::vec3 offset);
+    /**
+     * Sets the particle's direction
+     * @param direction Particle's new velocity
+    */
+    void setDirection(glm::vec3 direction);
+    /**
+     * Kills the particle before its time to live runs out
+    */
+    void kill();
+    /**
+     * Shortens the rest of the particle's life, the colors and scales keep their current value and reach their final one sooner
+     * @param seconds Time to live of the particle, the particles with less time left don't change
+    */
+    void fade(float seconds);
+    /**
+     * Sets the time of the particle system when the particle state is valid
+     * @param time Time of the particle system
+    */
+    void setStateTime(float time);
+    /**
+     * Gets the stored state of the particle as instance data
+     * @return Instance data, dead particles have no time to live
+    */
+    ParticleInstance getInstance() const;
+    /**
+     * Quantizes the stored state of the particle, the values outside the bounds are clamped
+     * @param bounds Range of the quantized values
+     * @return Compact particle, dead particles have no time to live
+    */
+    CompactParticle getCompact(const CompactBounds &bounds) const;
+    /**
+     * Gets the particle's largest scale
+     * @return Maximun absolute value of the initial and final scales
+    */
+    float getMaxScale() const;
     /**
      * Sets all the uniforms of the particles
      * @param shader Shader used to render the particle
      * @param camera Camera used to render the particle
     */
-    void draw(Shader *shader, Camera *camera);
+    void draw(Shader *shader, Camera *camera) const;
     /**
      * Resets all the particles properties, sets it alive
      * @param liveTime Particle's live time in seconds
@@ -34,24 +150,65 @@ public:
      * @param finalColor Particle's color at its life end
      * @param initialAlpha Particle's alpha at its life begin
      * @param finalAlpha Particle's alpha at its life end
+     * @param id Particle's identifier, stays the same while the particle lives
+     * @param stateTime Time of the particle system when the particle is spawned
     */
     void reset(float liveTime, glm::vec3 position, glm::vec3 direction, float initialScale, float finalScale,
-               glm::vec3 initialColor, glm::vec3 finalColor, float initialAlpha, float finalAlpha);
+               glm::vec3 initialColor, glm::vec3 finalColor, float initialAlpha, float finalAlpha, unsigned int id = 0,
+               float stateTime = 0.0f);
     /**
      * Gets the particle's position
      * @return Particle's position
     */
-    glm::vec3 getPosition();
-
-private:
+    glm::vec3 getPosition() const;
+    /**
+     * Gets the particle's direction
+     * @return Particle's velocity
+    */
+    glm::vec3 getDirection() const;
+    /**
+     * Gets the particle's identifier
+     * @return Spawn number of the particle, the particles spawned later have higher ids (until it wraps around)
+    */
+    unsigned int getId() const;
+    /**
+     * Gets the particle's status
+     * @return The particle is alive
+    */
+    bool isAlive() const;
+    /**
+     * Computes the particle's current scale given its live fraction
+     * @return Particle's current scale
+    */
+    float getScale() const;
+    /**
+     * Computes the particle's current color and alpha given its live fraction
+     * @return Particle's current color (rgb) and alpha (a)
+    */
+    glm::vec4 getColor() const;
     /**
      * Computes the model matrix used orient the particle to face the camera
      * @param camera Camera to which the camera will face
      * @return Model matrix to orient the particle towards the camera
     */
-    glm::mat4 computeBillBoardMatrix(Camera *camera);
+    glm::mat4 computeBillBoardMatrix(Camera *camera) const;
+    /**
+     * Adds the particle's state to a FNV-1a hash
+     * Dead particles only add their status, their other properties aren't used until they're respawned
+     * @param hash Current hash
+     * @return Updated hash
+    */
+    unsigned long long hash(unsigned long long hash) const;
+
+private:
+    /**
+     * Computes the particle's live fraction
+     * @return 0 when the particle is spawned, 1 when it dies
+    */
+    float getLifeFraction() const;
 
     bool alive;             // Particle's status
+    unsigned int id;        // Particle's identifier (spawn number)
     glm::vec3 position;     // Particle's position
     glm::vec3 direction;    // Particle's direction
     float initialScale;     // Particle's initial scale
@@ -62,4 +219,5 @@ private:
     float finalAlpha;       // Particle's final alpha
     float ttl;              // Particle's time to live (seconds)
     float liveTime;         // Particle's initial full live time (seconds)
+    float stateTime;        // Time of the particle system when the state was stored (analytic evaluation)
 };
\ No newline at end of file
@@ -0,0 +1,168 @@
+#include "perf-counters.h"
+
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <cstdint>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace
+{
+/**
+ * Opens a disabled counter of the calling thread
+ * @param type Event type (PERF_TYPE_*)
+ * @param config Event of the type
+ * @return File descriptor, -1 on error (errno is set)
+*/
+int openCounter(uint32_t type, uint64_t config)
+{
+    perf_event_attr attributes;
+    memset(&attributes, 0, sizeof(attributes));
+    attributes.size = sizeof(attributes);
+    attributes.type = type;
+    attributes.config = config;
+    attributes.disabled = 1;
+    // Counting the kernel usually needs privileges
+    attributes.exclude_kernel = 1;
+    attributes.exclude_hv = 1;
+    // Times to scale the value if the counter is multiplexed
+    attributes.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    return (int)syscall(__NR_perf_event_open, &attributes, 0, -1, -1, 0);
+}
+} // namespace
+
+PerfCounters::PerfCounters()
+{
+    const uint32_t types[NUMBER_OF_PERF_COUNTERS] = {
+        PERF_TYPE_HARDWARE,
+        PERF_TYPE_HARDWARE,
+        PERF_TYPE_HW_CACHE,
+        PERF_TYPE_HARDWARE,
+        PERF_TYPE_HARDWARE};
+    const uint64_t configs[NUMBER_OF_PERF_COUNTERS] = {
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+        PERF_COUNT_HW_CACHE_MISSES,
+        PERF_COUNT_HW_BRANCH_MISSES};
+
+    for (int i = 0; i < NUMBER_OF_PERF_COUNTERS; i++)
+    {
+        this->totals[i] = 0.0;
+        this->fileDescriptors[i] = openCounter(types[i], configs[i]);
+
+        if (this->fileDescriptors[i] < 0 && this->error.empty())
+        {
+            this->error = std::string(getName((PerfCounter)i)) + ": " + strerror(errno);
+            if (errno == EACCES || errno == EPERM)
+                this->error += " (check /proc/sys/kernel/perf_event_paranoid)";
+        }
+    }
+}
+
+PerfCounters::~PerfCounters()
+{
+    for (int i = 0; i < NUMBER_OF_PERF_COUNTERS; i++)
+        if (this->fileDescriptors[i] >= 0)
+            close(this->fileDescriptors[i]);
+}
+
+void PerfCounters::start()
+{
+    for (int i = 0; i < NUMBER_OF_PERF_COUNTERS; i++)
+    {
+        if (this->fileDescriptors[i] < 0)
+            continue;
+        ioctl(this->fileDescriptors[i], PERF_EVENT_IOC_RESET, 0);
+        ioctl(this->fileDescriptors[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+void PerfCounters::stop()
+{
+    for (int i = 0; i < NUMBER_OF_PERF_COUNTERS; i++)
+        if (this->fileDescriptors[i] >= 0)
+            ioctl(this->fileDescriptors[i], PERF_EVENT_IOC_DISABLE, 0);
+
+    for (int i = 0; i < NUMBER_OF_PERF_COUNTERS; i++)
+    {
+        if (this->fileDescriptors[i] < 0)
+            continue;
+
+        // Value, time enabled, time running
+        uint64_t values[3];
+        if (read(this->fileDescriptors[i], values, sizeof(values)) != sizeof(values))
+            continue;
+
+        // The counter only ran part of the time, the value is extrapolated
+        if (values[2] > 0 && values[2] < values[1])
+            this->totals[i] += (double)values[0] * values[1] / values[2];
+        else
+            this->totals[i] += (double)values[0];
+    }
+}
+
+#else
+
+PerfCounters::PerfCounters()
+{
+    for (int i = 0; i < NUMBER_OF_PERF_COUNTERS; i++)
+    {
+        this->fileDescriptors[i] = -1;
+        this->totals[i] = 0.0;
+    }
+    this->error = "Hardware counters are only supported on Linux";
+}
+
+PerfCounters::~PerfCounters()
+{
+}
+
+void PerfCounters::start()
+{
+}
+
+void PerfCounters::stop()
+{
+}
+
+#endif
+
+void PerfCounters::reset()
+{
+    for (int i = 0; i < NUMBER_OF_PERF_COUNTERS; i++)
+        this->totals[i] = 0.0;
+}
+
+bool PerfCounters::isAvailable(PerfCounter counter)
+{
+    return this->fileDescriptors[counter] >= 0;
+}
+
+bool PerfCounters::isAvailable()
+{
+    for (int i = 0; i < NUMBER_OF_PERF_COUNTERS; i++)
+        if (this->fileDescriptors[i] >= 0)
+            return true;
+    return false;
+}
+
+double PerfCounters::getValue(PerfCounter counter)
+{
+    return this->totals[counter];
+}
+
+const std::string &PerfCounters::getError()
+{
+    return this->error;
+}
+
+const char *PerfCounters::getName(PerfCounter counter)
+{
+    const char *names[NUMBER_OF_PERF_COUNTERS] = {"cycles", "instructions", "L1D misses", "LLC misses", "branch misses"};
+    return names[counter];
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <string>
+
+/**
+ * Hardware events counted by PerfCounters
+*/
+enum PerfCounter
+{
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_L1D_MISSES,
+    PERF_LLC_MISSES,
+    PERF_BRANCH_MISSES,
+    NUMBER_OF_PERF_COUNTERS
+};
+
+/**
+ * Counts hardware events (cycles, instructions, cache and branch misses) of the calling thread
+ * with perf_event_open, only user space code is counted.
+ * The counters are accumulated between start() and stop(), so a section can be measured over many frames.
+ * Counters that can't be opened (other platforms, containers, perf_event_paranoid) are reported
+ * as unavailable and read as 0, the caller keeps working without them.
+*/
+class PerfCounters
+{
+public:
+    /**
+     * Opens the counters, disabled
+    */
+    PerfCounters();
+    /**
+     * Closes the counters
+    */
+    ~PerfCounters();
+    PerfCounters(const PerfCounters &) = delete;
+    PerfCounters &operator=(const PerfCounters &) = delete;
+    /**
+     * Starts counting
+    */
+    void start();
+    /**
+     * Stops counting, adds the events since start() to the totals
+    */
+    void stop();
+    /**
+     * Sets the totals to 0
+    */
+    void reset();
+    /**
+     * Checks if a counter could be opened
+     * @param counter Counter to be checked
+     * @return The counter is counting
+    */
+    bool isAvailable(PerfCounter counter);
+    /**
+     * Checks if any counter could be opened
+     * @return At least one counter is counting
+    */
+    bool isAvailable();
+    /**
+     * Gets the events counted
+     * When the kernel multiplexes the counters the value is scaled to the whole measured time
+     * @param counter Counter to be read
+     * @return Total events between every start() and stop(), 0 if the counter isn't available
+    */
+    double getValue(PerfCounter counter);
+    /**
+     * Gets why the counters aren't available
+     * @return Error of the first counter that couldn't be opened, empty if every counter is available
+    */
+    const std::string &getError();
+    /**
+     * Gets the name of a counter
+     * @param counter Counter
+     * @return Counter name
+    */
+    static const char *getName(PerfCounter counter);
+
+private:
+    int fileDescriptors[NUMBER_OF_PERF_COUNTERS]; // Counter of each event, -1 if it isn't available
+    double totals[NUMBER_OF_PERF_COUNTERS];       // Events counted
+    std::string error;                            // Why a counter couldn't be opened
+};
@@ -0,0 +1,208 @@
+#include "profiler.h"
+
+#ifdef ENABLE_PROFILER
+
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+/**
+ * Zone recorded by a thread
+*/
+struct Event
+{
+    const char *name; // Zone name
+    int64_t start;    // Start ticks
+    int64_t end;      // End ticks
+};
+
+// The events are stored in blocks so the buffer grows without moving the recorded events
+const size_t eventsPerBlock = 16384;
+// Limit of events per thread and capture (16M), later events are dropped
+const size_t maxBlocks = 1024;
+
+/**
+ * Events of a thread, written only by its thread
+ * The number of events is published with release semantics, so the events below it
+ * can be read from other threads once the capture is stopped. It's stored with the capture
+ * it belongs to, a thread starts its buffer again the first time it records in a new capture
+ * and the events of an older capture are never read
+*/
+struct ThreadBuffer
+{
+    std::atomic<uint64_t> state;    // Capture the events belong to (high 32 bits) and number of events (low 32 bits)
+    Event *blocks[maxBlocks];       // Event blocks, allocated on demand
+    std::string name;               // Thread name shown in the trace
+    unsigned int id;                // Thread id shown in the trace
+};
+
+std::mutex registryMutex;            // Protects the list of buffers and the thread names
+std::vector<ThreadBuffer *> buffers; // Buffers of every thread that recorded a zone, never freed
+std::atomic<uint32_t> captureGeneration(0);              // Incremented by every capture, tells its events apart from the older ones
+int64_t captureStartTicks = 0;                           // Profiler ticks when the capture started
+std::chrono::steady_clock::time_point captureStartTime; // Time when the capture started, used to calibrate the ticks
+
+thread_local ThreadBuffer *threadBuffer = NULL; // Buffer of the calling thread
+
+/**
+ * Gets the calling thread's buffer, creating it the first time
+ * @return Buffer of the calling thread
+*/
+ThreadBuffer *getThreadBuffer()
+{
+    if (threadBuffer)
+        return threadBuffer;
+
+    ThreadBuffer *buffer = new ThreadBuffer();
+    buffer->state.store(0);
+    for (size_t i = 0; i < maxBlocks; i++)
+        buffer->blocks[i] = NULL;
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+    buffer->id = (unsigned int)buffers.size() + 1;
+    buffer->name = "Thread " + std::to_string(buffer->id);
+    buffers.push_back(buffer);
+
+    threadBuffer = buffer;
+    return buffer;
+}
+
+/**
+ * Gets the number of events a thread recorded in the current capture
+ * @param buffer Buffer of the thread
+ * @return Number of events, 0 if the thread didn't record in the current capture
+*/
+size_t getCount(const ThreadBuffer *buffer)
+{
+    const uint64_t state = buffer->state.load(std::memory_order_acquire);
+    return (uint32_t)(state >> 32) == captureGeneration.load(std::memory_order_relaxed) ? (size_t)(uint32_t)state : 0;
+}
+
+/**
+ * Writes a string as a JSON string
+ * @param output Where the string is written
+ * @param text String to be written
+*/
+void writeJsonString(std::ostream &output, const char *text)
+{
+    output << '"';
+    for (const char *c = text; *c; c++)
+    {
+        if (*c == '"' || *c == '\\')
+            output << '\\';
+        output << *c;
+    }
+    output << '"';
+}
+} // namespace
+
+std::atomic<bool> Profiler::capturing(false);
+
+void Profiler::start()
+{
+    // The buffers aren't touched, the threads may be recording. The events of the previous capture are left behind
+    // by the new generation, each thread starts its buffer again when it records
+    std::lock_guard<std::mutex> lock(registryMutex);
+    captureGeneration.fetch_add(1, std::memory_order_acq_rel);
+
+    captureStartTime = std::chrono::steady_clock::now();
+    captureStartTicks = ticks();
+    capturing.store(true, std::memory_order_release);
+}
+
+bool Profiler::stop(const std::string &path)
+{
+    capturing.store(false, std::memory_order_release);
+
+    // Ticks per microsecond, measured over the whole capture
+    const std::chrono::duration<double, std::micro> captureTime = std::chrono::steady_clock::now() - captureStartTime;
+    const int64_t captureTicks = ticks() - captureStartTicks;
+    const double ticksPerMicrosecond = captureTime.count() > 0.0 && captureTicks > 0 ? captureTicks / captureTime.count() : 1000.0;
+
+    std::ofstream file(path.c_str());
+    if (!file.is_open())
+        return false;
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+
+    // Complete events ("X") in microseconds, plus the threads' names
+    file << std::fixed << std::setprecision(3);
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    for (size_t i = 0; i < buffers.size(); i++)
+    {
+        const ThreadBuffer *buffer = buffers[i];
+
+        file << (first ? "\n" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->id
+             << ",\"args\":{\"name\":";
+        writeJsonString(file, buffer->name.c_str());
+        file << "}}";
+        first = false;
+
+        const size_t count = getCount(buffer);
+        for (size_t j = 0; j < count; j++)
+        {
+            const Event &event = buffer->blocks[j / eventsPerBlock][j % eventsPerBlock];
+            // Zones opened before the capture started, in the previous one, are left out
+            if (event.start < captureStartTicks)
+                continue;
+            file << ",\n{\"name\":";
+            writeJsonString(file, event.name);
+            file << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->id
+                 << ",\"ts\":" << (event.start - captureStartTicks) / ticksPerMicrosecond
+                 << ",\"dur\":" << (event.end - event.start) / ticksPerMicrosecond << "}";
+        }
+    }
+    file << "\n]}\n";
+
+    return file.good();
+}
+
+void Profiler::setThreadName(const std::string &name)
+{
+    ThreadBuffer *buffer = getThreadBuffer();
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+    buffer->name = name;
+}
+
+size_t Profiler::getNumberOfZones()
+{
+    std::lock_guard<std::mutex> lock(registryMutex);
+
+    size_t zones = 0;
+    for (size_t i = 0; i < buffers.size(); i++)
+        zones += getCount(buffers[i]);
+    return zones;
+}
+
+void Profiler::record(const char *name, int64_t start, int64_t end)
+{
+    ThreadBuffer *buffer = getThreadBuffer();
+
+    // The first event of a new capture starts the buffer again
+    const uint32_t generation = captureGeneration.load(std::memory_order_acquire);
+    const uint64_t state = buffer->state.load(std::memory_order_relaxed);
+    const size_t index = (uint32_t)(state >> 32) == generation ? (size_t)(uint32_t)state : 0;
+    const size_t block = index / eventsPerBlock;
+    if (block >= maxBlocks)
+        return;
+
+    // Blocks are kept between captures, they're only allocated the first time they're needed
+    if (!buffer->blocks[block])
+        buffer->blocks[block] = new Event[eventsPerBlock];
+
+    Event &event = buffer->blocks[block][index % eventsPerBlock];
+    event.name = name;
+    event.start = start;
+    event.end = end;
+
+    // Publishes the event with its capture, a thread that read the generation before a new capture started
+    // publishes it under the old one and it's ignored
+    buffer->state.store((uint64_t)generation << 32 | (uint64_t)(index + 1), std::memory_order_release);
+}
+
+#endif
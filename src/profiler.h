@@ -0,0 +1,132 @@
+#pragma once
+
+/**
+ * Scoped CPU profiler
+ * Code is instrumented with PROFILE_SCOPE("Name") zones, every zone records its start and end time
+ * while a capture is running. Each thread writes its zones to its own buffer, without locks,
+ * and the capture is written as a Chrome trace event JSON (chrome://tracing, ui.perfetto.dev).
+ * The profiler is compiled only when ENABLE_PROFILER is defined, otherwise the macros expand to nothing.
+ *
+ * Zone names must be string literals (or live as long as the capture), only the pointer is stored
+*/
+
+#ifdef ENABLE_PROFILER
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// The time stamp counter is read on x86, it's much cheaper than the system clock
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define PROFILER_USE_TSC
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+#define PROFILE_CONCATENATE_(a, b) a##b
+#define PROFILE_CONCATENATE(a, b) PROFILE_CONCATENATE_(a, b)
+
+// Measures the enclosing scope
+#define PROFILE_SCOPE(name) ProfileZone PROFILE_CONCATENATE(profileZone, __LINE__)(name)
+// Measures the enclosing function
+#define PROFILE_FUNCTION() PROFILE_SCOPE(__func__)
+// Names the calling thread in the trace
+#define PROFILE_THREAD_NAME(name) Profiler::setThreadName(name)
+
+class Profiler
+{
+public:
+    /**
+     * Starts a capture, discards the zones of the previous capture
+     * Other threads can be recording zones, the ones of the previous capture are never written
+    */
+    static void start();
+    /**
+     * Stops the capture and writes it as a Chrome trace event JSON
+     * Must be called from the thread that started it, the zones other threads finish while it's written may be left out
+     * @param path Path to the trace file
+     * @return The trace was written
+    */
+    static bool stop(const std::string &path);
+    /**
+     * Checks if a capture is running
+     * @return A capture is running
+    */
+    static bool isCapturing()
+    {
+        return capturing.load(std::memory_order_relaxed);
+    }
+    /**
+     * Names the calling thread in the trace
+     * @param name Thread name
+    */
+    static void setThreadName(const std::string &name);
+    /**
+     * Gets the number of zones recorded in the current capture
+     * @return Number of zones of every thread
+    */
+    static size_t getNumberOfZones();
+    /**
+     * Gets the current time of the profiler clock
+     * The ticks are converted to time when the trace is written
+     * @return Time stamp counter on x86, nanoseconds of the steady clock otherwise
+    */
+    static int64_t ticks()
+    {
+#ifdef PROFILER_USE_TSC
+        return (int64_t)__rdtsc();
+#else
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+    /**
+     * Records a finished zone in the calling thread's buffer
+     * @param name Zone name
+     * @param start Start ticks
+     * @param end End ticks
+    */
+    static void record(const char *name, int64_t start, int64_t end);
+
+private:
+    static std::atomic<bool> capturing; // Zones are being recorded
+};
+
+/**
+ * Measures a scope, the zone is recorded when it's destroyed
+ * Zones opened while no capture is running aren't recorded
+*/
+class ProfileZone
+{
+public:
+    explicit ProfileZone(const char *name) : start(0)
+    {
+        this->name = Profiler::isCapturing() ? name : NULL;
+        if (this->name)
+            this->start = Profiler::ticks();
+    }
+
+    ~ProfileZone()
+    {
+        if (this->name)
+            Profiler::record(this->name, this->start, Profiler::ticks());
+    }
+
+    ProfileZone(const ProfileZone &) = delete;
+    ProfileZone &operator=(const ProfileZone &) = delete;
+
+private:
+    const char *name; // Zone name, NULL if the zone isn't recorded
+    int64_t start;    // Start ticks
+};
+
+#else
+
+#define PROFILE_SCOPE(name)
+#define PROFILE_FUNCTION()
+#define PROFILE_THREAD_NAME(name)
+
+#endif
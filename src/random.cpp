@@ -0,0 +1,63 @@
+#include "random.h"
+
+namespace
+{
+/**
+ * SplitMix64 finalizer, scrambles the bits of a value
+*/
+unsigned long long mix(unsigned long long value)
+{
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+    return value ^ (value >> 31);
+}
+} // namespace
+
+RandomGenerator::RandomGenerator(unsigned long long seed, unsigned long long stream)
+{
+    // Each stream starts at an unrelated point of the seed's sequence
+    this->state = mix(seed + 0x9E3779B97F4A7C15ull) ^ mix(stream * 0xD1B54A32D192ED03ull + 1);
+}
+
+unsigned long long RandomGenerator::next()
+{
+    this->state += 0x9E3779B97F4A7C15ull;
+    return mix(this->state);
+}
+
+float RandomGenerator::nextFloat()
+{
+    // 24 bits, every value is exactly representable as a float
+    return (float)(this->next() >> 40) * (1.0f / 16777216.0f);
+}
+
+float randomValue(RandomGenerator &random, float baseValue, float variance)
+{
+    float value = random.nextFloat() * 2.0f - 1.0f;
+    return baseValue + variance * value;
+}
+
+glm::vec3 randomValue(RandomGenerator &random, glm::vec3 baseValue, glm::vec3 variance)
+{
+    // The components are generated in order, x, y, z
+    const float x = randomValue(random, baseValue.x, variance.x);
+    const float y = randomValue(random, baseValue.y, variance.y);
+    const float z = randomValue(random, baseValue.z, variance.z);
+    return glm::vec3(x, y, z);
+}
+
+float randomValueInterpolated(RandomGenerator &random, float min, float max)
+{
+    float value = random.nextFloat();
+
+    return glm::mix(min, max, value);
+}
+
+glm::vec3 randomValueInterpolated(RandomGenerator &random, glm::vec3 min, glm::vec3 max)
+{
+    // The components are generated in order, x, y, z
+    const float x = randomValueInterpolated(random, min.x, max.x);
+    const float y = randomValueInterpolated(random, min.y, max.y);
+    const float z = randomValueInterpolated(random, min.z, max.z);
+    return glm::vec3(x, y, z);
+}
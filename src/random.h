@@ -0,0 +1,69 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+/**
+ * Counter based random number generator (SplitMix64)
+ * Every stream of a seed is independent, so a particle's random values only depend on the seed
+ * and its spawn number, not on the order in which other particles were spawned or on the thread
+ * that spawns it. The same seed and stream always give the same sequence, on every platform.
+*/
+class RandomGenerator
+{
+public:
+    /**
+     * Creates a generator
+     * @param seed Random seed
+     * @param stream Sequence of the seed (i.e spawn number)
+    */
+    RandomGenerator(unsigned long long seed, unsigned long long stream = 0);
+    /**
+     * Gets the next random bits
+     * @return 64 random bits
+    */
+    unsigned long long next();
+    /**
+     * Gets the next random number in [0, 1)
+     * @return Random number
+    */
+    float nextFloat();
+
+private:
+    unsigned long long state; // Counter of the generator
+};
+
+/**
+ * Computes a random number from a base a variance
+ * @param random Random number generator
+ * @param baseValue Median number of the random
+ * @param variance Variance of the random centered of the baseValue
+ * @return Random number in the range [baseValue - variance, baseValue + variance]
+*/
+float randomValue(RandomGenerator &random, float baseValue, float variance);
+
+/**
+ * Computes a random vector from a base a variance
+ * @param random Random number generator
+ * @param baseValue Median vector of the random
+ * @param variance Variance of the random centered of the baseValue
+ * @return Random vector in the range [baseValue - variance, baseValue + variance]
+*/
+glm::vec3 randomValue(RandomGenerator &random, glm::vec3 baseValue, glm::vec3 variance);
+
+/**
+ * Builds a random number between the range [min, max]
+ * @param random Random number generator
+ * @param min Minimun posible random value
+ * @param max Maximun posible random value
+ * @return Random number in the range [min, max]
+*/
+float randomValueInterpolated(RandomGenerator &random, float min, float max);
+
+/**
+ * Builds a random vector between the range [min, max]
+ * @param random Random number generator
+ * @param min Minimun posible random value
+ * @param max Maximun posible random value
+ * @return Random vector in the range [min, max]
+*/
+glm::vec3 randomValueInterpolated(RandomGenerator &random, glm::vec3 min, glm::vec3 max);
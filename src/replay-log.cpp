@@ -0,0 +1,222 @@
+#include "replay-log.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+
+#include "profiler.h"
+
+ReplayRecorder::ReplayRecorder()
+{
+    this->lastDeltaTime = 0.0f;
+    this->steps = 0;
+}
+
+bool ReplayRecorder::start(const std::string &path, unsigned int seed)
+{
+    this->stop();
+
+    this->file.open(path.c_str());
+    if (!this->file)
+    {
+        std::cout << "Unable to write the replay log " << path << std::endl;
+        return false;
+    }
+
+    // Enough digits to read every float back exactly
+    this->file.precision(9);
+    this->file << "seed " << seed << std::endl;
+
+    this->lastProperties.clear();
+    this->lastDeltaTime = 0.0f;
+    this->steps = 0;
+    return true;
+}
+
+void ReplayRecorder::stop()
+{
+    if (!this->file.is_open())
+        return;
+
+    this->file << this->steps << " end" << std::endl;
+    this->file.close();
+}
+
+bool ReplayRecorder::isRecording()
+{
+    return this->file.is_open();
+}
+
+void ReplayRecorder::recordStep(float deltaTime, const MenuProperties &properties)
+{
+    if (!this->file.is_open())
+        return;
+
+    PROFILE_SCOPE("ReplayRecorder::recordStep");
+
+    this->recordProperties(properties);
+    if (deltaTime != this->lastDeltaTime)
+    {
+        this->file << this->steps << " dt " << deltaTime << std::endl;
+        this->lastDeltaTime = deltaTime;
+    }
+    this->steps++;
+}
+
+void ReplayRecorder::recordReload(const MenuProperties &properties)
+{
+    if (!this->file.is_open())
+        return;
+
+    // The properties the particle system is built with go first
+    this->recordProperties(properties);
+    this->file << this->steps << " reload" << std::endl;
+}
+
+unsigned long long ReplayRecorder::getSteps()
+{
+    return this->steps;
+}
+
+void ReplayRecorder::recordProperties(const MenuProperties &properties)
+{
+    std::stringstream text;
+    text.precision(9);
+    writeProperties(text, properties);
+
+    std::string line;
+    for (size_t i = 0; std::getline(text, line); i++)
+    {
+        if (i < this->lastProperties.size() && this->lastProperties[i] == line)
+            continue;
+
+        this->file << this->steps << " set " << line << std::endl;
+        if (i < this->lastProperties.size())
+            this->lastProperties[i] = line;
+        else
+            this->lastProperties.push_back(line);
+    }
+}
+
+ReplayPlayer::ReplayPlayer(Camera *camera)
+{
+    this->camera = camera;
+    this->particleSystem = NULL;
+    this->properties = MenuProperties();
+    this->seed = 0;
+    this->deltaTime = 0.0f;
+    this->nextEvent = 0;
+    this->steps = 0;
+    this->recordedSteps = 0;
+}
+
+ReplayPlayer::~ReplayPlayer()
+{
+    delete this->particleSystem;
+}
+
+bool ReplayPlayer::load(const std::string &path)
+{
+    std::ifstream file(path.c_str());
+    if (!file)
+    {
+        std::cout << "Unable to open the replay log " << path << std::endl;
+        return false;
+    }
+
+    std::string line;
+    if (!std::getline(file, line) || line.compare(0, 5, "seed ") != 0)
+    {
+        std::cout << "Invalid replay log " << path << std::endl;
+        return false;
+    }
+    this->seed = (unsigned int)strtoul(line.c_str() + 5, NULL, 10);
+
+    this->events.clear();
+    while (std::getline(file, line))
+    {
+        std::istringstream stream(line);
+        Event event;
+        if (!(stream >> event.step >> event.type))
+            continue;
+
+        if (event.type == "set")
+        {
+            // The value is the rest of the line, it can contain spaces
+            stream >> event.key;
+            std::getline(stream >> std::ws, event.value);
+        }
+        else if (event.type == "dt")
+            stream >> event.value;
+        else if (event.type == "end")
+            this->recordedSteps = event.step;
+
+        this->events.push_back(event);
+    }
+
+    delete this->particleSystem;
+    this->particleSystem = NULL;
+    this->nextEvent = 0;
+    this->steps = 0;
+    return true;
+}
+
+bool ReplayPlayer::step()
+{
+    if (this->steps >= this->recordedSteps)
+        return false;
+
+    // Applies the events recorded before this step, in order
+    while (this->nextEvent < this->events.size() && this->events[this->nextEvent].step <= this->steps)
+    {
+        const Event &event = this->events[this->nextEvent++];
+        if (event.type == "set")
+            storeProperty(event.key, event.value, this->properties);
+        else if (event.type == "dt")
+            this->deltaTime = (float)atof(event.value.c_str());
+        else if (event.type == "reload")
+        {
+            delete this->particleSystem;
+            this->particleSystem = new ParticleSystem(this->properties.maxParticles, this->camera);
+            this->particleSystem->setSeed(this->seed);
+            // Same order as the application: the reloaded particle system is configured and prewarmed
+            applyProperties(this->particleSystem, this->properties);
+            this->particleSystem->prewarm(this->properties.prewarmTime);
+        }
+    }
+
+    // Same order as the application: the properties are applied before every update
+    if (this->particleSystem)
+    {
+        applyProperties(this->particleSystem, this->properties);
+        this->particleSystem->update(this->deltaTime);
+    }
+    this->steps++;
+    return true;
+}
+
+void ReplayPlayer::run()
+{
+    while (this->step())
+        ;
+}
+
+ParticleSystem *ReplayPlayer::getParticleSystem()
+{
+    return this->particleSystem;
+}
+
+const MenuProperties &ReplayPlayer::getProperties()
+{
+    return this->properties;
+}
+
+unsigned long long ReplayPlayer::getSteps()
+{
+    return this->steps;
+}
+
+unsigned long long ReplayPlayer::getRecordedSteps()
+{
+    return this->recordedSteps;
+}
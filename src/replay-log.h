@@ -0,0 +1,146 @@
+#pragma once
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "camera.h"
+#include "configuration.h"
+#include "particle-system.h"
+
+/**
+ * Records every input of a simulation (seed, time steps, parameter changes and particle system
+ * reloads) so it can be replayed with bitwise identical particles.
+ * The log is a text file, one event per line prefixed by the step it happens before:
+ *   seed <seed>
+ *   <step> set <key> <value>   A property changed (configuration file syntax)
+ *   <step> dt <seconds>        The time step changed
+ *   <step> reload              The particle system was rebuilt with the current properties and the seed
+ *   <step> end                 Last step of the recording
+ * The floats are written with 9 significant digits so they're read back exactly.
+*/
+class ReplayRecorder
+{
+public:
+    ReplayRecorder();
+    /**
+     * Starts a recording
+     * The caller has to rebuild the particle system with the seed (recordReload) before the first step
+     * @param path Path to the log file
+     * @param seed Seed of the particle system
+     * @return The file was opened
+    */
+    bool start(const std::string &path, unsigned int seed);
+    /**
+     * Finishes the recording
+    */
+    void stop();
+    /**
+     * Checks if a recording is running
+     * @return A recording is running
+    */
+    bool isRecording();
+    /**
+     * Records a simulation step, logs the properties and time step changed since the last step
+     * Has to be called before each particle system update
+     * @param deltaTime Time step of the update
+     * @param properties Properties applied to the particle system
+    */
+    void recordStep(float deltaTime, const MenuProperties &properties);
+    /**
+     * Records a rebuild of the particle system
+     * @param properties Properties the particle system is rebuilt with
+    */
+    void recordReload(const MenuProperties &properties);
+    /**
+     * Gets the number of recorded steps
+     * @return Steps since the recording started
+    */
+    unsigned long long getSteps();
+
+private:
+    /**
+     * Logs the properties changed since the last logged ones
+     * @param properties Current properties
+    */
+    void recordProperties(const MenuProperties &properties);
+
+    std::ofstream file;                      // Log file
+    std::vector<std::string> lastProperties; // Last logged properties, one "key value" per line
+    float lastDeltaTime;                     // Last logged time step
+    unsigned long long steps;                // Recorded steps
+};
+
+/**
+ * Replays a recorded simulation
+*/
+class ReplayPlayer
+{
+public:
+    /**
+     * Creates a player
+     * @param camera Camera given to the replayed particle system
+    */
+    ReplayPlayer(Camera *camera);
+    /**
+     * Deletes the replayed particle system
+    */
+    ~ReplayPlayer();
+    /**
+     * Reads a log
+     * @param path Path to the log file
+     * @return The log was read
+    */
+    bool load(const std::string &path);
+    /**
+     * Runs the next recorded step
+     * @return A step was run, false at the end of the recording
+    */
+    bool step();
+    /**
+     * Runs every remaining step
+    */
+    void run();
+    /**
+     * Gets the replayed particle system
+     * @return Particle system, NULL before the first reload
+    */
+    ParticleSystem *getParticleSystem();
+    /**
+     * Gets the properties at the current step
+     * @return Replayed properties
+    */
+    const MenuProperties &getProperties();
+    /**
+     * Gets the number of steps run
+     * @return Steps run
+    */
+    unsigned long long getSteps();
+    /**
+     * Gets the number of steps of the recording
+     * @return Recorded steps
+    */
+    unsigned long long getRecordedSteps();
+
+private:
+    /**
+     * Recorded event
+    */
+    struct Event
+    {
+        unsigned long long step; // Step the event happens before
+        std::string type;        // set, dt, reload or end
+        std::string key;         // Property name of set events
+        std::string value;       // Property or time step value
+    };
+
+    Camera *camera;                 // Camera given to the particle system
+    ParticleSystem *particleSystem; // Replayed particle system
+    MenuProperties properties;      // Properties at the current step
+    unsigned int seed;              // Recorded seed
+    float deltaTime;                // Current time step
+    std::vector<Event> events;      // Recorded events, in order
+    size_t nextEvent;               // First event not applied yet
+    unsigned long long steps;       // Steps run
+    unsigned long long recordedSteps; // Steps of the recording
+};
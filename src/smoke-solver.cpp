@@ -0,0 +1,280 @@
+#include "smoke-solver.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "profiler.h"
+
+namespace
+{
+// Particles moved by each task of the thread pool
+const unsigned int chunkSize = 4096;
+// Cells along each axis the grid can't go over, bounds its memory and its cost
+const int maxResolution = 128;
+// Cells along each axis the grid has at least, the trilinear interpolation needs two
+const int minResolution = 2;
+} // namespace
+
+SmokeSolver::SmokeSolver(ThreadPool *threadPool)
+{
+    this->threadPool = threadPool;
+    this->boundsMin = glm::vec3(0.0f);
+    this->boundsMax = glm::vec3(0.0f);
+    this->cellSize = 0.0f;
+    this->resolution = glm::ivec3(0);
+}
+
+void SmokeSolver::setThreadPool(ThreadPool *threadPool)
+{
+    this->threadPool = threadPool;
+}
+
+void SmokeSolver::reset()
+{
+    std::fill(this->velocityX.begin(), this->velocityX.end(), 0.0f);
+    std::fill(this->velocityY.begin(), this->velocityY.end(), 0.0f);
+    std::fill(this->velocityZ.begin(), this->velocityZ.end(), 0.0f);
+    std::fill(this->temperature.begin(), this->temperature.end(), 0.0f);
+    std::fill(this->pressure.begin(), this->pressure.end(), 0.0f);
+}
+
+void SmokeSolver::resize(const SmokeParameters &parameters)
+{
+    if (parameters.boundsMin == this->boundsMin && parameters.boundsMax == this->boundsMax && parameters.cellSize == this->cellSize)
+        return;
+
+    this->boundsMin = parameters.boundsMin;
+    this->boundsMax = parameters.boundsMax;
+    this->cellSize = parameters.cellSize;
+    const glm::vec3 cells = glm::ceil((this->boundsMax - this->boundsMin) / this->cellSize);
+    this->resolution = glm::clamp(glm::ivec3(cells), glm::ivec3(minResolution), glm::ivec3(maxResolution));
+
+    const size_t count = (size_t)this->resolution.x * this->resolution.y * this->resolution.z;
+    std::vector<float> *fields[] = {&this->velocityX, &this->velocityY, &this->velocityZ, &this->temperature,
+                                    &this->nextVelocityX, &this->nextVelocityY, &this->nextVelocityZ, &this->nextTemperature,
+                                    &this->divergence, &this->pressure, &this->nextPressure};
+    for (std::vector<float> *field : fields)
+        field->assign(count, 0.0f);
+}
+
+void SmokeSolver::step(const SmokeParameters &parameters, glm::vec3 source, float deltaTime)
+{
+    PROFILE_SCOPE("SmokeSolver::step");
+
+    this->resize(parameters);
+    const int nx = this->resolution.x;
+    const int ny = this->resolution.y;
+    const glm::vec3 cellExtent = (this->boundsMax - this->boundsMin) / glm::vec3(this->resolution);
+    const float sourceRadiusSquared = parameters.sourceRadius * parameters.sourceRadius;
+
+    // Heat of the source and buoyancy
+    this->forEachSlab([&](int z) {
+        for (int y = 0; y < ny; y++)
+        {
+            size_t cell = (size_t)nx * (y + (size_t)ny * z);
+            for (int x = 0; x < nx; x++, cell++)
+            {
+                const glm::vec3 center = this->boundsMin + (glm::vec3(x, y, z) + 0.5f) * cellExtent;
+                const glm::vec3 offset = center - source;
+                if (glm::dot(offset, offset) < sourceRadiusSquared)
+                    this->temperature[cell] = glm::max(this->temperature[cell], parameters.sourceTemperature);
+                this->velocityY[cell] += parameters.buoyancy * this->temperature[cell] * deltaTime;
+            }
+        }
+    });
+
+    // Semi-Lagrangian advection, each cell takes the values found back along its velocity
+    const glm::vec3 cellsPerUnit = 1.0f / cellExtent;
+    const float coolingFactor = std::exp(-parameters.cooling * deltaTime);
+    this->forEachSlab([&](int z) {
+        for (int y = 0; y < ny; y++)
+        {
+            size_t cell = (size_t)nx * (y + (size_t)ny * z);
+            for (int x = 0; x < nx; x++, cell++)
+            {
+                const glm::vec3 velocity(this->velocityX[cell], this->velocityY[cell], this->velocityZ[cell]);
+                // The four fields share the cell and the weights of the position
+                size_t corner;
+                glm::vec3 weights;
+                this->locate(glm::vec3(x, y, z) - velocity * cellsPerUnit * deltaTime, corner, weights);
+                this->nextVelocityX[cell] = this->interpolate(this->velocityX, corner, weights);
+                this->nextVelocityY[cell] = this->interpolate(this->velocityY, corner, weights);
+                this->nextVelocityZ[cell] = this->interpolate(this->velocityZ, corner, weights);
+                this->nextTemperature[cell] = this->interpolate(this->temperature, corner, weights) * coolingFactor;
+            }
+        }
+    });
+    this->velocityX.swap(this->nextVelocityX);
+    this->velocityY.swap(this->nextVelocityY);
+    this->velocityZ.swap(this->nextVelocityZ);
+    this->temperature.swap(this->nextTemperature);
+
+    this->project(parameters.pressureIterations);
+}
+
+void SmokeSolver::project(int iterations)
+{
+    PROFILE_SCOPE("SmokeSolver::project");
+
+    const int nx = this->resolution.x;
+    const int ny = this->resolution.y;
+    const int nz = this->resolution.z;
+    const size_t strideY = nx;
+    const size_t strideZ = (size_t)nx * ny;
+    const glm::vec3 cellExtent = (this->boundsMax - this->boundsMin) / glm::vec3(this->resolution);
+    // The solve assumes cubic cells, the average size is close enough for the slightly stretched ones of the bounds
+    const float h = (cellExtent.x + cellExtent.y + cellExtent.z) / 3.0f;
+
+    // Divergence by central differences, the velocity outside the grid is the one of the border
+    this->forEachSlab([&](int z) {
+        for (int y = 0; y < ny; y++)
+        {
+            size_t cell = strideY * y + strideZ * z;
+            for (int x = 0; x < nx; x++, cell++)
+            {
+                const float right = this->velocityX[x + 1 < nx ? cell + 1 : cell];
+                const float left = this->velocityX[x > 0 ? cell - 1 : cell];
+                const float up = this->velocityY[y + 1 < ny ? cell + strideY : cell];
+                const float down = this->velocityY[y > 0 ? cell - strideY : cell];
+                const float front = this->velocityZ[z + 1 < nz ? cell + strideZ : cell];
+                const float back = this->velocityZ[z > 0 ? cell - strideZ : cell];
+                this->divergence[cell] = (right - left + up - down + front - back) * (0.5f / h);
+            }
+        }
+    });
+
+    // Jacobi iterations of the pressure Poisson equation, the previous step's pressure is the initial guess
+    // The rows outside the grid read a row of zeros and the first and the last cell of a row are done apart,
+    // so the cells inside a row are summed in a loop the compiler vectorizes
+    const float h2 = h * h;
+    const std::vector<float> zeros(nx, 0.0f);
+    for (int iteration = 0; iteration < iterations; iteration++)
+    {
+        this->forEachSlab([&](int z) {
+            for (int y = 0; y < ny; y++)
+            {
+                const size_t row = strideY * y + strideZ * z;
+                const float *center = &this->pressure[row];
+                const float *up = y + 1 < ny ? center + strideY : zeros.data();
+                const float *down = y > 0 ? center - strideY : zeros.data();
+                const float *front = z + 1 < nz ? center + strideZ : zeros.data();
+                const float *back = z > 0 ? center - strideZ : zeros.data();
+                const float *divergence = &this->divergence[row];
+                float *next = &this->nextPressure[row];
+                next[0] = (center[1] + up[0] + down[0] + front[0] + back[0] - divergence[0] * h2) * (1.0f / 6.0f);
+                for (int x = 1; x < nx - 1; x++)
+                    next[x] = (center[x + 1] + center[x - 1] + up[x] + down[x] + front[x] + back[x] - divergence[x] * h2) * (1.0f / 6.0f);
+                const int last = nx - 1;
+                next[last] = (center[last - 1] + up[last] + down[last] + front[last] + back[last] - divergence[last] * h2) * (1.0f / 6.0f);
+            }
+        });
+        this->pressure.swap(this->nextPressure);
+    }
+
+    // Subtracts the pressure gradient
+    this->forEachSlab([&](int z) {
+        for (int y = 0; y < ny; y++)
+        {
+            size_t cell = strideY * y + strideZ * z;
+            for (int x = 0; x < nx; x++, cell++)
+            {
+                const float right = x + 1 < nx ? this->pressure[cell + 1] : 0.0f;
+                const float left = x > 0 ? this->pressure[cell - 1] : 0.0f;
+                const float up = y + 1 < ny ? this->pressure[cell + strideY] : 0.0f;
+                const float down = y > 0 ? this->pressure[cell - strideY] : 0.0f;
+                const float front = z + 1 < nz ? this->pressure[cell + strideZ] : 0.0f;
+                const float back = z > 0 ? this->pressure[cell - strideZ] : 0.0f;
+                this->velocityX[cell] -= (right - left) * (0.5f / h);
+                this->velocityY[cell] -= (up - down) * (0.5f / h);
+                this->velocityZ[cell] -= (front - back) * (0.5f / h);
+            }
+        }
+    });
+}
+
+void SmokeSolver::moveParticles(const SmokeParameters &parameters, std::vector<Particle> &particles, glm::vec3 externalForce, float deltaTime)
+{
+    PROFILE_SCOPE("SmokeSolver::moveParticles");
+
+    const bool hasGrid = this->resolution.x > 0;
+    const float blend = glm::min(parameters.drag * deltaTime, 1.0f);
+    this->forEachChunk((unsigned int)particles.size(), [&](unsigned int first, unsigned int end) {
+        for (unsigned int i = first; i < end; i++)
+        {
+            Particle &particle = particles[i];
+            if (!particle.isAlive())
+                continue;
+
+            const glm::vec3 position = particle.getPosition();
+            const bool inside = hasGrid && glm::all(glm::greaterThanEqual(position, this->boundsMin)) && glm::all(glm::lessThanEqual(position, this->boundsMax));
+            if (inside)
+            {
+                // The drag against the force makes the particles drift at force / drag relative to the grid
+                const glm::vec3 velocity = particle.getDirection();
+                particle.setDirection(velocity + (this->sampleVelocity(position) - velocity) * blend);
+            }
+            particle.update(deltaTime, externalForce);
+        }
+    });
+}
+
+glm::vec3 SmokeSolver::sampleVelocity(glm::vec3 position) const
+{
+    if (this->resolution.x == 0)
+        return glm::vec3(0.0f);
+    size_t corner;
+    glm::vec3 weights;
+    this->locate((position - this->boundsMin) / (this->boundsMax - this->boundsMin) * glm::vec3(this->resolution) - 0.5f, corner, weights);
+    return glm::vec3(this->interpolate(this->velocityX, corner, weights), this->interpolate(this->velocityY, corner, weights),
+                     this->interpolate(this->velocityZ, corner, weights));
+}
+
+glm::ivec3 SmokeSolver::getResolution() const
+{
+    return this->resolution;
+}
+
+void SmokeSolver::locate(glm::vec3 gridPosition, size_t &corner, glm::vec3 &weights) const
+{
+    const glm::vec3 clamped = glm::clamp(gridPosition, glm::vec3(0.0f), glm::vec3(this->resolution - 1));
+    const glm::ivec3 cell = glm::min(glm::ivec3(clamped), this->resolution - 2);
+    weights = clamped - glm::vec3(cell);
+    corner = cell.x + (size_t)this->resolution.x * (cell.y + (size_t)this->resolution.y * cell.z);
+}
+
+float SmokeSolver::interpolate(const std::vector<float> &field, size_t corner, glm::vec3 weights) const
+{
+    const size_t strideY = this->resolution.x;
+    const size_t strideZ = (size_t)this->resolution.x * this->resolution.y;
+    const float x00 = glm::mix(field[corner], field[corner + 1], weights.x);
+    const float x10 = glm::mix(field[corner + strideY], field[corner + strideY + 1], weights.x);
+    const float x01 = glm::mix(field[corner + strideZ], field[corner + strideZ + 1], weights.x);
+    const float x11 = glm::mix(field[corner + strideY + strideZ], field[corner + strideY + strideZ + 1], weights.x);
+    return glm::mix(glm::mix(x00, x10, weights.y), glm::mix(x01, x11, weights.y), weights.z);
+}
+
+void SmokeSolver::forEachSlab(const std::function<void(int)> &task)
+{
+    const unsigned int numberOfSlabs = (unsigned int)this->resolution.z;
+    const std::function<void(unsigned int)> slabTask = [&](unsigned int z) {
+        task((int)z);
+    };
+    if (this->threadPool)
+        this->threadPool->parallelFor(numberOfSlabs, slabTask);
+    else
+        for (unsigned int z = 0; z < numberOfSlabs; z++)
+            slabTask(z);
+}
+
+void SmokeSolver::forEachChunk(unsigned int count, const std::function<void(unsigned int, unsigned int)> &task)
+{
+    const unsigned int numberOfChunks = (count + chunkSize - 1) / chunkSize;
+    const std::function<void(unsigned int)> chunkTask = [&](unsigned int chunk) {
+        task(chunk * chunkSize, glm::min((chunk + 1) * chunkSize, count));
+    };
+    if (this->threadPool)
+        this->threadPool->parallelFor(numberOfChunks, chunkTask);
+    else
+        for (unsigned int chunk = 0; chunk < numberOfChunks; chunk++)
+            chunkTask(chunk);
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "particle.h"
+#include "thread-pool.h"
+
+/**
+ * Properties of the smoke grid the particles are carried by
+*/
+struct SmokeParameters
+{
+    bool enabled;            // The particles are carried by the velocity of the smoke grid instead of moving on their own
+    glm::vec3 boundsMin;     // Box covered by the grid, the particles outside move on their own
+    glm::vec3 boundsMax;
+    float cellSize;          // Size of the grid cells
+    float buoyancy;          // Upward acceleration per unit of temperature
+    float cooling;           // Rate the temperature fades at, per second
+    float sourceRadius;      // Radius around the emitter the heat is added in
+    float sourceTemperature; // Temperature of the cells around the emitter
+    int pressureIterations;  // Jacobi iterations of the pressure projection
+    float timeStep;          // Fixed time step of the grid, 0 steps it once per update
+    float drag;              // Rate the particles take the velocity of the grid at, per second
+};
+
+/**
+ * Eulerian smoke solver (Stam 1999, Fedkiw et al. 2001) on a coarse grid, the particles are passive tracers of its velocity
+ * The velocity and the temperature are stored at the cell centers, a component per array. Each step adds the heat of the
+ * source and the buoyancy, advects the fields semi-Lagrangian and projects the velocity to be divergence
+ * free with Jacobi iterations. The boundaries are open, the pressure is 0 outside the grid so the smoke can leave it.
+ * Every pass runs in parallel over slabs of cells along z.
+*/
+class SmokeSolver
+{
+public:
+    /**
+     * Creates a smoke solver with an empty grid
+     * @param threadPool Threads running the passes, NULL runs them on the calling thread
+    */
+    SmokeSolver(ThreadPool *threadPool = NULL);
+    /**
+     * Sets the threads running the passes
+     * @param threadPool Threads running the passes, NULL runs them on the calling thread
+    */
+    void setThreadPool(ThreadPool *threadPool);
+    /**
+     * Clears the velocity and the temperature of the grid
+    */
+    void reset();
+    /**
+     * Advances the grid one step, the grid is reallocated and cleared when its bounds or its cell size change
+     * @param parameters Smoke properties
+     * @param source Position the heat is added around, the emitter
+     * @param deltaTime Time step
+    */
+    void step(const SmokeParameters &parameters, glm::vec3 source, float deltaTime);
+    /**
+     * Moves the alive particles, the ones inside the grid are dragged towards its velocity
+     * @param parameters Smoke properties
+     * @param particles Particles, the dead ones are skipped
+     * @param externalForce Acceleration of every particle (i.e wind), the drag of the grid bounds the drift it gives
+     * @param deltaTime Time step
+    */
+    void moveParticles(const SmokeParameters &parameters, std::vector<Particle> &particles, glm::vec3 externalForce, float deltaTime);
+    /**
+     * Samples the velocity of the grid with trilinear interpolation
+     * @param position Position, clamped to the grid
+     * @return Velocity
+    */
+    glm::vec3 sampleVelocity(glm::vec3 position) const;
+    /**
+     * Gets the number of cells of the grid
+     * @return Cells along each axis, 0 before the first step
+    */
+    glm::ivec3 getResolution() const;
+
+private:
+    /**
+     * Reallocates and clears the grid when its bounds or its cell size change
+     * @param parameters Smoke properties
+    */
+    void resize(const SmokeParameters &parameters);
+    /**
+     * Finds the cells a position is interpolated from, shared by the fields sampled at the same position
+     * @param gridPosition Position in cells, the center of the first cell is at 0, clamped to the grid
+     * @param corner Returns the index of the lowest of the eight cells
+     * @param weights Returns the trilinear weights of the upper cells along each axis
+    */
+    void locate(glm::vec3 gridPosition, size_t &corner, glm::vec3 &weights) const;
+    /**
+     * Samples a field with trilinear interpolation
+     * @param field Value of each cell
+     * @param corner Index of the lowest of the eight cells, from locate
+     * @param weights Trilinear weights, from locate
+     * @return Interpolated value
+    */
+    float interpolate(const std::vector<float> &field, size_t corner, glm::vec3 weights) const;
+    /**
+     * Projects the velocity to be divergence free
+     * @param iterations Jacobi iterations of the pressure
+    */
+    void project(int iterations);
+    /**
+     * Runs a task over the slabs of cells along z, in parallel with the thread pool
+     * @param task Called with the z of each slab
+    */
+    void forEachSlab(const std::function<void(int)> &task);
+    /**
+     * Runs a task over chunks of a range, in parallel with the thread pool
+     * @param count Number of elements
+     * @param task Called with the first and the end element of each chunk
+    */
+    void forEachChunk(unsigned int count, const std::function<void(unsigned int, unsigned int)> &task);
+
+    ThreadPool *threadPool;            // Threads running the passes, NULL runs them on the calling thread
+    glm::vec3 boundsMin;               // Box covered by the grid
+    glm::vec3 boundsMax;
+    float cellSize;                    // Size of the cells
+    glm::ivec3 resolution;             // Number of cells along each axis
+    std::vector<float> velocityX;      // Velocity of each cell, x first then y and z
+    std::vector<float> velocityY;
+    std::vector<float> velocityZ;
+    std::vector<float> temperature;    // Temperature of each cell, 0 is the ambient temperature
+    std::vector<float> nextVelocityX;  // Destination of the advection
+    std::vector<float> nextVelocityY;
+    std::vector<float> nextVelocityZ;
+    std::vector<float> nextTemperature;
+    std::vector<float> divergence;     // Divergence of the velocity of each cell
+    std::vector<float> pressure;       // Pressure of each cell
+    std::vector<float> nextPressure;   // Destination of each Jacobi iteration
+};
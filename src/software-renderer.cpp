@@ -0,0 +1,353 @@
+#include "software-renderer.h"
+#include "image-writer.h"
+#include <stb_image.h>
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SOFTWARE_RENDERER_SSE
+#endif
+
+static const unsigned int tileSize = 64;    // Width and height of the tiles in pixels
+static const unsigned int chunkSize = 4096; // Number of particles binned per task
+
+/**
+ * Computes the texels and weights of a bilinear sample with clamp to edge wrapping (GL_LINEAR, GL_CLAMP_TO_EDGE)
+ * @param width Texture width
+ * @param height Texture height
+ * @param u Horizontal texture coordinate
+ * @param v Vertical texture coordinate
+ * @param x0 x1 Columns of the texels to be blended
+ * @param y0 y1 Rows of the texels to be blended
+ * @param tx ty Blend weights of the second column and row
+*/
+static inline void bilinearCoordinates(int width, int height, float u, float v, int &x0, int &x1, int &y0, int &y1, float &tx, float &ty)
+{
+    const float fx = u * width - 0.5f;
+    const float fy = v * height - 0.5f;
+    const float floorX = floorf(fx);
+    const float floorY = floorf(fy);
+    tx = fx - floorX;
+    ty = fy - floorY;
+
+    x0 = std::min(std::max((int)floorX, 0), width - 1);
+    x1 = std::min(std::max((int)floorX + 1, 0), width - 1);
+    y0 = std::min(std::max((int)floorY, 0), height - 1);
+    y1 = std::min(std::max((int)floorY + 1, 0), height - 1);
+}
+
+SoftwareRenderer::SoftwareRenderer(unsigned int width, unsigned int height, ThreadPool *threadPool)
+{
+    this->width = width;
+    this->height = height;
+    this->tilesX = (width + tileSize - 1) / tileSize;
+    this->tilesY = (height + tileSize - 1) / tileSize;
+    this->threadPool = threadPool;
+
+    this->colorBuffer.resize((size_t)width * height * 4, 0.0f);
+
+    // Plain white texture until a texture is loaded
+    const unsigned char white[4] = {255, 255, 255, 255};
+    this->setTexture(white, 1, 1, 4);
+}
+
+bool SoftwareRenderer::loadTexture(const char *path)
+{
+    int textureWidth, textureHeight, numberOfChannels;
+    // Flips the texture when loads it, in the same way the OpenGL renderer does
+    stbi_set_flip_vertically_on_load(true);
+    unsigned char *data = stbi_load(path, &textureWidth, &textureHeight, &numberOfChannels, 0);
+    if (!data)
+        return false;
+
+    this->setTexture(data, textureWidth, textureHeight, numberOfChannels);
+    stbi_image_free(data);
+    return true;
+}
+
+void SoftwareRenderer::setTexture(const unsigned char *data, int width, int height, int channels)
+{
+    this->textureWidth = width;
+    this->textureHeight = height;
+    this->texels.resize((size_t)width * height * 4);
+
+    // Expands the texels to RGBA in the same way OpenGL does (GL_RED, GL_RGB, GL_RGBA)
+    for (size_t i = 0; i < (size_t)width * height; i++)
+    {
+        const unsigned char *texel = data + i * channels;
+        float *out = &this->texels[i * 4];
+
+        out[0] = texel[0] / 255.0f;
+        out[1] = channels >= 3 ? texel[1] / 255.0f : 0.0f;
+        out[2] = channels >= 3 ? texel[2] / 255.0f : 0.0f;
+        out[3] = channels == 4 ? texel[3] / 255.0f : channels == 2 ? texel[1] / 255.0f : 1.0f;
+    }
+}
+
+void SoftwareRenderer::clear(glm::vec4 color)
+{
+    for (size_t i = 0; i < this->colorBuffer.size(); i += 4)
+    {
+        this->colorBuffer[i] = color.r;
+        this->colorBuffer[i + 1] = color.g;
+        this->colorBuffer[i + 2] = color.b;
+        this->colorBuffer[i + 3] = color.a;
+    }
+}
+
+void SoftwareRenderer::draw(ParticleSystem *particleSystem)
+{
+    Camera *camera = particleSystem->getCamera();
+    const glm::mat4 viewProjection = camera->getProjectionMatrix(this->width, this->height) * camera->getViewMatrix();
+    const unsigned int numberOfParticles = particleSystem->getMaxAmountOfParticles();
+    const unsigned int numberOfChunks = (numberOfParticles + chunkSize - 1) / chunkSize;
+    const unsigned int numberOfTiles = this->tilesX * this->tilesY;
+
+    this->splats.resize(numberOfParticles);
+    this->bins.resize(numberOfChunks);
+    for (unsigned int chunk = 0; chunk < numberOfChunks; chunk++)
+    {
+        this->bins[chunk].resize(numberOfTiles);
+        for (unsigned int tile = 0; tile < numberOfTiles; tile++)
+            this->bins[chunk][tile].clear();
+    }
+
+    // Projects the particles and adds them to the tiles they overlap, each chunk has its own bins
+    // so the chunks can be binned in parallel
+    const auto binChunk = [&](unsigned int chunk) {
+        // Each chunk reads its own particles, no copy of every particle is made
+        const unsigned int first = chunk * chunkSize;
+        const unsigned int end = std::min(first + chunkSize, numberOfParticles);
+        std::vector<Particle> buffer(end - first);
+        const Particle *particles = particleSystem->getParticles(first, end - first, buffer.data());
+        for (unsigned int i = first; i < end; i++)
+        {
+            Splat &splat = this->splats[i];
+            if (!this->setupSplat(particles[i - first], camera, viewProjection, splat))
+                continue;
+
+            for (int tileY = splat.minY / (int)tileSize; tileY <= splat.maxY / (int)tileSize; tileY++)
+                for (int tileX = splat.minX / (int)tileSize; tileX <= splat.maxX / (int)tileSize; tileX++)
+                    this->bins[chunk][tileY * this->tilesX + tileX].push_back(i);
+        }
+    };
+
+    // Draws the particles of a tile, walking the chunks in order keeps the particles' draw order
+    const auto drawTile = [&](unsigned int tile) {
+        const unsigned int tileX = tile % this->tilesX;
+        const unsigned int tileY = tile / this->tilesX;
+        for (unsigned int chunk = 0; chunk < numberOfChunks; chunk++)
+        {
+            const std::vector<unsigned int> &bin = this->bins[chunk][tile];
+            for (size_t i = 0; i < bin.size(); i++)
+                this->rasterize(this->splats[bin[i]], tileX, tileY);
+        }
+    };
+
+    if (this->threadPool)
+    {
+        this->threadPool->parallelFor(numberOfChunks, binChunk);
+        this->threadPool->parallelFor(numberOfTiles, drawTile);
+    }
+    else
+    {
+        for (unsigned int chunk = 0; chunk < numberOfChunks; chunk++)
+            binChunk(chunk);
+        for (unsigned int tile = 0; tile < numberOfTiles; tile++)
+            drawTile(tile);
+    }
+}
+
+std::vector<unsigned char> SoftwareRenderer::getPixels()
+{
+    std::vector<unsigned char> pixels(this->colorBuffer.size());
+    for (size_t i = 0; i < this->colorBuffer.size(); i++)
+        pixels[i] = (unsigned char)(glm::clamp(this->colorBuffer[i], 0.0f, 1.0f) * 255.0f + 0.5f);
+    return pixels;
+}
+
+bool SoftwareRenderer::save(const std::string &path)
+{
+    const std::vector<unsigned char> pixels = this->getPixels();
+    return writePNG(path, this->width, this->height, 4, pixels.data(), true);
+}
+
+unsigned int SoftwareRenderer::getWidth()
+{
+    return this->width;
+}
+
+unsigned int SoftwareRenderer::getHeight()
+{
+    return this->height;
+}
+
+bool SoftwareRenderer::setupSplat(const Particle &particle, Camera *camera, const glm::mat4 &viewProjection, Splat &splat)
+{
+    if (!particle.isAlive())
+        return false;
+
+    splat.color = particle.getColor();
+    const float scale = particle.getScale();
+    // Fully transparent particles don't change the image
+    if (splat.color.a <= 0.0f || scale == 0.0f)
+        return false;
+
+    // Same transformation as the vertex shader: projection * view * model * (scale * vertex)
+    // The quad's vertices go from -0.5 to 0.5, its texture coordinates from 0 to 1,
+    // so clip = a * u + b * v + c
+    const glm::mat4 mvp = viewProjection * particle.computeBillBoardMatrix(camera);
+    const glm::vec4 a = mvp[0] * scale;
+    const glm::vec4 b = mvp[1] * scale;
+    const glm::vec4 c = mvp[3] - 0.5f * a - 0.5f * b;
+
+    // Computes the screen bounding box of the quad
+    const glm::vec4 corners[4] = {c, c + a, c + a + b, c + b};
+    float minX = INFINITY, minY = INFINITY, maxX = -INFINITY, maxY = -INFINITY;
+    for (int i = 0; i < 4; i++)
+    {
+        const glm::vec4 &corner = corners[i];
+        // The quads crossing the near or far planes aren't clipped, they are skipped
+        if (corner.w <= 1e-6f || corner.z < -corner.w || corner.z > corner.w)
+            return false;
+
+        const float x = (corner.x / corner.w + 1.0f) * 0.5f * this->width;
+        const float y = (corner.y / corner.w + 1.0f) * 0.5f * this->height;
+        minX = std::min(minX, x);
+        maxX = std::max(maxX, x);
+        minY = std::min(minY, y);
+        maxY = std::max(maxY, y);
+    }
+
+    // Pixels whose center is inside the bounding box
+    splat.minX = std::max((int)ceilf(minX - 0.5f), 0);
+    splat.minY = std::max((int)ceilf(minY - 0.5f), 0);
+    splat.maxX = std::min((int)floorf(maxX - 0.5f), (int)this->width - 1);
+    splat.maxY = std::min((int)floorf(maxY - 0.5f), (int)this->height - 1);
+    if (splat.minX > splat.maxX || splat.minY > splat.maxY)
+        return false;
+
+    // Maps texture coordinates (u, v, 1) to homogeneous window coordinates (x * w, y * w, w)
+    const glm::vec3 columnU(0.5f * this->width * (a.x + a.w), 0.5f * this->height * (a.y + a.w), a.w);
+    const glm::vec3 columnV(0.5f * this->width * (b.x + b.w), 0.5f * this->height * (b.y + b.w), b.w);
+    const glm::vec3 columnC(0.5f * this->width * (c.x + c.w), 0.5f * this->height * (c.y + c.w), c.w);
+    const glm::mat3 quadToScreen(columnU, columnV, columnC);
+
+    // The quad is seen edge on
+    if (fabsf(glm::determinant(quadToScreen)) < 1e-12f)
+        return false;
+
+    // Its inverse gives the perspective correct texture coordinates of any pixel
+    splat.screenToQuad = glm::inverse(quadToScreen);
+    return true;
+}
+
+void SoftwareRenderer::rasterize(const Splat &splat, unsigned int tileX, unsigned int tileY)
+{
+    // Clips the quad bounding box to the tile
+    const int x0 = std::max(splat.minX, (int)(tileX * tileSize));
+    const int x1 = std::min(splat.maxX, (int)((tileX + 1) * tileSize) - 1);
+    const int y0 = std::max(splat.minY, (int)(tileY * tileSize));
+    const int y1 = std::min(splat.maxY, (int)((tileY + 1) * tileSize) - 1);
+
+    for (int y = y0; y <= y1; y++)
+        this->fillSpan(splat, y, x0, x1);
+}
+
+void SoftwareRenderer::fillSpan(const Splat &splat, int y, int x0, int x1)
+{
+    // Quad coordinates of the first pixel center, they change linearly along the row
+    const glm::vec3 start = splat.screenToQuad * glm::vec3(x0 + 0.5f, y + 0.5f, 1.0f);
+    const glm::vec3 step = splat.screenToQuad[0];
+    float *row = &this->colorBuffer[(size_t)y * this->width * 4];
+
+    const float *texels = this->texels.data();
+    const int textureWidth = this->textureWidth;
+    const int textureHeight = this->textureHeight;
+
+#ifdef SOFTWARE_RENDERER_SSE
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 lanes = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+    const __m128 color = _mm_loadu_ps(&splat.color[0]);
+
+    // Four pixels of the span are tested at once
+    for (int x = x0; x <= x1; x += 4)
+    {
+        const __m128 offset = _mm_add_ps(_mm_set1_ps((float)(x - x0)), lanes);
+        const __m128 qx = _mm_add_ps(_mm_set1_ps(start.x), _mm_mul_ps(offset, _mm_set1_ps(step.x)));
+        const __m128 qy = _mm_add_ps(_mm_set1_ps(start.y), _mm_mul_ps(offset, _mm_set1_ps(step.y)));
+        const __m128 qz = _mm_add_ps(_mm_set1_ps(start.z), _mm_mul_ps(offset, _mm_set1_ps(step.z)));
+
+        // Perspective division gives the texture coordinates
+        const __m128 inverseZ = _mm_div_ps(one, qz);
+        const __m128 u = _mm_mul_ps(qx, inverseZ);
+        const __m128 v = _mm_mul_ps(qy, inverseZ);
+
+        // Pixels inside the quad
+        const __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmplt_ps(u, one)),
+                                         _mm_and_ps(_mm_cmpge_ps(v, zero), _mm_cmplt_ps(v, one)));
+        int mask = _mm_movemask_ps(inside);
+        if (x1 - x < 3)
+            mask &= (1 << (x1 - x + 1)) - 1;
+        if (!mask)
+            continue;
+
+        float us[4], vs[4];
+        _mm_storeu_ps(us, u);
+        _mm_storeu_ps(vs, v);
+
+        for (int lane = 0; lane < 4; lane++)
+        {
+            if (!(mask & (1 << lane)))
+                continue;
+
+            int tx0, tx1, ty0, ty1;
+            float tx, ty;
+            bilinearCoordinates(textureWidth, textureHeight, us[lane], vs[lane], tx0, tx1, ty0, ty1, tx, ty);
+            const __m128 t00 = _mm_loadu_ps(texels + ((size_t)ty0 * textureWidth + tx0) * 4);
+            const __m128 t10 = _mm_loadu_ps(texels + ((size_t)ty0 * textureWidth + tx1) * 4);
+            const __m128 t01 = _mm_loadu_ps(texels + ((size_t)ty1 * textureWidth + tx0) * 4);
+            const __m128 t11 = _mm_loadu_ps(texels + ((size_t)ty1 * textureWidth + tx1) * 4);
+            const __m128 weightX = _mm_set1_ps(tx);
+            const __m128 bottom = _mm_add_ps(t00, _mm_mul_ps(_mm_sub_ps(t10, t00), weightX));
+            const __m128 top = _mm_add_ps(t01, _mm_mul_ps(_mm_sub_ps(t11, t01), weightX));
+            const __m128 texel = _mm_add_ps(bottom, _mm_mul_ps(_mm_sub_ps(top, bottom), _mm_set1_ps(ty)));
+
+            // Fragment color = texture * color, blended with SRC_ALPHA / ONE_MINUS_SRC_ALPHA
+            const __m128 source = _mm_mul_ps(texel, color);
+            const __m128 alpha = _mm_shuffle_ps(source, source, _MM_SHUFFLE(3, 3, 3, 3));
+            float *pixel = row + (size_t)(x + lane) * 4;
+            const __m128 destination = _mm_loadu_ps(pixel);
+            _mm_storeu_ps(pixel, _mm_add_ps(_mm_mul_ps(source, alpha), _mm_mul_ps(destination, _mm_sub_ps(one, alpha))));
+        }
+    }
+#else
+    for (int x = x0; x <= x1; x++)
+    {
+        const float offset = (float)(x - x0);
+        const glm::vec3 q = start + step * offset;
+        const float u = q.x / q.z;
+        const float v = q.y / q.z;
+        if (u < 0.0f || u >= 1.0f || v < 0.0f || v >= 1.0f)
+            continue;
+
+        int tx0, tx1, ty0, ty1;
+        float tx, ty;
+        bilinearCoordinates(textureWidth, textureHeight, u, v, tx0, tx1, ty0, ty1, tx, ty);
+        const glm::vec4 t00 = glm::make_vec4(texels + ((size_t)ty0 * textureWidth + tx0) * 4);
+        const glm::vec4 t10 = glm::make_vec4(texels + ((size_t)ty0 * textureWidth + tx1) * 4);
+        const glm::vec4 t01 = glm::make_vec4(texels + ((size_t)ty1 * textureWidth + tx0) * 4);
+        const glm::vec4 t11 = glm::make_vec4(texels + ((size_t)ty1 * textureWidth + tx1) * 4);
+        const glm::vec4 texel = glm::mix(glm::mix(t00, t10, tx), glm::mix(t01, t11, tx), ty);
+
+        // Fragment color = texture * color, blended with SRC_ALPHA / ONE_MINUS_SRC_ALPHA
+        const glm::vec4 source = texel * splat.color;
+        float *pixel = row + (size_t)x * 4;
+        for (int channel = 0; channel < 4; channel++)
+            pixel[channel] = source[channel] * source.a + pixel[channel] * (1.0f - source.a);
+    }
+#endif
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+#include "particle-system.h"
+#include "thread-pool.h"
+
+/**
+ * Renders the particles of a particle system on the CPU
+ * Produces the same image as the OpenGL renderer (camera facing quads,
+ * texture * color * alpha, blended with SRC_ALPHA / ONE_MINUS_SRC_ALPHA, drawn in particle order)
+ * without a GPU, so it can be used for previews and as a reference image.
+ * The screen is split in tiles, the particles are binned into the tiles they overlap
+ * and every tile is rasterized by a different thread keeping the particles' draw order
+*/
+class SoftwareRenderer
+{
+public:
+    /**
+     * Creates a software renderer
+     * @param width Image width in pixels
+     * @param height Image height in pixels
+     * @param threadPool Threads used to bin and rasterize the particles, NULL renders on the calling thread
+    */
+    SoftwareRenderer(unsigned int width, unsigned int height, ThreadPool *threadPool = NULL);
+    /**
+     * Loads the particles' texture
+     * @param path Path of the texture file
+     * @return The texture was loaded
+    */
+    bool loadTexture(const char *path);
+    /**
+     * Sets the particles' texture
+     * @param data Texture pixels, bottom row first (OpenGL convention)
+     * @param width Texture width
+     * @param height Texture height
+     * @param channels Number of 8 bit channels per texel
+    */
+    void setTexture(const unsigned char *data, int width, int height, int channels);
+    /**
+     * Clears the image
+     * @param color Clear color
+    */
+    void clear(glm::vec4 color);
+    /**
+     * Draws the particles of a particle system, seen through the particle system's camera
+     * @param particleSystem Particle system to be drawn
+    */
+    void draw(ParticleSystem *particleSystem);
+    /**
+     * Gets the rendered image
+     * @return RGBA pixels, bottom row first (OpenGL convention)
+    */
+    std::vector<unsigned char> getPixels();
+    /**
+     * Saves the rendered image as a PNG file
+     * @param path Path of the image
+     * @return The image was written
+    */
+    bool save(const std::string &path);
+    /**
+     * Gets the image width
+     * @return Image width in pixels
+    */
+    unsigned int getWidth();
+    /**
+     * Gets the image height
+     * @return Image height in pixels
+    */
+    unsigned int getHeight();
+
+private:
+    /**
+     * Screen space description of a particle's quad
+    */
+    struct Splat
+    {
+        glm::mat3 screenToQuad; // Maps homogeneous window coordinates to the quad texture coordinates
+        glm::vec4 color;        // Particle's color and alpha
+        int minX, minY;         // First pixel covered by the quad
+        int maxX, maxY;         // Last pixel covered by the quad
+    };
+
+    /**
+     * Computes the screen space quad of a particle
+     * @param particle Particle to be projected
+     * @param camera Camera used to orient the particle
+     * @param viewProjection Projection * view matrix
+     * @param splat Where the quad will be stored
+     * @return The particle is visible
+    */
+    bool setupSplat(const Particle &particle, Camera *camera, const glm::mat4 &viewProjection, Splat &splat);
+    /**
+     * Blends the part of a quad inside a tile
+     * @param splat Quad to be drawn
+     * @param tileX Tile column
+     * @param tileY Tile row
+    */
+    void rasterize(const Splat &splat, unsigned int tileX, unsigned int tileY);
+    /**
+     * Blends a horizontal span of a quad
+     * @param splat Quad to be drawn
+     * @param y Pixel row
+     * @param x0 First pixel of the span
+     * @param x1 Last pixel of the span
+    */
+    void fillSpan(const Splat &splat, int y, int x0, int x1);
+
+    unsigned int width;      // Image width in pixels
+    unsigned int height;     // Image height in pixels
+    unsigned int tilesX;     // Number of tile columns
+    unsigned int tilesY;     // Number of tile rows
+    ThreadPool *threadPool;  // Threads used to render, can be NULL
+
+    std::vector<float> colorBuffer; // RGBA image, bottom row first
+    std::vector<float> texels;      // RGBA texture, bottom row first
+    int textureWidth;               // Texture width
+    int textureHeight;              // Texture height
+
+    std::vector<Splat> splats;                                // Screen space quads of the particles being drawn
+    std::vector<std::vector<std::vector<unsigned int>>> bins; // Visible particles per chunk and tile, in draw order
+};
@@ -0,0 +1,342 @@
+#include "spatial-hash.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "profiler.h"
+
+namespace
+{
+// Particles, slots or buckets handled by each task of the thread pool
+const unsigned int chunkSize = 16384;
+// The table never has less buckets, so tiny particle systems don't reallocate it
+const unsigned int minBuckets = 1024;
+// Bits of the bucket sorted on each pass of the radix sort
+const unsigned int radixBits = 11;
+const unsigned int radixSize = 1 << radixBits;
+// Visiting a cell (hash, bucket bounds) costs about as much as checking this many particles
+const unsigned int cellCost = 4;
+
+/**
+ * Bounding box of the alive particles of a chunk
+*/
+struct ChunkBounds
+{
+    glm::vec3 min;
+    glm::vec3 max;
+};
+} // namespace
+
+SpatialHash::SpatialHash(ThreadPool *threadPool)
+{
+    this->threadPool = threadPool;
+    this->cellSize = 1.0f;
+    this->inverseCellSize = 1.0f;
+    this->numberOfBuckets = 0;
+    this->boundsMin = glm::vec3(0.0f);
+    this->boundsMax = glm::vec3(0.0f);
+}
+
+void SpatialHash::setThreadPool(ThreadPool *threadPool)
+{
+    this->threadPool = threadPool;
+}
+
+void SpatialHash::build(const std::vector<Particle> &particles, float cellSize)
+{
+    PROFILE_SCOPE("SpatialHash::build");
+
+    const unsigned int numberOfParticles = (unsigned int)particles.size();
+    this->cellSize = cellSize;
+    this->inverseCellSize = 1.0f / cellSize;
+
+    // Enough buckets for one particle per bucket
+    unsigned int bucketBits = 0;
+    while ((1u << bucketBits) < glm::max(numberOfParticles, minBuckets))
+        bucketBits++;
+    this->numberOfBuckets = 1u << bucketBits;
+    this->bucketStart.resize(this->numberOfBuckets + 1);
+
+    const auto forEachChunk = [&](unsigned int count, const std::function<void(unsigned int, unsigned int, unsigned int)> &task) {
+        const unsigned int numberOfChunks = (count + chunkSize - 1) / chunkSize;
+        const std::function<void(unsigned int)> chunkTask = [&](unsigned int chunk) {
+            task(chunk, chunk * chunkSize, glm::min((chunk + 1) * chunkSize, count));
+        };
+        if (this->threadPool)
+            this->threadPool->parallelFor(numberOfChunks, chunkTask);
+        else
+            for (unsigned int chunk = 0; chunk < numberOfChunks; chunk++)
+                chunkTask(chunk);
+    };
+
+    // Bucket of each particle, the alive particles of each chunk are counted
+    const unsigned int numberOfChunks = (numberOfParticles + chunkSize - 1) / chunkSize;
+    std::vector<ChunkBounds> chunkBounds(numberOfChunks, {glm::vec3(INFINITY), glm::vec3(-INFINITY)});
+    std::vector<unsigned int> chunkStart(numberOfChunks + 1, 0);
+    this->particleBuckets.resize(numberOfParticles);
+    this->particlePositions.resize(numberOfParticles);
+    forEachChunk(numberOfParticles, [&](unsigned int chunk, unsigned int first, unsigned int end) {
+        ChunkBounds &bounds = chunkBounds[chunk];
+        unsigned int alive = 0;
+        for (unsigned int i = first; i < end; i++)
+        {
+            if (!particles[i].isAlive())
+            {
+                this->particleBuckets[i] = this->numberOfBuckets;
+                continue;
+            }
+            const glm::vec3 position = particles[i].getPosition();
+            this->particleBuckets[i] = this->getBucket(this->getCell(position));
+            this->particlePositions[i] = position;
+            bounds.min = glm::min(bounds.min, position);
+            bounds.max = glm::max(bounds.max, position);
+            alive++;
+        }
+        chunkStart[chunk + 1] = alive;
+    });
+
+    this->boundsMin = glm::vec3(INFINITY);
+    this->boundsMax = glm::vec3(-INFINITY);
+    for (unsigned int chunk = 0; chunk < numberOfChunks; chunk++)
+    {
+        this->boundsMin = glm::min(this->boundsMin, chunkBounds[chunk].min);
+        this->boundsMax = glm::max(this->boundsMax, chunkBounds[chunk].max);
+        chunkStart[chunk + 1] += chunkStart[chunk];
+    }
+    const unsigned int aliveParticles = chunkStart[numberOfChunks];
+
+    // The alive particles are packed in index order
+    this->sortedBuckets.resize(aliveParticles);
+    this->sortedIndices.resize(aliveParticles);
+    forEachChunk(numberOfParticles, [&](unsigned int chunk, unsigned int first, unsigned int end) {
+        unsigned int slot = chunkStart[chunk];
+        for (unsigned int i = first; i < end; i++)
+            if (this->particleBuckets[i] != this->numberOfBuckets)
+            {
+                this->sortedBuckets[slot] = this->particleBuckets[i];
+                this->sortedIndices[slot++] = i;
+            }
+    });
+
+    // Radix sort by bucket, a counting sort per digit. Each chunk counts its digits and writes its particles after
+    // the ones of the chunks before it, so the sort is stable and the particles of a bucket stay in index order
+    const unsigned int numberOfSlotChunks = (aliveParticles + chunkSize - 1) / chunkSize;
+    this->swapBuckets.resize(aliveParticles);
+    this->swapIndices.resize(aliveParticles);
+    for (unsigned int shift = 0; shift < bucketBits; shift += radixBits)
+    {
+        this->histograms.assign(numberOfSlotChunks * radixSize, 0);
+        forEachChunk(aliveParticles, [&](unsigned int chunk, unsigned int first, unsigned int end) {
+            unsigned int *histogram = &this->histograms[chunk * radixSize];
+            for (unsigned int slot = first; slot < end; slot++)
+                histogram[(this->sortedBuckets[slot] >> shift) & (radixSize - 1)]++;
+        });
+
+        unsigned int offset = 0;
+        for (unsigned int digit = 0; digit < radixSize; digit++)
+            for (unsigned int chunk = 0; chunk < numberOfSlotChunks; chunk++)
+            {
+                const unsigned int count = this->histograms[chunk * radixSize + digit];
+                this->histograms[chunk * radixSize + digit] = offset;
+                offset += count;
+            }
+
+        forEachChunk(aliveParticles, [&](unsigned int chunk, unsigned int first, unsigned int end) {
+            unsigned int *next = &this->histograms[chunk * radixSize];
+            for (unsigned int slot = first; slot < end; slot++)
+            {
+                const unsigned int target = next[(this->sortedBuckets[slot] >> shift) & (radixSize - 1)]++;
+                this->swapBuckets[target] = this->sortedBuckets[slot];
+                this->swapIndices[target] = this->sortedIndices[slot];
+            }
+        });
+        this->sortedBuckets.swap(this->swapBuckets);
+        this->sortedIndices.swap(this->swapIndices);
+    }
+
+    // First slot of each bucket, the buckets between two consecutive slots start at the second one
+    this->sortedPositions.resize(aliveParticles);
+    forEachChunk(aliveParticles, [&](unsigned int, unsigned int first, unsigned int end) {
+        for (unsigned int slot = first; slot < end; slot++)
+        {
+            const unsigned int firstBucket = slot > 0 ? this->sortedBuckets[slot - 1] + 1 : 0;
+            for (unsigned int bucket = firstBucket; bucket <= this->sortedBuckets[slot]; bucket++)
+                this->bucketStart[bucket] = slot;
+            this->sortedPositions[slot] = this->particlePositions[this->sortedIndices[slot]];
+        }
+    });
+    const unsigned int lastBucket = aliveParticles > 0 ? this->sortedBuckets[aliveParticles - 1] + 1 : 0;
+    for (unsigned int bucket = lastBucket; bucket <= this->numberOfBuckets; bucket++)
+        this->bucketStart[bucket] = aliveParticles;
+}
+
+void SpatialHash::queryRadius(glm::vec3 position, float radius, std::vector<unsigned int> &neighbors) const
+{
+    neighbors.clear();
+    this->forEachNeighbor(position, radius, [&](unsigned int slot, float) {
+        neighbors.push_back(this->sortedIndices[slot]);
+    });
+}
+
+void SpatialHash::queryNearest(glm::vec3 position, unsigned int count, std::vector<unsigned int> &neighbors) const
+{
+    neighbors.clear();
+    if (count == 0 || this->sortedIndices.empty())
+        return;
+
+    // The nearest particles found so far in a max heap, the farthest on top. Equal distances are ordered by index,
+    // so the result is deterministic
+    std::vector<std::pair<float, unsigned int>> nearest;
+    const auto consider = [&](unsigned int slot, float distanceSquared) {
+        const std::pair<float, unsigned int> candidate(distanceSquared, this->sortedIndices[slot]);
+        if (nearest.size() < count)
+        {
+            nearest.push_back(candidate);
+            std::push_heap(nearest.begin(), nearest.end());
+        }
+        else if (candidate < nearest.front())
+        {
+            std::pop_heap(nearest.begin(), nearest.end());
+            nearest.back() = candidate;
+            std::push_heap(nearest.begin(), nearest.end());
+        }
+    };
+
+    const auto visitCell = [&](glm::ivec3 cell) {
+        const unsigned int bucket = this->getBucket(cell);
+        for (unsigned int slot = this->bucketStart[bucket]; slot < this->bucketStart[bucket + 1]; slot++)
+        {
+            const glm::vec3 offset = this->sortedPositions[slot] - position;
+            const float distanceSquared = glm::dot(offset, offset);
+            // The particles farther than the ones found are rejected first, the particles of other cells in the same
+            // bucket are skipped, they're visited with their cell
+            if ((nearest.size() < count || distanceSquared <= nearest.front().first) && this->getCell(this->sortedPositions[slot]) == cell)
+                consider(slot, distanceSquared);
+        }
+    };
+
+    // The cells are searched in shells around the cell of the position, each shell only visits its new cells and
+    // the ones outside the particles are skipped. The first shell is the closest one touching the particles
+    const glm::ivec3 center = this->getCell(position);
+    const glm::ivec3 boxFirst = this->getCell(this->boundsMin);
+    const glm::ivec3 boxLast = this->getCell(this->boundsMax);
+    const glm::ivec3 gap = glm::max(glm::max(boxFirst - center, center - boxLast), glm::ivec3(0));
+    const unsigned long long numberOfParticles = this->sortedIndices.size();
+    for (int shell = glm::max(gap.x, glm::max(gap.y, gap.z));; shell++)
+    {
+        const glm::ivec3 first = glm::max(center - shell, boxFirst);
+        const glm::ivec3 last = glm::min(center + shell, boxLast);
+
+        // Once visiting the cells of the shells costs more than checking every particle, sparse particles far apart,
+        // every particle is checked instead. The cost is bounded by the particles, not by the extent of the grid
+        const glm::ivec3 cells = last - first + 1;
+        if ((unsigned long long)cells.x * cells.y * cells.z * cellCost > numberOfParticles)
+        {
+            nearest.clear();
+            for (unsigned int slot = 0; slot < numberOfParticles; slot++)
+            {
+                const glm::vec3 offset = this->sortedPositions[slot] - position;
+                const float distanceSquared = glm::dot(offset, offset);
+                if (nearest.size() < count || distanceSquared <= nearest.front().first)
+                    consider(slot, distanceSquared);
+            }
+            break;
+        }
+
+        for (int z = first.z; z <= last.z; z++)
+            for (int y = first.y; y <= last.y; y++)
+            {
+                // Inside the shell only the cells at its two x faces are new
+                if (z == center.z - shell || z == center.z + shell || y == center.y - shell || y == center.y + shell)
+                    for (int x = first.x; x <= last.x; x++)
+                        visitCell(glm::ivec3(x, y, z));
+                else
+                {
+                    if (center.x - shell >= first.x)
+                        visitCell(glm::ivec3(center.x - shell, y, z));
+                    if (center.x + shell <= last.x)
+                        visitCell(glm::ivec3(center.x + shell, y, z));
+                }
+            }
+
+        // Done once every cell of the particles was visited, or once the farthest of the nearest particles is
+        // closer than the next shell
+        if (first == boxFirst && last == boxLast)
+            break;
+        if (nearest.size() == count)
+        {
+            const glm::vec3 lower = position - glm::vec3(center - shell) * this->cellSize;
+            const glm::vec3 upper = glm::vec3(center + shell + 1) * this->cellSize - position;
+            const glm::vec3 margin = glm::min(lower, upper);
+            const float nextShell = glm::max(glm::min(margin.x, glm::min(margin.y, margin.z)), 0.0f);
+            if (nearest.front().first <= nextShell * nextShell)
+                break;
+        }
+    }
+
+    std::sort_heap(nearest.begin(), nearest.end());
+    for (size_t i = 0; i < nearest.size(); i++)
+        neighbors.push_back(nearest[i].second);
+}
+
+unsigned int SpatialHash::gatherNeighbors(glm::vec3 position, float radius, unsigned int maxCount, unsigned int *slots, float *distancesSquared) const
+{
+    if (maxCount == 0 || this->sortedIndices.empty())
+        return 0;
+
+    // Gathers the particles of a cell, false once there are enough
+    const float radiusSquared = radius * radius;
+    unsigned int found = 0;
+    const auto gatherCell = [&](glm::ivec3 cell) {
+        const unsigned int bucket = this->getBucket(cell);
+        for (unsigned int slot = this->bucketStart[bucket]; slot < this->bucketStart[bucket + 1]; slot++)
+        {
+            const glm::vec3 offset = this->sortedPositions[slot] - position;
+            const float distanceSquared = glm::dot(offset, offset);
+            if (distanceSquared <= radiusSquared && this->getCell(this->sortedPositions[slot]) == cell)
+            {
+                slots[found] = slot;
+                distancesSquared[found] = distanceSquared;
+                if (++found == maxCount)
+                    return false;
+            }
+        }
+        return true;
+    };
+
+    // The closest particles are more likely in the cell of the center, it's searched first
+    const glm::ivec3 center = this->getCell(position);
+    if (!gatherCell(center))
+        return found;
+    const glm::ivec3 first = this->getCell(glm::max(position - radius, this->boundsMin));
+    const glm::ivec3 last = this->getCell(glm::min(position + radius, this->boundsMax));
+    for (int z = first.z; z <= last.z; z++)
+        for (int y = first.y; y <= last.y; y++)
+            for (int x = first.x; x <= last.x; x++)
+            {
+                const glm::ivec3 cell(x, y, z);
+                if (cell != center && !gatherCell(cell))
+                    return found;
+            }
+    return found;
+}
+
+unsigned int SpatialHash::getNumberOfParticles() const
+{
+    return (unsigned int)this->sortedIndices.size();
+}
+
+float SpatialHash::getCellSize() const
+{
+    return this->cellSize;
+}
+
+const std::vector<unsigned int> &SpatialHash::getSortedIndices() const
+{
+    return this->sortedIndices;
+}
+
+const std::vector<glm::vec3> &SpatialHash::getSortedPositions() const
+{
+    return this->sortedPositions;
+}
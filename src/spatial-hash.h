@@ -0,0 +1,197 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "particle.h"
+#include "thread-pool.h"
+
+/**
+ * Uniform grid over the alive particles, for the queries between particles
+ * The cells are hashed into a table of buckets, the particles are sorted by their bucket with a parallel radix sort
+ * so the particles of a cell are contiguous. The particles of a bucket keep their index order, the queries are deterministic
+*/
+class SpatialHash
+{
+public:
+    /**
+     * Creates an empty spatial hash
+     * @param threadPool Threads used to build the hash, NULL builds it on the calling thread
+    */
+    SpatialHash(ThreadPool *threadPool = NULL);
+    /**
+     * Sets the threads used to build the hash
+     * @param threadPool Threads used to build the hash, NULL builds it on the calling thread
+    */
+    void setThreadPool(ThreadPool *threadPool);
+    /**
+     * Rebuilds the hash with the alive particles
+     * @param particles Particles, the dead ones are skipped
+     * @param cellSize Size of the cells, the queries are the fastest with the cell size of their radius
+    */
+    void build(const std::vector<Particle> &particles, float cellSize);
+    /**
+     * Finds the particles inside a sphere
+     * @param position Center of the sphere
+     * @param radius Radius of the sphere
+     * @param neighbors Where the indices of the particles are stored, in cell order
+    */
+    void queryRadius(glm::vec3 position, float radius, std::vector<unsigned int> &neighbors) const;
+    /**
+     * Finds the nearest particles
+     * The cells are searched in growing shells until the next shell can't hold a nearer particle, when the shells
+     * would visit more cells than checking every particle costs the particles are checked instead
+     * @param position Where the distances are measured from
+     * @param count Maximun number of particles
+     * @param neighbors Where the indices of the particles are stored, the nearest first
+    */
+    void queryNearest(glm::vec3 position, unsigned int count, std::vector<unsigned int> &neighbors) const;
+    /**
+     * Finds at most a number of particles inside a sphere, the search stops once it has found enough
+     * The cell of the center is searched first, then the others in cell order
+     * @param position Center of the sphere
+     * @param radius Radius of the sphere
+     * @param maxCount Maximum number of particles
+     * @param slots Where the slots of the particles in the sorted arrays are stored, room for maxCount
+     * @param distancesSquared Where the squared distances of the particles are stored, room for maxCount
+     * @return Number of particles found
+    */
+    unsigned int gatherNeighbors(glm::vec3 position, float radius, unsigned int maxCount, unsigned int *slots, float *distancesSquared) const;
+    /**
+     * Calls a function for each particle in the cells overlapping a sphere, without checking the distance
+     * The particles are found with the positions the hash was built with, so they can move a bit since
+     * @param position Center of the sphere
+     * @param radius Radius of the sphere
+     * @param callback Called with the particle's slot in the sorted arrays
+    */
+    template <typename Callback>
+    void forEachCandidate(glm::vec3 position, float radius, Callback callback) const;
+    /**
+     * Calls a function for each particle inside a sphere
+     * @param position Center of the sphere
+     * @param radius Radius of the sphere
+     * @param callback Called with the particle's slot in the sorted arrays and its squared distance
+    */
+    template <typename Callback>
+    void forEachNeighbor(glm::vec3 position, float radius, Callback callback) const;
+    /**
+     * Gets the number of particles in the hash
+     * @return Number of alive particles when the hash was built
+    */
+    unsigned int getNumberOfParticles() const;
+    /**
+     * Gets the cell size
+     * @return Cell size the hash was built with
+    */
+    float getCellSize() const;
+    /**
+     * Gets the particle indices sorted by cell
+     * @return Index of the particle of each slot
+    */
+    const std::vector<unsigned int> &getSortedIndices() const;
+    /**
+     * Gets the particle positions sorted by cell
+     * @return Position of the particle of each slot
+    */
+    const std::vector<glm::vec3> &getSortedPositions() const;
+
+private:
+    /**
+     * Gets the cell of a position
+     * @param position Position
+     * @return Integer coordinates of the cell
+    */
+    glm::ivec3 getCell(glm::vec3 position) const;
+    /**
+     * Gets the table bucket of a cell, different cells can share a bucket
+     * @param cell Integer coordinates of the cell
+     * @return Bucket index
+    */
+    unsigned int getBucket(glm::ivec3 cell) const;
+    /**
+     * Calls a function for each cell overlapping a sphere and the particles
+     * @param position Center of the sphere
+     * @param radius Radius of the sphere
+     * @param callback Called with the cell and the slots of its bucket
+    */
+    template <typename Callback>
+    void forEachCell(glm::vec3 position, float radius, Callback callback) const;
+
+    ThreadPool *threadPool;                    // Threads building the hash, NULL builds it on the calling thread
+    float cellSize;                            // Size of the cells
+    float inverseCellSize;                     // 1 / cellSize
+    unsigned int numberOfBuckets;              // Number of buckets, a power of two
+    glm::vec3 boundsMin;                       // Bounding box of the particles
+    glm::vec3 boundsMax;
+    std::vector<unsigned int> particleBuckets; // Bucket of each particle, dead particles are out of the table
+    std::vector<glm::vec3> particlePositions;  // Position of each alive particle
+    std::vector<unsigned int> histograms;      // Digit counts of each chunk, then the next slot of each digit
+    std::vector<unsigned int> swapBuckets;     // Destination of each radix sort pass
+    std::vector<unsigned int> swapIndices;
+    std::vector<unsigned int> bucketStart;     // First slot of each bucket, one past the last bucket at the end
+    std::vector<unsigned int> sortedBuckets;   // Bucket of each slot
+    std::vector<unsigned int> sortedIndices;   // Particle index of each slot
+    std::vector<glm::vec3> sortedPositions;    // Particle position of each slot
+};
+
+inline glm::ivec3 SpatialHash::getCell(glm::vec3 position) const
+{
+    // Truncation corrected for the negative values, faster than floor
+    const glm::vec3 scaled = position * this->inverseCellSize;
+    const glm::ivec3 truncated(scaled);
+    return truncated - glm::ivec3(glm::lessThan(scaled, glm::vec3(truncated)));
+}
+
+inline unsigned int SpatialHash::getBucket(glm::ivec3 cell) const
+{
+    // Large primes spread the neighbour cells over the table
+    const unsigned int hash = ((unsigned int)cell.x * 73856093u) ^ ((unsigned int)cell.y * 19349663u) ^ ((unsigned int)cell.z * 83492791u);
+    return hash & (this->numberOfBuckets - 1);
+}
+
+template <typename Callback>
+void SpatialHash::forEachCell(glm::vec3 position, float radius, Callback callback) const
+{
+    if (this->sortedIndices.empty())
+        return;
+
+    // Only the cells overlapping both the sphere and the particles are visited
+    const glm::ivec3 first = this->getCell(glm::max(position - radius, this->boundsMin));
+    const glm::ivec3 last = this->getCell(glm::min(position + radius, this->boundsMax));
+    for (int z = first.z; z <= last.z; z++)
+        for (int y = first.y; y <= last.y; y++)
+            for (int x = first.x; x <= last.x; x++)
+            {
+                const glm::ivec3 cell(x, y, z);
+                const unsigned int bucket = this->getBucket(cell);
+                callback(cell, this->bucketStart[bucket], this->bucketStart[bucket + 1]);
+            }
+}
+
+template <typename Callback>
+void SpatialHash::forEachCandidate(glm::vec3 position, float radius, Callback callback) const
+{
+    this->forEachCell(position, radius, [&](glm::ivec3 cell, unsigned int first, unsigned int end) {
+        // The particles of other cells in the same bucket are skipped, they're visited with their cell
+        for (unsigned int slot = first; slot < end; slot++)
+            if (this->getCell(this->sortedPositions[slot]) == cell)
+                callback(slot);
+    });
+}
+
+template <typename Callback>
+void SpatialHash::forEachNeighbor(glm::vec3 position, float radius, Callback callback) const
+{
+    const float radiusSquared = radius * radius;
+    this->forEachCell(position, radius, [&](glm::ivec3 cell, unsigned int first, unsigned int end) {
+        for (unsigned int slot = first; slot < end; slot++)
+        {
+            const glm::vec3 offset = this->sortedPositions[slot] - position;
+            const float distanceSquared = glm::dot(offset, offset);
+            // The particles of other cells in the same bucket are skipped, they're visited with their cell
+            if (distanceSquared <= radiusSquared && this->getCell(this->sortedPositions[slot]) == cell)
+                callback(slot, distanceSquared);
+        }
+    });
+}
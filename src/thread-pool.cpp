@@ -0,0 +1,117 @@
+#include "thread-pool.h"
+#include <algorithm>
+
+#include "profiler.h"
+
+ThreadPool::ThreadPool(unsigned int numberOfThreads)
+{
+    this->task = NULL;
+    this->count = 0;
+    this->nextIndex = 0;
+    this->generation = 0;
+    this->busyWorkers = 0;
+    this->stopping = false;
+
+    if (numberOfThreads == 0)
+        numberOfThreads = std::max(std::thread::hardware_concurrency(), 1u);
+
+    // The calling thread also runs tasks, so one thread less is created
+    for (unsigned int i = 1; i < numberOfThreads; i++)
+        this->workers.push_back(std::thread(&ThreadPool::work, this));
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stopping = true;
+    }
+    this->jobReady.notify_all();
+
+    for (size_t i = 0; i < this->workers.size(); i++)
+        this->workers[i].join();
+}
+
+void ThreadPool::parallelFor(unsigned int count, const std::function<void(unsigned int)> &task)
+{
+    if (count == 0)
+        return;
+
+    // Runs small loops or single threaded pools directly
+    if (this->workers.empty() || count == 1)
+    {
+        for (unsigned int i = 0; i < count; i++)
+            task(i);
+        return;
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        // Waits for late workers still leaving the previous job
+        this->jobDone.wait(lock, [this] { return this->busyWorkers == 0; });
+
+        this->task = &task;
+        this->count = count;
+        this->nextIndex = 0;
+        this->generation++;
+    }
+    this->jobReady.notify_all();
+
+    // The calling thread works too
+    this->runTasks(&task, count);
+
+    // Waits until the workers finish their last index
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->jobDone.wait(lock, [this] { return this->busyWorkers == 0; });
+    this->task = NULL;
+}
+
+unsigned int ThreadPool::getNumberOfThreads()
+{
+    return (unsigned int)this->workers.size() + 1;
+}
+
+void ThreadPool::work()
+{
+    PROFILE_THREAD_NAME("Pool worker");
+    unsigned int lastGeneration = 0;
+
+    while (true)
+    {
+        const std::function<void(unsigned int)> *currentTask;
+        unsigned int currentCount;
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->jobReady.wait(lock, [&] { return this->stopping || this->generation != lastGeneration; });
+
+            if (this->stopping)
+                return;
+
+            lastGeneration = this->generation;
+            if (this->task == NULL)
+                continue;
+
+            currentTask = this->task;
+            currentCount = this->count;
+            this->busyWorkers++;
+        }
+
+        {
+            PROFILE_SCOPE("ThreadPool job");
+            this->runTasks(currentTask, currentCount);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->busyWorkers--;
+        }
+        this->jobDone.notify_all();
+    }
+}
+
+void ThreadPool::runTasks(const std::function<void(unsigned int)> *task, unsigned int count)
+{
+    unsigned int index;
+    while ((index = this->nextIndex.fetch_add(1)) < count)
+        (*task)(index);
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Fixed group of worker threads used to split loops across the CPU cores
+*/
+class ThreadPool
+{
+public:
+    /**
+     * Creates the worker threads
+     * @param numberOfThreads Number of threads running the tasks (the calling thread included),
+     *                        0 uses one thread per hardware core
+    */
+    ThreadPool(unsigned int numberOfThreads = 0);
+    /**
+     * Stops and joins the worker threads
+    */
+    ~ThreadPool();
+    /**
+     * Runs a task for every index in [0, count), the indices are distributed between the workers
+     * and the calling thread, returns when every index is done.
+     * Tasks can't call parallelFor on the same pool
+     * @param count Number of indices
+     * @param task Function called once per index
+    */
+    void parallelFor(unsigned int count, const std::function<void(unsigned int)> &task);
+    /**
+     * Gets the number of threads running the tasks, the calling thread included
+     * @return Number of threads
+    */
+    unsigned int getNumberOfThreads();
+
+private:
+    /**
+     * Worker loop, waits for a new parallelFor and takes indices until there are none left
+    */
+    void work();
+    /**
+     * Takes indices of the current parallelFor until there are none left
+    */
+    void runTasks(const std::function<void(unsigned int)> *task, unsigned int count);
+
+    std::vector<std::thread> workers;  // Worker threads
+    std::mutex mutex;                  // Protects the current job
+    std::condition_variable jobReady;  // Signaled when a new parallelFor starts
+    std::condition_variable jobDone;   // Signaled when a worker leaves a job
+
+    const std::function<void(unsigned int)> *task; // Task of the current parallelFor
+    unsigned int count;                            // Number of indices of the current parallelFor
+    std::atomic<unsigned int> nextIndex;           // Next index to be taken
+    unsigned int generation;                       // Number of parallelFor started
+    unsigned int busyWorkers;                      // Workers running the current job
+    bool stopping;                                 // The pool is being destroyed
+};
@@ -0,0 +1,271 @@
+/**
+ * Performance regression gate
+ * Compares the results of preset-benchmark against the baseline stored for each configuration
+ * (<baseline dir>/<name>.json, written by preset-benchmark --json-dir). Every phase is compared
+ * with a one sided Mann-Whitney U test over the time per frame of the repeated runs, a phase
+ * regresses when it's significantly slower and its median slowdown is over the threshold.
+ *
+ * Usage: benchmark-compare [options] <results.json>
+ * Exit code: 0 no regression, 1 some phase regressed, 2 invalid usage or files
+*/
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "json.h"
+
+/**
+ * Comparison options read from the command line
+*/
+struct CompareOptions
+{
+    std::string baselineDirectory; // Folder with a <name>.json baseline per configuration
+    std::string resultsPath;       // Results of the current build
+    double alpha;                  // Significance level of the test
+    double threshold;              // Minimun relative slowdown reported as a regression
+    double minDifference;          // Minimun absolute slowdown reported as a regression (ms per frame)
+    bool requireBaseline;          // Configurations without a baseline fail
+};
+
+/**
+ * Prints the command line usage
+*/
+void printUsage()
+{
+    std::cout << "Usage: benchmark-compare [options] <results.json>" << std::endl
+              << "  --baseline <dir>        Folder with the baselines, one <name>.json per configuration (default benchmarks/baseline)" << std::endl
+              << "  --alpha <p>             Significance level (default 0.01)" << std::endl
+              << "  --threshold <fraction>  Minimun median slowdown to fail, 0.1 is 10% (default 0.1)" << std::endl
+              << "  --min-difference <ms>   Minimun median slowdown per frame to fail (default 0.001)" << std::endl
+              << "  --require-baseline      Fails if a configuration doesn't have a baseline" << std::endl;
+}
+
+/**
+ * Reads the command line options
+ * @return The options are valid
+*/
+bool readOptions(int argc, char const *argv[], CompareOptions &options)
+{
+    options.baselineDirectory = "benchmarks/baseline";
+    options.alpha = 0.01;
+    options.threshold = 0.1;
+    options.minDifference = 0.001;
+    options.requireBaseline = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string argument = argv[i];
+        const int remaining = argc - i - 1;
+
+        if (argument == "--baseline" && remaining >= 1)
+            options.baselineDirectory = argv[++i];
+        else if (argument == "--alpha" && remaining >= 1)
+            options.alpha = atof(argv[++i]);
+        else if (argument == "--threshold" && remaining >= 1)
+            options.threshold = atof(argv[++i]);
+        else if (argument == "--min-difference" && remaining >= 1)
+            options.minDifference = atof(argv[++i]);
+        else if (argument == "--require-baseline")
+            options.requireBaseline = true;
+        else if (argument.compare(0, 2, "--") == 0 || !options.resultsPath.empty())
+            return false;
+        else
+            options.resultsPath = argument;
+    }
+
+    return !options.resultsPath.empty() && options.alpha > 0.0 && options.alpha < 1.0;
+}
+
+/**
+ * Gets the median of some values
+ * @param values Values, they're sorted
+ * @return Median value
+*/
+double median(std::vector<double> values)
+{
+    std::sort(values.begin(), values.end());
+    const size_t middle = values.size() / 2;
+    return values.size() % 2 ? values[middle] : (values[middle - 1] + values[middle]) / 2.0;
+}
+
+/**
+ * One sided Mann-Whitney U test, checks if the current samples tend to be larger than the baseline ones
+ * Uses the normal approximation with tie and continuity corrections
+ * @param baseline Baseline samples
+ * @param current Current samples
+ * @return p-value of the current samples being larger only by chance
+*/
+double mannWhitneyGreater(const std::vector<double> &baseline, const std::vector<double> &current)
+{
+    // Sorts every sample keeping where it came from
+    std::vector<std::pair<double, bool>> samples;
+    for (size_t i = 0; i < baseline.size(); i++)
+        samples.push_back(std::make_pair(baseline[i], false));
+    for (size_t i = 0; i < current.size(); i++)
+        samples.push_back(std::make_pair(current[i], true));
+    std::sort(samples.begin(), samples.end());
+
+    // Sums the ranks of the current samples, tied samples get the mean of their ranks
+    const double n = (double)samples.size();
+    double currentRanks = 0.0;
+    double tieCorrection = 0.0;
+    for (size_t i = 0; i < samples.size();)
+    {
+        size_t j = i;
+        while (j < samples.size() && samples[j].first == samples[i].first)
+            j++;
+
+        const double rank = (i + 1 + j) / 2.0;
+        for (size_t k = i; k < j; k++)
+            if (samples[k].second)
+                currentRanks += rank;
+
+        const double ties = (double)(j - i);
+        tieCorrection += ties * ties * ties - ties;
+        i = j;
+    }
+
+    const double n1 = (double)baseline.size();
+    const double n2 = (double)current.size();
+    const double u = currentRanks - n2 * (n2 + 1.0) / 2.0;
+    const double mean = n1 * n2 / 2.0;
+    const double variance = n1 * n2 / 12.0 * ((n + 1.0) - tieCorrection / (n * (n - 1.0)));
+    if (variance <= 0.0)
+        return 1.0;
+
+    const double z = (u - mean - 0.5) / sqrt(variance);
+    return 0.5 * erfc(z / sqrt(2.0));
+}
+
+/**
+ * Reads the time per frame of every run of a phase
+ * @param phase Phase JSON object
+ * @return Samples in milliseconds
+*/
+std::vector<double> readSamples(const JsonValue &phase)
+{
+    std::vector<double> samples;
+    const std::vector<JsonValue> &values = phase["ms_per_frame"].getArray();
+    for (size_t i = 0; i < values.size(); i++)
+        samples.push_back(values[i].getNumber());
+    return samples;
+}
+
+/**
+ * Finds a phase by name
+ * @param preset Preset JSON object
+ * @param name Phase name
+ * @return Phase JSON object, null if it doesn't exist
+*/
+const JsonValue &findPhase(const JsonValue &preset, const std::string &name)
+{
+    static const JsonValue null;
+
+    const std::vector<JsonValue> &phases = preset["phases"].getArray();
+    for (size_t i = 0; i < phases.size(); i++)
+        if (phases[i]["name"].getString() == name)
+            return phases[i];
+    return null;
+}
+
+int main(int argc, char const *argv[])
+{
+    CompareOptions options;
+    if (!readOptions(argc, argv, options))
+    {
+        printUsage();
+        return 2;
+    }
+
+    JsonValue results;
+    std::string error;
+    if (!JsonValue::parseFile(options.resultsPath, results, error))
+    {
+        std::cout << error << std::endl;
+        return 2;
+    }
+
+    std::cout << std::left << std::setw(28) << "Configuration/phase" << std::right << std::setw(14) << "Baseline ms"
+              << std::setw(14) << "Current ms" << std::setw(10) << "Change" << std::setw(12) << "p-value" << "  Result" << std::endl;
+
+    unsigned int regressions = 0;
+    bool missingBaseline = false;
+    const std::vector<JsonValue> &presets = results["presets"].getArray();
+    for (size_t i = 0; i < presets.size(); i++)
+    {
+        const std::string &name = presets[i]["name"].getString();
+
+        JsonValue baseline;
+        if (!JsonValue::parseFile(options.baselineDirectory + "/" + name + ".json", baseline, error))
+        {
+            std::cout << std::left << std::setw(28) << name << std::right << "  no baseline (" << error << ")" << std::endl;
+            missingBaseline = true;
+            continue;
+        }
+        const std::vector<JsonValue> &baselinePresets = baseline["presets"].getArray();
+        if (baselinePresets.empty())
+        {
+            std::cout << std::left << std::setw(28) << name << std::right << "  invalid baseline" << std::endl;
+            missingBaseline = true;
+            continue;
+        }
+
+        const std::vector<JsonValue> &phases = presets[i]["phases"].getArray();
+        for (size_t j = 0; j < phases.size(); j++)
+        {
+            const std::string &phaseName = phases[j]["name"].getString();
+            const std::vector<double> current = readSamples(phases[j]);
+            const std::vector<double> reference = readSamples(findPhase(baselinePresets[0], phaseName));
+
+            std::cout << std::left << std::setw(28) << (name + "/" + phaseName) << std::right;
+            if (current.empty() || reference.empty())
+            {
+                std::cout << "  no samples" << std::endl;
+                continue;
+            }
+
+            const double currentMedian = median(current);
+            const double referenceMedian = median(reference);
+            const double change = referenceMedian > 0.0 ? currentMedian / referenceMedian - 1.0 : 0.0;
+
+            std::cout << std::fixed << std::setprecision(4) << std::setw(14) << referenceMedian << std::setw(14) << currentMedian
+                      << std::setprecision(1) << std::setw(9) << change * 100.0 << "%";
+
+            // A few samples per side are needed for the test to be able to reject
+            if (current.size() < 3 || reference.size() < 3)
+            {
+                std::cout << std::setw(12) << "-" << "  not enough runs (use --repetitions)" << std::endl;
+                continue;
+            }
+
+            const double pValue = mannWhitneyGreater(reference, current);
+            std::cout << std::setprecision(5) << std::setw(12) << pValue;
+
+            const bool slower = pValue < options.alpha && change > options.threshold &&
+                                currentMedian - referenceMedian > options.minDifference;
+            if (slower)
+            {
+                std::cout << "  REGRESSION" << std::endl;
+                regressions++;
+            }
+            else if (mannWhitneyGreater(current, reference) < options.alpha && change < -options.threshold)
+                std::cout << "  faster" << std::endl;
+            else
+                std::cout << "  ok" << std::endl;
+        }
+    }
+
+    if (regressions > 0)
+    {
+        std::cout << regressions << " phase(s) significantly slower than the baseline" << std::endl;
+        return 1;
+    }
+    if (missingBaseline && options.requireBaseline)
+        return 1;
+
+    return 0;
+}
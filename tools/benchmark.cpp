@@ -0,0 +1,282 @@
+#include "benchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+namespace
+{
+/**
+ * Benchmark waiting to be run
+*/
+struct RegisteredBenchmark
+{
+    std::string name;                          // Benchmark name
+    BenchmarkFunction function;                // Measured code
+    std::vector<unsigned long long> arguments; // Arguments it's run with
+};
+
+/**
+ * Measurements of a benchmark with an argument
+*/
+struct BenchmarkResult
+{
+    std::string name;             // Benchmark name, with the argument
+    unsigned long long argument;  // Benchmark argument
+    unsigned long long iterations; // Iterations per run
+    std::vector<double> samples;  // Time per iteration of each run, nanoseconds
+    double itemsPerSecond;        // Items processed per second (median run), 0 if the benchmark doesn't set them
+};
+
+/**
+ * Options read from the command line
+*/
+struct RunnerOptions
+{
+    std::string filter;              // Only the benchmarks whose name contains it are run
+    double minTime;                  // Minimun time of a run, seconds
+    unsigned int repetitions;        // Runs per benchmark
+    unsigned long long maxArgument;  // Arguments over it are skipped
+    std::string jsonPath;            // Where the results are written as JSON, empty doesn't write them
+};
+
+/**
+ * Gets the registered benchmarks
+ * @return Benchmarks in registration order
+*/
+std::vector<RegisteredBenchmark> &getRegistry()
+{
+    static std::vector<RegisteredBenchmark> registry;
+    return registry;
+}
+
+/**
+ * Gets the steady clock time
+ * @return Time in nanoseconds
+*/
+long long now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * Gets the median of some values
+ * @param values Values, they're sorted
+ * @return Median value
+*/
+double median(std::vector<double> values)
+{
+    std::sort(values.begin(), values.end());
+    const size_t middle = values.size() / 2;
+    return values.size() % 2 ? values[middle] : (values[middle - 1] + values[middle]) / 2.0;
+}
+
+/**
+ * Reads the command line options
+ * @return The options are valid
+*/
+bool readOptions(int argc, char const *argv[], RunnerOptions &options)
+{
+    options.minTime = 0.2;
+    options.repetitions = 5;
+    options.maxArgument = ~0ull;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string argument = argv[i];
+        const int remaining = argc - i - 1;
+
+        if (argument == "--filter" && remaining >= 1)
+            options.filter = argv[++i];
+        else if (argument == "--min-time" && remaining >= 1)
+            options.minTime = atof(argv[++i]);
+        else if (argument == "--repetitions" && remaining >= 1)
+            options.repetitions = atoi(argv[++i]);
+        else if (argument == "--max-argument" && remaining >= 1)
+            options.maxArgument = strtoull(argv[++i], NULL, 10);
+        else if (argument == "--json" && remaining >= 1)
+            options.jsonPath = argv[++i];
+        else
+            return false;
+    }
+
+    return options.repetitions > 0 && options.minTime > 0.0;
+}
+
+/**
+ * Writes the results with a layout similar to Google Benchmark's JSON
+ * @return The file was written
+*/
+bool writeJson(const std::string &path, const std::vector<BenchmarkResult> &results, const RunnerOptions &options)
+{
+    std::ofstream file(path.c_str());
+    if (!file.is_open())
+        return false;
+
+    char date[32];
+    const time_t currentTime = time(NULL);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&currentTime));
+
+    file << std::setprecision(9);
+    file << "{" << std::endl
+         << "  \"context\": {" << std::endl
+         << "    \"date\": \"" << date << "\"," << std::endl
+         << "    \"num_cpus\": " << std::thread::hardware_concurrency() << "," << std::endl
+         << "    \"min_time\": " << options.minTime << "," << std::endl
+         << "    \"repetitions\": " << options.repetitions << std::endl
+         << "  }," << std::endl
+         << "  \"benchmarks\": [";
+
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const BenchmarkResult &result = results[i];
+        file << (i == 0 ? "" : ",") << std::endl
+             << "    {" << std::endl
+             << "      \"name\": \"" << result.name << "\"," << std::endl
+             << "      \"argument\": " << result.argument << "," << std::endl
+             << "      \"iterations\": " << result.iterations << "," << std::endl
+             << "      \"real_time\": " << median(result.samples) << "," << std::endl
+             << "      \"min_time\": " << *std::min_element(result.samples.begin(), result.samples.end()) << "," << std::endl
+             << "      \"max_time\": " << *std::max_element(result.samples.begin(), result.samples.end()) << "," << std::endl
+             << "      \"time_unit\": \"ns\"," << std::endl
+             << "      \"items_per_second\": " << result.itemsPerSecond << "," << std::endl
+             << "      \"samples\": [";
+        for (size_t sample = 0; sample < result.samples.size(); sample++)
+            file << (sample == 0 ? "" : ", ") << result.samples[sample];
+        file << "]" << std::endl
+             << "    }";
+    }
+    file << std::endl
+         << "  ]" << std::endl
+         << "}" << std::endl;
+
+    return file.good();
+}
+} // namespace
+
+/**
+ * Runs the benchmark functions and times them
+*/
+class BenchmarkRunner
+{
+public:
+    /**
+     * Runs a benchmark once
+     * @param function Measured code
+     * @param iterations Iterations of the run
+     * @param argument Benchmark argument
+     * @param itemsPerIteration Where the items per iteration set by the benchmark are stored
+     * @return Time of the run in nanoseconds
+    */
+    static double run(const BenchmarkFunction &function, unsigned long long iterations, unsigned long long argument,
+                      unsigned long long &itemsPerIteration)
+    {
+        BenchmarkState state(iterations, argument);
+        state.resetTimer();
+        function(state);
+        const long long end = now();
+
+        itemsPerIteration = state.itemsPerIteration;
+        return (double)(end - state.startTime);
+    }
+};
+
+BenchmarkState::BenchmarkState(unsigned long long iterations, unsigned long long argument)
+    : iterations(iterations), argument(argument)
+{
+    this->startTime = 0;
+    this->itemsPerIteration = 0;
+}
+
+void BenchmarkState::resetTimer()
+{
+    this->startTime = now();
+}
+
+void BenchmarkState::setItemsPerIteration(unsigned long long items)
+{
+    this->itemsPerIteration = items;
+}
+
+void registerBenchmark(const std::string &name, BenchmarkFunction function, const std::vector<unsigned long long> &arguments)
+{
+    RegisteredBenchmark benchmark;
+    benchmark.name = name;
+    benchmark.function = function;
+    benchmark.arguments = arguments;
+    getRegistry().push_back(benchmark);
+}
+
+int runBenchmarks(int argc, char const *argv[])
+{
+    RunnerOptions options;
+    if (!readOptions(argc, argv, options))
+    {
+        std::cout << "Usage: " << argv[0] << " [--filter <text>] [--min-time <s>] [--repetitions <n>] "
+                  << "[--max-argument <n>] [--json <path>]" << std::endl;
+        return 2;
+    }
+
+    std::cout << std::left << std::setw(48) << "Benchmark" << std::right << std::setw(16) << "Time (ns)"
+              << std::setw(14) << "Iterations" << std::setw(18) << "Items/s" << std::endl;
+
+    std::vector<BenchmarkResult> results;
+    const std::vector<RegisteredBenchmark> &registry = getRegistry();
+    for (size_t i = 0; i < registry.size(); i++)
+    {
+        const RegisteredBenchmark &benchmark = registry[i];
+        // Benchmarks without arguments run once, with the argument 0
+        std::vector<unsigned long long> arguments = benchmark.arguments;
+        if (arguments.empty())
+            arguments.push_back(0);
+
+        for (size_t j = 0; j < arguments.size(); j++)
+        {
+            BenchmarkResult result;
+            result.argument = arguments[j];
+            result.name = benchmark.name + (benchmark.arguments.empty() ? "" : "/" + std::to_string(result.argument));
+
+            if (result.name.find(options.filter) == std::string::npos || result.argument > options.maxArgument)
+                continue;
+
+            // Grows the iterations until a run lasts the minimun time
+            const double minTime = options.minTime * 1e9;
+            unsigned long long iterations = 1;
+            unsigned long long itemsPerIteration = 0;
+            while (true)
+            {
+                const double time = BenchmarkRunner::run(benchmark.function, iterations, result.argument, itemsPerIteration);
+                if (time >= minTime || iterations >= 1000000000ull)
+                    break;
+
+                const double factor = time > 0.0 ? std::min(std::max(1.4 * minTime / time, 2.0), 10.0) : 10.0;
+                iterations = (unsigned long long)(iterations * factor);
+            }
+
+            result.iterations = iterations;
+            for (unsigned int repetition = 0; repetition < options.repetitions; repetition++)
+                result.samples.push_back(BenchmarkRunner::run(benchmark.function, iterations, result.argument, itemsPerIteration) / iterations);
+
+            const double time = median(result.samples);
+            result.itemsPerSecond = time > 0.0 ? itemsPerIteration * 1e9 / time : 0.0;
+            results.push_back(result);
+
+            std::cout << std::left << std::setw(48) << result.name << std::right << std::fixed << std::setprecision(1)
+                      << std::setw(16) << time << std::setw(14) << iterations << std::setprecision(0)
+                      << std::setw(18) << result.itemsPerSecond << std::endl;
+        }
+    }
+
+    if (!options.jsonPath.empty() && !writeJson(options.jsonPath, results, options))
+    {
+        std::cout << "Unable to write " << options.jsonPath << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * Minimal microbenchmark harness
+ * A benchmark is a function that repeats the measured code state.iterations times, the harness
+ * grows the number of iterations until a run lasts long enough, repeats the run and reports the median
+ * time per iteration. Benchmarks can be registered with a list of arguments (i.e particle counts),
+ * each argument is measured on its own as "name/argument".
+*/
+
+/**
+ * State of a benchmark run, given to the benchmark function
+*/
+class BenchmarkState
+{
+public:
+    BenchmarkState(unsigned long long iterations, unsigned long long argument);
+    /**
+     * Restarts the timer, the setup done before calling it isn't measured
+    */
+    void resetTimer();
+    /**
+     * Sets the items processed per iteration (i.e particles), reported as items per second
+     * @param items Items processed in every iteration
+    */
+    void setItemsPerIteration(unsigned long long items);
+
+    const unsigned long long iterations; // Times the measured code has to run
+    const unsigned long long argument;   // Benchmark argument, 0 if it doesn't have arguments
+
+private:
+    friend class BenchmarkRunner;
+
+    long long startTime;                // Steady clock time when the timer was reset, nanoseconds
+    unsigned long long itemsPerIteration; // Items processed per iteration
+};
+
+typedef std::function<void(BenchmarkState &)> BenchmarkFunction;
+
+/**
+ * Registers a benchmark
+ * @param name Benchmark name
+ * @param function Function that runs the measured code
+ * @param arguments Arguments the benchmark is run with, empty runs it once without argument
+*/
+void registerBenchmark(const std::string &name, BenchmarkFunction function,
+                       const std::vector<unsigned long long> &arguments = std::vector<unsigned long long>());
+
+/**
+ * Runs the registered benchmarks, reading the options from the command line
+ * (--filter <text>, --min-time <s>, --repetitions <n>, --max-argument <n>, --json <path>)
+ * @return Exit code, 0 if every benchmark ran
+*/
+int runBenchmarks(int argc, char const *argv[]);
+
+/**
+ * Prevents the compiler from optimizing away a computed value
+ * @param value Value that has to be computed
+*/
+template <class T>
+inline void doNotOptimize(const T &value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    volatile char sink = *reinterpret_cast<const volatile char *>(&value);
+    (void)sink;
+#endif
+}
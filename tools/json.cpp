@@ -0,0 +1,299 @@
+#include "json.h"
+
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+/**
+ * Recursive descent JSON parser
+*/
+class JsonParser
+{
+public:
+    JsonParser(const std::string &text) : text(text), position(0)
+    {
+    }
+
+    /**
+     * Parses the whole text as a single value
+     * @return The text is valid
+    */
+    bool parseDocument(JsonValue &value)
+    {
+        if (!this->parseValue(value))
+            return false;
+        this->skipWhitespace();
+        if (this->position != this->text.size())
+            return this->fail("Unexpected characters after the document");
+        return true;
+    }
+
+    std::string error; // Why the text isn't valid
+
+private:
+    bool fail(const std::string &message)
+    {
+        if (this->error.empty())
+            this->error = message + " at offset " + std::to_string(this->position);
+        return false;
+    }
+
+    void skipWhitespace()
+    {
+        while (this->position < this->text.size() && isspace((unsigned char)this->text[this->position]))
+            this->position++;
+    }
+
+    bool consume(const char *literal)
+    {
+        const size_t length = strlen(literal);
+        if (this->text.compare(this->position, length, literal) != 0)
+            return false;
+        this->position += length;
+        return true;
+    }
+
+    bool parseValue(JsonValue &value)
+    {
+        this->skipWhitespace();
+        if (this->position >= this->text.size())
+            return this->fail("Unexpected end of the document");
+
+        const char c = this->text[this->position];
+        if (c == '{')
+            return this->parseObject(value);
+        if (c == '[')
+            return this->parseArray(value);
+        if (c == '"')
+        {
+            value.type = JsonValue::JSON_STRING;
+            return this->parseString(value.string);
+        }
+        if (this->consume("true"))
+        {
+            value.type = JsonValue::JSON_BOOLEAN;
+            value.boolean = true;
+            return true;
+        }
+        if (this->consume("false"))
+        {
+            value.type = JsonValue::JSON_BOOLEAN;
+            value.boolean = false;
+            return true;
+        }
+        if (this->consume("null"))
+        {
+            value.type = JsonValue::JSON_NULL;
+            return true;
+        }
+        return this->parseNumber(value);
+    }
+
+    bool parseNumber(JsonValue &value)
+    {
+        const char *start = this->text.c_str() + this->position;
+        char *end;
+        value.number = strtod(start, &end);
+        if (end == start)
+            return this->fail("Invalid value");
+
+        value.type = JsonValue::JSON_NUMBER;
+        this->position += end - start;
+        return true;
+    }
+
+    bool parseString(std::string &string)
+    {
+        // Skips the opening quote
+        this->position++;
+        string.clear();
+
+        while (this->position < this->text.size())
+        {
+            const char c = this->text[this->position++];
+            if (c == '"')
+                return true;
+            if (c != '\\')
+            {
+                string += c;
+                continue;
+            }
+
+            if (this->position >= this->text.size())
+                break;
+            const char escaped = this->text[this->position++];
+            switch (escaped)
+            {
+            case 'n':
+                string += '\n';
+                break;
+            case 't':
+                string += '\t';
+                break;
+            case 'r':
+                string += '\r';
+                break;
+            case 'b':
+                string += '\b';
+                break;
+            case 'f':
+                string += '\f';
+                break;
+            case 'u':
+            {
+                // Only ASCII escapes are needed by the tools, others are replaced
+                if (this->position + 4 > this->text.size())
+                    return this->fail("Invalid escape");
+                const long code = strtol(this->text.substr(this->position, 4).c_str(), NULL, 16);
+                string += code < 128 ? (char)code : '?';
+                this->position += 4;
+                break;
+            }
+            default:
+                string += escaped;
+            }
+        }
+        return this->fail("Unterminated string");
+    }
+
+    bool parseArray(JsonValue &value)
+    {
+        value.type = JsonValue::JSON_ARRAY;
+        // Skips the opening bracket
+        this->position++;
+
+        this->skipWhitespace();
+        if (this->consume("]"))
+            return true;
+
+        while (true)
+        {
+            value.array.push_back(JsonValue());
+            if (!this->parseValue(value.array.back()))
+                return false;
+
+            this->skipWhitespace();
+            if (this->consume("]"))
+                return true;
+            if (!this->consume(","))
+                return this->fail("Expected ',' or ']'");
+        }
+    }
+
+    bool parseObject(JsonValue &value)
+    {
+        value.type = JsonValue::JSON_OBJECT;
+        // Skips the opening brace
+        this->position++;
+
+        this->skipWhitespace();
+        if (this->consume("}"))
+            return true;
+
+        while (true)
+        {
+            this->skipWhitespace();
+            if (this->position >= this->text.size() || this->text[this->position] != '"')
+                return this->fail("Expected a member name");
+
+            std::string key;
+            if (!this->parseString(key))
+                return false;
+
+            this->skipWhitespace();
+            if (!this->consume(":"))
+                return this->fail("Expected ':'");
+            if (!this->parseValue(value.object[key]))
+                return false;
+
+            this->skipWhitespace();
+            if (this->consume("}"))
+                return true;
+            if (!this->consume(","))
+                return this->fail("Expected ',' or '}'");
+        }
+    }
+
+    const std::string &text; // Text being parsed
+    size_t position;         // Next character to be read
+};
+
+JsonValue::JsonValue()
+{
+    this->type = JSON_NULL;
+    this->boolean = false;
+    this->number = 0.0;
+}
+
+bool JsonValue::parse(const std::string &text, JsonValue &value, std::string &error)
+{
+    value = JsonValue();
+    JsonParser parser(text);
+    if (parser.parseDocument(value))
+        return true;
+
+    error = parser.error;
+    return false;
+}
+
+bool JsonValue::parseFile(const std::string &path, JsonValue &value, std::string &error)
+{
+    std::ifstream file(path.c_str());
+    if (!file.is_open())
+    {
+        error = "Unable to open " + path;
+        return false;
+    }
+
+    std::stringstream text;
+    text << file.rdbuf();
+    if (!parse(text.str(), value, error))
+    {
+        error = path + ": " + error;
+        return false;
+    }
+    return true;
+}
+
+JsonValue::Type JsonValue::getType() const
+{
+    return this->type;
+}
+
+bool JsonValue::isNull() const
+{
+    return this->type == JSON_NULL;
+}
+
+double JsonValue::getNumber() const
+{
+    return this->number;
+}
+
+bool JsonValue::getBoolean() const
+{
+    return this->boolean;
+}
+
+const std::string &JsonValue::getString() const
+{
+    return this->string;
+}
+
+const std::vector<JsonValue> &JsonValue::getArray() const
+{
+    return this->array;
+}
+
+const JsonValue &JsonValue::operator[](const std::string &key) const
+{
+    static const JsonValue null;
+
+    if (this->type != JSON_OBJECT)
+        return null;
+
+    std::map<std::string, JsonValue>::const_iterator member = this->object.find(key);
+    return member == this->object.end() ? null : member->second;
+}
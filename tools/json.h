@@ -0,0 +1,64 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * Value of a JSON document
+ * Only what the benchmark tools need: parsing, typed access and lookups
+*/
+class JsonValue
+{
+public:
+    enum Type
+    {
+        JSON_NULL,
+        JSON_BOOLEAN,
+        JSON_NUMBER,
+        JSON_STRING,
+        JSON_ARRAY,
+        JSON_OBJECT
+    };
+
+    JsonValue();
+    /**
+     * Parses a JSON document
+     * @param text JSON text
+     * @param value Where the document is stored
+     * @param error Where the reason is stored if the text isn't valid
+     * @return The text was parsed
+    */
+    static bool parse(const std::string &text, JsonValue &value, std::string &error);
+    /**
+     * Reads and parses a JSON file
+     * @param path Path to the file
+     * @param value Where the document is stored
+     * @param error Where the reason is stored if the file can't be read or parsed
+     * @return The file was parsed
+    */
+    static bool parseFile(const std::string &path, JsonValue &value, std::string &error);
+
+    Type getType() const;
+    bool isNull() const;
+    double getNumber() const;
+    bool getBoolean() const;
+    const std::string &getString() const;
+    const std::vector<JsonValue> &getArray() const;
+    /**
+     * Gets a member of an object
+     * @param key Member name
+     * @return Member value, a null value if the member doesn't exist or this isn't an object
+    */
+    const JsonValue &operator[](const std::string &key) const;
+
+private:
+    friend class JsonParser;
+
+    Type type;                              // Kind of value
+    bool boolean;                           // Value of a boolean
+    double number;                          // Value of a number
+    std::string string;                     // Value of a string
+    std::vector<JsonValue> array;           // Elements of an array
+    std::map<std::string, JsonValue> object; // Members of an object
+};
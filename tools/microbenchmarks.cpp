@@ -0,0 +1,251 @@
+/**
+ * Microbenchmarks of the particle system hot paths
+ * The per particle paths are measured over particle counts from 1k to 10M, so the cache effects
+ * of the particles' layout show up. Results can be written as JSON to track them across commits.
+ *
+ * Usage: particle-microbenchmarks [--filter <text>] [--min-time <s>] [--repetitions <n>] [--max-argument <n>] [--json <path>]
+*/
+#include <cstdlib>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "benchmark.h"
+#include "camera.h"
+#include "configuration.h"
+#include "particle.h"
+#include "particle-system.h"
+#include "random.h"
+#include "spatial-hash.h"
+#include "thread-pool.h"
+
+// Particle counts of the per particle benchmarks
+const std::vector<unsigned long long> particleCounts = {1000, 10000, 100000, 1000000, 10000000};
+
+/**
+ * Sets the fire preset properties to a particle system
+ * @param particleSystem Particle system to be configured
+*/
+void configureFire(ParticleSystem &particleSystem)
+{
+    particleSystem.setTTL(5.0f);
+    particleSystem.setParticleSpawns(6, 0.05f);
+    particleSystem.setPosition(glm::vec3(0.0f, -1.8f, -2.4f));
+    particleSystem.setDirection(glm::vec3(0.0f, 0.8f, 0.0f), glm::vec3(0.532f, 0.193f, 0.419f));
+    particleSystem.setScale(0.4f, 3.0f, 0.1f);
+    particleSystem.setColor(glm::vec3(1.0f, 0.588f, 0.0f), glm::vec3(1.0f, 0.117f, 0.0f),
+                            glm::vec3(0.328f, 0.067f, 0.0f), glm::vec3(0.0f));
+    particleSystem.setAplha(0.4f, 0.0f, 0.01f);
+    particleSystem.setGlobalExternalForce(glm::vec3(0.227f, 0.0f, 0.0f));
+}
+
+/**
+ * Builds alive particles spread around the origin
+ * @param count Number of particles
+ * @return Particles with a life long enough to never die while measured
+*/
+std::vector<Particle> buildParticles(unsigned long long count)
+{
+    RandomGenerator random(1);
+    std::vector<Particle> particles(count);
+    for (size_t i = 0; i < particles.size(); i++)
+        particles[i].reset(1e9f, randomValue(random, glm::vec3(0.0f), glm::vec3(2.0f)), randomValue(random, glm::vec3(0.0f), glm::vec3(1.0f)),
+                           0.4f, 3.0f, glm::vec3(1.0f, 0.5f, 0.0f), glm::vec3(0.3f, 0.0f, 0.0f), 0.4f, 0.0f);
+    return particles;
+}
+
+void benchmarkRandomValue(BenchmarkState &state)
+{
+    RandomGenerator random(1);
+    for (unsigned long long i = 0; i < state.iterations; i++)
+        doNotOptimize(randomValue(random, 1.0f, 0.5f));
+    state.setItemsPerIteration(1);
+}
+
+void benchmarkRandomValueVector(BenchmarkState &state)
+{
+    RandomGenerator random(1);
+    for (unsigned long long i = 0; i < state.iterations; i++)
+        doNotOptimize(randomValue(random, glm::vec3(1.0f), glm::vec3(0.5f)));
+    state.setItemsPerIteration(1);
+}
+
+void benchmarkRandomValueInterpolated(BenchmarkState &state)
+{
+    RandomGenerator random(1);
+    for (unsigned long long i = 0; i < state.iterations; i++)
+        doNotOptimize(randomValueInterpolated(random, 0.0f, 1.0f));
+    state.setItemsPerIteration(1);
+}
+
+void benchmarkRandomValueInterpolatedVector(BenchmarkState &state)
+{
+    RandomGenerator random(1);
+    for (unsigned long long i = 0; i < state.iterations; i++)
+        doNotOptimize(randomValueInterpolated(random, glm::vec3(0.0f), glm::vec3(1.0f)));
+    state.setItemsPerIteration(1);
+}
+
+void benchmarkSpawnParticle(BenchmarkState &state)
+{
+    Camera camera(glm::vec3(0, 0, 5), 45.0f, 0.01f, 100.0f, 5, 0.1f);
+    ParticleSystem particleSystem((unsigned int)state.argument, &camera);
+    configureFire(particleSystem);
+    particleSystem.setSeed(1);
+
+    // Every iteration respawns the whole particle array
+    state.resetTimer();
+    for (unsigned long long i = 0; i < state.iterations; i++)
+        for (unsigned int index = 0; index < state.argument; index++)
+            particleSystem.spawnParticle(index);
+
+    Particle buffer;
+    doNotOptimize(*particleSystem.getParticles(0, 1, &buffer));
+    state.setItemsPerIteration(state.argument);
+}
+
+void benchmarkParticleUpdate(BenchmarkState &state)
+{
+    std::vector<Particle> particles = buildParticles(state.argument);
+    const glm::vec3 gravity(0.0f, -0.98f, 0.0f);
+
+    state.resetTimer();
+    for (unsigned long long i = 0; i < state.iterations; i++)
+        for (size_t j = 0; j < particles.size(); j++)
+            particles[j].update(1.0f / 60.0f, gravity);
+
+    doNotOptimize(particles[0]);
+    state.setItemsPerIteration(state.argument);
+}
+
+void benchmarkComputeBillBoardMatrix(BenchmarkState &state)
+{
+    Camera camera(glm::vec3(0, 0, 5), 45.0f, 0.01f, 100.0f, 5, 0.1f);
+    std::vector<Particle> particles = buildParticles(state.argument);
+
+    state.resetTimer();
+    for (unsigned long long i = 0; i < state.iterations; i++)
+        for (size_t j = 0; j < particles.size(); j++)
+            doNotOptimize(particles[j].computeBillBoardMatrix(&camera));
+
+    state.setItemsPerIteration(state.argument);
+}
+
+void benchmarkSpatialHashBuild(BenchmarkState &state)
+{
+    std::vector<Particle> particles = buildParticles(state.argument);
+    ThreadPool threadPool;
+    SpatialHash spatialHash(&threadPool);
+
+    state.resetTimer();
+    for (unsigned long long i = 0; i < state.iterations; i++)
+        spatialHash.build(particles, 0.05f);
+
+    doNotOptimize(spatialHash.getNumberOfParticles());
+    state.setItemsPerIteration(state.argument);
+}
+
+void benchmarkSpatialHashQueryRadius(BenchmarkState &state)
+{
+    std::vector<Particle> particles = buildParticles(state.argument);
+    SpatialHash spatialHash;
+    spatialHash.build(particles, 0.05f);
+    std::vector<unsigned int> neighbors;
+
+    // Queries around the particles themselves, the same radius as the cells
+    state.resetTimer();
+    for (unsigned long long i = 0; i < state.iterations; i++)
+    {
+        spatialHash.queryRadius(particles[i % particles.size()].getPosition(), 0.05f, neighbors);
+        doNotOptimize(neighbors.size());
+    }
+
+    state.setItemsPerIteration(1);
+}
+
+void benchmarkSpatialHashQueryNearest(BenchmarkState &state)
+{
+    std::vector<Particle> particles = buildParticles(state.argument);
+    SpatialHash spatialHash;
+    spatialHash.build(particles, 0.05f);
+    std::vector<unsigned int> neighbors;
+
+    state.resetTimer();
+    for (unsigned long long i = 0; i < state.iterations; i++)
+    {
+        spatialHash.queryNearest(particles[i % particles.size()].getPosition(), 8, neighbors);
+        doNotOptimize(neighbors.size());
+    }
+
+    state.setItemsPerIteration(1);
+}
+
+void benchmarkSpatialHashGatherNeighbors(BenchmarkState &state)
+{
+    std::vector<Particle> particles = buildParticles(state.argument);
+    SpatialHash spatialHash;
+    spatialHash.build(particles, 0.05f);
+    unsigned int slots[16];
+    float distancesSquared[16];
+
+    // At most 16 neighbours, the cap the flocks use by default
+    state.resetTimer();
+    for (unsigned long long i = 0; i < state.iterations; i++)
+        doNotOptimize(spatialHash.gatherNeighbors(particles[i % particles.size()].getPosition(), 0.05f, 16, slots, distancesSquared));
+
+    state.setItemsPerIteration(1);
+}
+
+void benchmarkStoreProperty(BenchmarkState &state)
+{
+    // Properties of the fire preset
+    const std::vector<std::pair<std::string, std::string>> properties = {
+        {"maxParticles", "1000"}, {"ttl", "5"}, {"spawnInterval", "0.05"}, {"particlesPerSpawn", "6"},
+        {"position", "0 -1.8 -2.4"}, {"positionVariance", "0 0 0"}, {"direction", "0 1 0"},
+        {"directionScale", "0.8"}, {"directionVariance", "0.532 0.193 0.419"}, {"initialScale", "0.4"},
+        {"finalScale", "3"}, {"scaleVariance", "0.1"}, {"minInitialColor", "1 0.588235 0"},
+        {"maxInitialColor", "1 0.117647 0"}, {"minFinalColor", "0.328431 0.0676183 0"},
+        {"maxFinalColor", "1e-06 7.64705e-07 0"}, {"initialAplha", "0.4"}, {"finalAlpha", "0"},
+        {"alphaVariance", "0.01"}, {"externalForce", "0.227 0 0"}, {"externalForceVelocity", "1"},
+        {"fileTextureName", "assets/textures/spark.png"}};
+    MenuProperties menuProperties = MenuProperties();
+
+    state.resetTimer();
+    for (unsigned long long i = 0; i < state.iterations; i++)
+        for (size_t j = 0; j < properties.size(); j++)
+            doNotOptimize(storeProperty(properties[j].first, properties[j].second, menuProperties));
+
+    state.setItemsPerIteration(properties.size());
+}
+
+void benchmarkGetViewMatrix(BenchmarkState &state)
+{
+    Camera camera(glm::vec3(0, 0, 5), 45.0f, 0.01f, 100.0f, 5, 0.1f);
+
+    state.resetTimer();
+    for (unsigned long long i = 0; i < state.iterations; i++)
+        doNotOptimize(camera.getViewMatrix());
+
+    state.setItemsPerIteration(1);
+}
+
+int main(int argc, char const *argv[])
+{
+    registerBenchmark("randomValue(float)", benchmarkRandomValue);
+    registerBenchmark("randomValue(vec3)", benchmarkRandomValueVector);
+    registerBenchmark("randomValueInterpolated(float)", benchmarkRandomValueInterpolated);
+    registerBenchmark("randomValueInterpolated(vec3)", benchmarkRandomValueInterpolatedVector);
+    registerBenchmark("ParticleSystem::spawnParticle", benchmarkSpawnParticle, particleCounts);
+    registerBenchmark("Particle::update", benchmarkParticleUpdate, particleCounts);
+    registerBenchmark("Particle::computeBillBoardMatrix", benchmarkComputeBillBoardMatrix, particleCounts);
+    registerBenchmark("SpatialHash::build", benchmarkSpatialHashBuild, particleCounts);
+    registerBenchmark("SpatialHash::queryRadius", benchmarkSpatialHashQueryRadius, particleCounts);
+    registerBenchmark("SpatialHash::queryNearest", benchmarkSpatialHashQueryNearest, particleCounts);
+    registerBenchmark("SpatialHash::gatherNeighbors", benchmarkSpatialHashGatherNeighbors, particleCounts);
+    registerBenchmark("storeProperty", benchmarkStoreProperty);
+    registerBenchmark("Camera::getViewMatrix", benchmarkGetViewMatrix);
+
+    return runBenchmarks(argc, argv);
+}
@@ -0,0 +1,432 @@
+/**
+ * Measures the particle system hot paths of the configuration presets
+ * Each configuration is simulated with a fixed time step, after a warm up the time and the hardware
+ * counters (cycles, instructions, cache and branch misses) of the spawn, the particles update and the
+ * draw preparation (the per particle data the renderer uploads) are accumulated per phase.
+ *
+ * Usage: preset-benchmark [options] <configuration.ini>...
+*/
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "camera.h"
+#include "particle-system.h"
+#include "configuration.h"
+#include "perf-counters.h"
+
+/**
+ * Benchmark options read from the command line
+*/
+struct BenchmarkOptions
+{
+    unsigned int frames;                     // Measured frames per run
+    unsigned int warmupFrames;               // Frames simulated before measuring
+    unsigned int repetitions;                // Runs per configuration
+    float timeStep;                          // Simulation time step
+    unsigned int seed;                       // Random seed of the particle systems
+    std::string jsonPath;                    // Where the results are written as JSON, empty doesn't write them
+    std::string jsonDirectory;               // Where each configuration's results are written as <name>.json, empty doesn't write them
+    std::vector<std::string> configurations; // Configuration files to measure
+};
+
+// Measured phases of a frame
+enum BenchmarkPhase
+{
+    SPAWN_PHASE,
+    SIMULATE_PHASE,
+    DRAW_PREPARATION_PHASE,
+    NUMBER_OF_PHASES
+};
+const char *phaseNames[NUMBER_OF_PHASES] = {"spawn", "simulate", "draw_preparation"};
+
+/**
+ * Measurements of a phase in a run
+*/
+struct PhaseResult
+{
+    double milliseconds;                       // Time spent in the phase
+    double particles;                          // Particles processed by the phase
+    bool available[NUMBER_OF_PERF_COUNTERS];   // The counter could be read
+    double counters[NUMBER_OF_PERF_COUNTERS];  // Hardware events counted in the phase
+};
+
+/**
+ * Measurements of every run of a configuration
+*/
+struct PresetResult
+{
+    std::string name;                          // Configuration name
+    std::string path;                          // Configuration file
+    std::vector<PhaseResult> runs[NUMBER_OF_PHASES]; // Result of each run per phase
+};
+
+/**
+ * Per particle data prepared each frame for the renderer
+*/
+struct DrawData
+{
+    glm::mat4 model; // Billboard model matrix
+    glm::vec4 color; // Color and alpha
+    float scale;     // Current scale
+};
+
+/**
+ * Prints the command line usage
+*/
+void printUsage()
+{
+    std::cout << "Usage: preset-benchmark [options] <configuration.ini>..." << std::endl
+              << "  --frames <n>       Measured frames per run (default 600)" << std::endl
+              << "  --warmup <n>       Frames simulated before measuring (default 300)" << std::endl
+              << "  --repetitions <n>  Runs per configuration (default 1)" << std::endl
+              << "  --dt <s>           Simulation time step (default 1/60)" << std::endl
+              << "  --seed <n>         Random seed (default 1)" << std::endl
+              << "  --json <path>      Writes the results as JSON" << std::endl
+              << "  --json-dir <dir>   Writes the results of each configuration as <dir>/<name>.json (i.e baselines)" << std::endl;
+}
+
+/**
+ * Reads the command line options
+ * @return The options are valid
+*/
+bool readOptions(int argc, char const *argv[], BenchmarkOptions &options)
+{
+    options.frames = 600;
+    options.warmupFrames = 300;
+    options.repetitions = 1;
+    options.timeStep = 1.0f / 60.0f;
+    options.seed = 1;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string argument = argv[i];
+        const int remaining = argc - i - 1;
+
+        if (argument == "--frames" && remaining >= 1)
+            options.frames = atoi(argv[++i]);
+        else if (argument == "--warmup" && remaining >= 1)
+            options.warmupFrames = atoi(argv[++i]);
+        else if (argument == "--repetitions" && remaining >= 1)
+            options.repetitions = atoi(argv[++i]);
+        else if (argument == "--dt" && remaining >= 1)
+            options.timeStep = (float)atof(argv[++i]);
+        else if (argument == "--seed" && remaining >= 1)
+            options.seed = atoi(argv[++i]);
+        else if (argument == "--json" && remaining >= 1)
+            options.jsonPath = argv[++i];
+        else if (argument == "--json-dir" && remaining >= 1)
+            options.jsonDirectory = argv[++i];
+        else if (argument.compare(0, 2, "--") == 0)
+            return false;
+        else
+            options.configurations.push_back(argument);
+    }
+
+    return !options.configurations.empty() && options.frames > 0 && options.repetitions > 0 && options.timeStep > 0.0f;
+}
+
+/**
+ * Gets the name of a configuration file without folder and extension
+ * @param path Path to the configuration file
+ * @return Configuration name, i.e assets/configurations/fire.ini -> fire
+*/
+std::string configurationName(const std::string &path)
+{
+    const size_t slash = path.find_last_of("/\\");
+    std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+    const size_t dot = name.find_last_of('.');
+    return dot == std::string::npos ? name : name.substr(0, dot);
+}
+
+/**
+ * Computes the data the renderer needs for every alive particle
+ * @param particleSystem Particle system to be drawn
+ * @param drawData Where the data is stored
+ * @return Number of alive particles
+*/
+unsigned int prepareDraw(ParticleSystem &particleSystem, std::vector<DrawData> &drawData)
+{
+    // The particles are read a chunk at a time, like the renderers do
+    const unsigned int chunkSize = 4096;
+    const unsigned int numberOfParticles = particleSystem.getMaxAmountOfParticles();
+    std::vector<Particle> buffer(std::min(chunkSize, numberOfParticles));
+    Camera *camera = particleSystem.getCamera();
+
+    unsigned int alive = 0;
+    for (unsigned int first = 0; first < numberOfParticles; first += chunkSize)
+    {
+        const unsigned int count = std::min(chunkSize, numberOfParticles - first);
+        const Particle *particles = particleSystem.getParticles(first, count, buffer.data());
+        for (unsigned int i = 0; i < count; i++)
+        {
+            if (!particles[i].isAlive())
+                continue;
+
+            DrawData &data = drawData[alive++];
+            data.model = particles[i].computeBillBoardMatrix(camera);
+            data.color = particles[i].getColor();
+            data.scale = particles[i].getScale();
+        }
+    }
+    return alive;
+}
+
+/**
+ * Simulates a configuration and measures its phases
+ * @param properties Configuration properties
+ * @param counters Hardware counters of each phase
+ * @param result Where the measurements of each phase are added
+*/
+void run(const MenuProperties &properties, const BenchmarkOptions &options, PerfCounters *counters, PresetResult &result)
+{
+    // Same camera as the application
+    Camera camera(glm::vec3(0, 0, 5), 45.0f, 0.01f, 100.0f, 5, 0.1f);
+    ParticleSystem particleSystem(properties.maxParticles, &camera);
+    applyProperties(&particleSystem, properties);
+    // Fixed seed so every run simulates the same particles
+    particleSystem.setSeed(options.seed);
+
+    std::vector<DrawData> drawData(properties.maxParticles);
+    for (unsigned int i = 0; i < options.warmupFrames; i++)
+    {
+        particleSystem.update(options.timeStep);
+        prepareDraw(particleSystem, drawData);
+    }
+
+    double milliseconds[NUMBER_OF_PHASES] = {0.0, 0.0, 0.0};
+    double particles[NUMBER_OF_PHASES] = {0.0, 0.0, 0.0};
+    for (int phase = 0; phase < NUMBER_OF_PHASES; phase++)
+        counters[phase].reset();
+
+    typedef std::chrono::steady_clock Clock;
+    for (unsigned int i = 0; i < options.frames; i++)
+    {
+        Clock::time_point start = Clock::now();
+        counters[SPAWN_PHASE].start();
+        particles[SPAWN_PHASE] += particleSystem.emit(options.timeStep);
+        counters[SPAWN_PHASE].stop();
+        Clock::time_point end = Clock::now();
+        milliseconds[SPAWN_PHASE] += std::chrono::duration<double, std::milli>(end - start).count();
+
+        start = Clock::now();
+        counters[SIMULATE_PHASE].start();
+        particleSystem.simulate(options.timeStep);
+        counters[SIMULATE_PHASE].stop();
+        end = Clock::now();
+        milliseconds[SIMULATE_PHASE] += std::chrono::duration<double, std::milli>(end - start).count();
+        particles[SIMULATE_PHASE] += properties.maxParticles;
+
+        start = Clock::now();
+        counters[DRAW_PREPARATION_PHASE].start();
+        particles[DRAW_PREPARATION_PHASE] += prepareDraw(particleSystem, drawData);
+        counters[DRAW_PREPARATION_PHASE].stop();
+        end = Clock::now();
+        milliseconds[DRAW_PREPARATION_PHASE] += std::chrono::duration<double, std::milli>(end - start).count();
+    }
+
+    for (int phase = 0; phase < NUMBER_OF_PHASES; phase++)
+    {
+        PhaseResult phaseResult;
+        phaseResult.milliseconds = milliseconds[phase];
+        phaseResult.particles = particles[phase];
+        for (int counter = 0; counter < NUMBER_OF_PERF_COUNTERS; counter++)
+        {
+            phaseResult.available[counter] = counters[phase].isAvailable((PerfCounter)counter);
+            phaseResult.counters[counter] = counters[phase].getValue((PerfCounter)counter);
+        }
+        result.runs[phase].push_back(phaseResult);
+    }
+}
+
+/**
+ * Gets the sum of a phase over every run
+ * @param runs Results of each run
+ * @return Total of the runs
+*/
+PhaseResult sumRuns(const std::vector<PhaseResult> &runs)
+{
+    PhaseResult total = runs[0];
+    for (size_t i = 1; i < runs.size(); i++)
+    {
+        total.milliseconds += runs[i].milliseconds;
+        total.particles += runs[i].particles;
+        for (int counter = 0; counter < NUMBER_OF_PERF_COUNTERS; counter++)
+            total.counters[counter] += runs[i].counters[counter];
+    }
+    return total;
+}
+
+/**
+ * Prints the results of a configuration: time per frame, IPC and events per particle of each phase
+*/
+void printResult(const PresetResult &result, const BenchmarkOptions &options)
+{
+    const double frames = (double)options.frames * options.repetitions;
+
+    std::cout << std::fixed << std::setprecision(3)
+              << "  phase               ms/frame  particles/frame      IPC  cycles/p  L1D miss/p  LLC miss/p  br miss/p" << std::endl;
+    for (int phase = 0; phase < NUMBER_OF_PHASES; phase++)
+    {
+        const PhaseResult total = sumRuns(result.runs[phase]);
+        const double particles = total.particles > 0.0 ? total.particles : 1.0;
+
+        std::cout << "  " << std::left << std::setw(18) << phaseNames[phase] << std::right
+                  << std::setw(10) << total.milliseconds / frames
+                  << std::setw(17) << std::setprecision(0) << total.particles / frames << std::setprecision(3);
+
+        // IPC and the events per particle, only for the counters that could be read
+        if (total.available[PERF_CYCLES] && total.available[PERF_INSTRUCTIONS] && total.counters[PERF_CYCLES] > 0.0)
+            std::cout << std::setw(9) << total.counters[PERF_INSTRUCTIONS] / total.counters[PERF_CYCLES];
+        else
+            std::cout << std::setw(9) << "-";
+
+        const PerfCounter perParticle[] = {PERF_CYCLES, PERF_L1D_MISSES, PERF_LLC_MISSES, PERF_BRANCH_MISSES};
+        const int widths[] = {10, 12, 12, 11};
+        for (int i = 0; i < 4; i++)
+        {
+            if (total.available[perParticle[i]])
+                std::cout << std::setw(widths[i]) << total.counters[perParticle[i]] / particles;
+            else
+                std::cout << std::setw(widths[i]) << "-";
+        }
+        std::cout << std::endl;
+    }
+}
+
+/**
+ * Writes every result as JSON
+ * Each phase has the time per frame of every run, so runs can be compared statistically,
+ * and the hardware events per frame (mean of the runs, null if the counter isn't available)
+ * @return The file was written
+*/
+bool writeJson(const std::string &path, const std::vector<PresetResult> &results, const BenchmarkOptions &options)
+{
+    std::ofstream file(path.c_str());
+    if (!file.is_open())
+        return false;
+
+    file << std::setprecision(9);
+    file << "{" << std::endl
+         << "  \"benchmark\": \"preset-benchmark\"," << std::endl
+         << "  \"frames\": " << options.frames << "," << std::endl
+         << "  \"warmup_frames\": " << options.warmupFrames << "," << std::endl
+         << "  \"repetitions\": " << options.repetitions << "," << std::endl
+         << "  \"dt\": " << options.timeStep << "," << std::endl
+         << "  \"seed\": " << options.seed << "," << std::endl
+         << "  \"presets\": [";
+
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const PresetResult &result = results[i];
+        file << (i == 0 ? "" : ",") << std::endl
+             << "    {" << std::endl
+             << "      \"name\": \"" << result.name << "\"," << std::endl
+             << "      \"configuration\": \"" << result.path << "\"," << std::endl
+             << "      \"phases\": [";
+
+        for (int phase = 0; phase < NUMBER_OF_PHASES; phase++)
+        {
+            const std::vector<PhaseResult> &runs = result.runs[phase];
+            const PhaseResult total = sumRuns(runs);
+            const double frames = (double)options.frames * runs.size();
+
+            file << (phase == 0 ? "" : ",") << std::endl
+                 << "        {" << std::endl
+                 << "          \"name\": \"" << phaseNames[phase] << "\"," << std::endl
+                 << "          \"particles_per_frame\": " << total.particles / frames << "," << std::endl
+                 << "          \"ms_per_frame\": [";
+            for (size_t run = 0; run < runs.size(); run++)
+                file << (run == 0 ? "" : ", ") << runs[run].milliseconds / options.frames;
+            file << "]," << std::endl
+                 << "          \"counters_per_frame\": {";
+            for (int counter = 0; counter < NUMBER_OF_PERF_COUNTERS; counter++)
+            {
+                file << (counter == 0 ? "" : ", ") << "\"" << PerfCounters::getName((PerfCounter)counter) << "\": ";
+                if (total.available[counter])
+                    file << total.counters[counter] / frames;
+                else
+                    file << "null";
+            }
+            file << "}" << std::endl
+                 << "        }";
+        }
+        file << std::endl
+             << "      ]" << std::endl
+             << "    }";
+    }
+    file << std::endl
+         << "  ]" << std::endl
+         << "}" << std::endl;
+
+    return file.good();
+}
+
+int main(int argc, char const *argv[])
+{
+    BenchmarkOptions options;
+    if (!readOptions(argc, argv, options))
+    {
+        printUsage();
+        return 2;
+    }
+
+    // The counters are opened once, each phase has its own set
+    PerfCounters counters[NUMBER_OF_PHASES];
+    if (!counters[0].isAvailable())
+        std::cout << "Hardware counters unavailable, measuring time only (" << counters[0].getError() << ")" << std::endl;
+    else if (!counters[0].getError().empty())
+        std::cout << "Some hardware counters are unavailable (" << counters[0].getError() << ")" << std::endl;
+
+    std::vector<PresetResult> results;
+    bool succeeded = true;
+    for (size_t i = 0; i < options.configurations.size(); i++)
+    {
+        const std::string &path = options.configurations[i];
+        MenuProperties properties = MenuProperties();
+        if (!readConfiguration(path, properties))
+        {
+            std::cout << "Unable to read " << path << std::endl;
+            succeeded = false;
+            continue;
+        }
+
+        PresetResult result;
+        result.name = configurationName(path);
+        result.path = path;
+        for (unsigned int repetition = 0; repetition < options.repetitions; repetition++)
+            run(properties, options, counters, result);
+
+        std::cout << result.name << " (" << properties.maxParticles << " particles)" << std::endl;
+        printResult(result, options);
+        results.push_back(result);
+    }
+
+    if (!options.jsonPath.empty() && !writeJson(options.jsonPath, results, options))
+    {
+        std::cout << "Unable to write " << options.jsonPath << std::endl;
+        return 1;
+    }
+
+    if (!options.jsonDirectory.empty())
+    {
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            const std::string path = options.jsonDirectory + "/" + results[i].name + ".json";
+            if (!writeJson(path, std::vector<PresetResult>(1, results[i]), options))
+            {
+                std::cout << "Unable to write " << path << std::endl;
+                return 1;
+            }
+        }
+    }
+
+    return succeeded ? 0 : 1;
+}
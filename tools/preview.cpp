@@ -0,0 +1,278 @@
+/**
+ * Renders the particle system configurations without a GPU
+ * Each configuration is simulated with a fixed time step and drawn with the software renderer,
+ * the images can be written or compared against reference (golden) images.
+ * Replay logs recorded by the application are simulated step by step and rendered the same way,
+ * the state hash printed for each image is bitwise reproducible across runs and thread counts.
+ *
+ * Usage: particle-preview [options] <configuration.ini>...
+*/
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <stb_image.h>
+
+#include "camera.h"
+#include "particle-system.h"
+#include "configuration.h"
+#include "replay-log.h"
+#include "software-renderer.h"
+#include "thread-pool.h"
+
+/**
+ * Preview options read from the command line
+*/
+struct PreviewOptions
+{
+    float seconds;                           // Simulated time before the image is rendered
+    float timeStep;                          // Simulation time step
+    unsigned int width;                      // Image width
+    unsigned int height;                     // Image height
+    unsigned int seed;                       // Random seed of the particle systems
+    unsigned int threads;                    // Rendering threads, 0 uses every core
+    std::string outputDirectory;             // Where the images are written
+    std::string referenceDirectory;          // Where the reference images are read, empty doesn't compare
+    int tolerance;                           // Maximun channel difference against the reference
+    std::vector<std::string> configurations; // Configuration files to render
+    std::vector<std::string> replays;        // Replay logs to render
+};
+
+/**
+ * Prints the command line usage
+*/
+void printUsage()
+{
+    std::cout << "Usage: particle-preview [options] <configuration.ini>..." << std::endl
+              << "  --replay <log>     Replays a recorded simulation and renders its last step, can be repeated" << std::endl
+              << "  --seconds <s>      Simulated time before rendering (default 5)" << std::endl
+              << "  --dt <s>           Simulation time step (default 1/60)" << std::endl
+              << "  --size <w> <h>     Image size (default 800 600)" << std::endl
+              << "  --seed <n>         Random seed (default 1)" << std::endl
+              << "  --threads <n>      Rendering threads, 0 uses every core (default 0)" << std::endl
+              << "  --output <dir>     Folder where the images are written (default .)" << std::endl
+              << "  --compare <dir>    Compares the images against the references in <dir>" << std::endl
+              << "  --tolerance <n>    Maximun channel difference when comparing (default 2)" << std::endl;
+}
+
+/**
+ * Reads the command line options
+ * @return The options are valid
+*/
+bool readOptions(int argc, char const *argv[], PreviewOptions &options)
+{
+    options.seconds = 5.0f;
+    options.timeStep = 1.0f / 60.0f;
+    options.width = 800;
+    options.height = 600;
+    options.seed = 1;
+    options.threads = 0;
+    options.outputDirectory = ".";
+    options.tolerance = 2;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string argument = argv[i];
+        const int remaining = argc - i - 1;
+
+        if (argument == "--seconds" && remaining >= 1)
+            options.seconds = (float)atof(argv[++i]);
+        else if (argument == "--dt" && remaining >= 1)
+            options.timeStep = (float)atof(argv[++i]);
+        else if (argument == "--size" && remaining >= 2)
+        {
+            options.width = atoi(argv[++i]);
+            options.height = atoi(argv[++i]);
+        }
+        else if (argument == "--seed" && remaining >= 1)
+            options.seed = atoi(argv[++i]);
+        else if (argument == "--threads" && remaining >= 1)
+            options.threads = atoi(argv[++i]);
+        else if (argument == "--output" && remaining >= 1)
+            options.outputDirectory = argv[++i];
+        else if (argument == "--compare" && remaining >= 1)
+            options.referenceDirectory = argv[++i];
+        else if (argument == "--tolerance" && remaining >= 1)
+            options.tolerance = atoi(argv[++i]);
+        else if (argument == "--replay" && remaining >= 1)
+            options.replays.push_back(argv[++i]);
+        else if (argument.compare(0, 2, "--") == 0)
+            return false;
+        else
+            options.configurations.push_back(argument);
+    }
+
+    return (!options.configurations.empty() || !options.replays.empty()) && options.width > 0 && options.height > 0 && options.timeStep > 0.0f;
+}
+
+/**
+ * Gets the name of a configuration file without folder and extension
+ * @param path Path to the configuration file
+ * @return Configuration name, i.e assets/configurations/fire.ini -> fire
+*/
+std::string configurationName(const std::string &path)
+{
+    const size_t slash = path.find_last_of("/\\");
+    std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+    const size_t dot = name.find_last_of('.');
+    return dot == std::string::npos ? name : name.substr(0, dot);
+}
+
+/**
+ * Compares a rendered image against a reference image
+ * @param pixels Rendered RGBA pixels, bottom row first
+ * @param path Path to the reference image
+ * @param tolerance Maximun channel difference allowed
+ * @return The images match
+*/
+bool compareImage(const std::vector<unsigned char> &pixels, unsigned int width, unsigned int height,
+                  const std::string &path, int tolerance)
+{
+    int referenceWidth, referenceHeight, channels;
+    // The reference is stored top row first, it's flipped to match the rendered pixels
+    stbi_set_flip_vertically_on_load(true);
+    unsigned char *reference = stbi_load(path.c_str(), &referenceWidth, &referenceHeight, &channels, 4);
+    if (!reference)
+    {
+        std::cout << "  Unable to load the reference image " << path << std::endl;
+        return false;
+    }
+
+    bool match = (unsigned int)referenceWidth == width && (unsigned int)referenceHeight == height;
+    int maxDifference = 0;
+    size_t differentPixels = 0;
+
+    if (match)
+    {
+        for (size_t i = 0; i < pixels.size(); i += 4)
+        {
+            int pixelDifference = 0;
+            for (int channel = 0; channel < 4; channel++)
+                pixelDifference = std::max(pixelDifference, abs((int)pixels[i + channel] - (int)reference[i + channel]));
+
+            maxDifference = std::max(maxDifference, pixelDifference);
+            if (pixelDifference > tolerance)
+                differentPixels++;
+        }
+        match = differentPixels == 0;
+        std::cout << "  Max difference " << maxDifference << ", " << differentPixels << " pixels over the tolerance" << std::endl;
+    }
+    else
+        std::cout << "  Reference size " << referenceWidth << "x" << referenceHeight << " doesn't match" << std::endl;
+
+    stbi_image_free(reference);
+    return match;
+}
+
+/**
+ * Renders a simulated particle system
+ * @param particleSystem Particle system to render
+ * @param texturePath Path to the particle texture
+ * @param name Name of the image
+ * @return The image was written or matches its reference
+*/
+bool render(ParticleSystem *particleSystem, const std::string &texturePath, const std::string &name,
+            const PreviewOptions &options, ThreadPool *threadPool)
+{
+    std::cout << "  State hash " << std::hex << std::setw(16) << std::setfill('0') << particleSystem->computeStateHash()
+              << std::dec << std::setfill(' ') << std::endl;
+
+    SoftwareRenderer renderer(options.width, options.height, threadPool);
+    if (!renderer.loadTexture(texturePath.c_str()))
+        std::cout << "  Unable to load texture " << texturePath << ", using a white texture" << std::endl;
+
+    // Same clear color as the application
+    renderer.clear(glm::vec4(0.3f, 0.3f, 0.3f, 1.0f));
+    renderer.draw(particleSystem);
+
+    const std::string image = name + ".png";
+    if (!options.referenceDirectory.empty())
+        return compareImage(renderer.getPixels(), options.width, options.height,
+                            options.referenceDirectory + "/" + image, options.tolerance);
+
+    const std::string output = options.outputDirectory + "/" + image;
+    if (!renderer.save(output))
+    {
+        std::cout << "  Unable to write " << output << std::endl;
+        return false;
+    }
+    std::cout << "  " << output << std::endl;
+    return true;
+}
+
+/**
+ * Simulates and renders a configuration
+ * @return The image was written or matches its reference
+*/
+bool preview(const std::string &path, const PreviewOptions &options, ThreadPool *threadPool)
+{
+    std::cout << path << std::endl;
+
+    MenuProperties properties = MenuProperties();
+    if (!readConfiguration(path, properties))
+        return false;
+
+    // Same camera as the application
+    Camera camera(glm::vec3(0, 0, 5), 45.0f, 0.01f, 100.0f, 5, 0.1f);
+    ParticleSystem particleSystem(properties.maxParticles, &camera);
+    particleSystem.setThreadPool(threadPool);
+    applyProperties(&particleSystem, properties);
+    // Fixed seed so the image is the same on every run
+    particleSystem.setSeed(options.seed);
+    particleSystem.prewarm(properties.prewarmTime);
+
+    const unsigned int steps = (unsigned int)(options.seconds / options.timeStep + 0.5f);
+    for (unsigned int i = 0; i < steps; i++)
+        particleSystem.update(options.timeStep);
+
+    return render(&particleSystem, properties.fileTextureName, configurationName(path), options, threadPool);
+}
+
+/**
+ * Simulates and renders a replay log
+ * @return The image was written or matches its reference
+*/
+bool replay(const std::string &path, const PreviewOptions &options, ThreadPool *threadPool)
+{
+    std::cout << path << std::endl;
+
+    // Same camera as the application
+    Camera camera(glm::vec3(0, 0, 5), 45.0f, 0.01f, 100.0f, 5, 0.1f);
+    ReplayPlayer player(&camera);
+    if (!player.load(path))
+        return false;
+
+    player.run();
+    if (!player.getParticleSystem())
+    {
+        std::cout << "  The log doesn't build a particle system" << std::endl;
+        return false;
+    }
+    std::cout << "  Replayed " << player.getSteps() << " steps" << std::endl;
+
+    return render(player.getParticleSystem(), player.getProperties().fileTextureName, configurationName(path), options, threadPool);
+}
+
+int main(int argc, char const *argv[])
+{
+    PreviewOptions options;
+    if (!readOptions(argc, argv, options))
+    {
+        printUsage();
+        return 2;
+    }
+
+    ThreadPool threadPool(options.threads);
+
+    bool succeeded = true;
+    for (size_t i = 0; i < options.configurations.size(); i++)
+        succeeded = preview(options.configurations[i], options, &threadPool) && succeeded;
+    for (size_t i = 0; i < options.replays.size(); i++)
+        succeeded = replay(options.replays[i], options, &threadPool) && succeeded;
+
+    return succeeded ? 0 : 1;
+}
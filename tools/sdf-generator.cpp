@@ -0,0 +1,150 @@
+/**
+ * Writes the distance volume files of the sdf colliders
+ * The signed distance of an analytic shape is sampled on a regular grid around it and saved
+ * in the format DistanceVolume::load reads, the shape is centered on the origin of the volume.
+ *
+ * Usage: sdf-generator [options] <output.sdf>
+*/
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "collider.h"
+
+/**
+ * Shapes the generator can sample
+*/
+enum Shape
+{
+    SHAPE_SPHERE, // Sphere of radius 1
+    SHAPE_BOX,    // Cube of half extent 1
+    SHAPE_TORUS,  // Torus around the y axis, radius 1 to the center of its tube
+    NUMBER_OF_SHAPES
+};
+
+const char *shapeNames[NUMBER_OF_SHAPES] = {"sphere", "box", "torus"};
+
+/**
+ * Generator options read from the command line
+*/
+struct GeneratorOptions
+{
+    int shape;               // Shape
+    unsigned int resolution; // Samples along each axis
+    float thickness;         // Radius of the tube of the torus
+    float margin;            // Distance between the shape and the bounds of the volume
+    std::string output;      // Path to the volume file
+};
+
+/**
+ * Prints the command line usage
+*/
+void printUsage()
+{
+    std::cout << "Usage: sdf-generator [options] <output.sdf>" << std::endl
+              << "  --shape <name>      sphere, box or torus (default torus)" << std::endl
+              << "  --resolution <n>    Samples along each axis, 2 to 512 (default 32)" << std::endl
+              << "  --thickness <r>     Radius of the tube of the torus (default 0.35)" << std::endl
+              << "  --margin <d>        Space around the shape inside the volume (default 0.25)" << std::endl;
+}
+
+/**
+ * Reads the command line options
+ * @return The options are valid
+*/
+bool readOptions(int argc, char const *argv[], GeneratorOptions &options)
+{
+    options.shape = SHAPE_TORUS;
+    options.resolution = 32;
+    options.thickness = 0.35f;
+    options.margin = 0.25f;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string argument = argv[i];
+        const int remaining = argc - i - 1;
+
+        if (argument == "--shape" && remaining >= 1)
+        {
+            const std::string name = argv[++i];
+            options.shape = NUMBER_OF_SHAPES;
+            for (int shape = 0; shape < NUMBER_OF_SHAPES; shape++)
+                if (name == shapeNames[shape])
+                    options.shape = shape;
+        }
+        else if (argument == "--resolution" && remaining >= 1)
+            options.resolution = atoi(argv[++i]);
+        else if (argument == "--thickness" && remaining >= 1)
+            options.thickness = (float)atof(argv[++i]);
+        else if (argument == "--margin" && remaining >= 1)
+            options.margin = (float)atof(argv[++i]);
+        else if (argument.compare(0, 2, "--") == 0 || !options.output.empty())
+            return false;
+        else
+            options.output = argument;
+    }
+
+    return !options.output.empty() && options.shape != NUMBER_OF_SHAPES && options.resolution >= 2 && options.resolution <= 512 &&
+           options.thickness > 0.0f && options.margin >= 0.0f;
+}
+
+/**
+ * Computes the signed distance to a shape
+ * @param position Position
+ * @return Distance, negative inside the shape
+*/
+float distance(glm::vec3 position, const GeneratorOptions &options)
+{
+    switch (options.shape)
+    {
+    case SHAPE_SPHERE:
+        return glm::length(position) - 1.0f;
+    case SHAPE_BOX:
+    {
+        const glm::vec3 q = glm::abs(position) - 1.0f;
+        return glm::length(glm::max(q, glm::vec3(0.0f))) + glm::min(glm::max(q.x, glm::max(q.y, q.z)), 0.0f);
+    }
+    default:
+    {
+        const glm::vec2 q(glm::length(glm::vec2(position.x, position.z)) - 1.0f, position.y);
+        return glm::length(q) - options.thickness;
+    }
+    }
+}
+
+int main(int argc, char const *argv[])
+{
+    GeneratorOptions options;
+    if (!readOptions(argc, argv, options))
+    {
+        printUsage();
+        return 2;
+    }
+
+    // The torus is flat, its bounds are only as high as its tube
+    const float height = options.shape == SHAPE_TORUS ? options.thickness : 1.0f;
+    const float width = options.shape == SHAPE_TORUS ? 1.0f + options.thickness : 1.0f;
+    const glm::vec3 boundsMax = glm::vec3(width, height, width) + options.margin;
+    const glm::vec3 boundsMin = -boundsMax;
+
+    const unsigned int resolution = options.resolution;
+    std::vector<float> distances((size_t)resolution * resolution * resolution);
+    size_t sample = 0;
+    for (unsigned int z = 0; z < resolution; z++)
+        for (unsigned int y = 0; y < resolution; y++)
+            for (unsigned int x = 0; x < resolution; x++)
+            {
+                const glm::vec3 position = glm::mix(boundsMin, boundsMax, glm::vec3(x, y, z) / (float)(resolution - 1));
+                distances[sample++] = distance(position, options);
+            }
+
+    const DistanceVolume volume(glm::uvec3(resolution), boundsMin, boundsMax, distances);
+    if (!volume.save(options.output))
+        return 1;
+
+    std::cout << options.output << ": " << shapeNames[options.shape] << ", " << resolution << "^3 samples" << std::endl;
+    return 0;
+}